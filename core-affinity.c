@@ -20,14 +20,55 @@
 #include "stress-ng.h"
 #include "core-affinity.h"
 #include "core-builtin.h"
+#include "core-cpu-cache.h"
+#include "core-numa.h"
 
 #include <sched.h>
 
 static const char option[] = "taskset";
 
+/* --placement policies */
+#define STRESS_PLACEMENT_NONE		(0)
+#define STRESS_PLACEMENT_COMPACT	(1)
+#define STRESS_PLACEMENT_SCATTER_CORE	(2)
+#define STRESS_PLACEMENT_SCATTER_LLC	(3)
+#define STRESS_PLACEMENT_NUMA		(4)
+#define STRESS_PLACEMENT_SMT_PAIRED	(5)
+
+#define STRESS_PLACEMENT_KEYS		(6)	/* sort keys per CPU */
+
+typedef struct {
+	const char *name;		/* --placement policy name */
+	const int policy;		/* STRESS_PLACEMENT_* policy */
+} stress_placement_method_t;
+
+/* indexed by policy */
+static const stress_placement_method_t stress_placement_methods[] = {
+	{ "none",		STRESS_PLACEMENT_NONE },
+	{ "compact",		STRESS_PLACEMENT_COMPACT },
+	{ "scatter-core",	STRESS_PLACEMENT_SCATTER_CORE },
+	{ "scatter-llc",	STRESS_PLACEMENT_SCATTER_LLC },
+	{ "numa-node",		STRESS_PLACEMENT_NUMA },
+	{ "smt-paired",		STRESS_PLACEMENT_SMT_PAIRED },
+};
+
 #if defined(HAVE_SCHED_SETAFFINITY)
 
+/* CPU topology and derived ranks used to order CPUs */
+typedef struct {
+	stress_cpu_topology_t topo;	/* CPU, core, package and LLC ids */
+	int32_t core;			/* core id, CPU number if unknown */
+	int32_t node;			/* NUMA node, -1 if unknown */
+	int32_t thread_rank;		/* nth SMT thread of its core */
+	int32_t core_rank;		/* nth core of its last level cache */
+	int32_t node_rank;		/* nth CPU of its NUMA node, scatter-core order */
+} stress_placement_cpu_t;
+
 static cpu_set_t stress_affinity_cpu_set;
+static int placement_policy = STRESS_PLACEMENT_NONE;
+static int placement_sort_policy = STRESS_PLACEMENT_NONE;
+static int32_t *placement_cpus;		/* CPUs in placement order */
+static uint32_t placement_cpus_count;
 
 /*
  * stress_check_cpu_affinity_range()
@@ -168,6 +209,245 @@ int stress_change_cpu(stress_args_t *args, const int old_cpu)
 	return (int)from_cpu;
 }
 
+/*
+ *  stress_set_placement()
+ *	set the --placement instance CPU placement policy
+ */
+int stress_set_placement(const char *arg)
+{
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(stress_placement_methods); i++) {
+		if (!strcmp(arg, stress_placement_methods[i].name)) {
+			placement_policy = stress_placement_methods[i].policy;
+			return 0;
+		}
+	}
+	(void)fprintf(stderr, "placement: invalid policy '%s', allowed policies:", arg);
+	for (i = 0; i < SIZEOF_ARRAY(stress_placement_methods); i++)
+		(void)fprintf(stderr, " %s", stress_placement_methods[i].name);
+	(void)fprintf(stderr, "\n");
+	return -1;
+}
+
+/*
+ *  stress_placement_set_keys()
+ *	fill in the sort keys of a CPU, most significant first
+ */
+static inline void stress_placement_set_keys(
+	int32_t keys[STRESS_PLACEMENT_KEYS],
+	const int32_t k0, const int32_t k1, const int32_t k2,
+	const int32_t k3, const int32_t k4, const int32_t k5)
+{
+	keys[0] = k0;
+	keys[1] = k1;
+	keys[2] = k2;
+	keys[3] = k3;
+	keys[4] = k4;
+	keys[5] = k5;
+}
+
+/*
+ *  stress_placement_keys()
+ *	sort keys of a CPU for the given placement policy
+ */
+static void stress_placement_keys(
+	const int policy,
+	const stress_placement_cpu_t *c,
+	int32_t keys[STRESS_PLACEMENT_KEYS])
+{
+	const stress_cpu_topology_t *t = &c->topo;
+
+	switch (policy) {
+	case STRESS_PLACEMENT_SCATTER_CORE:
+		/* a different core per instance before using SMT siblings */
+		stress_placement_set_keys(keys, c->thread_rank, t->package_id,
+			t->llc_id, c->core, t->cpu, 0);
+		break;
+	case STRESS_PLACEMENT_SCATTER_LLC:
+		/* round-robin over the last level caches */
+		stress_placement_set_keys(keys, c->thread_rank, c->core_rank,
+			t->package_id, t->llc_id, c->core, t->cpu);
+		break;
+	case STRESS_PLACEMENT_NUMA:
+		/* round-robin over the NUMA nodes */
+		stress_placement_set_keys(keys, c->node_rank, c->node,
+			t->cpu, 0, 0, 0);
+		break;
+	case STRESS_PLACEMENT_SMT_PAIRED:
+		/* SMT siblings adjacent, cores round-robin over the LLCs */
+		stress_placement_set_keys(keys, c->core_rank, t->package_id,
+			t->llc_id, c->core, c->thread_rank, t->cpu);
+		break;
+	case STRESS_PLACEMENT_COMPACT:
+	default:
+		/* fill SMT siblings, then cores, then LLCs, then packages */
+		stress_placement_set_keys(keys, t->package_id, t->llc_id,
+			c->core, c->thread_rank, t->cpu, 0);
+		break;
+	}
+}
+
+/*
+ *  stress_placement_cmp()
+ *	qsort comparator, order CPUs by the current sort policy
+ */
+static int stress_placement_cmp(const void *p1, const void *p2)
+{
+	int32_t k1[STRESS_PLACEMENT_KEYS], k2[STRESS_PLACEMENT_KEYS];
+	size_t i;
+
+	stress_placement_keys(placement_sort_policy, (const stress_placement_cpu_t *)p1, k1);
+	stress_placement_keys(placement_sort_policy, (const stress_placement_cpu_t *)p2, k2);
+	for (i = 0; i < STRESS_PLACEMENT_KEYS; i++) {
+		if (k1[i] != k2[i])
+			return (k1[i] < k2[i]) ? -1 : 1;
+	}
+	return 0;
+}
+
+/*
+ *  stress_placement_init()
+ *	order the CPUs this process may use according to the
+ *	--placement policy, instance N is pinned to the Nth
+ *	CPU in this order (modulo the number of CPUs)
+ */
+void stress_placement_init(void)
+{
+	stress_cpu_topology_t *topology;
+	stress_placement_cpu_t *cpus;
+	uint32_t i, j, n;
+	int32_t max_thread_rank = 0;
+	char buf[1024];
+	size_t len;
+
+	if (placement_policy == STRESS_PLACEMENT_NONE)
+		return;
+
+	topology = stress_cpu_topology_get(&n);
+	if (!topology) {
+		pr_inf("placement: cannot determine CPU topology, ignoring --placement\n");
+		return;
+	}
+	cpus = (stress_placement_cpu_t *)calloc((size_t)n, sizeof(*cpus));
+	placement_cpus = (int32_t *)calloc((size_t)n, sizeof(*placement_cpus));
+	if (!cpus || !placement_cpus) {
+		pr_inf("placement: cannot allocate %" PRIu32 " CPU placement entries, "
+			"ignoring --placement\n", n);
+		goto tidy;
+	}
+
+	for (i = 0; i < n; i++) {
+		stress_placement_cpu_t *c = &cpus[i];
+
+		c->topo = topology[i];
+		/* unknown core ids, treat each CPU as a core */
+		c->core = (c->topo.core_id >= 0) ? c->topo.core_id : c->topo.cpu;
+		c->node = stress_numa_cpu_node(c->topo.cpu);
+	}
+	for (i = 0; i < n; i++) {
+		stress_placement_cpu_t *c = &cpus[i];
+
+		for (j = 0; j < n; j++) {
+			const stress_placement_cpu_t *o = &cpus[j];
+
+			if ((o->topo.package_id == c->topo.package_id) &&
+			    (o->core == c->core) && (o->topo.cpu < c->topo.cpu))
+				c->thread_rank++;
+		}
+		if (max_thread_rank < c->thread_rank)
+			max_thread_rank = c->thread_rank;
+	}
+	for (i = 0; i < n; i++) {
+		stress_placement_cpu_t *c = &cpus[i];
+
+		for (j = 0; j < n; j++) {
+			const stress_placement_cpu_t *o = &cpus[j];
+
+			if ((o->thread_rank == 0) &&
+			    (o->topo.package_id == c->topo.package_id) &&
+			    (o->topo.llc_id == c->topo.llc_id) && (o->core < c->core))
+				c->core_rank++;
+		}
+	}
+
+	/* NUMA node ranks follow the scatter-core order within each node */
+	placement_sort_policy = STRESS_PLACEMENT_SCATTER_CORE;
+	qsort(cpus, (size_t)n, sizeof(*cpus), stress_placement_cmp);
+	for (i = 0; i < n; i++) {
+		for (j = 0; j < i; j++) {
+			if (cpus[j].node == cpus[i].node)
+				cpus[i].node_rank++;
+		}
+	}
+	placement_sort_policy = placement_policy;
+	qsort(cpus, (size_t)n, sizeof(*cpus), stress_placement_cmp);
+
+	for (len = 0, i = 0; i < n; i++) {
+		placement_cpus[i] = cpus[i].topo.cpu;
+		if (len < sizeof(buf) - 16)
+			len += (size_t)snprintf(buf + len, sizeof(buf) - len, " %" PRId32, placement_cpus[i]);
+		else if (len < sizeof(buf) - 4)
+			len += (size_t)snprintf(buf + len, sizeof(buf) - len, " ...");
+	}
+	placement_cpus_count = n;
+
+	if ((placement_policy == STRESS_PLACEMENT_SMT_PAIRED) && (max_thread_rank == 0))
+		pr_inf("placement: no SMT siblings found, smt-paired uses one CPU per core\n");
+	pr_inf("placement: %s over %" PRIu32 " CPU%s, CPU order:%s\n",
+		stress_placement_methods[placement_policy].name, n,
+		n == 1 ? "" : "s", buf);
+tidy:
+	if (!placement_cpus_count) {
+		free(placement_cpus);
+		placement_cpus = NULL;
+	}
+	free(cpus);
+	free(topology);
+}
+
+/*
+ *  stress_placement_set()
+ *	pin a newly forked stressor instance to its CPU,
+ *	instance is the nth instance started in the run
+ */
+void stress_placement_set(const int32_t instance)
+{
+	cpu_set_t mask;
+	int32_t cpu;
+
+	if (!placement_cpus_count)
+		return;
+
+	cpu = placement_cpus[(uint32_t)instance % placement_cpus_count];
+	CPU_ZERO(&mask);
+	CPU_SET(cpu, &mask);
+	if (sched_setaffinity(0, sizeof(mask), &mask) < 0) {
+		pr_dbg("placement: cannot pin pid %" PRIdMAX " to CPU %" PRId32 ", errno=%d (%s)\n",
+			(intmax_t)getpid(), cpu, errno, strerror(errno));
+	}
+}
+
+/*
+ *  stress_placement_enabled()
+ *	true if instances are being pinned by --placement
+ */
+bool stress_placement_enabled(void)
+{
+	return placement_cpus_count > 0;
+}
+
+/*
+ *  stress_placement_deinit()
+ *	free the placement CPU order
+ */
+void stress_placement_deinit(void)
+{
+	free(placement_cpus);
+	placement_cpus = NULL;
+	placement_cpus_count = 0;
+}
+
 #else
 int stress_change_cpu(stress_args_t *args, const int old_cpu)
 {
@@ -184,4 +464,31 @@ int stress_set_cpu_affinity(const char *arg)
 	(void)fprintf(stderr, "%s: setting CPU affinity not supported\n", option);
 	_exit(EXIT_FAILURE);
 }
+
+int stress_set_placement(const char *arg)
+{
+	(void)arg;
+	(void)stress_placement_methods;
+
+	(void)fprintf(stderr, "placement: setting CPU affinity not supported\n");
+	return -1;
+}
+
+void stress_placement_init(void)
+{
+}
+
+void stress_placement_set(const int32_t instance)
+{
+	(void)instance;
+}
+
+bool stress_placement_enabled(void)
+{
+	return false;
+}
+
+void stress_placement_deinit(void)
+{
+}
 #endif
@@ -21,5 +21,10 @@
 
 extern int stress_set_cpu_affinity(const char *arg);
 extern int stress_change_cpu(stress_args_t *args, const int old_cpu);
+extern int stress_set_placement(const char *arg);
+extern void stress_placement_init(void);
+extern void stress_placement_set(const int32_t instance);
+extern bool stress_placement_enabled(void);
+extern void stress_placement_deinit(void);
 
 #endif
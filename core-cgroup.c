@@ -0,0 +1,749 @@
+/*
+ * Copyright (C) 2024      Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+#include "core-builtin.h"
+#include "core-cgroup.h"
+
+#if defined(HAVE_SYS_SYSMACROS_H)
+#include <sys/sysmacros.h>
+#endif
+
+#define STRESS_CGROUP_CPU	(0x01)
+#define STRESS_CGROUP_MEMORY	(0x02)
+#define STRESS_CGROUP_IO	(0x04)
+
+#define STRESS_CGROUP_NAME_LEN	(64)
+#define STRESS_CGROUP_PERIOD	(100000)	/* default cpu.max period, usecs */
+
+/* per-stressor cgroup, created under the stress-ng-<pid> cgroup */
+typedef struct {
+	const stress_stressor_t *ss;		/* stressor placed in this cgroup */
+	char name[STRESS_CGROUP_NAME_LEN];	/* cgroup directory name */
+	bool created;				/* true if mkdir succeeded */
+} stress_cgroup_t;
+
+/* controller names, index matches STRESS_CGROUP_* bit position */
+static const char * const stress_cgroup_controllers[] = {
+	"cpu",
+	"memory",
+	"io",
+};
+
+static char cgroup_cpu_max[64];		/* cpu.max setting */
+static char cgroup_memory_high[32];	/* memory.high setting */
+static char cgroup_io_max[256];		/* io.max setting */
+static uint32_t cgroup_wanted;		/* STRESS_CGROUP_* controllers to enable */
+static char cgroup_parent[PATH_MAX];	/* cgroup stress-ng was started in */
+static char cgroup_top[PATH_MAX + 32];	/* stress-ng-<pid> cgroup */
+static bool cgroup_moved;		/* stress-ng moved to stress-ng-<pid>/main */
+static stress_cgroup_t *cgroups;
+static size_t cgroups_count;
+
+/*
+ *  stress_set_cgroup_cpu_max()
+ *	set the --cgroup-cpu-max limit, max, QUOTA[/PERIOD]
+ *	in microseconds or N% of one CPU
+ */
+int stress_set_cgroup_cpu_max(const char *opt)
+{
+	uint64_t quota, period = STRESS_CGROUP_PERIOD;
+	char *end;
+
+	if (!strcmp(opt, "max")) {
+		(void)shim_strscpy(cgroup_cpu_max, "max", sizeof(cgroup_cpu_max));
+		cgroup_wanted |= STRESS_CGROUP_CPU;
+		return 0;
+	}
+
+	errno = 0;
+	quota = (uint64_t)strtoull(opt, &end, 10);
+	if ((end == opt) || errno)
+		goto err;
+	if (*end == '%') {
+		if (end[1])
+			goto err;
+		quota = (quota * period) / 100;
+	} else if (*end == '/') {
+		const char *ptr = end + 1;
+
+		period = (uint64_t)strtoull(ptr, &end, 10);
+		if ((end == ptr) || *end)
+			goto err;
+	} else if (*end) {
+		goto err;
+	}
+
+	if ((quota < 1000) || (period < 1000) || (period > 1000000)) {
+		(void)fprintf(stderr, "cgroup-cpu-max: quota must be at least 1000 and "
+			"period 1000 to 1000000 microseconds\n");
+		return -1;
+	}
+	(void)snprintf(cgroup_cpu_max, sizeof(cgroup_cpu_max),
+		"%" PRIu64 " %" PRIu64, quota, period);
+	cgroup_wanted |= STRESS_CGROUP_CPU;
+	return 0;
+err:
+	(void)fprintf(stderr, "cgroup-cpu-max: invalid value '%s', expecting "
+		"max, QUOTA[/PERIOD] in microseconds or N%%\n", opt);
+	return -1;
+}
+
+/*
+ *  stress_set_cgroup_memory_high()
+ *	set the --cgroup-memory-high limit in bytes or max
+ */
+int stress_set_cgroup_memory_high(const char *opt)
+{
+	static const char scales[] = "bkmgt";
+	uint64_t bytes;
+	const char *ptr;
+	char *end;
+
+	if (!strcmp(opt, "max")) {
+		(void)shim_strscpy(cgroup_memory_high, "max", sizeof(cgroup_memory_high));
+		cgroup_wanted |= STRESS_CGROUP_MEMORY;
+		return 0;
+	}
+
+	errno = 0;
+	bytes = (uint64_t)strtoull(opt, &end, 10);
+	if ((end == opt) || errno || (*opt == '-'))
+		goto err;
+	if (*end) {
+		if (end[1] || !(ptr = strchr(scales, tolower((int)*end))))
+			goto err;
+		bytes <<= (10 * (ptr - scales));
+	}
+	if (bytes < 4096) {
+		(void)fprintf(stderr, "cgroup-memory-high: %" PRIu64 " bytes is too small, "
+			"must be at least 4096 bytes\n", bytes);
+		return -1;
+	}
+	(void)snprintf(cgroup_memory_high, sizeof(cgroup_memory_high), "%" PRIu64, bytes);
+	cgroup_wanted |= STRESS_CGROUP_MEMORY;
+	return 0;
+err:
+	(void)fprintf(stderr, "cgroup-memory-high: invalid value '%s', expecting "
+		"max or N bytes with an optional b, k, m, g or t suffix\n", opt);
+	return -1;
+}
+
+/*
+ *  stress_cgroup_io_device()
+ *	map a MAJ:MIN or a path to the MAJ:MIN of the whole
+ *	disk it lives on, io.max does not accept partitions
+ */
+static int stress_cgroup_io_device(const char *dev, char *buf, const size_t len)
+{
+	unsigned int maj, min;
+
+	if (sscanf(dev, "%u:%u", &maj, &min) == 2) {
+		(void)snprintf(buf, len, "%u:%u", maj, min);
+		return 0;
+	}
+#if defined(HAVE_SYS_SYSMACROS_H)
+	{
+		struct stat statbuf;
+		char path[128], tmp[32];
+		dev_t devno;
+
+		if (stat(dev, &statbuf) < 0)
+			return -1;
+		devno = S_ISBLK(statbuf.st_mode) ? statbuf.st_rdev : statbuf.st_dev;
+		maj = (unsigned int)major(devno);
+		min = (unsigned int)minor(devno);
+
+		(void)snprintf(path, sizeof(path), "/sys/dev/block/%u:%u/partition", maj, min);
+		if (access(path, R_OK) == 0) {
+			(void)snprintf(path, sizeof(path), "/sys/dev/block/%u:%u/../dev", maj, min);
+			if (stress_system_read(path, tmp, sizeof(tmp)) > 0)
+				(void)sscanf(tmp, "%u:%u", &maj, &min);
+		}
+		(void)snprintf(buf, len, "%u:%u", maj, min);
+		return 0;
+	}
+#else
+	return -1;
+#endif
+}
+
+/*
+ *  stress_set_cgroup_io_max()
+ *	set the --cgroup-io-max limit, "DEV key=value ..." where
+ *	DEV is MAJ:MIN or a path on the device to be limited
+ */
+int stress_set_cgroup_io_max(const char *opt)
+{
+	char dev[PATH_MAX], devnum[32];
+	const char *keys;
+	size_t n;
+
+	keys = strchr(opt, ' ');
+	if (!keys || !strchr(keys, '=')) {
+		(void)fprintf(stderr, "cgroup-io-max: invalid value '%s', expecting "
+			"\"DEV rbps=N wbps=N riops=N wiops=N\"\n", opt);
+		return -1;
+	}
+	n = STRESS_MINIMUM((size_t)(keys - opt), sizeof(dev) - 1);
+	(void)shim_memcpy(dev, opt, n);
+	dev[n] = '\0';
+	if (stress_cgroup_io_device(dev, devnum, sizeof(devnum)) < 0) {
+		(void)fprintf(stderr, "cgroup-io-max: cannot determine block device of '%s'\n", dev);
+		return -1;
+	}
+	(void)snprintf(cgroup_io_max, sizeof(cgroup_io_max), "%s%s", devnum, keys);
+	cgroup_wanted |= STRESS_CGROUP_IO;
+	return 0;
+}
+
+#if defined(__linux__)
+/*
+ *  stress_cgroup_self_path()
+ *	get the cgroup v2 directory this process (and hence
+ *	the stressors) belongs to, returns NULL if unknown
+ */
+static char *stress_cgroup_self_path(char *path, const size_t len)
+{
+	char buf[PATH_MAX - 64];
+	FILE *fp;
+	char *ret = NULL;
+
+	fp = fopen("/proc/self/cgroup", "r");
+	if (!fp)
+		return NULL;
+
+	while (fgets(buf, sizeof(buf), fp)) {
+		const char *cgroup;
+		char *nl;
+
+		/* cgroup v2 unified hierarchy entry */
+		if (strncmp(buf, "0::", 3))
+			continue;
+		nl = strchr(buf, '\n');
+		if (nl)
+			*nl = '\0';
+		/* root cgroup, avoid a trailing / */
+		cgroup = strcmp(buf + 3, "/") ? buf + 3 : "";
+		/* hybrid v1/v2 systems mount the unified hierarchy separately */
+		if (access("/sys/fs/cgroup/cgroup.controllers", F_OK) == 0)
+			(void)snprintf(path, len, "/sys/fs/cgroup%s", cgroup);
+		else if (access("/sys/fs/cgroup/unified/cgroup.controllers", F_OK) == 0)
+			(void)snprintf(path, len, "/sys/fs/cgroup/unified%s", cgroup);
+		else
+			break;
+		ret = path;
+		break;
+	}
+	(void)fclose(fp);
+
+	return ret;
+}
+#endif
+
+/*
+ *  stress_cgroup_get_path()
+ *	get the cgroup v2 directory that contains the stressors,
+ *	this is the stress-ng-<pid> cgroup if limits are being
+ *	applied, returns NULL if unknown
+ */
+char *stress_cgroup_get_path(char *path, const size_t len)
+{
+#if defined(__linux__)
+	if (*cgroup_top) {
+		(void)shim_strscpy(path, cgroup_top, len);
+		return path;
+	}
+	return stress_cgroup_self_path(path, len);
+#else
+	(void)path;
+	(void)len;
+
+	return NULL;
+#endif
+}
+
+/*
+ *  stress_cgroup_read_keyed()
+ *	read "key value" lines from a cgroup v2 file, fill in
+ *	values for matching keys, returns false if file not readable
+ */
+bool stress_cgroup_read_keyed(
+	const char *cgroup,
+	const char *filename,
+	const char * const keys[],
+	uint64_t * const values[],
+	const size_t n)
+{
+	char path[PATH_MAX + 64], buf[256];
+	FILE *fp;
+
+	(void)snprintf(path, sizeof(path), "%s/%s", cgroup, filename);
+	fp = fopen(path, "r");
+	if (!fp)
+		return false;
+
+	while (fgets(buf, sizeof(buf), fp)) {
+		char key[64];
+		uint64_t val;
+		size_t i;
+
+		if (sscanf(buf, "%63s %" SCNu64, key, &val) != 2)
+			continue;
+		for (i = 0; i < n; i++) {
+			if (!strcmp(key, keys[i])) {
+				*values[i] = val;
+				break;
+			}
+		}
+	}
+	(void)fclose(fp);
+
+	return true;
+}
+
+#if defined(__linux__)
+/*
+ *  stress_cgroup_path()
+ *	path of a per-stressor cgroup directory or, if filename
+ *	is not NULL, of a file in that cgroup
+ */
+static void stress_cgroup_path(
+	char *path,
+	const size_t len,
+	const char *name,
+	const char *filename)
+{
+	if (filename)
+		(void)snprintf(path, len, "%s/%s/%s", cgroup_top, name, filename);
+	else
+		(void)snprintf(path, len, "%s/%s", cgroup_top, name);
+}
+
+/*
+ *  stress_cgroup_write()
+ *	write a string to a cgroup file, returns 0 or -errno
+ */
+static int stress_cgroup_write(const char *path, const char *str)
+{
+	const ssize_t ret = stress_system_write(path, str, strlen(str));
+
+	return (ret < 0) ? (int)ret : 0;
+}
+
+/*
+ *  stress_cgroup_write_pid()
+ *	move a process into a cgroup directory
+ */
+static int stress_cgroup_write_pid(const char *cgroup, const pid_t pid)
+{
+	char path[PATH_MAX + 64], str[32];
+
+	(void)snprintf(path, sizeof(path), "%s/cgroup.procs", cgroup);
+	(void)snprintf(str, sizeof(str), "%" PRIdMAX "\n", (intmax_t)pid);
+	return stress_cgroup_write(path, str);
+}
+
+/*
+ *  stress_cgroup_enable()
+ *	enable the wanted controllers for the children of a cgroup
+ */
+static int stress_cgroup_enable(const char *cgroup)
+{
+	char path[PATH_MAX + 64];
+	size_t i;
+
+	(void)snprintf(path, sizeof(path), "%s/cgroup.subtree_control", cgroup);
+	for (i = 0; i < SIZEOF_ARRAY(stress_cgroup_controllers); i++) {
+		char str[16];
+		int ret;
+
+		if (!(cgroup_wanted & (1U << i)))
+			continue;
+		(void)snprintf(str, sizeof(str), "+%s", stress_cgroup_controllers[i]);
+		ret = stress_cgroup_write(path, str);
+		if (ret < 0)
+			return ret;
+	}
+	return 0;
+}
+
+/*
+ *  stress_cgroup_rmdir()
+ *	remove a cgroup, reaped processes may take a
+ *	moment to leave so retry on EBUSY
+ */
+static void stress_cgroup_rmdir(const char *path)
+{
+	int i;
+
+	for (i = 0; i < 10; i++) {
+		if ((rmdir(path) == 0) || (errno != EBUSY))
+			return;
+		(void)shim_usleep(10000);
+	}
+	pr_dbg("cgroup: cannot remove %s, errno=%d (%s)\n",
+		path, errno, strerror(errno));
+}
+
+/*
+ *  stress_cgroup_available()
+ *	check the wanted controllers are available in the
+ *	parent cgroup, returns -1 if any are not
+ */
+static int stress_cgroup_available(void)
+{
+	static const char * const limits[] = {
+		"cpu.max", "memory.high", "io.max",
+	};
+	char path[PATH_MAX + 64], buf[256];
+	char *tok, *saveptr = NULL;
+	uint32_t available = 0;
+	size_t i;
+	int ret = 0;
+
+	(void)snprintf(path, sizeof(path), "%s/cgroup.controllers", cgroup_parent);
+	if (stress_system_read(path, buf, sizeof(buf)) < 0)
+		*buf = '\0';
+	for (tok = strtok_r(buf, " \n", &saveptr); tok; tok = strtok_r(NULL, " \n", &saveptr)) {
+		for (i = 0; i < SIZEOF_ARRAY(stress_cgroup_controllers); i++) {
+			if (!strcmp(tok, stress_cgroup_controllers[i]))
+				available |= (1U << i);
+		}
+	}
+	for (i = 0; i < SIZEOF_ARRAY(stress_cgroup_controllers); i++) {
+		const uint32_t bit = 1U << i;
+
+		if ((cgroup_wanted & bit) && !(available & bit)) {
+			pr_err("cgroup: %s controller not available in %s, cannot apply %s limit\n",
+				stress_cgroup_controllers[i], cgroup_parent, limits[i]);
+			ret = -1;
+		}
+	}
+	return ret;
+}
+
+/*
+ *  stress_cgroup_limit()
+ *	write a limit to a per-stressor cgroup
+ */
+static int stress_cgroup_limit(
+	const char *name,
+	const uint32_t controller,
+	const char *filename,
+	const char *limit)
+{
+	char path[PATH_MAX + 192];
+	int ret;
+
+	if (!(cgroup_wanted & controller))
+		return 0;
+	stress_cgroup_path(path, sizeof(path), name, filename);
+	ret = stress_cgroup_write(path, limit);
+	if (ret < 0) {
+		pr_err("cgroup: cannot set %s %s to '%s', errno=%d (%s)\n",
+			name, filename, limit, -ret, strerror(-ret));
+		return -1;
+	}
+	return 0;
+}
+#endif
+
+/*
+ *  stress_cgroup_init()
+ *	create a stress-ng-<pid> cgroup with a child cgroup
+ *	per stressor that has the cpu.max, memory.high and
+ *	io.max limits applied, returns -1 if the limits can't
+ *	be applied
+ */
+int stress_cgroup_init(stress_stressor_t *stressors_list)
+{
+#if defined(__linux__)
+	char path[PATH_MAX + 192], name[STRESS_CGROUP_NAME_LEN - 24];
+	const pid_t pid = getpid();
+	stress_stressor_t *ss;
+	size_t i, n;
+	int ret;
+
+	if (!cgroup_wanted)
+		return 0;
+
+	if (!stress_cgroup_self_path(cgroup_parent, sizeof(cgroup_parent))) {
+		pr_err("cgroup: cgroup v2 hierarchy not found, cannot apply cgroup limits\n");
+		return -1;
+	}
+	if (stress_cgroup_available() < 0)
+		return -1;
+
+	(void)snprintf(cgroup_top, sizeof(cgroup_top), "%s/stress-ng-%" PRIdMAX,
+		cgroup_parent, (intmax_t)pid);
+	if (mkdir(cgroup_top, S_IRWXU | S_IRGRP | S_IXGRP | S_IROTH | S_IXOTH) < 0) {
+		pr_err("cgroup: cannot create %s, errno=%d (%s), cannot apply cgroup limits\n",
+			cgroup_top, errno, strerror(errno));
+		*cgroup_top = '\0';
+		return -1;
+	}
+
+	/*
+	 *  Controllers can't be enabled for the children of a
+	 *  non-root cgroup that has processes in it, so move
+	 *  stress-ng into a leaf and try again; this only helps
+	 *  if stress-ng was the only process in its cgroup
+	 */
+	ret = stress_cgroup_enable(cgroup_parent);
+	if (ret == -EBUSY) {
+		stress_cgroup_path(path, sizeof(path), "main", NULL);
+		if ((mkdir(path, S_IRWXU) == 0) &&
+		    (stress_cgroup_write_pid(path, pid) == 0)) {
+			cgroup_moved = true;
+			ret = stress_cgroup_enable(cgroup_parent);
+		}
+	}
+	if (ret == 0)
+		ret = stress_cgroup_enable(cgroup_top);
+	if (ret < 0) {
+		pr_err("cgroup: cannot enable controllers in %s, errno=%d (%s)\n",
+			cgroup_parent, -ret, strerror(-ret));
+		if (ret == -EBUSY)
+			pr_err("cgroup: other processes share this cgroup, run stress-ng "
+				"in an empty or delegated cgroup, e.g. with systemd-run --scope\n");
+		goto tidy;
+	}
+
+	for (n = 0, ss = stressors_list; ss; ss = ss->next)
+		n++;
+	cgroups = (stress_cgroup_t *)calloc(n, sizeof(*cgroups));
+	if (!cgroups) {
+		pr_err("cgroup: cannot allocate %zu cgroups\n", n);
+		goto tidy;
+	}
+
+	for (ss = stressors_list; ss; ss = ss->next) {
+		stress_cgroup_t *cg = &cgroups[cgroups_count];
+
+		if (ss->ignore.run)
+			continue;
+		cg->ss = ss;
+		(void)stress_munge_underscore(name, ss->stressor->name, sizeof(name));
+		(void)shim_strscpy(cg->name, name, sizeof(cg->name));
+		/* the same stressor may appear more than once in a job file */
+		for (i = 0; i < cgroups_count; i++) {
+			if (!strcmp(cgroups[i].name, name)) {
+				(void)snprintf(cg->name, sizeof(cg->name), "%s-%zu",
+					name, cgroups_count);
+				break;
+			}
+		}
+		cgroups_count++;
+
+		stress_cgroup_path(path, sizeof(path), cg->name, NULL);
+		if (mkdir(path, S_IRWXU | S_IRGRP | S_IXGRP | S_IROTH | S_IXOTH) < 0) {
+			pr_err("cgroup: cannot create %s, errno=%d (%s)\n",
+				path, errno, strerror(errno));
+			goto tidy;
+		}
+		cg->created = true;
+		if ((stress_cgroup_limit(cg->name, STRESS_CGROUP_CPU, "cpu.max", cgroup_cpu_max) < 0) ||
+		    (stress_cgroup_limit(cg->name, STRESS_CGROUP_MEMORY, "memory.high", cgroup_memory_high) < 0) ||
+		    (stress_cgroup_limit(cg->name, STRESS_CGROUP_IO, "io.max", cgroup_io_max) < 0))
+			goto tidy;
+	}
+	pr_dbg("cgroup: created %zu stressor cgroups in %s\n", cgroups_count, cgroup_top);
+	return 0;
+
+tidy:
+	stress_cgroup_deinit();
+	return -1;
+#else
+	(void)stressors_list;
+
+	if (cgroup_wanted) {
+		pr_err("cgroup: cgroup v2 not supported, cannot apply cgroup limits\n");
+		return -1;
+	}
+	return 0;
+#endif
+}
+
+/*
+ *  stress_cgroup_add_pid()
+ *	move the calling stressor instance into the cgroup
+ *	of its stressor, called in the child just after fork
+ */
+void stress_cgroup_add_pid(const stress_stressor_t *ss)
+{
+#if defined(__linux__)
+	size_t i;
+
+	for (i = 0; i < cgroups_count; i++) {
+		char path[PATH_MAX + 192];
+		int ret;
+
+		if ((cgroups[i].ss != ss) || !cgroups[i].created)
+			continue;
+		stress_cgroup_path(path, sizeof(path), cgroups[i].name, NULL);
+		ret = stress_cgroup_write_pid(path, getpid());
+		if (ret < 0) {
+			pr_dbg("cgroup: cannot move pid %" PRIdMAX " to %s, errno=%d (%s)\n",
+				(intmax_t)getpid(), path, -ret, strerror(-ret));
+		}
+		return;
+	}
+#else
+	(void)ss;
+#endif
+}
+
+#if defined(__linux__)
+/*
+ *  stress_cgroup_psi_total()
+ *	read the "some" stall total in microseconds from
+ *	a cgroup pressure file
+ */
+static uint64_t stress_cgroup_psi_total(const char *path)
+{
+	char buf[256];
+	const char *ptr;
+	uint64_t total = 0;
+
+	if (stress_system_read(path, buf, sizeof(buf)) < 0)
+		return 0;
+	if (strncmp(buf, "some", 4))
+		return 0;
+	ptr = strstr(buf, "total=");
+	if (ptr)
+		(void)sscanf(ptr + 6, "%" SCNu64, &total);
+	return total;
+}
+#endif
+
+/*
+ *  stress_cgroup_dump()
+ *	report cpu throttling, memory.events and io stalls
+ *	of each stressor cgroup
+ */
+void stress_cgroup_dump(FILE *yaml)
+{
+#if defined(__linux__)
+	size_t i;
+
+	if (!cgroups_count)
+		return;
+
+	pr_block_begin();
+	pr_inf("cgroup limits: cpu.max '%s', memory.high '%s', io.max '%s':\n",
+		(cgroup_wanted & STRESS_CGROUP_CPU) ? cgroup_cpu_max : "unset",
+		(cgroup_wanted & STRESS_CGROUP_MEMORY) ? cgroup_memory_high : "unset",
+		(cgroup_wanted & STRESS_CGROUP_IO) ? cgroup_io_max : "unset");
+	pr_inf("%-13s %9s %9s %7s %8s %8s %8s %9s %9s\n",
+		"stressor", "cpu (s)", "thrtl (s)", "thrtl%", "mem high",
+		"mem max", "oom kill", "peak (MB)", "io stall");
+	pr_yaml(yaml, "cgroup-limits:\n");
+	for (i = 0; i < cgroups_count; i++) {
+		static const char * const cpu_keys[] = {
+			"usage_usec", "nr_periods", "nr_throttled", "throttled_usec",
+		};
+		static const char * const memory_keys[] = {
+			"high", "max", "oom", "oom_kill",
+		};
+		const stress_cgroup_t *cg = &cgroups[i];
+		char path[PATH_MAX + 192], buf[32];
+		uint64_t usage_usec = 0, nr_periods = 0, nr_throttled = 0, throttled_usec = 0;
+		uint64_t high = 0, max = 0, oom = 0, oom_kill = 0, peak = 0, io_stall;
+		uint64_t * const cpu_values[] = {
+			&usage_usec, &nr_periods, &nr_throttled, &throttled_usec,
+		};
+		uint64_t * const memory_values[] = {
+			&high, &max, &oom, &oom_kill,
+		};
+		double throttled_pc;
+
+		if (!cg->created)
+			continue;
+
+		stress_cgroup_path(path, sizeof(path), cg->name, NULL);
+		(void)stress_cgroup_read_keyed(path, "cpu.stat", cpu_keys,
+			cpu_values, SIZEOF_ARRAY(cpu_keys));
+		(void)stress_cgroup_read_keyed(path, "memory.events", memory_keys,
+			memory_values, SIZEOF_ARRAY(memory_keys));
+		stress_cgroup_path(path, sizeof(path), cg->name, "memory.peak");
+		if (stress_system_read(path, buf, sizeof(buf)) > 0)
+			peak = (uint64_t)strtoull(buf, NULL, 10);
+		stress_cgroup_path(path, sizeof(path), cg->name, "io.pressure");
+		io_stall = stress_cgroup_psi_total(path);
+
+		throttled_pc = nr_periods ? 100.0 * (double)nr_throttled / (double)nr_periods : 0.0;
+
+		pr_inf("%-13s %9.2f %9.2f %6.2f%% %8" PRIu64 " %8" PRIu64 " %8" PRIu64 " %9.2f %9.2f\n",
+			cg->name, (double)usage_usec / 1000000.0,
+			(double)throttled_usec / 1000000.0, throttled_pc,
+			high, max, oom_kill, (double)peak / (double)MB,
+			(double)io_stall / 1000000.0);
+
+		pr_yaml(yaml, "    - stressor: %s\n", cg->name);
+		pr_yaml(yaml, "      cpu-usage-usec: %" PRIu64 "\n", usage_usec);
+		pr_yaml(yaml, "      cpu-nr-periods: %" PRIu64 "\n", nr_periods);
+		pr_yaml(yaml, "      cpu-nr-throttled: %" PRIu64 "\n", nr_throttled);
+		pr_yaml(yaml, "      cpu-throttled-usec: %" PRIu64 "\n", throttled_usec);
+		pr_yaml(yaml, "      memory-events-high: %" PRIu64 "\n", high);
+		pr_yaml(yaml, "      memory-events-max: %" PRIu64 "\n", max);
+		pr_yaml(yaml, "      memory-events-oom: %" PRIu64 "\n", oom);
+		pr_yaml(yaml, "      memory-events-oom-kill: %" PRIu64 "\n", oom_kill);
+		pr_yaml(yaml, "      memory-peak: %" PRIu64 "\n", peak);
+		pr_yaml(yaml, "      io-some-stall-usec: %" PRIu64 "\n", io_stall);
+	}
+	pr_block_end();
+#else
+	(void)yaml;
+#endif
+}
+
+/*
+ *  stress_cgroup_deinit()
+ *	move stress-ng back to its original cgroup and remove
+ *	the per-stressor and stress-ng-<pid> cgroups
+ */
+void stress_cgroup_deinit(void)
+{
+#if defined(__linux__)
+	char path[PATH_MAX + 192];
+	size_t i;
+
+	if (!*cgroup_top)
+		return;
+
+	if (cgroup_moved) {
+		(void)stress_cgroup_write_pid(cgroup_parent, getpid());
+		stress_cgroup_path(path, sizeof(path), "main", NULL);
+		stress_cgroup_rmdir(path);
+		cgroup_moved = false;
+	}
+	for (i = 0; i < cgroups_count; i++) {
+		if (!cgroups[i].created)
+			continue;
+		stress_cgroup_path(path, sizeof(path), cgroups[i].name, NULL);
+		stress_cgroup_rmdir(path);
+	}
+	stress_cgroup_rmdir(cgroup_top);
+	*cgroup_top = '\0';
+
+	free(cgroups);
+	cgroups = NULL;
+	cgroups_count = 0;
+#endif
+}
@@ -24,6 +24,8 @@
 #include "core-builtin.h"
 #include "core-cpu-cache.h"
 
+#include <sched.h>
+
 #if defined(HAVE_SYS_AUXV_H)
 #include <sys/auxv.h>
 #endif
@@ -1323,3 +1325,155 @@ free_cpu_caches:
 	*cache_line_size = 0;
 #endif
 }
+
+#if defined(__linux__)
+/*
+ *  stress_cpu_topology_read_id()
+ *	read a numeric id for a cpu from a sysfs file relative
+ *	to the cpu's sysfs directory, -1 if it cannot be read
+ */
+static int32_t stress_cpu_topology_read_id(const int32_t cpu, const char *file)
+{
+	char path[PATH_MAX];
+	char tmp[4096];
+
+	(void)snprintf(path, sizeof(path), "%s/cpu%" PRId32 "/%s",
+		stress_sys_cpu_prefix, cpu, file);
+	if (stress_get_string_from_file(path, tmp, sizeof(tmp)) < 0)
+		return -1;
+	if (!isdigit((unsigned char)tmp[0]))
+		return -1;
+	return (int32_t)atoi(tmp);
+}
+
+/*
+ *  stress_cpu_topology_llc_id()
+ *	identify the last level data or unified cache of a cpu by
+ *	the lowest numbered cpu in the cache's shared_cpu_list
+ */
+static int32_t stress_cpu_topology_llc_id(const int32_t cpu)
+{
+	int32_t max_level = -1, llc_id = -1;
+	int i;
+
+	for (i = 0; i < 32; i++) {
+		char file[64], path[PATH_MAX], tmp[64];
+		int32_t level, id;
+
+		(void)snprintf(file, sizeof(file), "%s/index%d/level", stress_cpu_cache_dir, i);
+		level = stress_cpu_topology_read_id(cpu, file);
+		if (level < 0)
+			break;
+		if (level <= max_level)
+			continue;
+		(void)snprintf(path, sizeof(path), "%s/cpu%" PRId32 "/%s/index%d/type",
+			stress_sys_cpu_prefix, cpu, stress_cpu_cache_dir, i);
+		if ((stress_get_string_from_file(path, tmp, sizeof(tmp)) == 0) &&
+		    (stress_cpu_cache_get_type(tmp) == CACHE_TYPE_INSTRUCTION))
+			continue;
+		(void)snprintf(file, sizeof(file), "%s/index%d/shared_cpu_list", stress_cpu_cache_dir, i);
+		id = stress_cpu_topology_read_id(cpu, file);
+		if (id < 0)
+			continue;
+		max_level = level;
+		llc_id = id;
+	}
+	return llc_id;
+}
+
+/*
+ *  stress_cpu_topology_get()
+ *	get the core, package and last level cache of each online
+ *	cpu the process may run on, returns a calloc'd array that
+ *	the caller must free and the number of cpus in *count
+ */
+stress_cpu_topology_t *stress_cpu_topology_get(uint32_t *count)
+{
+	const int32_t cpus = stress_get_processors_configured();
+	stress_cpu_topology_t *topology;
+	int32_t cpu;
+	uint32_t n = 0;
+#if defined(HAVE_SCHED_GETAFFINITY)
+	cpu_set_t mask;
+	bool has_mask;
+
+	CPU_ZERO(&mask);
+	has_mask = (sched_getaffinity(0, sizeof(mask), &mask) == 0);
+#endif
+
+	*count = 0;
+	if (cpus < 1)
+		return NULL;
+	topology = (stress_cpu_topology_t *)calloc((size_t)cpus, sizeof(*topology));
+	if (!topology)
+		return NULL;
+
+	for (cpu = 0; cpu < cpus; cpu++) {
+		stress_cpu_topology_t *t = &topology[n];
+
+#if defined(HAVE_SCHED_GETAFFINITY)
+		if (has_mask && (cpu < CPU_SETSIZE) && !CPU_ISSET(cpu, &mask))
+			continue;
+#endif
+		/* cpu0 may not have an online file */
+		if ((cpu > 0) && (stress_cpu_topology_read_id(cpu, "online") == 0))
+			continue;
+
+		t->cpu = cpu;
+		t->core_id = stress_cpu_topology_read_id(cpu, "topology/core_id");
+		t->package_id = stress_cpu_topology_read_id(cpu, "topology/physical_package_id");
+		t->llc_id = stress_cpu_topology_llc_id(cpu);
+		n++;
+	}
+	if (n == 0) {
+		free(topology);
+		return NULL;
+	}
+	*count = n;
+	return topology;
+}
+#else
+stress_cpu_topology_t *stress_cpu_topology_get(uint32_t *count)
+{
+	*count = 0;
+	return NULL;
+}
+#endif
+
+/*
+ *  stress_cpu_topology_distance()
+ *	how far apart two cpus are in the cpu topology
+ */
+stress_cpu_distance_t stress_cpu_topology_distance(
+	const stress_cpu_topology_t *t1,
+	const stress_cpu_topology_t *t2)
+{
+	if (t1->cpu == t2->cpu)
+		return CPU_DISTANCE_SAME_CPU;
+	if (t1->package_id != t2->package_id)
+		return CPU_DISTANCE_CROSS_PACKAGE;
+	if ((t1->core_id >= 0) && (t1->core_id == t2->core_id))
+		return CPU_DISTANCE_SMT_SIBLING;
+	if ((t1->llc_id >= 0) && (t1->llc_id == t2->llc_id))
+		return CPU_DISTANCE_SAME_LLC;
+	return CPU_DISTANCE_CROSS_LLC;
+}
+
+/*
+ *  stress_cpu_topology_distance_name()
+ *	human readable name of a cpu distance
+ */
+const char *stress_cpu_topology_distance_name(const stress_cpu_distance_t distance)
+{
+	static const char * const names[] = {
+		"same-cpu",
+		"smt-sibling",
+		"same-llc",
+		"cross-llc",
+		"cross-socket",
+	};
+
+	if ((size_t)distance >= SIZEOF_ARRAY(names))
+		return "unknown";
+	return names[distance];
+}
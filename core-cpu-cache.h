@@ -58,6 +58,24 @@ typedef struct stress_cpus {
 	uint8_t		padding[4];	/* padding */
 } stress_cpu_cache_cpus_t;
 
+/* CPU topology, ids are -1 when not known */
+typedef struct stress_cpu_topology {
+	int32_t		cpu;		/* CPU number */
+	int32_t		core_id;	/* core id within the package */
+	int32_t		package_id;	/* physical package (socket) id */
+	int32_t		llc_id;		/* lowest CPU sharing the last level cache */
+} stress_cpu_topology_t;
+
+/* Topological distance between two CPUs, nearest first */
+typedef enum stress_cpu_distance {
+	CPU_DISTANCE_SAME_CPU = 0,	/* same logical CPU */
+	CPU_DISTANCE_SMT_SIBLING,	/* SMT siblings on the same core */
+	CPU_DISTANCE_SAME_LLC,		/* different cores sharing the LLC */
+	CPU_DISTANCE_CROSS_LLC,		/* same package, different LLCs */
+	CPU_DISTANCE_CROSS_PACKAGE,	/* different packages */
+	CPU_DISTANCE_MAX,
+} stress_cpu_distance_t;
+
 /* CPU cache helpers */
 extern stress_cpu_cache_cpus_t *stress_cpu_cache_get_all_details(void);
 extern uint16_t stress_cpu_cache_get_max_level(const stress_cpu_cache_cpus_t *cpus);
@@ -67,6 +85,10 @@ extern void stress_free_cpu_caches(stress_cpu_cache_cpus_t *cpus);
 extern void stress_cpu_cache_get_llc_size(size_t *llc_size, size_t *cache_line_size);
 extern void stress_cpu_cache_get_level_size(const uint16_t cache_level,
 	size_t *cache_size, size_t *cache_line_size);
+extern stress_cpu_topology_t *stress_cpu_topology_get(uint32_t *count);
+extern stress_cpu_distance_t stress_cpu_topology_distance(const stress_cpu_topology_t *t1,
+	const stress_cpu_topology_t *t2);
+extern const char *stress_cpu_topology_distance_name(const stress_cpu_distance_t distance);
 
 
 /*
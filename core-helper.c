@@ -30,6 +30,7 @@
 #include "core-pthread.h"
 #include "core-pragma.h"
 #include "core-sort.h"
+#include "core-trace.h"
 
 #include <sched.h>
 #include <pwd.h>
@@ -1307,6 +1308,7 @@ void stress_set_proc_state(const char *name, const int state)
 	if ((state < 0) || (state >= (int)SIZEOF_ARRAY(stress_states)))
 		return;
 
+	stress_trace_state(state);
 	stress_set_proc_state_str(name, stress_states[state]);
 }
 
@@ -2415,8 +2417,7 @@ int stress_sighandler_default(const int signum)
  */
 void stress_handle_stop_stressing(const int signum)
 {
-	(void)signum;
-
+	stress_trace_signal(signum);
 	stress_continue_set_flag(false);
 	/*
 	 * Trigger another SIGARLM until stressor gets the message
@@ -0,0 +1,210 @@
+/*
+ * Copyright (C) 2024 Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+#include "core-builtin.h"
+#include "core-latency.h"
+
+static const double stress_latency_percentiles[] = {
+	50.0, 90.0, 99.0, 99.9
+};
+
+/*
+ *  stress_latency_msb()
+ *	find most significant bit set in a non-zero value
+ */
+static inline unsigned int OPTIMIZE3 stress_latency_msb(uint64_t v)
+{
+	unsigned int msb = 0;
+
+	while (v >>= 1)
+		msb++;
+	return msb;
+}
+
+/*
+ *  stress_latency_index()
+ *	map a latency in nanoseconds to a histogram bucket
+ */
+static inline size_t OPTIMIZE3 stress_latency_index(const uint64_t ns)
+{
+	unsigned int msb;
+	uint64_t sub;
+
+	if (ns < STRESS_LATENCY_SUB_BUCKETS)
+		return (size_t)ns;
+	msb = stress_latency_msb(ns);
+	sub = (ns >> (msb - 2)) & (STRESS_LATENCY_SUB_BUCKETS - 1);
+
+	return ((size_t)(msb - 1) * STRESS_LATENCY_SUB_BUCKETS) + (size_t)sub;
+}
+
+/*
+ *  stress_latency_bucket_max()
+ *	the largest latency that maps into a histogram bucket
+ */
+static uint64_t stress_latency_bucket_max(const size_t idx)
+{
+	size_t msb, sub;
+
+	if (idx < STRESS_LATENCY_SUB_BUCKETS)
+		return (uint64_t)idx;
+	msb = (idx / STRESS_LATENCY_SUB_BUCKETS) + 1;
+	sub = idx % STRESS_LATENCY_SUB_BUCKETS;
+	if (msb >= 63)
+		return ~(uint64_t)0;
+
+	return ((uint64_t)(STRESS_LATENCY_SUB_BUCKETS + sub + 1) << (msb - 2)) - 1;
+}
+
+/*
+ *  stress_latency_init()
+ *	initialize an empty latency histogram
+ */
+void stress_latency_init(stress_latency_t *lat)
+{
+	(void)shim_memset(lat, 0, sizeof(*lat));
+	lat->min_ns = ~(uint64_t)0;
+}
+
+/*
+ *  stress_latency_add()
+ *	add a latency sample in nanoseconds
+ */
+void OPTIMIZE3 stress_latency_add(stress_latency_t *lat, const uint64_t ns)
+{
+	lat->buckets[stress_latency_index(ns)]++;
+	lat->count++;
+	lat->total_ns += (double)ns;
+	if (ns < lat->min_ns)
+		lat->min_ns = ns;
+	if (ns > lat->max_ns)
+		lat->max_ns = ns;
+}
+
+/*
+ *  stress_latency_merge()
+ *	add the samples of src into dst
+ */
+void stress_latency_merge(stress_latency_t *dst, const stress_latency_t *src)
+{
+	size_t i;
+
+	for (i = 0; i < STRESS_LATENCY_BUCKETS; i++)
+		dst->buckets[i] += src->buckets[i];
+	dst->count += src->count;
+	dst->total_ns += src->total_ns;
+	if (src->min_ns < dst->min_ns)
+		dst->min_ns = src->min_ns;
+	if (src->max_ns > dst->max_ns)
+		dst->max_ns = src->max_ns;
+}
+
+/*
+ *  stress_latency_percentile()
+ *	return the latency in nanoseconds at the given percentile,
+ *	this is the upper bound of the bucket the percentile lands in
+ */
+uint64_t stress_latency_percentile(const stress_latency_t *lat, const double percentile)
+{
+	uint64_t threshold, sum = 0;
+	size_t i;
+
+	if (lat->count == 0)
+		return 0;
+	threshold = (uint64_t)(((double)lat->count * percentile) / 100.0);
+	if (threshold >= lat->count)
+		threshold = lat->count - 1;
+
+	for (i = 0; i < STRESS_LATENCY_BUCKETS; i++) {
+		sum += lat->buckets[i];
+		if (sum > threshold) {
+			const uint64_t ns = stress_latency_bucket_max(i);
+
+			return (ns > lat->max_ns) ? lat->max_ns : ns;
+		}
+	}
+	return lat->max_ns;
+}
+
+/*
+ *  stress_latency_mean()
+ *	mean latency in nanoseconds
+ */
+double stress_latency_mean(const stress_latency_t *lat)
+{
+	return (lat->count > 0) ? lat->total_ns / (double)lat->count : 0.0;
+}
+
+/*
+ *  stress_latency_report()
+ *	log latency statistics and percentiles
+ */
+void stress_latency_report(
+	stress_args_t *args,
+	const char *description,
+	const stress_latency_t *lat)
+{
+	size_t i;
+
+	if (lat->count == 0) {
+		pr_inf("%s: %s latency: no samples\n", args->name, description);
+		return;
+	}
+	pr_inf("%s: %s latency: %" PRIu64 " samples, min %" PRIu64
+		" ns, mean %.2f ns, max %" PRIu64 " ns\n",
+		args->name, description, lat->count, lat->min_ns,
+		stress_latency_mean(lat), lat->max_ns);
+	for (i = 0; i < SIZEOF_ARRAY(stress_latency_percentiles); i++) {
+		pr_inf("%s:   %6.2f%%: %12" PRIu64 " ns\n", args->name,
+			stress_latency_percentiles[i],
+			stress_latency_percentile(lat, stress_latency_percentiles[i]));
+	}
+}
+
+/*
+ *  stress_latency_metrics_set()
+ *	set mean, 50th, 99th percentile and max latency metrics
+ *	starting at metrics index idx, returns the next free index
+ */
+size_t stress_latency_metrics_set(
+	stress_args_t *args,
+	const size_t idx,
+	const char *description,
+	const stress_latency_t *lat)
+{
+	char str[64];
+
+	if (lat->count == 0)
+		return idx;
+
+	(void)snprintf(str, sizeof(str), "nanosecs mean %s latency", description);
+	stress_metrics_set(args, idx + 0, str,
+		stress_latency_mean(lat), STRESS_GEOMETRIC_MEAN);
+	(void)snprintf(str, sizeof(str), "nanosecs p50 %s latency", description);
+	stress_metrics_set(args, idx + 1, str,
+		(double)stress_latency_percentile(lat, 50.0), STRESS_GEOMETRIC_MEAN);
+	(void)snprintf(str, sizeof(str), "nanosecs p99 %s latency", description);
+	stress_metrics_set(args, idx + 2, str,
+		(double)stress_latency_percentile(lat, 99.0), STRESS_GEOMETRIC_MEAN);
+	(void)snprintf(str, sizeof(str), "nanosecs max %s latency", description);
+	stress_metrics_set(args, idx + 3, str,
+		(double)lat->max_ns, STRESS_GEOMETRIC_MEAN);
+
+	return idx + 4;
+}
@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2024 Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#ifndef CORE_LATENCY_H
+#define CORE_LATENCY_H
+
+/*
+ *  Log-linear latency histogram, 4 sub-buckets per power of 2
+ *  giving a worst case bucket resolution of 25%, enough to cover
+ *  the full 64 bit nanosecond range in a small fixed size table
+ *  that can be cheaply updated and merged
+ */
+#define STRESS_LATENCY_SUB_BUCKETS	(4)
+#define STRESS_LATENCY_BUCKETS		(64 * STRESS_LATENCY_SUB_BUCKETS)
+
+typedef struct {
+	uint64_t count;		/* number of samples */
+	uint64_t min_ns;	/* minimum latency */
+	uint64_t max_ns;	/* maximum latency */
+	double	total_ns;	/* sum of latencies */
+	uint64_t buckets[STRESS_LATENCY_BUCKETS];
+} stress_latency_t;
+
+extern void stress_latency_init(stress_latency_t *lat);
+extern void stress_latency_add(stress_latency_t *lat, const uint64_t ns);
+extern void stress_latency_merge(stress_latency_t *dst, const stress_latency_t *src);
+extern uint64_t stress_latency_percentile(const stress_latency_t *lat, const double percentile);
+extern double stress_latency_mean(const stress_latency_t *lat);
+extern void stress_latency_report(stress_args_t *args, const char *description,
+	const stress_latency_t *lat);
+extern size_t stress_latency_metrics_set(stress_args_t *args, const size_t idx,
+	const char *description, const stress_latency_t *lat);
+
+#endif
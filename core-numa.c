@@ -247,3 +247,40 @@ int stress_set_mbind(const char *arg)
 	_exit(EXIT_FAILURE);
 }
 #endif
+
+/*
+ *  stress_numa_cpu_node()
+ *	find the NUMA node a CPU belongs to from the
+ *	cpuN/nodeM sysfs link, returns -1 if not known
+ */
+int32_t stress_numa_cpu_node(const int32_t cpu)
+{
+#if defined(__linux__)
+	char path[64];
+	DIR *dir;
+	const struct dirent *d;
+	int32_t node = -1;
+
+	(void)snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%" PRId32, cpu);
+	dir = opendir(path);
+	if (!dir)
+		return -1;
+	while ((d = readdir(dir)) != NULL) {
+		int32_t n;
+
+		if (strncmp(d->d_name, "node", 4))
+			continue;
+		if (sscanf(d->d_name + 4, "%" SCNd32, &n) == 1) {
+			node = n;
+			break;
+		}
+	}
+	(void)closedir(dir);
+
+	return node;
+#else
+	(void)cpu;
+
+	return -1;
+#endif
+}
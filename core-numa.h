@@ -22,5 +22,6 @@
 extern int stress_numa_count_mem_nodes(unsigned long *max_node);
 extern int stress_numa_nodes(void);
 extern int stress_set_mbind(const char *arg);
+extern int32_t stress_numa_cpu_node(const int32_t cpu);
 
 #endif
@@ -110,6 +110,9 @@ const struct option stress_long_options[] = {
 	{ "chroot",		1,	0, 	OPT_chroot},
 	{ "chroot-ops",		1,	0,	OPT_chroot_ops },
 	{ "cgroup",		1,	0,	OPT_cgroup },
+	{ "cgroup-cpu-max",	1,	0,	OPT_cgroup_cpu_max },
+	{ "cgroup-io-max",	1,	0,	OPT_cgroup_io_max },
+	{ "cgroup-memory-high",	1,	0,	OPT_cgroup_memory_high },
 	{ "cgroup-ops",		1,	0,	OPT_cgroup_ops },
 	{ "class",		1,	0,	OPT_class },
 	{ "clock",		1,	0,	OPT_clock },
@@ -133,6 +136,7 @@ const struct option stress_long_options[] = {
 	{ "cpu-online",		1,	0,	OPT_cpu_online },
 	{ "cpu-online-affinity",0,	0,	OPT_cpu_online_affinity },
 	{ "cpu-online-all",	0,	0,	OPT_cpu_online_all },
+	{ "cpu-online-latency",0,	0,	OPT_cpu_online_latency },
 	{ "cpu-online-ops",	1,	0,	OPT_cpu_online_ops },
 	{ "crypt",		1,	0,	OPT_crypt },
 	{ "crypt-method",	1,	0,	OPT_crypt_method },
@@ -199,6 +203,8 @@ const struct option stress_long_options[] = {
 	{ "epoll-domain",	1,	0,	OPT_epoll_domain },
 	{ "epoll-ops",		1,	0,	OPT_epoll_ops },
 	{ "epoll-port",		1,	0,	OPT_epoll_port },
+	{ "epoll-reactors",	1,	0,	OPT_epoll_reactors },
+	{ "epoll-shard",	1,	0,	OPT_epoll_shard },
 	{ "epoll-sockets",	1,	0,	OPT_epoll_sockets },
 	{ "eventfd",		1,	0,	OPT_eventfd },
 	{ "eventfd-nonblock",	0,	0,	OPT_eventfd_nonblock },
@@ -283,6 +289,13 @@ const struct option stress_long_options[] = {
 	{ "funcret-ops",	1,	0,	OPT_funcret_ops },
 	{ "futex",		1,	0,	OPT_futex },
 	{ "futex-ops",		1,	0,	OPT_futex_ops },
+	{ "futex-queue",	1,	0,	OPT_futex_queue },
+	{ "futex-queue-batch",1,	0,	OPT_futex_queue_batch },
+	{ "futex-queue-consumers",1,	0,	OPT_futex_queue_consumers },
+	{ "futex-queue-ops",	1,	0,	OPT_futex_queue_ops },
+	{ "futex-queue-producers",1,	0,	OPT_futex_queue_producers },
+	{ "futex-queue-spin",	1,	0,	OPT_futex_queue_spin },
+	{ "futex-queue-wait",	1,	0,	OPT_futex_queue_wait },
 	{ "get",		1,	0,	OPT_get },
 	{ "get-ops",		1,	0,	OPT_get_ops },
 	{ "getrandom",		1,	0,	OPT_getrandom },
@@ -300,6 +313,11 @@ const struct option stress_long_options[] = {
 	{ "gpu-upload",		1,	0,	OPT_gpu_uploads },
 	{ "gpu-xsize",		1,	0,	OPT_gpu_xsize },
 	{ "gpu-ysize",		1,	0,	OPT_gpu_ysize },
+	{ "group-commit",	1,	0,	OPT_group_commit },
+	{ "group-commit-method",1,	0,	OPT_group_commit_method },
+	{ "group-commit-ops",	1,	0,	OPT_group_commit_ops },
+	{ "group-commit-record",1,	0,	OPT_group_commit_record },
+	{ "group-commit-writers",1,	0,	OPT_group_commit_writers },
 	{ "handle",		1,	0,	OPT_handle },
 	{ "handle-ops",		1,	0,	OPT_handle_ops },
 	{ "hash",		1,	0,	OPT_hash },
@@ -338,7 +356,10 @@ const struct option stress_long_options[] = {
 	{ "io-ops",		1,	0,	OPT_io_ops },
 	{ "iomix",		1,	0,	OPT_iomix },
 	{ "iomix-bytes",	1,	0,	OPT_iomix_bytes },
+	{ "iomix-lock",		0,	0,	OPT_iomix_lock },
 	{ "iomix-ops",		1,	0,	OPT_iomix_ops },
+	{ "iomix-overlap",	0,	0,	OPT_iomix_overlap },
+	{ "iomix-threads",	1,	0,	OPT_iomix_threads },
 	{ "ionice-class",	1,	0,	OPT_ionice_class },
 	{ "ionice-level",	1,	0,	OPT_ionice_level },
 	{ "ioport",		1,	0,	OPT_ioport },
@@ -349,6 +370,9 @@ const struct option stress_long_options[] = {
 	{ "iostat",		1,	0,	OPT_iostat },
 	{ "io-uring",		1,	0,	OPT_io_uring },
 	{ "io-uring-entries",	1,	0,	OPT_io_uring_entries },
+	{ "io-uring-net",	1,	0,	OPT_io_uring_net },
+	{ "io-uring-net-port",	1,	0,	OPT_io_uring_net_port },
+	{ "io-uring-net-size",	1,	0,	OPT_io_uring_net_size },
 	{ "io-uring-ops",	1,	0,	OPT_io_uring_ops },
 	{ "ipsec-mb",		1,	0,	OPT_ipsec_mb },
 	{ "ipsec-mb-feature",	1,	0,	OPT_ipsec_mb_feature },
@@ -487,6 +511,12 @@ const struct option stress_long_options[] = {
 	{ "mergesort-method",	1,	0,	OPT_mergesort_method },
 	{ "mergesort-ops",	1,	0,	OPT_mergesort_ops },
 	{ "mergesort-size",	1,	0,	OPT_mergesort_size },
+	{ "metadata",		1,	0,	OPT_metadata },
+	{ "metadata-dirs",	1,	0,	OPT_metadata_dirs },
+	{ "metadata-files",	1,	0,	OPT_metadata_files },
+	{ "metadata-mix",	1,	0,	OPT_metadata_mix },
+	{ "metadata-ops",	1,	0,	OPT_metadata_ops },
+	{ "metadata-threads",	1,	0,	OPT_metadata_threads },
 	{ "metamix",		1,	0,	OPT_metamix },
         { "metamix-ops",	1,	0,	OPT_metamix_ops },
         { "metamix-bytes",	1,	0,	OPT_metamix_bytes },
@@ -582,6 +612,7 @@ const struct option stress_long_options[] = {
 	{ "nanosleep",		1,	0,	OPT_nanosleep },
 	{ "nanosleep-method",	1,	0,	OPT_nanosleep_method },
 	{ "nanosleep-ops",	1,	0,	OPT_nanosleep_ops },
+	{ "nanosleep-sweep",	0,	0,	OPT_nanosleep_sweep },
 	{ "nanosleep-threads",	1,	0,	OPT_nanosleep_threads },
 	{ "netdev",		1,	0,	OPT_netdev },
 	{ "netdev-ops",		1,	0,	OPT_netdev_ops },
@@ -656,6 +687,7 @@ const struct option stress_long_options[] = {
 	{ "pipeherd-yield", 	0,	0,	OPT_pipeherd_yield },
 	{ "pkey",		1,	0,	OPT_pkey },
 	{ "pkey-ops",		1,	0,	OPT_pkey_ops },
+	{ "placement",		1,	0,	OPT_placement },
 	{ "plugin",		1,	0,	OPT_plugin },
 	{ "plugin-method",	1,	0,	OPT_plugin_method },
 	{ "plugin-ops",		1,	0,	OPT_plugin_ops },
@@ -669,6 +701,7 @@ const struct option stress_long_options[] = {
 	{ "prefetch-l3-size",	1,	0,	OPT_prefetch_l3_size },
 	{ "prefetch-method",	1,	0,	OPT_prefetch_method },
 	{ "prefetch-ops",	1,	0,	OPT_prefetch_ops },
+	{ "pressurestat",	1,	0,	OPT_pressurestat },
 	{ "prio-inv",		1,	0,	OPT_prio_inv },
 	{ "prio-inv-ops",	1,	0,	OPT_prio_inv_ops },
 	{ "prio-inv-policy",	1,	0,	OPT_prio_inv_policy },
@@ -677,8 +710,12 @@ const struct option stress_long_options[] = {
 	{ "priv-instr-ops",	1,	0,	OPT_priv_instr_ops },
 	{ "procfs",		1,	0,	OPT_procfs },
 	{ "procfs-ops",		1,	0,	OPT_procfs_ops },
+	{ "procmatrix",		1,	0,	OPT_procmatrix },
+	{ "procmatrix-max-size",1,	0,	OPT_procmatrix_max_size },
+	{ "procmatrix-ops",	1,	0,	OPT_procmatrix_ops },
 	{ "progress",		0,	0,	OPT_progress },
 	{ "pthread",		1,	0,	OPT_pthread },
+	{ "pthread-bench",	0,	0,	OPT_pthread_bench },
 	{ "pthread-max",	1,	0,	OPT_pthread_max },
 	{ "pthread-ops",	1,	0,	OPT_pthread_ops },
 	{ "ptrace",		1,	0,	OPT_ptrace },
@@ -730,6 +767,11 @@ const struct option stress_long_options[] = {
 	{ "readahead",		1,	0,	OPT_readahead },
 	{ "readahead-bytes",	1,	0,	OPT_readahead_bytes },
 	{ "readahead-ops",	1,	0,	OPT_readahead_ops },
+	{ "readpath",		1,	0,	OPT_readpath },
+	{ "readpath-block-size",1,	0,	OPT_readpath_block_size },
+	{ "readpath-bytes",	1,	0,	OPT_readpath_bytes },
+	{ "readpath-ops",	1,	0,	OPT_readpath_ops },
+	{ "readpath-random",	0,	0,	OPT_readpath_random },
 	{ "reboot",		1,	0,	OPT_reboot },
 	{ "reboot-ops",		1,	0,	OPT_reboot_ops },
 	{ "regs",		1,	0,	OPT_regs },
@@ -817,6 +859,12 @@ const struct option stress_long_options[] = {
 	{ "shm-mlock",		0,	0,	OPT_shm_mlock },
 	{ "shm-objs",		1,	0,	OPT_shm_objects },
 	{ "shm-ops",		1,	0,	OPT_shm_ops },
+	{ "shm-ring",		1,	0,	OPT_shm_ring },
+	{ "shm-ring-consumers",1,	0,	OPT_shm_ring_consumers },
+	{ "shm-ring-msg-size",1,	0,	OPT_shm_ring_msg_size },
+	{ "shm-ring-ops",	1,	0,	OPT_shm_ring_ops },
+	{ "shm-ring-producers",1,	0,	OPT_shm_ring_producers },
+	{ "shm-ring-wake",	1,	0,	OPT_shm_ring_wake },
 	{ "shm-sysv",		1,	0,	OPT_shm_sysv },
 	{ "shm-sysv-bytes",	1,	0,	OPT_shm_sysv_bytes },
 	{ "shm-sysv-mlock",	0,	0,	OPT_shm_sysv_mlock },
@@ -876,11 +924,24 @@ const struct option stress_long_options[] = {
 	{ "sock-opts",		1,	0,	OPT_sock_opts },
 	{ "sock-port",		1,	0,	OPT_sock_port },
 	{ "sock-protocol",	1,	0,	OPT_sock_protocol },
+	{ "sock-rpc",		1,	0,	OPT_sock_rpc },
+	{ "sock-rpc-pipeline",	1,	0,	OPT_sock_rpc_pipeline },
+	{ "sock-rpc-size",	1,	0,	OPT_sock_rpc_size },
 	{ "sock-type",		1,	0,	OPT_sock_type },
 	{ "sock-zerocopy", 	0,	0,	OPT_sock_zerocopy },
+	{ "sock-zerocopy-sweep", 0,	0,	OPT_sock_zerocopy_sweep },
 	{ "sockabuse",		1,	0,	OPT_sockabuse },
 	{ "sockabuse-ops",	1,	0,	OPT_sockabuse_ops },
 	{ "sockabuse-port",	1,	0,	OPT_sockabuse_port },
+	{ "sockchurn",		1,	0,	OPT_sockchurn },
+	{ "sockchurn-backlog",	1,	0,	OPT_sockchurn_backlog },
+	{ "sockchurn-close",	1,	0,	OPT_sockchurn_close },
+	{ "sockchurn-domain",	1,	0,	OPT_sockchurn_domain },
+	{ "sockchurn-ops",	1,	0,	OPT_sockchurn_ops },
+	{ "sockchurn-port",	1,	0,	OPT_sockchurn_port },
+	{ "sockchurn-ports",	1,	0,	OPT_sockchurn_ports },
+	{ "sockchurn-rate",	1,	0,	OPT_sockchurn_rate },
+	{ "sockchurn-threads",	1,	0,	OPT_sockchurn_threads },
 	{ "sockdiag",		1,	0,	OPT_sockdiag },
 	{ "sockdiag-ops",	1,	0,	OPT_sockdiag_ops },
 	{ "sockfd",		1,	0,	OPT_sockfd },
@@ -891,7 +952,9 @@ const struct option stress_long_options[] = {
 	{ "sockmany-ops",	1,	0,	OPT_sockmany_ops },
 	{ "sockmany-port",	1,	0,	OPT_sockmany_port },
 	{ "sockpair",		1,	0,	OPT_sockpair },
+	{ "sockpair-fds",	1,	0,	OPT_sockpair_fds },
 	{ "sockpair-ops",	1,	0,	OPT_sockpair_ops },
+	{ "sockpair-sweep",	0,	0,	OPT_sockpair_sweep },
 	{ "softlockup",		1,	0,	OPT_softlockup },
 	{ "softlockup-ops",	1,	0,	OPT_softlockup_ops },
 	{ "sparsematrix",	1,	0,	OPT_sparsematrix},
@@ -931,6 +994,7 @@ const struct option stress_long_options[] = {
 	{ "switch-freq",	1,	0,	OPT_switch_freq },
 	{ "switch-method",	1,	0,	OPT_switch_method },
 	{ "switch-ops",		1,	0,	OPT_switch_ops },
+	{ "switch-topology",	0,	0,	OPT_switch_topology },
 	{ "symlink",		1,	0,	OPT_symlink },
 	{ "symlink-ops",	1,	0,	OPT_symlink_ops },
 	{ "symlink-sync",	0,	0,	OPT_symlink_sync },
@@ -1001,13 +1065,17 @@ const struct option stress_long_options[] = {
 	{ "thrash",		0,	0,	OPT_thrash },
 	{ "times",		0,	0,	OPT_times },
 	{ "timestamp",		0,	0,	OPT_timestamp },
+	{ "trace-decode",	1,	0,	OPT_trace_decode },
+	{ "trace-file",		1,	0,	OPT_trace_file },
 	{ "tz",			0,	0,	OPT_thermal_zones },
 	{ "tun",		1,	0,	OPT_tun},
 	{ "tun-tap",		0,	0,	OPT_tun_tap },
 	{ "tun-ops",		1,	0,	OPT_tun_ops },
 	{ "udp",		1,	0,	OPT_udp },
+	{ "udp-batch",		1,	0,	OPT_udp_batch },
 	{ "udp-domain",		1,	0,	OPT_udp_domain },
 	{ "udp-gro",		0,	0,	OPT_udp_gro },
+	{ "udp-gso",		0,	0,	OPT_udp_gso },
 	{ "udp-if",		1,	0,	OPT_udp_if },
 	{ "udp-lite",		0,	0,	OPT_udp_lite },
 	{ "udp-ops",		1,	0,	OPT_udp_ops },
@@ -1106,6 +1174,7 @@ const struct option stress_long_options[] = {
 	{ "workload-method",	1,	0,	OPT_workload_method },
 	{ "workload-ops",	1,	0,	OPT_workload_ops },
 	{ "workload-quanta-us",	1,	0,	OPT_workload_quanta_us },
+	{ "workload-rate",	1,	0,	OPT_workload_rate },
 	{ "workload-sched",	1,	0,	OPT_workload_sched },
 	{ "workload-slice-us",	1,	0,	OPT_workload_slice_us },
 	{ "workload-threads",	1,	0,	OPT_workload_threads },
@@ -236,6 +236,10 @@ typedef enum {
 	OPT_cgroup,
 	OPT_cgroup_ops,
 
+	OPT_cgroup_cpu_max,
+	OPT_cgroup_io_max,
+	OPT_cgroup_memory_high,
+
 	OPT_chattr,
 	OPT_chattr_ops,
 
@@ -281,6 +285,7 @@ typedef enum {
 	OPT_cpu_online,
 	OPT_cpu_online_affinity,
 	OPT_cpu_online_all,
+	OPT_cpu_online_latency,
 	OPT_cpu_online_ops,
 
 	OPT_crypt,
@@ -364,6 +369,8 @@ typedef enum {
 	OPT_epoll_ops,
 	OPT_epoll_port,
 	OPT_epoll_domain,
+	OPT_epoll_reactors,
+	OPT_epoll_shard,
 	OPT_epoll_sockets,
 
 	OPT_eventfd,
@@ -475,6 +482,14 @@ typedef enum {
 	OPT_futex,
 	OPT_futex_ops,
 
+	OPT_futex_queue,
+	OPT_futex_queue_batch,
+	OPT_futex_queue_consumers,
+	OPT_futex_queue_ops,
+	OPT_futex_queue_producers,
+	OPT_futex_queue_spin,
+	OPT_futex_queue_wait,
+
 	OPT_get,
 	OPT_get_ops,
 
@@ -497,6 +512,12 @@ typedef enum {
 	OPT_gpu_xsize,
 	OPT_gpu_ysize,
 
+	OPT_group_commit,
+	OPT_group_commit_ops,
+	OPT_group_commit_method,
+	OPT_group_commit_record,
+	OPT_group_commit_writers,
+
 	OPT_handle,
 	OPT_handle_ops,
 
@@ -544,7 +565,10 @@ typedef enum {
 
 	OPT_iomix,
 	OPT_iomix_bytes,
+	OPT_iomix_lock,
 	OPT_iomix_ops,
+	OPT_iomix_overlap,
+	OPT_iomix_threads,
 
 	OPT_ioport,
 	OPT_ioport_ops,
@@ -562,6 +586,9 @@ typedef enum {
 
 	OPT_io_uring,
 	OPT_io_uring_entries,
+	OPT_io_uring_net,
+	OPT_io_uring_net_port,
+	OPT_io_uring_net_size,
 	OPT_io_uring_ops,
 
 	OPT_ipsec_mb,
@@ -741,6 +768,13 @@ typedef enum {
 	OPT_mergesort_ops,
 	OPT_mergesort_size,
 
+	OPT_metadata,
+	OPT_metadata_ops,
+	OPT_metadata_dirs,
+	OPT_metadata_files,
+	OPT_metadata_mix,
+	OPT_metadata_threads,
+
 	OPT_metamix,
 	OPT_metamix_ops,
 	OPT_metamix_bytes,
@@ -861,6 +895,7 @@ typedef enum {
 	OPT_nanosleep,
 	OPT_nanosleep_method,
 	OPT_nanosleep_ops,
+	OPT_nanosleep_sweep,
 	OPT_nanosleep_threads,
 
 	OPT_netdev,
@@ -954,6 +989,8 @@ typedef enum {
 	OPT_pkey,
 	OPT_pkey_ops,
 
+	OPT_placement,
+
 	OPT_plugin,
 	OPT_plugin_ops,
 	OPT_plugin_method,
@@ -967,6 +1004,8 @@ typedef enum {
 	OPT_prefetch_method,
 	OPT_prefetch_ops,
 
+	OPT_pressurestat,
+
 	OPT_prctl,
 	OPT_prctl_ops,
 
@@ -981,9 +1020,14 @@ typedef enum {
 	OPT_procfs,
 	OPT_procfs_ops,
 
+	OPT_procmatrix,
+	OPT_procmatrix_max_size,
+	OPT_procmatrix_ops,
+
 	OPT_progress,
 
 	OPT_pthread,
+	OPT_pthread_bench,
 	OPT_pthread_ops,
 	OPT_pthread_max,
 
@@ -1048,6 +1092,12 @@ typedef enum {
 	OPT_readahead_ops,
 	OPT_readahead_bytes,
 
+	OPT_readpath,
+	OPT_readpath_block_size,
+	OPT_readpath_bytes,
+	OPT_readpath_ops,
+	OPT_readpath_random,
+
 	OPT_reboot,
 	OPT_reboot_ops,
 
@@ -1164,6 +1214,13 @@ typedef enum {
 	OPT_shm_ops,
 	OPT_shm_objects,
 
+	OPT_shm_ring,
+	OPT_shm_ring_consumers,
+	OPT_shm_ring_msg_size,
+	OPT_shm_ring_ops,
+	OPT_shm_ring_producers,
+	OPT_shm_ring_wake,
+
 	OPT_shm_sysv,
 	OPT_shm_sysv_bytes,
 	OPT_shm_sysv_mlock,
@@ -1248,13 +1305,27 @@ typedef enum {
 	OPT_sock_opts,
 	OPT_sock_port,
 	OPT_sock_protocol,
+	OPT_sock_rpc,
+	OPT_sock_rpc_pipeline,
+	OPT_sock_rpc_size,
 	OPT_sock_type,
 	OPT_sock_zerocopy,
+	OPT_sock_zerocopy_sweep,
 
 	OPT_sockabuse,
 	OPT_sockabuse_ops,
 	OPT_sockabuse_port,
 
+	OPT_sockchurn,
+	OPT_sockchurn_backlog,
+	OPT_sockchurn_close,
+	OPT_sockchurn_domain,
+	OPT_sockchurn_ops,
+	OPT_sockchurn_port,
+	OPT_sockchurn_ports,
+	OPT_sockchurn_rate,
+	OPT_sockchurn_threads,
+
 	OPT_sockdiag,
 	OPT_sockdiag_ops,
 
@@ -1268,7 +1339,9 @@ typedef enum {
 	OPT_sockmany_port,
 
 	OPT_sockpair,
+	OPT_sockpair_fds,
 	OPT_sockpair_ops,
+	OPT_sockpair_sweep,
 
 	OPT_softlockup,
 	OPT_softlockup_ops,
@@ -1279,6 +1352,7 @@ typedef enum {
 	OPT_switch_ops,
 	OPT_switch_freq,
 	OPT_switch_method,
+	OPT_switch_topology,
 
 	OPT_spawn,
 	OPT_spawn_ops,
@@ -1381,6 +1455,9 @@ typedef enum {
 
 	OPT_timestamp,
 
+	OPT_trace_decode,
+	OPT_trace_file,
+
 	OPT_time_warp,
 	OPT_time_warp_ops,
 
@@ -1422,9 +1499,11 @@ typedef enum {
 	OPT_udp,
 	OPT_udp_ops,
 	OPT_udp_port,
+	OPT_udp_batch,
 	OPT_udp_domain,
 	OPT_udp_lite,
 	OPT_udp_gro,
+	OPT_udp_gso,
 	OPT_udp_if,
 
 	OPT_udp_flood,
@@ -1543,6 +1622,7 @@ typedef enum {
 	OPT_workload_method,
 	OPT_workload_ops,
 	OPT_workload_quanta_us,
+	OPT_workload_rate,
 	OPT_workload_sched,
 	OPT_workload_slice_us,
 	OPT_workload_threads,
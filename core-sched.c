@@ -334,3 +334,67 @@ int sched_settings_apply(const bool quiet)
 
         return stress_set_sched(getpid(), (int)sched, sched_prio, quiet);
 }
+
+/*
+ *  stress_get_schedstat()
+ *	read the on-CPU time, run queue wait time and number of
+ *	timeslices of a process from /proc/pid/schedstat, pid 0
+ *	is the calling process. Returns 0 on success, -1 on failure
+ */
+int stress_get_schedstat(const pid_t pid, stress_schedstat_t *schedstat)
+{
+#if defined(__linux__)
+	char path[64];
+	char buf[128];
+
+	if (pid) {
+		(void)snprintf(path, sizeof(path), "/proc/%" PRIdMAX "/schedstat", (intmax_t)pid);
+	} else {
+#if defined(CLOCK_THREAD_CPUTIME_ID)
+		struct timespec ts;
+
+		/*
+		 *  The on-CPU time of a running task is only brought up
+		 *  to date on a tick or context switch, reading the thread
+		 *  CPU clock forces an update so short intervals are exact
+		 */
+		(void)clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+#endif
+		(void)shim_strscpy(path, "/proc/self/schedstat", sizeof(path));
+	}
+
+	(void)shim_memset(buf, 0, sizeof(buf));
+	if (stress_system_read(path, buf, sizeof(buf)) < 1)
+		return -1;
+	if (sscanf(buf, "%" SCNu64 " %" SCNu64 " %" SCNu64,
+		   &schedstat->run_ns, &schedstat->wait_ns,
+		   &schedstat->timeslices) != 3)
+		return -1;
+	return 0;
+#else
+	(void)pid;
+	(void)shim_memset(schedstat, 0, sizeof(*schedstat));
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
+/*
+ *  stress_sched_fairness()
+ *	Jain's fairness index (sum x)^2 / (n * sum x^2) of n
+ *	values, 1.0 is perfectly fair down to 1/n for the
+ *	most unfair case, 0.0 if there is nothing to compare
+ */
+double stress_sched_fairness(const double *values, const size_t n)
+{
+	double sum = 0.0, sum_sq = 0.0;
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		sum += values[i];
+		sum_sq += values[i] * values[i];
+	}
+	if ((n == 0) || (sum_sq <= 0.0))
+		return 0.0;
+	return (sum * sum) / ((double)n * sum_sq);
+}
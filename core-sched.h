@@ -19,10 +19,19 @@
 #ifndef CORE_SCHED_H
 #define CORE_SCHED_H
 
+/* per process scheduler statistics from /proc/pid/schedstat */
+typedef struct {
+	uint64_t run_ns;	/* time spent on a CPU */
+	uint64_t wait_ns;	/* time spent waiting on a run queue */
+	uint64_t timeslices;	/* number of times run on a CPU */
+} stress_schedstat_t;
+
 extern const char *stress_get_sched_name(const int sched);
 extern WARN_UNUSED int stress_set_sched(const pid_t pid, const int sched,
 	const int sched_priority, const bool quiet);
 extern WARN_UNUSED int32_t stress_get_opt_sched(const char *const str);
 extern int sched_settings_apply(const bool quiet);
+extern int stress_get_schedstat(const pid_t pid, stress_schedstat_t *schedstat);
+extern double stress_sched_fairness(const double *values, const size_t n);
 
 #endif
@@ -105,11 +105,13 @@
 	MACRO(funccall)		\
 	MACRO(funcret)		\
 	MACRO(futex)		\
+	MACRO(futex_queue)	\
 	MACRO(get)		\
 	MACRO(getdent)		\
 	MACRO(getrandom)	\
 	MACRO(goto)		\
 	MACRO(gpu)		\
+	MACRO(group_commit)	\
 	MACRO(handle)		\
 	MACRO(hash)		\
 	MACRO(hdd)		\
@@ -162,6 +164,7 @@
 	MACRO(memrate)		\
 	MACRO(memthrash)	\
 	MACRO(mergesort)	\
+	MACRO(metadata)		\
 	MACRO(metamix)		\
 	MACRO(mincore)		\
 	MACRO(misaligned)	\
@@ -215,6 +218,7 @@
 	MACRO(prio_inv)		\
 	MACRO(priv_instr)	\
 	MACRO(procfs)		\
+	MACRO(procmatrix)	\
 	MACRO(pthread)		\
 	MACRO(ptrace)		\
 	MACRO(pty)		\
@@ -230,6 +234,7 @@
 	MACRO(rawudp)		\
 	MACRO(rdrand)		\
 	MACRO(readahead)	\
+	MACRO(readpath)		\
 	MACRO(reboot)		\
 	MACRO(regs)		\
 	MACRO(remap)		\
@@ -257,6 +262,7 @@
 	MACRO(set)		\
 	MACRO(shellsort)	\
 	MACRO(shm)		\
+	MACRO(shm_ring)		\
 	MACRO(shm_sysv)		\
 	MACRO(sigabrt)		\
 	MACRO(sigbus)		\
@@ -280,6 +286,7 @@
 	MACRO(smi)		\
 	MACRO(sock)		\
 	MACRO(sockabuse)	\
+	MACRO(sockchurn)	\
 	MACRO(sockdiag)		\
 	MACRO(sockfd)		\
 	MACRO(sockpair)		\
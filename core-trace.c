@@ -0,0 +1,514 @@
+/*
+ * Copyright (C) 2024      Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+#include "core-asm-x86.h"
+#include "core-builtin.h"
+#include "core-killpid.h"
+#include "core-trace.h"
+
+#include <sys/wait.h>
+
+#define STRESS_TRACE_EVENTS	(4096)		/* events per instance ring */
+#define STRESS_TRACE_NAME_LEN	(32)
+#define STRESS_TRACE_SAMPLE_NS	(100000000ULL)	/* counter sampling, 0.1 secs */
+#define STRESS_TRACE_STALL	(1.0)		/* flag no progress after 1 sec */
+#define STRESS_TRACE_VERSION	(1)
+
+#define STRESS_TRACE_STATE	(1)		/* arg = state, value = counter */
+#define STRESS_TRACE_COUNTER	(2)		/* value = counter */
+#define STRESS_TRACE_FORK	(3)		/* value = child pid */
+#define STRESS_TRACE_EXIT	(4)		/* arg = wait status, value = counter */
+#define STRESS_TRACE_SIGNAL	(5)		/* arg = signal, value = counter */
+
+#if defined(STRESS_ARCH_X86) &&	\
+    defined(HAVE_ASM_X86_RDTSC)
+#define STRESS_TRACE_TSC
+#endif
+
+/* compact binary event, 24 bytes */
+typedef struct {
+	uint64_t ts;			/* TSC or nanosecond timestamp */
+	uint64_t value;			/* event specific value */
+	int32_t pid;			/* pid of the writer */
+	uint16_t type;			/* STRESS_TRACE_* event type */
+	uint16_t arg;			/* event specific argument */
+} stress_trace_event_t;
+
+/* per-instance ring in shared memory */
+typedef struct {
+	uint64_t head;			/* next event slot to claim */
+	uint32_t instance;		/* stressor instance number */
+	bool active;			/* true if instance is running */
+	char name[STRESS_TRACE_NAME_LEN];	/* stressor name */
+	stress_trace_event_t events[STRESS_TRACE_EVENTS];
+} stress_trace_ring_t;
+
+/* trace file header, followed by rings * (ring header + events) */
+typedef struct {
+	char magic[8];			/* "STNGTRC" */
+	uint32_t version;		/* STRESS_TRACE_VERSION */
+	uint32_t rings;			/* number of rings in the file */
+	uint32_t event_size;		/* sizeof(stress_trace_event_t) */
+	uint32_t tsc;			/* 1 = TSC, 0 = nanosecond clock */
+	uint64_t ts_start;		/* timestamp at start of run */
+	double ts_hz;			/* timestamp ticks per second */
+} stress_trace_file_header_t;
+
+typedef struct {
+	char name[STRESS_TRACE_NAME_LEN];	/* stressor name */
+	uint32_t instance;		/* stressor instance number */
+	uint32_t count;			/* number of events that follow */
+	uint64_t dropped;		/* events overwritten on ring wrap */
+} stress_trace_file_ring_t;
+
+static const char stress_trace_magic[8] = "STNGTRC";
+
+static const char * const stress_trace_states[] = {
+	"start",
+	"init",
+	"run",
+	"deinit",
+	"stop",
+	"exit",
+	"wait",
+	"zombie",
+};
+
+static const char *trace_filename;
+static stress_trace_ring_t *trace_rings = MAP_FAILED;
+static size_t trace_rings_size;
+static uint32_t trace_rings_count;
+static stress_trace_ring_t *trace_ring;	/* ring of this instance */
+static const stress_counter_info_t *trace_ci;	/* bogo-op counter of this instance */
+static uint64_t trace_ts_start;
+static double trace_time_start;
+static pid_t trace_pid = -1;
+static int32_t trace_self_pid;	/* cached pid of this process for events */
+
+/*
+ *  stress_set_trace_file()
+ *	set the --trace-file filename
+ */
+int stress_set_trace_file(const char *opt)
+{
+	if (!*opt) {
+		(void)fprintf(stderr, "trace-file: no filename specified\n");
+		return -1;
+	}
+	trace_filename = opt;
+	return 0;
+}
+
+/*
+ *  stress_trace_ts()
+ *	cheap timestamp, TSC where available
+ */
+static inline uint64_t ALWAYS_INLINE stress_trace_ts(void)
+{
+#if defined(STRESS_TRACE_TSC)
+	return stress_asm_x86_rdtsc();
+#else
+	return (uint64_t)(stress_time_now() * STRESS_DBL_NANOSECOND);
+#endif
+}
+
+/*
+ *  stress_trace_add()
+ *	append an event to a ring, slots are claimed with an
+ *	atomic add so the stressor, its children, the parent
+ *	and the sampler can all write without locking. The
+ *	oldest events are overwritten when the ring wraps.
+ */
+static void stress_trace_add(
+	stress_trace_ring_t *ring,
+	const uint16_t type,
+	const uint16_t arg,
+	const uint64_t value)
+{
+	uint64_t slot;
+	stress_trace_event_t *event;
+
+#if defined(HAVE_ATOMIC_FETCH_ADD)
+	slot = __atomic_fetch_add(&ring->head, 1, __ATOMIC_RELAXED);
+#else
+	slot = ring->head++;
+#endif
+	event = &ring->events[slot % STRESS_TRACE_EVENTS];
+	event->ts = stress_trace_ts();
+	event->value = value;
+	event->pid = trace_self_pid;
+	event->type = type;
+	event->arg = arg;
+}
+
+/*
+ *  stress_trace_ring()
+ *	find the ring for a given stats slot
+ */
+static stress_trace_ring_t *stress_trace_ring(const stress_stats_t *stats)
+{
+	size_t idx;
+
+	if ((trace_rings == MAP_FAILED) || !g_shared || !stats)
+		return NULL;
+	if (stats < g_shared->stats)
+		return NULL;
+	idx = (size_t)(stats - g_shared->stats);
+	if (idx >= trace_rings_count)
+		return NULL;
+	return &trace_rings[idx];
+}
+
+/*
+ *  stress_trace_init()
+ *	allocate the per-instance rings in shared memory,
+ *	one ring per g_shared->stats[] slot
+ */
+void stress_trace_init(void)
+{
+	if (!trace_filename || !g_shared || (g_shared->stats_count == 0))
+		return;
+
+	trace_rings_count = g_shared->stats_count;
+	trace_rings_size = sizeof(*trace_rings) * (size_t)trace_rings_count;
+	trace_rings = (stress_trace_ring_t *)mmap(NULL, trace_rings_size,
+		PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (trace_rings == MAP_FAILED) {
+		pr_inf("trace: cannot mmap %zu bytes for trace rings, errno=%d (%s), disabling tracing\n",
+			trace_rings_size, errno, strerror(errno));
+		trace_rings_count = 0;
+		return;
+	}
+	trace_time_start = stress_time_now();
+	trace_ts_start = stress_trace_ts();
+	trace_self_pid = (int32_t)getpid();
+}
+
+/*
+ *  stress_trace_start()
+ *	start a light weight process that snapshots the bogo-op
+ *	counters of running instances every 0.1 seconds so that
+ *	stalls can be seen without touching the stressors
+ */
+void stress_trace_start(void)
+{
+	if (trace_rings == MAP_FAILED)
+		return;
+
+	trace_pid = fork();
+	if (trace_pid != 0) {
+		if (trace_pid < 0)
+			pr_inf("trace: cannot fork counter sampler, errno=%d (%s)\n",
+				errno, strerror(errno));
+		return;
+	}
+
+	trace_self_pid = (int32_t)getpid();
+	stress_parent_died_alarm();
+	stress_set_proc_name("stat [trace]");
+
+	while (stress_continue_flag()) {
+		uint32_t i;
+
+		for (i = 0; i < trace_rings_count; i++) {
+			stress_trace_ring_t *ring = &trace_rings[i];
+
+			if (ring->active)
+				stress_trace_add(ring, STRESS_TRACE_COUNTER, 0,
+					g_shared->stats[i].args.ci.counter);
+		}
+		(void)shim_nanosleep_uint64(STRESS_TRACE_SAMPLE_NS);
+	}
+	_exit(0);
+}
+
+/*
+ *  stress_trace_stop()
+ *	stop the counter sampler
+ */
+void stress_trace_stop(void)
+{
+	if (trace_pid > 0)
+		(void)stress_kill_pid_wait(trace_pid, NULL);
+	trace_pid = -1;
+}
+
+/*
+ *  stress_trace_instance()
+ *	called by a newly forked stressor to select its ring
+ */
+void stress_trace_instance(const stress_stats_t *stats)
+{
+	trace_ring = stress_trace_ring(stats);
+	trace_ci = trace_ring ? &stats->args.ci : NULL;
+	trace_self_pid = (int32_t)getpid();
+}
+
+/*
+ *  stress_trace_fork()
+ *	record a stressor instance being forked by the parent
+ */
+void stress_trace_fork(
+	const stress_stats_t *stats,
+	const char *name,
+	const uint32_t instance,
+	const pid_t pid)
+{
+	stress_trace_ring_t *ring = stress_trace_ring(stats);
+
+	if (!ring)
+		return;
+	(void)stress_munge_underscore(ring->name, name, sizeof(ring->name));
+	ring->instance = instance;
+	ring->active = true;
+	stress_trace_add(ring, STRESS_TRACE_FORK, 0, (uint64_t)pid);
+}
+
+/*
+ *  stress_trace_exit()
+ *	record a stressor instance being reaped by the parent
+ */
+void stress_trace_exit(const stress_stats_t *stats, const int status)
+{
+	stress_trace_ring_t *ring = stress_trace_ring(stats);
+
+	if (!ring)
+		return;
+	ring->active = false;
+	stress_trace_add(ring, STRESS_TRACE_EXIT, (uint16_t)status,
+		stats->args.ci.counter);
+}
+
+/*
+ *  stress_trace_state()
+ *	record a stressor run state change, see STRESS_STATE_*
+ */
+void stress_trace_state(const int state)
+{
+	if (!trace_ring)
+		return;
+	stress_trace_add(trace_ring, STRESS_TRACE_STATE, (uint16_t)state,
+		trace_ci->counter);
+}
+
+/*
+ *  stress_trace_signal()
+ *	record a signal received by a stressor, async signal safe
+ */
+void stress_trace_signal(const int signum)
+{
+	if (!trace_ring)
+		return;
+	stress_trace_add(trace_ring, STRESS_TRACE_SIGNAL, (uint16_t)signum,
+		trace_ci->counter);
+}
+
+/*
+ *  stress_trace_dump()
+ *	write the rings to the --trace-file in binary form,
+ *	oldest event first, and free the rings
+ */
+void stress_trace_dump(void)
+{
+	FILE *fp;
+	uint32_t i;
+	stress_trace_file_header_t hdr;
+	const uint64_t ts_end = stress_trace_ts();
+	const double time_end = stress_time_now();
+	const double duration = time_end - trace_time_start;
+	uint64_t total = 0, dropped = 0;
+
+	if (trace_rings == MAP_FAILED)
+		return;
+
+	fp = fopen(trace_filename, "w");
+	if (!fp) {
+		pr_err("trace: cannot create trace file %s, errno=%d (%s)\n",
+			trace_filename, errno, strerror(errno));
+		goto unmap;
+	}
+
+	(void)shim_memset(&hdr, 0, sizeof(hdr));
+	(void)shim_memcpy(hdr.magic, stress_trace_magic, sizeof(hdr.magic));
+	hdr.version = STRESS_TRACE_VERSION;
+	hdr.rings = trace_rings_count;
+	hdr.event_size = (uint32_t)sizeof(stress_trace_event_t);
+#if defined(STRESS_TRACE_TSC)
+	hdr.tsc = 1;
+#endif
+	hdr.ts_start = trace_ts_start;
+	hdr.ts_hz = ((duration > 0.0) && (ts_end > trace_ts_start)) ?
+		(double)(ts_end - trace_ts_start) / duration : STRESS_DBL_NANOSECOND;
+	if (fwrite(&hdr, sizeof(hdr), 1, fp) != 1)
+		goto write_fail;
+
+	for (i = 0; i < trace_rings_count; i++) {
+		const stress_trace_ring_t *ring = &trace_rings[i];
+		const uint64_t head = ring->head;
+		const uint64_t n = STRESS_MINIMUM(head, STRESS_TRACE_EVENTS);
+		stress_trace_file_ring_t fring;
+		uint64_t j;
+
+		(void)shim_memset(&fring, 0, sizeof(fring));
+		(void)shim_strscpy(fring.name, ring->name, sizeof(fring.name));
+		fring.instance = ring->instance;
+		fring.count = (uint32_t)n;
+		fring.dropped = head - n;
+		if (fwrite(&fring, sizeof(fring), 1, fp) != 1)
+			goto write_fail;
+		for (j = head - n; j < head; j++) {
+			if (fwrite(&ring->events[j % STRESS_TRACE_EVENTS],
+				   sizeof(stress_trace_event_t), 1, fp) != 1)
+				goto write_fail;
+		}
+		total += n;
+		dropped += fring.dropped;
+	}
+	(void)fclose(fp);
+	pr_inf("trace: %" PRIu64 " events (%" PRIu64 " dropped) written to %s\n",
+		total, dropped, trace_filename);
+	goto unmap;
+
+write_fail:
+	pr_err("trace: failed to write trace file %s, errno=%d (%s)\n",
+		trace_filename, errno, strerror(errno));
+	(void)fclose(fp);
+unmap:
+	(void)munmap((void *)trace_rings, trace_rings_size);
+	trace_rings = MAP_FAILED;
+	trace_ring = NULL;
+}
+
+/*
+ *  stress_trace_decode_status()
+ *	turn a wait status into a human readable string
+ */
+static void stress_trace_decode_status(const int status, char *buf, const size_t len)
+{
+	if (WIFSIGNALED(status))
+		(void)snprintf(buf, len, "killed by signal %d (%s)",
+			WTERMSIG(status), stress_get_signal_name(WTERMSIG(status)));
+	else
+		(void)snprintf(buf, len, "exit status %d", WEXITSTATUS(status));
+}
+
+/*
+ *  stress_trace_decode()
+ *	decode a --trace-file to stdout, one line per event
+ */
+int stress_trace_decode(const char *filename)
+{
+	FILE *fp;
+	stress_trace_file_header_t hdr;
+	uint32_t i;
+	int rc = -1;
+
+	fp = fopen(filename, "r");
+	if (!fp) {
+		(void)fprintf(stderr, "cannot open trace file %s, errno=%d (%s)\n",
+			filename, errno, strerror(errno));
+		return -1;
+	}
+	if ((fread(&hdr, sizeof(hdr), 1, fp) != 1) ||
+	    (memcmp(hdr.magic, stress_trace_magic, sizeof(hdr.magic)) != 0) ||
+	    (hdr.version != STRESS_TRACE_VERSION) ||
+	    (hdr.event_size != sizeof(stress_trace_event_t)) ||
+	    (hdr.ts_hz <= 0.0)) {
+		(void)fprintf(stderr, "%s is not a compatible stress-ng trace file\n", filename);
+		goto close;
+	}
+	(void)printf("%s: %" PRIu32 " instances, %s timestamps at %.3f MHz\n",
+		filename, hdr.rings, hdr.tsc ? "TSC" : "clock",
+		hdr.ts_hz / 1000000.0);
+
+	for (i = 0; i < hdr.rings; i++) {
+		stress_trace_file_ring_t fring;
+		uint32_t j;
+		uint64_t last_counter = 0;
+		double last_progress = 0.0;
+
+		if (fread(&fring, sizeof(fring), 1, fp) != 1)
+			goto truncated;
+		fring.name[sizeof(fring.name) - 1] = '\0';
+		if (fring.count == 0)
+			continue;
+		(void)printf("%s instance %" PRIu32 ": %" PRIu32 " events, %" PRIu64 " dropped\n",
+			fring.name, fring.instance, fring.count, fring.dropped);
+
+		for (j = 0; j < fring.count; j++) {
+			stress_trace_event_t event;
+			char detail[128];
+			double t;
+
+			if (fread(&event, sizeof(event), 1, fp) != 1)
+				goto truncated;
+			t = ((double)event.ts - (double)hdr.ts_start) / hdr.ts_hz;
+
+			switch (event.type) {
+			case STRESS_TRACE_STATE:
+				(void)snprintf(detail, sizeof(detail), "state %s, bogo-ops %" PRIu64,
+					(event.arg < SIZEOF_ARRAY(stress_trace_states)) ?
+						stress_trace_states[event.arg] : "unknown",
+					event.value);
+				break;
+			case STRESS_TRACE_COUNTER:
+				if ((event.value != last_counter) || (j == 0)) {
+					(void)snprintf(detail, sizeof(detail), "bogo-ops %" PRIu64, event.value);
+					last_counter = event.value;
+					last_progress = t;
+				} else if ((t - last_progress) >= STRESS_TRACE_STALL) {
+					(void)snprintf(detail, sizeof(detail), "bogo-ops %" PRIu64 ", no progress for %.2f secs",
+						event.value, t - last_progress);
+				} else {
+					(void)snprintf(detail, sizeof(detail), "bogo-ops %" PRIu64, event.value);
+				}
+				break;
+			case STRESS_TRACE_FORK:
+				(void)snprintf(detail, sizeof(detail), "forked pid %" PRIu64, event.value);
+				last_counter = 0;
+				last_progress = t;
+				break;
+			case STRESS_TRACE_EXIT: {
+					char status[80];
+
+					stress_trace_decode_status((int)event.arg, status, sizeof(status));
+					(void)snprintf(detail, sizeof(detail), "reaped, %s, bogo-ops %" PRIu64,
+						status, event.value);
+				}
+				break;
+			case STRESS_TRACE_SIGNAL:
+				(void)snprintf(detail, sizeof(detail), "signal %s, bogo-ops %" PRIu64,
+					stress_get_signal_name((int)event.arg), event.value);
+				break;
+			default:
+				(void)snprintf(detail, sizeof(detail), "unknown event %" PRIu16, event.type);
+				break;
+			}
+			(void)printf("  %12.6f [%" PRId32 "] %s\n", t, event.pid, detail);
+		}
+	}
+	rc = 0;
+	goto close;
+
+truncated:
+	(void)fprintf(stderr, "%s: trace file is truncated\n", filename);
+close:
+	(void)fclose(fp);
+	return rc;
+}
@@ -0,0 +1,38 @@
+/*
+ * Copyright (C) 2024      Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#ifndef CORE_TRACE_H
+#define CORE_TRACE_H
+
+#include "stress-ng.h"
+
+/* binary per-instance event trace helpers */
+extern int stress_set_trace_file(const char *opt);
+extern int stress_trace_decode(const char *filename);
+extern void stress_trace_init(void);
+extern void stress_trace_start(void);
+extern void stress_trace_stop(void);
+extern void stress_trace_dump(void);
+extern void stress_trace_instance(const stress_stats_t *stats);
+extern void stress_trace_fork(const stress_stats_t *stats, const char *name,
+	const uint32_t instance, const pid_t pid);
+extern void stress_trace_exit(const stress_stats_t *stats, const int status);
+extern void stress_trace_state(const int state);
+extern void stress_trace_signal(const int signum);
+
+#endif
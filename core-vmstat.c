@@ -19,6 +19,7 @@
  */
 #include "stress-ng.h"
 #include "core-builtin.h"
+#include "core-cgroup.h"
 #include "core-killpid.h"
 #include "core-pragma.h"
 #include "core-thermal-zone.h"
@@ -110,10 +111,61 @@ typedef struct {
 	uint64_t	discard_ticks;	/* total wait time for discard requests */
 } stress_iostat_t;
 
+#define STRESS_PSI_CPU		(0)
+#define STRESS_PSI_MEMORY	(1)
+#define STRESS_PSI_IO		(2)
+#define STRESS_PSI_MAX		(3)
+
+#define STRESS_PRESSURESTAT_SAMPLES	(4096)
+
+/* pressure stall information, from /proc/pressure/$resource */
+typedef struct {
+	double		some_avg10;	/* % time some tasks stalled, 10 sec avg */
+	double		full_avg10;	/* % time all tasks stalled, 10 sec avg */
+	uint64_t	some_total;	/* total some stall time, usecs */
+	uint64_t	full_total;	/* total full stall time, usecs */
+} stress_psi_t;
+
+/* pressure and cgroup v2 statistics sample */
+typedef struct {
+	double		time;		/* secs since start of run */
+	uint64_t	bogo_ops;	/* bogo ops of all instances so far */
+	bool		psi_ok[STRESS_PSI_MAX];	/* psi[] is valid */
+	bool		cpu_ok;		/* cgroup cpu.stat is valid */
+	bool		memory_ok;	/* cgroup memory.stat is valid */
+	bool		io_ok;		/* cgroup io.stat is valid */
+	stress_psi_t	psi[STRESS_PSI_MAX];
+	uint64_t	cpu_usage_usec;	/* cpu.stat usage_usec */
+	uint64_t	cpu_user_usec;	/* cpu.stat user_usec */
+	uint64_t	cpu_system_usec;/* cpu.stat system_usec */
+	uint64_t	cpu_nr_throttled; /* cpu.stat nr_throttled */
+	uint64_t	cpu_throttled_usec; /* cpu.stat throttled_usec */
+	uint64_t	memory_anon;	/* memory.stat anon */
+	uint64_t	memory_file;	/* memory.stat file */
+	uint64_t	memory_pgfault;	/* memory.stat pgfault */
+	uint64_t	memory_pgmajfault; /* memory.stat pgmajfault */
+	uint64_t	io_rbytes;	/* io.stat rbytes, all devices */
+	uint64_t	io_wbytes;	/* io.stat wbytes, all devices */
+	uint64_t	io_rios;	/* io.stat rios, all devices */
+	uint64_t	io_wios;	/* io.stat wios, all devices */
+} stress_pressurestat_t;
+
+/*
+ *  ring of samples shared between the periodic stat
+ *  process (writer) and the main process (reader after
+ *  the stat process has been stopped)
+ */
+typedef struct {
+	uint64_t	head;		/* number of samples written */
+	stress_pressurestat_t samples[STRESS_PRESSURESTAT_SAMPLES];
+} stress_pressurestat_ring_t;
+
 static int32_t status_delay = 0;
 static int32_t vmstat_delay = 0;
 static int32_t thermalstat_delay = 0;
 static int32_t iostat_delay = 0;
+static int32_t pressurestat_delay = 0;
+static stress_pressurestat_ring_t *pressurestat_ring = MAP_FAILED;
 
 #if defined(__FreeBSD__)
 /*
@@ -228,6 +280,15 @@ int stress_set_iostat(const char *const opt)
 	return stress_set_generic_stat(opt, "iostat", &iostat_delay);
 }
 
+/*
+ *  stress_set_pressurestat()
+ *	parse --pressurestat option
+ */
+int stress_set_pressurestat(const char *const opt)
+{
+	return stress_set_generic_stat(opt, "pressurestat", &pressurestat_delay);
+}
+
 /*
  *  stress_find_mount_dev()
  *	find the path of the device that the file is located on
@@ -1103,6 +1164,245 @@ static void stress_get_cpu_ghz(
 }
 #endif
 
+#if defined(__linux__)
+/*
+ *  stress_read_psi()
+ *	read pressure stall information for a resource,
+ *	returns false if it is not available
+ */
+static bool stress_read_psi(const char *resource, stress_psi_t *psi)
+{
+	char path[PATH_MAX], buf[256];
+	FILE *fp;
+	int found = 0;
+
+	(void)snprintf(path, sizeof(path), "/proc/pressure/%s", resource);
+	fp = fopen(path, "r");
+	if (!fp)
+		return false;
+
+	(void)shim_memset(psi, 0, sizeof(*psi));
+	while (fgets(buf, sizeof(buf), fp)) {
+		double avg10, avg60, avg300;
+		uint64_t total;
+
+		if (sscanf(buf + 4, " avg10=%lf avg60=%lf avg300=%lf total=%" SCNu64,
+			   &avg10, &avg60, &avg300, &total) != 4)
+			continue;
+		if (!strncmp(buf, "some", 4)) {
+			psi->some_avg10 = avg10;
+			psi->some_total = total;
+			found++;
+		} else if (!strncmp(buf, "full", 4)) {
+			psi->full_avg10 = avg10;
+			psi->full_total = total;
+			found++;
+		}
+	}
+	(void)fclose(fp);
+
+	return found > 0;
+}
+
+/*
+ *  stress_read_cgroup_io()
+ *	read and sum per device cgroup v2 io.stat counters
+ */
+static bool stress_read_cgroup_io(const char *cgroup, stress_pressurestat_t *sample)
+{
+	char path[PATH_MAX + 64], buf[1024];
+	FILE *fp;
+
+	(void)snprintf(path, sizeof(path), "%s/io.stat", cgroup);
+	fp = fopen(path, "r");
+	if (!fp)
+		return false;
+
+	while (fgets(buf, sizeof(buf), fp)) {
+		char *saveptr = NULL, *tok;
+
+		/* maj:min rbytes=N wbytes=N rios=N wios=N dbytes=N dios=N */
+		for (tok = strtok_r(buf, " \n", &saveptr); tok; tok = strtok_r(NULL, " \n", &saveptr)) {
+			uint64_t val;
+
+			if (sscanf(tok, "rbytes=%" SCNu64, &val) == 1)
+				sample->io_rbytes += val;
+			else if (sscanf(tok, "wbytes=%" SCNu64, &val) == 1)
+				sample->io_wbytes += val;
+			else if (sscanf(tok, "rios=%" SCNu64, &val) == 1)
+				sample->io_rios += val;
+			else if (sscanf(tok, "wios=%" SCNu64, &val) == 1)
+				sample->io_wios += val;
+		}
+	}
+	(void)fclose(fp);
+
+	return true;
+}
+#endif
+
+/*
+ *  stress_get_pressurestat()
+ *	sample pressure stall and cgroup statistics
+ */
+static void stress_get_pressurestat(
+	const char *cgroup,
+	stress_pressurestat_t *sample)
+{
+	uint32_t i;
+
+	(void)shim_memset(sample, 0, sizeof(*sample));
+	sample->time = stress_time_now() - g_shared->time_started;
+	for (i = 0; i < g_shared->stats_count; i++)
+		sample->bogo_ops += g_shared->stats[i].args.ci.counter;
+
+#if defined(__linux__)
+	{
+		static const char * const cpu_keys[] = {
+			"usage_usec", "user_usec", "system_usec",
+			"nr_throttled", "throttled_usec",
+		};
+		static const char * const memory_keys[] = {
+			"anon", "file", "pgfault", "pgmajfault",
+		};
+		uint64_t * const cpu_values[] = {
+			&sample->cpu_usage_usec, &sample->cpu_user_usec,
+			&sample->cpu_system_usec, &sample->cpu_nr_throttled,
+			&sample->cpu_throttled_usec,
+		};
+		uint64_t * const memory_values[] = {
+			&sample->memory_anon, &sample->memory_file,
+			&sample->memory_pgfault, &sample->memory_pgmajfault,
+		};
+
+		sample->psi_ok[STRESS_PSI_CPU] = stress_read_psi("cpu", &sample->psi[STRESS_PSI_CPU]);
+		sample->psi_ok[STRESS_PSI_MEMORY] = stress_read_psi("memory", &sample->psi[STRESS_PSI_MEMORY]);
+		sample->psi_ok[STRESS_PSI_IO] = stress_read_psi("io", &sample->psi[STRESS_PSI_IO]);
+		if (cgroup) {
+			sample->cpu_ok = stress_cgroup_read_keyed(cgroup, "cpu.stat",
+				cpu_keys, cpu_values, SIZEOF_ARRAY(cpu_keys));
+			sample->memory_ok = stress_cgroup_read_keyed(cgroup, "memory.stat",
+				memory_keys, memory_values, SIZEOF_ARRAY(memory_keys));
+			sample->io_ok = stress_read_cgroup_io(cgroup, sample);
+		}
+	}
+#else
+	(void)cgroup;
+#endif
+}
+
+/*
+ *  stress_pressurestat_summary()
+ *	report the percentage of time tasks were stalled on
+ *	each resource over the sampled period and the peak
+ *	10 second averages
+ */
+static void stress_pressurestat_summary(
+	const char * const psi_names[],
+	const uint64_t start,
+	const uint64_t n)
+{
+	const stress_pressurestat_t *first =
+		&pressurestat_ring->samples[start % STRESS_PRESSURESTAT_SAMPLES];
+	const stress_pressurestat_t *last =
+		&pressurestat_ring->samples[(start + n - 1) % STRESS_PRESSURESTAT_SAMPLES];
+	const double dt = last->time - first->time;
+	size_t j;
+
+	if ((n < 2) || (dt <= 0.0))
+		return;
+
+	pr_block_begin();
+	pr_inf("psi: %" PRIu64 " samples over %.2f secs, %.2f bogo-ops/s\n", n, dt,
+		(last->bogo_ops >= first->bogo_ops) ?
+		(double)(last->bogo_ops - first->bogo_ops) / dt : 0.0);
+	pr_inf("psi: resource  %% some  %% full  max some avg10  max full avg10\n");
+	for (j = 0; j < STRESS_PSI_MAX; j++) {
+		double some_max = 0.0, full_max = 0.0;
+		uint64_t i;
+
+		if (!first->psi_ok[j] || !last->psi_ok[j])
+			continue;
+		for (i = start; i < start + n; i++) {
+			const stress_pressurestat_t *sample =
+				&pressurestat_ring->samples[i % STRESS_PRESSURESTAT_SAMPLES];
+
+			if (!sample->psi_ok[j])
+				continue;
+			some_max = STRESS_MAXIMUM(some_max, sample->psi[j].some_avg10);
+			full_max = STRESS_MAXIMUM(full_max, sample->psi[j].full_avg10);
+		}
+		pr_inf("psi: %-8.8s %7.2f %7.2f %15.2f %15.2f\n", psi_names[j],
+			100.0 * (double)(last->psi[j].some_total - first->psi[j].some_total) / (dt * STRESS_DBL_MICROSECOND),
+			100.0 * (double)(last->psi[j].full_total - first->psi[j].full_total) / (dt * STRESS_DBL_MICROSECOND),
+			some_max, full_max);
+	}
+	pr_block_end();
+}
+
+/*
+ *  stress_pressurestat_dump()
+ *	summarise the pressure stall samples, dump them and the
+ *	cgroup samples to the YAML file and free the sample ring,
+ *	the periodic stat process must be stopped before calling this
+ */
+void stress_pressurestat_dump(FILE *yaml)
+{
+	static const char * const psi_names[] = { "cpu", "memory", "io" };
+	uint64_t i, n, start;
+
+	if (pressurestat_ring == MAP_FAILED)
+		return;
+
+	n = STRESS_MINIMUM(pressurestat_ring->head, STRESS_PRESSURESTAT_SAMPLES);
+	start = pressurestat_ring->head - n;
+	stress_pressurestat_summary(psi_names, start, n);
+	if (n > 0)
+		pr_yaml(yaml, "pressure-stats:\n");
+	for (i = start; i < start + n; i++) {
+		const stress_pressurestat_t *sample =
+			&pressurestat_ring->samples[i % STRESS_PRESSURESTAT_SAMPLES];
+		size_t j;
+
+		pr_yaml(yaml, "    - time: %f\n", sample->time);
+		pr_yaml(yaml, "      bogo-ops: %" PRIu64 "\n", sample->bogo_ops);
+		for (j = 0; j < STRESS_PSI_MAX; j++) {
+			const stress_psi_t *psi = &sample->psi[j];
+
+			if (!sample->psi_ok[j])
+				continue;
+			pr_yaml(yaml, "      psi-%s-some-avg10: %f\n", psi_names[j], psi->some_avg10);
+			pr_yaml(yaml, "      psi-%s-some-total-usec: %" PRIu64 "\n", psi_names[j], psi->some_total);
+			pr_yaml(yaml, "      psi-%s-full-avg10: %f\n", psi_names[j], psi->full_avg10);
+			pr_yaml(yaml, "      psi-%s-full-total-usec: %" PRIu64 "\n", psi_names[j], psi->full_total);
+		}
+		if (sample->cpu_ok) {
+			pr_yaml(yaml, "      cgroup-cpu-usage-usec: %" PRIu64 "\n", sample->cpu_usage_usec);
+			pr_yaml(yaml, "      cgroup-cpu-user-usec: %" PRIu64 "\n", sample->cpu_user_usec);
+			pr_yaml(yaml, "      cgroup-cpu-system-usec: %" PRIu64 "\n", sample->cpu_system_usec);
+			pr_yaml(yaml, "      cgroup-cpu-nr-throttled: %" PRIu64 "\n", sample->cpu_nr_throttled);
+			pr_yaml(yaml, "      cgroup-cpu-throttled-usec: %" PRIu64 "\n", sample->cpu_throttled_usec);
+		}
+		if (sample->memory_ok) {
+			pr_yaml(yaml, "      cgroup-memory-anon: %" PRIu64 "\n", sample->memory_anon);
+			pr_yaml(yaml, "      cgroup-memory-file: %" PRIu64 "\n", sample->memory_file);
+			pr_yaml(yaml, "      cgroup-memory-pgfault: %" PRIu64 "\n", sample->memory_pgfault);
+			pr_yaml(yaml, "      cgroup-memory-pgmajfault: %" PRIu64 "\n", sample->memory_pgmajfault);
+		}
+		if (sample->io_ok) {
+			pr_yaml(yaml, "      cgroup-io-rbytes: %" PRIu64 "\n", sample->io_rbytes);
+			pr_yaml(yaml, "      cgroup-io-wbytes: %" PRIu64 "\n", sample->io_wbytes);
+			pr_yaml(yaml, "      cgroup-io-rios: %" PRIu64 "\n", sample->io_rios);
+			pr_yaml(yaml, "      cgroup-io-wios: %" PRIu64 "\n", sample->io_wios);
+		}
+	}
+	if (n > 0)
+		pr_yaml(yaml, "\n");
+
+	(void)munmap((void *)pressurestat_ring, sizeof(*pressurestat_ring));
+	pressurestat_ring = MAP_FAILED;
+}
+
 /*
  *  stress_vmstat_start()
  *	start vmstat statistics (1 per second)
@@ -1113,7 +1413,12 @@ void stress_vmstat_start(void)
 	size_t tz_num = 0;
 	stress_tz_info_t *tz_info;
 	int32_t vmstat_sleep, thermalstat_sleep, iostat_sleep, status_sleep;
+	int32_t pressurestat_sleep;
 	double t1, t2, t_start;
+	char *cgroup = NULL;
+#if defined(__linux__)
+	char cgroup_path[PATH_MAX];
+#endif
 #if defined(HAVE_SYS_SYSMACROS_H) &&	\
     defined(__linux__)
 	char iostat_name[PATH_MAX];
@@ -1123,13 +1428,30 @@ void stress_vmstat_start(void)
 	if ((vmstat_delay == 0) &&
 	    (thermalstat_delay == 0) &&
 	    (iostat_delay == 0) &&
-	    (status_delay == 0))
+	    (status_delay == 0) &&
+	    (pressurestat_delay == 0))
 		return;
 
 	vmstat_sleep = vmstat_delay;
 	thermalstat_sleep = thermalstat_delay;
 	iostat_sleep = iostat_delay;
 	status_sleep = status_delay;
+	pressurestat_sleep = pressurestat_delay;
+
+	/* samples are kept in shared memory for the YAML dump */
+	if (pressurestat_delay) {
+		pressurestat_ring = (stress_pressurestat_ring_t *)mmap(NULL,
+			sizeof(*pressurestat_ring), PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+		if (pressurestat_ring == MAP_FAILED) {
+			pr_inf("pressurestat: cannot mmap sample buffer, errno=%d (%s), disabling pressurestat\n",
+				errno, strerror(errno));
+			pressurestat_delay = 0;
+			pressurestat_sleep = 0;
+		} else {
+			pressurestat_ring->head = 0;
+		}
+	}
 
 	vmstat_pid = fork();
 	if ((vmstat_pid < 0) || (vmstat_pid > 0))
@@ -1146,6 +1468,11 @@ void stress_vmstat_start(void)
 			tz_num++;
 	}
 
+#if defined(__linux__)
+	if (pressurestat_delay)
+		cgroup = stress_cgroup_get_path(cgroup_path, sizeof(cgroup_path));
+#endif
+
 #if defined(HAVE_SYS_SYSMACROS_H) &&	\
     defined(__linux__)
 	if (stress_iostat_iostat_name(iostat_name, sizeof(iostat_name)) == NULL)
@@ -1176,6 +1503,8 @@ void stress_vmstat_start(void)
 #endif
 		if (status_delay > 0)
 			sleep_delay = STRESS_MINIMUM(status_delay, sleep_delay);
+		if (pressurestat_delay > 0)
+			sleep_delay = STRESS_MINIMUM(pressurestat_delay, sleep_delay);
 		t1 += sleep_delay;
 		t2 = stress_time_now();
 
@@ -1190,6 +1519,7 @@ void stress_vmstat_start(void)
 		thermalstat_sleep -= sleep_delay;
 		iostat_sleep -= sleep_delay;
 		status_sleep -= sleep_delay;
+		pressurestat_sleep -= sleep_delay;
 
 		if ((vmstat_delay > 0) && (vmstat_sleep <= 0))
 			vmstat_sleep = vmstat_delay;
@@ -1199,6 +1529,8 @@ void stress_vmstat_start(void)
 			iostat_sleep = iostat_delay;
 		if ((status_delay > 0) && (status_sleep <= 0))
 			status_sleep = status_delay;
+		if ((pressurestat_delay > 0) && (pressurestat_sleep <= 0))
+			pressurestat_sleep = pressurestat_delay;
 
 		if (vmstat_sleep == vmstat_delay) {
 			static uint32_t vmstat_count = 0;
@@ -1348,6 +1680,44 @@ void stress_vmstat_start(void)
 				g_shared->instance_count.alarmed,
 				stress_duration_to_str(runtime, false));
 		}
+
+		if ((pressurestat_delay > 0) && (pressurestat_sleep == pressurestat_delay)) {
+			static uint32_t pressurestat_count = 0;
+			static uint64_t prev_bogo_ops = 0;
+			static double prev_time = 0.0;
+			stress_pressurestat_t *sample = &pressurestat_ring->samples[
+				pressurestat_ring->head % STRESS_PRESSURESTAT_SAMPLES];
+			double dt, rate;
+
+			stress_get_pressurestat(cgroup, sample);
+			stress_asm_mb();
+			pressurestat_ring->head++;
+
+			/* the live per sample line is only shown with --vmstat */
+			if (vmstat_delay <= 0)
+				continue;
+
+			dt = sample->time - prev_time;
+			rate = ((dt > 0.0) && (sample->bogo_ops >= prev_bogo_ops)) ?
+				(double)(sample->bogo_ops - prev_bogo_ops) / dt : 0.0;
+
+			pr_block_begin();
+			if (pressurestat_count == 0)
+				pr_inf("psi: %% stalled, 10 sec avg: cpu  memory  mem-full      io io-full  bogo-ops/s\n");
+			pr_inf("psi: %27.2f %7.2f %9.2f %7.2f %7.2f %11.2f\n",
+				sample->psi[STRESS_PSI_CPU].some_avg10,
+				sample->psi[STRESS_PSI_MEMORY].some_avg10,
+				sample->psi[STRESS_PSI_MEMORY].full_avg10,
+				sample->psi[STRESS_PSI_IO].some_avg10,
+				sample->psi[STRESS_PSI_IO].full_avg10, rate);
+			pr_block_end();
+			prev_bogo_ops = sample->bogo_ops;
+			prev_time = sample->time;
+
+			pressurestat_count++;
+			if (pressurestat_count >= 25)
+				pressurestat_count = 0;
+		}
 	}
 	_exit(0);
 }
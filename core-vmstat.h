@@ -25,8 +25,10 @@ extern WARN_UNUSED int stress_set_status(const char *const opt);
 extern WARN_UNUSED int stress_set_vmstat(const char *const opt);
 extern WARN_UNUSED int stress_set_thermalstat(const char *const opt);
 extern WARN_UNUSED int stress_set_iostat(const char *const opt);
+extern WARN_UNUSED int stress_set_pressurestat(const char *const opt);
 extern WARN_UNUSED char *stress_find_mount_dev(const char *name);
 extern void stress_vmstat_start(void);
 extern void stress_vmstat_stop(void);
+extern void stress_pressurestat_dump(FILE *yaml);
 
 #endif
@@ -19,6 +19,8 @@
  */
 #include "stress-ng.h"
 #include "core-builtin.h"
+#include "core-latency.h"
+#include "core-pthread.h"
 
 #include <sched.h>
 
@@ -26,6 +28,7 @@ static const stress_help_t help[] = {
 	{ NULL,	"cpu-online N",		"start N workers offlining/onlining the CPUs" },
 	{ NULL, "cpu-online-affinity",	"set CPU affinity to the CPU to be offlined" },
 	{ NULL, "cpu-online-all",	"attempt to exercise all CPUs include CPU 0" },
+	{ NULL, "cpu-online-latency",	"time per CPU hotplug and cpufreq step transitions" },
 	{ NULL,	"cpu-online-ops N",	"stop after N offline/online operations" },
 	{ NULL,	NULL,			NULL }
 };
@@ -42,9 +45,15 @@ static int stress_set_cpu_online_all(const char *opt)
 	return stress_set_setting_true("cpu-online-all", opt);
 }
 
+static int stress_set_cpu_online_latency(const char *opt)
+{
+	return stress_set_setting_true("cpu-online-latency", opt);
+}
+
 static const stress_opt_set_func_t opt_set_funcs[] = {
 	{ OPT_cpu_online_affinity,	stress_set_cpu_online_affinity },
 	{ OPT_cpu_online_all,		stress_set_cpu_online_all },
+	{ OPT_cpu_online_latency,	stress_set_cpu_online_latency },
 	{ 0,				NULL },
 };
 
@@ -162,6 +171,431 @@ static int stress_cpu_online_supported(const char *name)
 	return 0;
 }
 
+#if defined(HAVE_LIB_PTHREAD) &&	\
+    defined(HAVE_ATOMIC_LOAD) &&	\
+    defined(HAVE_ATOMIC_STORE)
+#define STRESS_CPU_ONLINE_FREQ
+#endif
+
+#define STRESS_CPU_ONLINE_FREQ_STEPS	(8)	/* down/up step pairs per CPU visit */
+#define STRESS_CPU_ONLINE_FREQ_TIMEOUT	(0.1)	/* give up on a step after 100ms */
+#define STRESS_CPU_ONLINE_FREQ_SETTLE	(20000)	/* usecs settle time after a step */
+#define STRESS_CPU_ONLINE_FREQ_SAMPLES	(10)	/* spin chunk samples for a baseline */
+#define STRESS_CPU_ONLINE_SPIN_LOOPS	(10000)	/* spin loops per timed chunk */
+
+/* per CPU transition latencies */
+typedef struct {
+	stress_latency_t offline;	/* offline write latency */
+	stress_latency_t online;	/* online write latency */
+	stress_latency_t freq_down;	/* max to min step latency */
+	stress_latency_t freq_up;	/* min to max step latency */
+	uint64_t cpuinfo_min_freq;	/* hardware min frequency */
+	uint64_t cpuinfo_max_freq;	/* hardware max frequency */
+	uint64_t scaling_min_freq;	/* original min, restored at end */
+	uint64_t scaling_max_freq;	/* original max, restored at end */
+	uint64_t freq_missed;		/* steps with no observed change */
+	bool freq;			/* cpufreq limits can be stepped */
+} stress_cpu_online_latency_t;
+
+#if defined(STRESS_CPU_ONLINE_FREQ)
+/* spinning timestamp loop state shared with the stepping thread */
+typedef struct {
+	pthread_t pthread;		/* spinner thread */
+	uint32_t cpu;			/* CPU to spin on */
+	int pending;			/* 1 = slower, -1 = faster, 0 = idle */
+	bool stop;			/* true = spinner should exit */
+	volatile double t_write;	/* time the new limit was written */
+	volatile double threshold;	/* chunk time between the two speeds */
+	volatile double t_seen;		/* time the change was seen */
+	volatile double chunk;		/* latest chunk duration */
+} stress_cpu_online_spin_t;
+
+/*
+ *  stress_cpu_online_spin()
+ *	spin on the target CPU timing fixed size chunks of work,
+ *	when a frequency step is pending note the end of the first
+ *	of two consecutive chunks that crossed the speed threshold
+ */
+static void *stress_cpu_online_spin(void *arg)
+{
+	static void *nowt = NULL;
+	stress_cpu_online_spin_t *spin = (stress_cpu_online_spin_t *)arg;
+	volatile uint64_t counter = 0;
+	double t_start, t_hit = 0.0;
+	int hits = 0;
+
+	stress_cpu_online_set_affinity(spin->cpu);
+	t_start = stress_time_now();
+	while (!__atomic_load_n(&spin->stop, __ATOMIC_ACQUIRE)) {
+		double t_end, duration;
+		int pending, i;
+
+		for (i = 0; i < STRESS_CPU_ONLINE_SPIN_LOOPS; i++)
+			counter++;
+		t_end = stress_time_now();
+		duration = t_end - t_start;
+		spin->chunk = duration;
+
+		pending = __atomic_load_n(&spin->pending, __ATOMIC_ACQUIRE);
+		if (pending && (t_start >= spin->t_write) &&
+		    (((pending > 0) && (duration > spin->threshold)) ||
+		     ((pending < 0) && (duration < spin->threshold)))) {
+			if (hits++ == 0)
+				t_hit = t_end;
+			if (hits >= 2) {
+				spin->t_seen = t_hit;
+				__atomic_store_n(&spin->pending, 0, __ATOMIC_RELEASE);
+				hits = 0;
+			}
+		} else {
+			hits = 0;
+		}
+		t_start = t_end;
+	}
+	return &nowt;
+}
+
+/*
+ *  stress_cpu_online_freq_write()
+ *	write a cpufreq scaling frequency limit
+ */
+static int stress_cpu_online_freq_write(
+	const uint32_t cpu,
+	const char *name,
+	const uint64_t freq)
+{
+	char path[PATH_MAX];
+	char buffer[32];
+
+	(void)snprintf(path, sizeof(path),
+		"/sys/devices/system/cpu/cpu%" PRIu32 "/cpufreq/%s", cpu, name);
+	(void)snprintf(buffer, sizeof(buffer), "%" PRIu64 "\n", freq);
+	return (stress_system_write(path, buffer, strlen(buffer)) < 0) ? -1 : 0;
+}
+
+/*
+ *  stress_cpu_online_freq_read()
+ *	read a cpufreq frequency, 0 if not readable
+ */
+static uint64_t stress_cpu_online_freq_read(const uint32_t cpu, const char *name)
+{
+	char path[PATH_MAX];
+	char buffer[32];
+	uint64_t freq = 0;
+
+	(void)snprintf(path, sizeof(path),
+		"/sys/devices/system/cpu/cpu%" PRIu32 "/cpufreq/%s", cpu, name);
+	(void)shim_memset(buffer, 0, sizeof(buffer));
+	if (stress_system_read(path, buffer, sizeof(buffer)) < 1)
+		return 0;
+	if (sscanf(buffer, "%" SCNu64, &freq) != 1)
+		return 0;
+	return freq;
+}
+
+/*
+ *  stress_cpu_online_freq_baseline()
+ *	fastest spin chunk time seen over a few samples,
+ *	the minimum filters out chunks that were preempted
+ */
+static double stress_cpu_online_freq_baseline(stress_cpu_online_spin_t *spin)
+{
+	double baseline = 0.0;
+	int i;
+
+	for (i = 0; i < STRESS_CPU_ONLINE_FREQ_SAMPLES; i++) {
+		const double chunk = spin->chunk;
+
+		if ((chunk > 0.0) && ((baseline == 0.0) || (chunk < baseline)))
+			baseline = chunk;
+		(void)shim_usleep(1000);
+	}
+	return baseline;
+}
+
+/*
+ *  stress_cpu_online_freq_step()
+ *	write a new scaling_max_freq limit and wait for the spinner
+ *	to see the speed change, returns -1 if the write failed
+ */
+static int stress_cpu_online_freq_step(
+	stress_cpu_online_spin_t *spin,
+	const uint64_t freq,
+	const double threshold,
+	const int direction,
+	stress_latency_t *lat,
+	uint64_t *missed)
+{
+	double t;
+
+	spin->threshold = threshold;
+	spin->t_seen = 0.0;
+	t = stress_time_now();
+	spin->t_write = t;
+	__atomic_store_n(&spin->pending, direction, __ATOMIC_RELEASE);
+	if (stress_cpu_online_freq_write(spin->cpu, "scaling_max_freq", freq) < 0) {
+		__atomic_store_n(&spin->pending, 0, __ATOMIC_RELEASE);
+		return -1;
+	}
+	while (__atomic_load_n(&spin->pending, __ATOMIC_ACQUIRE)) {
+		if (stress_time_now() - t > STRESS_CPU_ONLINE_FREQ_TIMEOUT)
+			break;
+		(void)shim_usleep(100);
+	}
+	if (__atomic_load_n(&spin->pending, __ATOMIC_ACQUIRE)) {
+		__atomic_store_n(&spin->pending, 0, __ATOMIC_RELEASE);
+		(*missed)++;
+	} else {
+		stress_latency_add(lat, (uint64_t)((spin->t_seen - t) * STRESS_DBL_NANOSECOND));
+	}
+	(void)shim_usleep(STRESS_CPU_ONLINE_FREQ_SETTLE);
+	return 0;
+}
+
+/*
+ *  stress_cpu_online_freq()
+ *	measure cpufreq max to min and min to max step latency
+ *	on a CPU, the speed is observed by a spinning timestamp
+ *	loop on the CPU, returns -1 if stepping is not usable
+ */
+static int stress_cpu_online_freq(
+	stress_args_t *args,
+	const uint32_t cpu,
+	stress_cpu_online_latency_t *lat)
+{
+	stress_cpu_online_spin_t spin;
+	double fast, slow, threshold;
+	int ret, i, rc = -1;
+
+	(void)shim_memset(&spin, 0, sizeof(spin));
+	spin.cpu = cpu;
+	spin.t_write = stress_time_now();
+
+	/* allow the full hardware range, then start spinning at max */
+	if (stress_cpu_online_freq_write(cpu, "scaling_max_freq", lat->cpuinfo_max_freq) < 0)
+		return -1;
+	if (stress_cpu_online_freq_write(cpu, "scaling_min_freq", lat->cpuinfo_min_freq) < 0)
+		goto restore;
+	ret = pthread_create(&spin.pthread, NULL, stress_cpu_online_spin, (void *)&spin);
+	if (ret) {
+		pr_dbg("%s: pthread_create failed, errno=%d (%s)\n",
+			args->name, ret, strerror(ret));
+		rc = 0;
+		goto restore;
+	}
+
+	(void)shim_usleep(STRESS_CPU_ONLINE_FREQ_SETTLE);
+	fast = stress_cpu_online_freq_baseline(&spin);
+	if (stress_cpu_online_freq_write(cpu, "scaling_max_freq", lat->cpuinfo_min_freq) < 0)
+		goto stop;
+	(void)shim_usleep(STRESS_CPU_ONLINE_FREQ_SETTLE);
+	slow = stress_cpu_online_freq_baseline(&spin);
+
+	/* limits that don't change the spin speed can't be timed */
+	if ((fast <= 0.0) || (slow < fast * 1.2)) {
+		pr_dbg("%s: cpu %" PRIu32 " spin speed does not change with cpufreq limits, "
+			"fast %.3f usecs, slow %.3f usecs per chunk\n",
+			args->name, cpu, fast * STRESS_DBL_MICROSECOND, slow * STRESS_DBL_MICROSECOND);
+		goto stop;
+	}
+	threshold = (fast + slow) / 2.0;
+
+	for (i = 0; (i < STRESS_CPU_ONLINE_FREQ_STEPS) && stress_continue(args); i++) {
+		if (stress_cpu_online_freq_step(&spin, lat->cpuinfo_max_freq, threshold,
+						-1, &lat->freq_up, &lat->freq_missed) < 0)
+			goto stop;
+		if (stress_cpu_online_freq_step(&spin, lat->cpuinfo_min_freq, threshold,
+						1, &lat->freq_down, &lat->freq_missed) < 0)
+			goto stop;
+	}
+	rc = 0;
+stop:
+	__atomic_store_n(&spin.stop, true, __ATOMIC_RELEASE);
+	(void)pthread_join(spin.pthread, NULL);
+restore:
+	(void)stress_cpu_online_freq_write(cpu, "scaling_max_freq", lat->scaling_max_freq);
+	(void)stress_cpu_online_freq_write(cpu, "scaling_min_freq", lat->scaling_min_freq);
+	return rc;
+}
+#endif
+
+/*
+ *  stress_cpu_online_latency_table()
+ *	per CPU hotplug latencies in milliseconds and
+ *	cpufreq step latencies in microseconds
+ */
+static void stress_cpu_online_latency_table(
+	stress_args_t *args,
+	const stress_cpu_online_latency_t *lats,
+	const int32_t cpus)
+{
+	int32_t i;
+
+	pr_inf("%s: %5s %21s %21s %21s %21s\n", args->name, "",
+		"offline (msec)", "online (msec)", "freq down (usec)", "freq up (usec)");
+	pr_inf("%s: %5s %10s %10s %10s %10s %10s %10s %10s %10s\n", args->name, "cpu",
+		"p50", "p99", "p50", "p99", "p50", "p99", "p50", "p99");
+	for (i = 0; i < cpus; i++) {
+		const stress_cpu_online_latency_t *lat = &lats[i];
+		const stress_latency_t *l[4] = {
+			&lat->offline, &lat->online, &lat->freq_down, &lat->freq_up
+		};
+		const double scale[4] = { 1000000.0, 1000000.0, 1000.0, 1000.0 };
+		char line[128];
+		int j, len;
+
+		if ((lat->offline.count + lat->online.count +
+		     lat->freq_down.count + lat->freq_up.count) == 0)
+			continue;
+		len = snprintf(line, sizeof(line), "%5" PRId32, i);
+		for (j = 0; j < 4; j++) {
+			if (l[j]->count == 0) {
+				len += snprintf(line + len, sizeof(line) - (size_t)len,
+					" %10s %10s", "-", "-");
+			} else {
+				len += snprintf(line + len, sizeof(line) - (size_t)len,
+					" %10.2f %10.2f",
+					(double)stress_latency_percentile(l[j], 50.0) / scale[j],
+					(double)stress_latency_percentile(l[j], 99.0) / scale[j]);
+			}
+		}
+		pr_inf("%s: %s\n", args->name, line);
+	}
+}
+
+/*
+ *  stress_cpu_online_latency()
+ *	visit each CPU in turn timing its offline and online
+ *	transitions followed by cpufreq max/min steps
+ */
+static int stress_cpu_online_latency(
+	stress_args_t *args,
+	const int32_t cpus,
+	const bool *cpu_online,
+	const bool cpu_online_all,
+	const bool cpu_online_affinity)
+{
+	stress_cpu_online_latency_t *lats;
+	stress_latency_t offline, online, freq_down, freq_up;
+	uint64_t freq_missed = 0;
+	int32_t i, freq_cpus = 0;
+	size_t idx;
+	int rc = EXIT_SUCCESS;
+
+	lats = calloc((size_t)cpus, sizeof(*lats));
+	if (!lats) {
+		pr_inf_skip("%s: out of memory allocating %" PRId32 " latency histograms, "
+			    "skipping stressor\n", args->name, cpus);
+		return EXIT_NO_RESOURCE;
+	}
+	for (i = 0; i < cpus; i++) {
+		stress_cpu_online_latency_t *lat = &lats[i];
+
+		stress_latency_init(&lat->offline);
+		stress_latency_init(&lat->online);
+		stress_latency_init(&lat->freq_down);
+		stress_latency_init(&lat->freq_up);
+#if defined(STRESS_CPU_ONLINE_FREQ)
+		lat->cpuinfo_min_freq = stress_cpu_online_freq_read((uint32_t)i, "cpuinfo_min_freq");
+		lat->cpuinfo_max_freq = stress_cpu_online_freq_read((uint32_t)i, "cpuinfo_max_freq");
+		lat->scaling_min_freq = stress_cpu_online_freq_read((uint32_t)i, "scaling_min_freq");
+		lat->scaling_max_freq = stress_cpu_online_freq_read((uint32_t)i, "scaling_max_freq");
+		lat->freq = (lat->cpuinfo_min_freq > 0) &&
+			    (lat->cpuinfo_min_freq < lat->cpuinfo_max_freq) &&
+			    (lat->scaling_min_freq > 0) && (lat->scaling_max_freq > 0);
+		if (lat->freq)
+			freq_cpus++;
+#endif
+	}
+	if (args->instance == 0) {
+		pr_inf("%s: timing CPU hotplug transitions%s\n", args->name,
+			freq_cpus ? " and cpufreq max/min steps" : ", no cpufreq limits to step");
+		if (args->num_instances > 1)
+			pr_inf("%s: %" PRIu32 " instances will perturb each other's measurements\n",
+				args->name, args->num_instances);
+	}
+
+	do {
+		for (i = 0; (i < cpus) && stress_continue(args); i++) {
+			const uint32_t cpu = (uint32_t)i;
+			stress_cpu_online_latency_t *lat = &lats[i];
+
+			if (cpu_online[i] && ((cpu != 0) || cpu_online_all)) {
+				double t;
+				int setting;
+
+				if (cpu_online_affinity)
+					stress_cpu_online_set_affinity(cpu);
+
+				t = stress_time_now();
+				rc = stress_cpu_online_set(args, cpu, 0);
+				if (rc == EXIT_FAILURE)
+					break;
+				if (rc == EXIT_SUCCESS) {
+					const double duration = stress_time_now() - t;
+
+					if ((stress_cpu_online_get(cpu, &setting) == EXIT_SUCCESS) && (setting == 0))
+						stress_latency_add(&lat->offline, (uint64_t)(duration * STRESS_DBL_NANOSECOND));
+				}
+
+				t = stress_time_now();
+				rc = stress_cpu_online_set(args, cpu, 1);
+				if (rc == EXIT_FAILURE)
+					break;
+				if (rc == EXIT_SUCCESS) {
+					const double duration = stress_time_now() - t;
+
+					if ((stress_cpu_online_get(cpu, &setting) == EXIT_SUCCESS) && (setting == 1))
+						stress_latency_add(&lat->online, (uint64_t)(duration * STRESS_DBL_NANOSECOND));
+					if (cpu_online_affinity)
+						stress_cpu_online_set_affinity(cpu);
+				}
+				rc = EXIT_SUCCESS;
+				stress_bogo_inc(args);
+			}
+#if defined(STRESS_CPU_ONLINE_FREQ)
+			if (lat->freq && stress_continue(args)) {
+				if (stress_cpu_online_freq(args, cpu, lat) < 0)
+					lat->freq = false;
+				else
+					stress_bogo_inc(args);
+			}
+#endif
+		}
+	} while ((rc != EXIT_FAILURE) && stress_continue(args));
+
+	stress_latency_init(&offline);
+	stress_latency_init(&online);
+	stress_latency_init(&freq_down);
+	stress_latency_init(&freq_up);
+	for (i = 0; i < cpus; i++) {
+		stress_latency_merge(&offline, &lats[i].offline);
+		stress_latency_merge(&online, &lats[i].online);
+		stress_latency_merge(&freq_down, &lats[i].freq_down);
+		stress_latency_merge(&freq_up, &lats[i].freq_up);
+		freq_missed += lats[i].freq_missed;
+	}
+	idx = 0;
+	idx = stress_latency_metrics_set(args, idx, "cpu offline", &offline);
+	idx = stress_latency_metrics_set(args, idx, "cpu online", &online);
+	if (freq_down.count + freq_up.count > 0) {
+		idx = stress_latency_metrics_set(args, idx, "cpufreq max to min", &freq_down);
+		(void)stress_latency_metrics_set(args, idx, "cpufreq min to max", &freq_up);
+	}
+	if (freq_missed > 0)
+		pr_dbg("%s: %" PRIu64 " cpufreq steps were not seen within %.0f msecs\n",
+			args->name, freq_missed, STRESS_CPU_ONLINE_FREQ_TIMEOUT * 1000.0);
+
+	if (args->instance == 0) {
+		pr_block_begin();
+		stress_cpu_online_latency_table(args, lats, cpus);
+		pr_block_end();
+	}
+	free(lats);
+
+	return rc;
+}
+
 /*
  *  stress_cpu_online
  *	stress twiddling CPUs online/offline
@@ -173,6 +607,7 @@ static int stress_cpu_online(stress_args_t *args)
 	bool *cpu_online;
 	bool cpu_online_affinity = false;
 	bool cpu_online_all = false;
+	bool cpu_online_latency = false;
 	int rc = EXIT_SUCCESS;
 	double offline_duration = 0.0, offline_count = 0.0;
 	double online_duration  = 0.0, online_count = 0.0;
@@ -180,6 +615,7 @@ static int stress_cpu_online(stress_args_t *args)
 
 	(void)stress_get_setting("cpu-online-affinity", &cpu_online_affinity);
 	(void)stress_get_setting("cpu-online-all", &cpu_online_all);
+	(void)stress_get_setting("cpu-online-latency", &cpu_online_latency);
 
 	if (geteuid() != 0) {
 		if (args->instance == 0)
@@ -245,6 +681,12 @@ static int stress_cpu_online(stress_args_t *args)
 
 	stress_set_proc_state(args->name, STRESS_STATE_RUN);
 
+	if (cpu_online_latency) {
+		rc = stress_cpu_online_latency(args, cpus, cpu_online,
+			cpu_online_all, cpu_online_affinity);
+		goto deinit;
+	}
+
 	/*
 	 *  Now randomly offline/online them all
 	 */
@@ -298,6 +740,14 @@ static int stress_cpu_online(stress_args_t *args)
 		}
 	} while (stress_continue(args));
 
+	rate = (offline_count > 0.0) ? (double)offline_duration / offline_count : 0.0;
+	stress_metrics_set(args, 0, "millisecs per offline action",
+		rate * STRESS_DBL_MILLISECOND, STRESS_HARMONIC_MEAN);
+	rate = (online_count > 0.0) ? (double)online_duration / online_count : 0.0;
+	stress_metrics_set(args, 1, "millisecs per online action",
+		rate * STRESS_DBL_MILLISECOND, STRESS_HARMONIC_MEAN);
+
+deinit:
 	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
 
 	/*
@@ -309,13 +759,6 @@ static int stress_cpu_online(stress_args_t *args)
 	}
 	free(cpu_online);
 
-	rate = (offline_count > 0.0) ? (double)offline_duration / offline_count : 0.0;
-	stress_metrics_set(args, 0, "millisecs per offline action",
-		rate * STRESS_DBL_MILLISECOND, STRESS_HARMONIC_MEAN);
-	rate = (online_count > 0.0) ? (double)online_duration / online_count : 0.0;
-	stress_metrics_set(args, 1, "millisecs per online action",
-		rate * STRESS_DBL_MILLISECOND, STRESS_HARMONIC_MEAN);
-
 	return rc;
 }
 
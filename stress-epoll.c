@@ -20,8 +20,10 @@
 #include "stress-ng.h"
 #include "core-builtin.h"
 #include "core-killpid.h"
+#include "core-lock.h"
 #include "core-net.h"
 #include "core-pragma.h"
+#include "core-pthread.h"
 
 #if defined(HAVE_SYS_UN_H)
 #include <sys/un.h>
@@ -40,12 +42,18 @@
 #define MIN_EPOLL_SOCKETS	(64)
 #define MAX_EPOLL_SOCKETS	(100000)
 #define DEFAULT_EPOLL_SOCKETS	(4096)
+#define MAX_EPOLL_REACTORS	(64)
+
+#define EPOLL_SHARD_REUSEPORT	(0)
+#define EPOLL_SHARD_EXCLUSIVE	(1)
 
 static const stress_help_t help[] = {
 	{ NULL,	"epoll N",	  	"start N workers doing epoll handled socket activity" },
 	{ NULL,	"epoll-domain D", 	"specify socket domain, default is unix" },
 	{ NULL,	"epoll-ops N",	  	"stop after N epoll bogo operations" },
 	{ NULL,	"epoll-port P",	  	"use socket ports P upwards" },
+	{ NULL,	"epoll-reactors N",	"use N epoll reactor threads serving echo clients" },
+	{ NULL,	"epoll-shard S",	"reactor listener sharding, reuseport or exclusive" },
 	{ NULL, "epoll-sockets N",	"specify maximum number of open sockets" },
 	{ NULL,	NULL,			NULL }
 };
@@ -123,9 +131,43 @@ static int stress_set_epoll_sockets(const char *opt)
         return stress_set_setting("epoll-sockets", TYPE_ID_INT, &epoll_sockets);
 }
 
+/*
+ *  stress_set_epoll_reactors()
+ *	set the number of reactor threads, 0 disables reactor mode
+ */
+static int stress_set_epoll_reactors(const char *opt)
+{
+	size_t epoll_reactors;
+
+	epoll_reactors = (size_t)stress_get_uint64(opt);
+	stress_check_range("epoll-reactors", (uint64_t)epoll_reactors, 0, MAX_EPOLL_REACTORS);
+	return stress_set_setting("epoll-reactors", TYPE_ID_SIZE_T, &epoll_reactors);
+}
+
+/*
+ *  stress_set_epoll_shard()
+ *	set the reactor listener sharding mode
+ */
+static int stress_set_epoll_shard(const char *opt)
+{
+	int epoll_shard;
+
+	if (!strcmp(opt, "reuseport")) {
+		epoll_shard = EPOLL_SHARD_REUSEPORT;
+	} else if (!strcmp(opt, "exclusive")) {
+		epoll_shard = EPOLL_SHARD_EXCLUSIVE;
+	} else {
+		(void)fprintf(stderr, "epoll-shard option '%s' not known, options are: reuseport, exclusive\n", opt);
+		return -1;
+	}
+	return stress_set_setting("epoll-shard", TYPE_ID_INT, &epoll_shard);
+}
+
 static const stress_opt_set_func_t opt_set_funcs[] = {
 	{ OPT_epoll_domain,	stress_set_epoll_domain },
 	{ OPT_epoll_port,	stress_set_epoll_port },
+	{ OPT_epoll_reactors,	stress_set_epoll_reactors },
+	{ OPT_epoll_shard,	stress_set_epoll_shard },
 	{ OPT_epoll_sockets,	stress_set_epoll_sockets },
 	{ 0,			NULL }
 };
@@ -1006,6 +1048,710 @@ die:
 	_exit(rc);
 }
 
+#if defined(HAVE_LIB_PTHREAD) &&	\
+    defined(HAVE_ACCEPT4) &&		\
+    defined(SOCK_NONBLOCK)
+
+#define EPOLL_REACTOR_MSG_SIZE	(64)
+#define EPOLL_REACTOR_EVENTS	(256)
+#define EPOLL_REACTOR_BUF_SIZE	(4096)
+#define EPOLL_REACTOR_CONN_EVENTS (EPOLLIN | EPOLLET | EPOLLRDHUP)
+
+/* echo data that could not be sent yet, flushed on EPOLLOUT */
+typedef struct {
+	size_t len;			/* unsent bytes in data */
+	char data[EPOLL_REACTOR_BUF_SIZE];
+} stress_epoll_pending_t;
+
+typedef struct {
+	stress_args_t *args;		/* stressor args */
+	pthread_t pthread;		/* reactor thread */
+	int ret;			/* pthread_create return */
+	int efd;			/* reactor epoll fd */
+	int lfd;			/* listening socket */
+	uint8_t *conn_fds;		/* map of open connection fds, shared */
+	stress_epoll_pending_t **pending; /* unsent echo data per fd, shared */
+	size_t max_fds;			/* size of conn_fds and pending maps */
+	void *lock;			/* bogo counter lock */
+	uint64_t rx_bytes;		/* request bytes received */
+	uint64_t accepts;		/* connections accepted */
+	uint64_t wakeups;		/* epoll_wait returns with events */
+	uint64_t idle_wakeups;		/* wakeups that found no work */
+	uint64_t events;		/* total events returned */
+	uint64_t short_sends;		/* echoes deferred to EPOLLOUT */
+	bool failed;			/* true on unexpected error */
+} stress_epoll_reactor_t;
+
+typedef struct {
+	int fd;				/* client connection */
+	size_t rx;			/* response bytes pending */
+} stress_epoll_conn_t;
+
+/*
+ *  stress_epoll_reactor_listen()
+ *	create a non-blocking listening socket, optionally
+ *	sharing the port with SO_REUSEPORT
+ */
+static int stress_epoll_reactor_listen(
+	stress_args_t *args,
+	const pid_t mypid,
+	const int port,
+	const int epoll_domain,
+	const bool reuseport)
+{
+	int fd, so_reuseaddr = 1;
+	struct sockaddr *addr = NULL;
+	socklen_t addr_len = 0;
+
+	fd = socket(epoll_domain, SOCK_STREAM, 0);
+	if (fd < 0) {
+		pr_fail("%s: socket failed, errno=%d (%s)\n",
+			args->name, errno, strerror(errno));
+		return -1;
+	}
+	if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR,
+			&so_reuseaddr, sizeof(so_reuseaddr)) < 0) {
+		pr_fail("%s: setsockopt SO_REUSEADDR failed, errno=%d (%s)\n",
+			args->name, errno, strerror(errno));
+		goto err;
+	}
+#if defined(SO_REUSEPORT)
+	if (reuseport) {
+		int so_reuseport = 1;
+
+		if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT,
+				&so_reuseport, sizeof(so_reuseport)) < 0) {
+			pr_fail("%s: setsockopt SO_REUSEPORT failed, errno=%d (%s)\n",
+				args->name, errno, strerror(errno));
+			goto err;
+		}
+	}
+#else
+	(void)reuseport;
+#endif
+	if (stress_set_sockaddr(args->name, args->instance, mypid,
+		epoll_domain, port, &addr, &addr_len, NET_ADDR_ANY) < 0)
+		goto err;
+#if defined(AF_UNIX) &&		\
+    defined(HAVE_SOCKADDR_UN)
+	if (epoll_domain == AF_UNIX) {
+		struct sockaddr_un *addr_un = (struct sockaddr_un *)addr;
+
+		(void)shim_unlink(addr_un->sun_path);
+	}
+#endif
+	if (bind(fd, addr, addr_len) < 0) {
+		pr_fail("%s: bind failed, errno=%d (%s)\n",
+			args->name, errno, strerror(errno));
+		goto err;
+	}
+	if (epoll_set_fd_nonblock(fd) < 0) {
+		pr_fail("%s: setting socket to non-blocking failed, errno=%d (%s)\n",
+			args->name, errno, strerror(errno));
+		goto err;
+	}
+	if (listen(fd, SOMAXCONN) < 0) {
+		pr_fail("%s: listen failed, errno=%d (%s)\n",
+			args->name, errno, strerror(errno));
+		goto err;
+	}
+	return fd;
+err:
+	(void)close(fd);
+	return -1;
+}
+
+/*
+ *  stress_epoll_reactor_accept()
+ *	accept all pending connections, returns number accepted
+ */
+static int stress_epoll_reactor_accept(stress_epoll_reactor_t *reactor)
+{
+	int accepted = 0;
+
+	for (;;) {
+		const int fd = accept4(reactor->lfd, NULL, NULL, SOCK_NONBLOCK);
+
+		if (fd < 0) {
+			if ((errno == ECONNABORTED) || (errno == EINTR))
+				continue;
+			break;
+		}
+		if (((size_t)fd >= reactor->max_fds) ||
+		    (epoll_ctl_add(reactor->efd, fd, EPOLL_REACTOR_CONN_EVENTS) < 0)) {
+			(void)close(fd);
+			continue;
+		}
+		reactor->conn_fds[fd] = 1;
+		reactor->accepts++;
+		accepted++;
+	}
+	return accepted;
+}
+
+/*
+ *  stress_epoll_reactor_close()
+ *	close a connection and drop any unsent echo data
+ */
+static void stress_epoll_reactor_close(stress_epoll_reactor_t *reactor, const int fd)
+{
+	/* clear before close, the fd may be reused immediately */
+	free(reactor->pending[fd]);
+	reactor->pending[fd] = NULL;
+	reactor->conn_fds[fd] = 0;
+	(void)close(fd);
+}
+
+/*
+ *  stress_epoll_reactor_pollout()
+ *	enable or disable EPOLLOUT events on a connection,
+ *	only wanted while echo data is waiting to be sent
+ */
+static int stress_epoll_reactor_pollout(
+	const stress_epoll_reactor_t *reactor,
+	const int fd,
+	const bool pollout)
+{
+	struct epoll_event event;
+
+	(void)shim_memset(&event, 0, sizeof(event));
+	event.data.fd = fd;
+	event.events = EPOLL_REACTOR_CONN_EVENTS | (pollout ? EPOLLOUT : 0);
+	return epoll_ctl(reactor->efd, EPOLL_CTL_MOD, fd, &event);
+}
+
+/*
+ *  stress_epoll_reactor_send()
+ *	non-blocking send of len bytes, returns bytes sent or
+ *	-1 if the connection failed
+ */
+static ssize_t stress_epoll_reactor_send(const int fd, const char *buf, const size_t len)
+{
+	size_t sent = 0;
+
+	while (sent < len) {
+		const ssize_t n = send(fd, buf + sent, len - sent, 0);
+
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+				break;
+			return -1;
+		}
+		sent += (size_t)n;
+	}
+	return (ssize_t)sent;
+}
+
+/*
+ *  stress_epoll_reactor_echo()
+ *	edge triggered read, drain fd until EAGAIN and echo
+ *	the data back, returns number of bytes handled. Data
+ *	that can't be sent is kept and reading stops until an
+ *	EPOLLOUT event flushes it.
+ */
+static ssize_t stress_epoll_reactor_echo(stress_epoll_reactor_t *reactor, const int fd)
+{
+	char buf[EPOLL_REACTOR_BUF_SIZE];
+	stress_epoll_pending_t *pending = reactor->pending[fd];
+	ssize_t total = 0, sent;
+
+	if (pending) {
+		sent = stress_epoll_reactor_send(fd, pending->data, pending->len);
+		if (sent < 0) {
+			stress_epoll_reactor_close(reactor, fd);
+			return 0;
+		}
+		pending->len -= (size_t)sent;
+		if (pending->len > 0) {
+			(void)memmove(pending->data, pending->data + sent, pending->len);
+			return sent;
+		}
+		if (stress_epoll_reactor_pollout(reactor, fd, false) < 0) {
+			stress_epoll_reactor_close(reactor, fd);
+			return 0;
+		}
+		free(pending);
+		pending = NULL;
+		reactor->pending[fd] = NULL;
+		total += sent;
+	}
+
+	for (;;) {
+		const ssize_t n = recv(fd, buf, sizeof(buf), 0);
+
+		if (n > 0) {
+			total += n;
+			reactor->rx_bytes += (uint64_t)n;
+			sent = stress_epoll_reactor_send(fd, buf, (size_t)n);
+			if (sent < 0) {
+				stress_epoll_reactor_close(reactor, fd);
+				break;
+			}
+			if (sent < n) {
+				pending = malloc(sizeof(*pending));
+				if (!pending) {
+					stress_epoll_reactor_close(reactor, fd);
+					break;
+				}
+				reactor->pending[fd] = pending;
+				if (stress_epoll_reactor_pollout(reactor, fd, true) < 0) {
+					stress_epoll_reactor_close(reactor, fd);
+					break;
+				}
+				pending->len = (size_t)(n - sent);
+				(void)shim_memcpy(pending->data, buf + sent, pending->len);
+				reactor->short_sends++;
+				break;
+			}
+			continue;
+		}
+		if ((n < 0) && (errno == EINTR))
+			continue;
+		if ((n == 0) || ((errno != EAGAIN) && (errno != EWOULDBLOCK)))
+			stress_epoll_reactor_close(reactor, fd);
+		break;
+	}
+	return total;
+}
+
+/*
+ *  stress_epoll_reactor()
+ *	reactor thread, handles events on its own epoll fd
+ */
+static void *stress_epoll_reactor(void *arg)
+{
+	static void *nowt = NULL;
+	stress_epoll_reactor_t *reactor = (stress_epoll_reactor_t *)arg;
+	stress_args_t *args = reactor->args;
+	struct epoll_event events[EPOLL_REACTOR_EVENTS];
+	uint64_t counted = 0;
+
+	while (stress_continue(args)) {
+		int i, n;
+		bool work = false;
+		uint64_t requests;
+
+		n = epoll_wait(reactor->efd, events, EPOLL_REACTOR_EVENTS, 100);
+		if (UNLIKELY(n < 0)) {
+			if (errno == EINTR)
+				continue;
+			pr_fail("%s: epoll_wait failed, errno=%d (%s)\n",
+				args->name, errno, strerror(errno));
+			reactor->failed = true;
+			break;
+		}
+		if (n == 0)
+			continue;
+
+		reactor->wakeups++;
+		reactor->events += (uint64_t)n;
+		for (i = 0; i < n; i++) {
+			const int fd = events[i].data.fd;
+
+			if (fd == reactor->lfd) {
+				if (stress_epoll_reactor_accept(reactor) > 0)
+					work = true;
+			} else if (stress_epoll_reactor_echo(reactor, fd) > 0) {
+				work = true;
+			}
+		}
+		if (!work)
+			reactor->idle_wakeups++;
+
+		requests = reactor->rx_bytes / EPOLL_REACTOR_MSG_SIZE;
+		if (requests > counted) {
+			stress_bogo_add_lock(args, reactor->lock, requests - counted);
+			counted = requests;
+		}
+	}
+	return &nowt;
+}
+
+/*
+ *  stress_epoll_reactor_client()
+ *	open up to epoll_sockets connections and run a closed
+ *	loop of 64 byte request/echo response on each one
+ */
+static void NORETURN stress_epoll_reactor_client(
+	stress_args_t *args,
+	const pid_t mypid,
+	const int port,
+	const int epoll_domain,
+	const size_t epoll_sockets)
+{
+	stress_epoll_conn_t *conns;
+	struct epoll_event *events;
+	struct sockaddr *addr = NULL;
+	socklen_t addr_len = 0;
+	char req[EPOLL_REACTOR_MSG_SIZE];
+	size_t i, n_conns = 0;
+	int efd;
+
+	conns = calloc(epoll_sockets, sizeof(*conns));
+	events = calloc(MAX_EPOLL_EVENTS, sizeof(*events));
+	if (!conns || !events)
+		goto done;
+	efd = epoll_create(1);
+	if (efd < 0)
+		goto done;
+	if (stress_set_sockaddr(args->name, args->instance, mypid,
+		epoll_domain, port, &addr, &addr_len, NET_ADDR_ANY) < 0)
+		goto done_efd;
+	stress_rndbuf(req, sizeof(req));
+
+	for (i = 0; (i < epoll_sockets) && stress_continue_flag(); i++) {
+		struct epoll_event event;
+		int fd, retries;
+
+		fd = socket(epoll_domain, SOCK_STREAM, 0);
+		if (fd < 0)
+			break;
+		for (retries = 0; retries < 100; retries++) {
+			if (connect(fd, addr, addr_len) == 0)
+				break;
+			if ((errno != ECONNREFUSED) && (errno != EAGAIN) &&
+			    (errno != EINTR) && (errno != ENOENT))
+				break;
+			(void)shim_usleep(10000);
+		}
+		if ((retries == 100) || (epoll_set_fd_nonblock(fd) < 0)) {
+			(void)close(fd);
+			break;
+		}
+		(void)shim_memset(&event, 0, sizeof(event));
+		event.data.u64 = n_conns;
+		event.events = EPOLLIN;
+		if (epoll_ctl(efd, EPOLL_CTL_ADD, fd, &event) < 0) {
+			(void)close(fd);
+			break;
+		}
+		conns[n_conns].fd = fd;
+		conns[n_conns].rx = 0;
+		n_conns++;
+		(void)send(fd, req, sizeof(req), 0);
+	}
+
+	while (stress_continue_flag() && (n_conns > 0)) {
+		int j, n;
+
+		n = epoll_wait(efd, events, MAX_EPOLL_EVENTS, 100);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		for (j = 0; j < n; j++) {
+			stress_epoll_conn_t *conn = &conns[events[j].data.u64];
+			char buf[4096];
+			ssize_t ret;
+
+			if (conn->fd < 0)
+				continue;
+			ret = recv(conn->fd, buf, sizeof(buf), 0);
+			if (ret <= 0) {
+				if ((ret == 0) || ((errno != EAGAIN) && (errno != EINTR))) {
+					(void)close(conn->fd);
+					conn->fd = -1;
+				}
+				continue;
+			}
+			conn->rx += (size_t)ret;
+			while (conn->rx >= sizeof(req)) {
+				conn->rx -= sizeof(req);
+				(void)send(conn->fd, req, sizeof(req), 0);
+			}
+		}
+	}
+
+	for (i = 0; i < n_conns; i++) {
+		if (conns[i].fd >= 0)
+			(void)close(conns[i].fd);
+	}
+done_efd:
+	(void)close(efd);
+done:
+	free(events);
+	free(conns);
+	_exit(EXIT_SUCCESS);
+}
+
+/*
+ *  stress_epoll_reactors()
+ *	multi-reactor mode, N threads each owning an epoll fd and
+ *	either a SO_REUSEPORT sharded listener or a shared listener
+ *	registered with EPOLLEXCLUSIVE, serving many client connections
+ */
+static int stress_epoll_reactors(
+	stress_args_t *args,
+	const pid_t mypid,
+	const int port,
+	const int epoll_domain,
+	const size_t epoll_reactors,
+	int epoll_shard,
+	size_t epoll_sockets)
+{
+	stress_epoll_reactor_t *reactors;
+	uint8_t *conn_fds = NULL;
+	stress_epoll_pending_t **pending = NULL;
+	size_t i, max_fds, free_fds, n_threads = 0;
+	void *lock;
+	int rc = EXIT_SUCCESS, shared_lfd = -1;
+	pid_t pid = -1;
+	struct rlimit rlim;
+	double t_start, duration;
+	uint64_t total_requests = 0, total_wakeups = 0, total_idle = 0, total_events = 0;
+	uint64_t total_short_sends = 0;
+	uint64_t max_requests = 0, min_requests = UINT64_MAX;
+	static const char * const shard_names[] = { "reuseport", "exclusive" };
+
+#if !defined(SO_REUSEPORT)
+	epoll_shard = EPOLL_SHARD_EXCLUSIVE;
+#endif
+	if ((epoll_shard == EPOLL_SHARD_REUSEPORT) && (epoll_domain == AF_UNIX)) {
+		if (args->instance == 0)
+			pr_inf("%s: SO_REUSEPORT not supported on unix domain sockets, "
+				"using a shared exclusive listener\n", args->name);
+		epoll_shard = EPOLL_SHARD_EXCLUSIVE;
+	}
+
+	/* leave headroom for listeners, epoll fds and stdio */
+	free_fds = stress_get_file_limit();
+	if (epoll_sockets + (2 * epoll_reactors) + 64 > free_fds) {
+		const size_t new_sockets = (free_fds > (2 * epoll_reactors) + 128) ?
+			free_fds - (2 * epoll_reactors) - 64 : 64;
+
+		if (args->instance == 0)
+			pr_inf("%s: file descriptor limit reduces connections from %zu to %zu\n",
+				args->name, epoll_sockets, new_sockets);
+		epoll_sockets = new_sockets;
+	}
+	if ((getrlimit(RLIMIT_NOFILE, &rlim) < 0) || (rlim.rlim_cur == RLIM_INFINITY))
+		max_fds = 65536;
+	else
+		max_fds = (size_t)rlim.rlim_cur;
+	if (max_fds > 1024 * 1024)
+		max_fds = 1024 * 1024;
+
+	reactors = calloc(epoll_reactors, sizeof(*reactors));
+	if (!reactors) {
+		pr_inf_skip("%s: cannot allocate %zu reactors, skipping stressor\n",
+			args->name, epoll_reactors);
+		return EXIT_NO_RESOURCE;
+	}
+	conn_fds = calloc(max_fds, sizeof(*conn_fds));
+	pending = calloc(max_fds, sizeof(*pending));
+	if (!conn_fds || !pending) {
+		pr_inf_skip("%s: cannot allocate file descriptor map, skipping stressor\n",
+			args->name);
+		free(pending);
+		free(conn_fds);
+		free(reactors);
+		return EXIT_NO_RESOURCE;
+	}
+	lock = stress_lock_create();
+	if (!lock) {
+		pr_inf_skip("%s: cannot create bogo counter lock, skipping stressor\n",
+			args->name);
+		free(pending);
+		free(conn_fds);
+		free(reactors);
+		return EXIT_NO_RESOURCE;
+	}
+	for (i = 0; i < epoll_reactors; i++) {
+		reactors[i].efd = -1;
+		reactors[i].lfd = -1;
+		reactors[i].ret = -1;
+	}
+
+	if (epoll_shard == EPOLL_SHARD_EXCLUSIVE) {
+		shared_lfd = stress_epoll_reactor_listen(args, mypid, port, epoll_domain, false);
+		if (shared_lfd < 0) {
+			rc = EXIT_FAILURE;
+			goto tidy;
+		}
+	}
+	for (i = 0; i < epoll_reactors; i++) {
+		stress_epoll_reactor_t *reactor = &reactors[i];
+		uint32_t events;
+
+		reactor->args = args;
+		reactor->conn_fds = conn_fds;
+		reactor->pending = pending;
+		reactor->max_fds = max_fds;
+		reactor->lock = lock;
+		reactor->efd = epoll_create(1);
+		if (reactor->efd < 0) {
+			pr_fail("%s: epoll_create failed, errno=%d (%s)\n",
+				args->name, errno, strerror(errno));
+			rc = EXIT_FAILURE;
+			goto tidy;
+		}
+		if (epoll_shard == EPOLL_SHARD_EXCLUSIVE) {
+			reactor->lfd = shared_lfd;
+#if defined(EPOLLEXCLUSIVE)
+			events = EPOLLIN | EPOLLEXCLUSIVE;
+#else
+			events = EPOLLIN;
+#endif
+		} else {
+			reactor->lfd = stress_epoll_reactor_listen(args, mypid, port, epoll_domain, true);
+			if (reactor->lfd < 0) {
+				rc = EXIT_FAILURE;
+				goto tidy;
+			}
+			events = EPOLLIN | EPOLLET;
+		}
+		if (epoll_ctl_add(reactor->efd, reactor->lfd, events) < 0) {
+			pr_fail("%s: epoll_ctl_add failed, errno=%d (%s)\n",
+				args->name, errno, strerror(errno));
+			rc = EXIT_FAILURE;
+			goto tidy;
+		}
+	}
+
+again:
+	pid = fork();
+	if (pid < 0) {
+		if (stress_redo_fork(args, errno))
+			goto again;
+		pr_inf_skip("%s: fork failed, errno=%d (%s), skipping stressor\n",
+			args->name, errno, strerror(errno));
+		rc = EXIT_NO_RESOURCE;
+		goto tidy;
+	} else if (pid == 0) {
+		stress_parent_died_alarm();
+		(void)sched_settings_apply(true);
+		stress_epoll_reactor_client(args, mypid, port, epoll_domain, epoll_sockets);
+	}
+
+	t_start = stress_time_now();
+	for (i = 0; i < epoll_reactors; i++) {
+		reactors[i].ret = pthread_create(&reactors[i].pthread, NULL,
+				stress_epoll_reactor, (void *)&reactors[i]);
+		if (reactors[i].ret == 0)
+			n_threads++;
+	}
+	if (n_threads == 0) {
+		pr_inf_skip("%s: cannot create reactor threads, skipping stressor\n",
+			args->name);
+		rc = EXIT_NO_RESOURCE;
+		goto reap;
+	}
+	for (i = 0; i < epoll_reactors; i++) {
+		if (reactors[i].ret == 0)
+			(void)pthread_join(reactors[i].pthread, NULL);
+	}
+	duration = stress_time_now() - t_start;
+
+	for (i = 0; i < epoll_reactors; i++) {
+		const uint64_t requests = reactors[i].rx_bytes / EPOLL_REACTOR_MSG_SIZE;
+
+		if (reactors[i].failed)
+			rc = EXIT_FAILURE;
+		if (reactors[i].ret != 0)
+			continue;
+		total_requests += requests;
+		total_wakeups += reactors[i].wakeups;
+		total_idle += reactors[i].idle_wakeups;
+		total_events += reactors[i].events;
+		total_short_sends += reactors[i].short_sends;
+		if (requests > max_requests)
+			max_requests = requests;
+		if (requests < min_requests)
+			min_requests = requests;
+	}
+
+	if ((args->instance == 0) && (duration > 0.0)) {
+		pr_inf("%s: %zu reactors, %s sharding, %zu client connections\n",
+			args->name, n_threads, shard_names[epoll_shard], epoll_sockets);
+		pr_inf("%s: reactor  conns  requests/sec  wakeups  events/wakeup  efficiency\n",
+			args->name);
+		for (i = 0; i < epoll_reactors; i++) {
+			const stress_epoll_reactor_t *reactor = &reactors[i];
+
+			if (reactor->ret != 0)
+				continue;
+			pr_inf("%s: %7zu %6" PRIu64 " %13.1f %8" PRIu64 " %14.2f %10.1f%%\n",
+				args->name, i, reactor->accepts,
+				(double)(reactor->rx_bytes / EPOLL_REACTOR_MSG_SIZE) / duration,
+				reactor->wakeups,
+				reactor->wakeups ? (double)reactor->events / (double)reactor->wakeups : 0.0,
+				reactor->wakeups ? 100.0 * (double)(reactor->wakeups - reactor->idle_wakeups) /
+					(double)reactor->wakeups : 0.0);
+		}
+		if (total_short_sends > 0)
+			pr_inf("%s: %" PRIu64 " short echo sends deferred until the socket was writable\n",
+				args->name, total_short_sends);
+	}
+	if (duration > 0.0) {
+		size_t idx = 0;
+
+		stress_metrics_set(args, idx++, "requests per sec",
+			(double)total_requests / duration, STRESS_HARMONIC_MEAN);
+		stress_metrics_set(args, idx++, "requests per sec per reactor",
+			(double)total_requests / (duration * (double)n_threads), STRESS_HARMONIC_MEAN);
+		stress_metrics_set(args, idx++, "% wakeup efficiency",
+			total_wakeups ? 100.0 * (double)(total_wakeups - total_idle) / (double)total_wakeups : 0.0,
+			STRESS_GEOMETRIC_MEAN);
+		stress_metrics_set(args, idx++, "events per wakeup",
+			total_wakeups ? (double)total_events / (double)total_wakeups : 0.0,
+			STRESS_GEOMETRIC_MEAN);
+		stress_metrics_set(args, idx++, "reactor load imbalance (max/min)",
+			min_requests ? (double)max_requests / (double)min_requests : 0.0,
+			STRESS_GEOMETRIC_MEAN);
+		for (i = 0; (i < epoll_reactors) && (i < 16); i++) {
+			char str[40];
+
+			if (reactors[i].ret != 0)
+				continue;
+			(void)snprintf(str, sizeof(str), "requests per sec reactor %zu", i);
+			stress_metrics_set(args, idx++, str,
+				(double)(reactors[i].rx_bytes / EPOLL_REACTOR_MSG_SIZE) / duration,
+				STRESS_HARMONIC_MEAN);
+		}
+	}
+
+reap:
+	(void)stress_kill_pid_wait(pid, NULL);
+tidy:
+	for (i = 0; i < max_fds; i++) {
+		free(pending[i]);
+		if (conn_fds[i])
+			(void)close((int)i);
+	}
+	for (i = 0; i < epoll_reactors; i++) {
+		if (reactors[i].efd >= 0)
+			(void)close(reactors[i].efd);
+		if ((reactors[i].lfd >= 0) && (reactors[i].lfd != shared_lfd))
+			(void)close(reactors[i].lfd);
+	}
+	if (shared_lfd >= 0)
+		(void)close(shared_lfd);
+#if defined(AF_UNIX) &&		\
+    defined(HAVE_SOCKADDR_UN)
+	if (epoll_domain == AF_UNIX) {
+		struct sockaddr *addr = NULL;
+		socklen_t addr_len = 0;
+
+		if (stress_set_sockaddr(args->name, args->instance, mypid,
+			epoll_domain, port, &addr, &addr_len, NET_ADDR_ANY) == 0) {
+			struct sockaddr_un *addr_un = (struct sockaddr_un *)addr;
+
+			(void)shim_unlink(addr_un->sun_path);
+		}
+	}
+#endif
+	(void)stress_lock_destroy(lock);
+	free(pending);
+	free(conn_fds);
+	free(reactors);
+
+	return rc;
+}
+#endif
+
 /*
  *  stress_epoll
  *	stress by heavy socket I/O
@@ -1018,9 +1764,13 @@ static int stress_epoll(stress_args_t *args)
 	int epoll_port = DEFAULT_EPOLL_PORT;
 	int epoll_sockets = DEFAULT_EPOLL_SOCKETS;
 	int start_port, end_port, reserved_port;
+	int epoll_shard = EPOLL_SHARD_REUSEPORT;
+	size_t epoll_reactors = 0;
 
 	(void)stress_get_setting("epoll-domain", &epoll_domain);
 	(void)stress_get_setting("epoll-port", &epoll_port);
+	(void)stress_get_setting("epoll-reactors", &epoll_reactors);
+	(void)stress_get_setting("epoll-shard", &epoll_shard);
 	(void)stress_get_setting("epoll-sockets", &epoll_sockets);
 
 	if (stress_sighandler(args->name, SIGPIPE, SIG_IGN, NULL) < 0)
@@ -1063,6 +1813,23 @@ static int stress_epoll(stress_args_t *args)
 
 	stress_set_proc_state(args->name, STRESS_STATE_RUN);
 
+	if (epoll_reactors > 0) {
+#if defined(HAVE_LIB_PTHREAD) &&	\
+    defined(HAVE_ACCEPT4) &&		\
+    defined(SOCK_NONBLOCK)
+		rc = stress_epoll_reactors(args, mypid, start_port, epoll_domain,
+			epoll_reactors, epoll_shard, (size_t)epoll_sockets);
+#else
+		if (args->instance == 0)
+			pr_inf("%s: epoll-reactors requires pthread and accept4 support, "
+				"ignoring option\n", args->name);
+		rc = EXIT_NOT_IMPLEMENTED;
+#endif
+		stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+		stress_net_release_ports(start_port, end_port);
+		return rc;
+	}
+
 	/*
 	 *  Spawn off servers to handle multi port connections.
 	 *  The (src address, src port, dst address, dst port) tuple
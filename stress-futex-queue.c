@@ -0,0 +1,734 @@
+/*
+ * Copyright (C) 2024 Colin Ian King.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+#include "core-arch.h"
+#include "core-asm-x86.h"
+#include "core-builtin.h"
+#include "core-latency.h"
+#include "core-pthread.h"
+
+#if defined(HAVE_LINUX_FUTEX_H)
+#include <linux/futex.h>
+#endif
+
+#define MIN_FUTEX_QUEUE_THREADS		(1)
+#define MAX_FUTEX_QUEUE_THREADS		(64)
+#define DEFAULT_FUTEX_QUEUE_PRODUCERS	(1)
+#define DEFAULT_FUTEX_QUEUE_CONSUMERS	(4)
+
+#define MIN_FUTEX_QUEUE_BATCH		(1)
+#define MAX_FUTEX_QUEUE_BATCH		(1024)
+
+#define MIN_FUTEX_QUEUE_SPIN		(0)
+#define MAX_FUTEX_QUEUE_SPIN		(1000000)
+
+#define FUTEX_QUEUE_SLOTS		(1024)
+#define FUTEX_QUEUE_SLOTS_MASK		(FUTEX_QUEUE_SLOTS - 1)
+#define FUTEX_QUEUE_WAIT_NS		(100000000)
+#define FUTEX_QUEUE_DRAIN_SECS		(5.0)	/* max time to drain queue at stop */
+
+#define FUTEX_QUEUE_WAIT_FUTEX		(0)
+#define FUTEX_QUEUE_WAIT_WAITV		(1)
+#define FUTEX_QUEUE_WAIT_FUTEX2		(2)
+
+static const stress_help_t help[] = {
+	{ NULL,	"futex-queue N",		"start N workers passing work items from producers to consumers" },
+	{ NULL,	"futex-queue-batch N",		"producers wake consumers once every N items (default 1)" },
+	{ NULL,	"futex-queue-consumers N",	"number of consumer threads (default 4)" },
+	{ NULL,	"futex-queue-ops N",		"stop after N work items have been consumed" },
+	{ NULL,	"futex-queue-producers N",	"number of producer threads (default 1)" },
+	{ NULL,	"futex-queue-spin N",		"spin N times on an empty queue before waiting (default 0)" },
+	{ NULL,	"futex-queue-wait M",		"wait method: futex, waitv or futex2 (default futex)" },
+	{ NULL,	NULL,				NULL }
+};
+
+static const char * const stress_futex_queue_waits[] = {
+	"futex",
+	"waitv",
+	"futex2",
+};
+
+static int stress_set_futex_queue_threads(const char *opt, const char *name)
+{
+	uint32_t threads;
+
+	threads = stress_get_uint32(opt);
+	stress_check_range(name, (uint64_t)threads,
+		MIN_FUTEX_QUEUE_THREADS, MAX_FUTEX_QUEUE_THREADS);
+	return stress_set_setting(name, TYPE_ID_UINT32, &threads);
+}
+
+static int stress_set_futex_queue_producers(const char *opt)
+{
+	return stress_set_futex_queue_threads(opt, "futex-queue-producers");
+}
+
+static int stress_set_futex_queue_consumers(const char *opt)
+{
+	return stress_set_futex_queue_threads(opt, "futex-queue-consumers");
+}
+
+static int stress_set_futex_queue_batch(const char *opt)
+{
+	uint32_t futex_queue_batch;
+
+	futex_queue_batch = stress_get_uint32(opt);
+	stress_check_range("futex-queue-batch", (uint64_t)futex_queue_batch,
+		MIN_FUTEX_QUEUE_BATCH, MAX_FUTEX_QUEUE_BATCH);
+	return stress_set_setting("futex-queue-batch", TYPE_ID_UINT32, &futex_queue_batch);
+}
+
+static int stress_set_futex_queue_spin(const char *opt)
+{
+	uint32_t futex_queue_spin;
+
+	futex_queue_spin = stress_get_uint32(opt);
+	stress_check_range("futex-queue-spin", (uint64_t)futex_queue_spin,
+		MIN_FUTEX_QUEUE_SPIN, MAX_FUTEX_QUEUE_SPIN);
+	return stress_set_setting("futex-queue-spin", TYPE_ID_UINT32, &futex_queue_spin);
+}
+
+/*
+ *  stress_set_futex_queue_wait()
+ *	set the system call used by idle consumers to wait
+ */
+static int stress_set_futex_queue_wait(const char *opt)
+{
+	int futex_queue_wait;
+
+	for (futex_queue_wait = 0; futex_queue_wait < (int)SIZEOF_ARRAY(stress_futex_queue_waits); futex_queue_wait++) {
+		if (!strcmp(opt, stress_futex_queue_waits[futex_queue_wait]))
+			return stress_set_setting("futex-queue-wait", TYPE_ID_INT, &futex_queue_wait);
+	}
+	(void)fprintf(stderr, "futex-queue-wait option '%s' not known, options are: futex, waitv, futex2\n", opt);
+	return -1;
+}
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_futex_queue_batch,	stress_set_futex_queue_batch },
+	{ OPT_futex_queue_consumers,	stress_set_futex_queue_consumers },
+	{ OPT_futex_queue_producers,	stress_set_futex_queue_producers },
+	{ OPT_futex_queue_spin,		stress_set_futex_queue_spin },
+	{ OPT_futex_queue_wait,		stress_set_futex_queue_wait },
+	{ 0,				NULL }
+};
+
+#if defined(HAVE_LIB_PTHREAD) &&		\
+    defined(HAVE_LINUX_FUTEX_H) &&		\
+    defined(__NR_futex) &&			\
+    defined(HAVE_SYSCALL) &&			\
+    defined(FUTEX_WAIT_PRIVATE) &&		\
+    defined(FUTEX_WAKE_PRIVATE) &&		\
+    defined(HAVE_ATOMIC_LOAD) &&		\
+    defined(HAVE_ATOMIC_STORE) &&		\
+    defined(HAVE_ATOMIC_ADD_FETCH) &&		\
+    defined(HAVE_ATOMIC_SUB_FETCH) &&		\
+    defined(HAVE_ATOMIC_COMPARE_EXCHANGE)
+
+#if defined(__NR_futex_waitv) &&	\
+    defined(FUTEX_32) &&		\
+    defined(FUTEX_PRIVATE_FLAG) &&	\
+    defined(CLOCK_MONOTONIC)
+#define STRESS_FUTEX_QUEUE_WAITV
+#endif
+
+#if defined(__NR_futex_wait) &&		\
+    defined(__NR_futex_wake) &&		\
+    defined(FUTEX2_SIZE_U32) &&		\
+    defined(FUTEX2_PRIVATE) &&		\
+    defined(FUTEX_BITSET_MATCH_ANY) &&	\
+    defined(CLOCK_MONOTONIC)
+#define STRESS_FUTEX_QUEUE_FUTEX2
+#endif
+
+typedef struct {
+	double stamp;			/* time item was queued */
+	uint64_t seq;			/* per producer sequence number */
+	uint32_t producer;		/* producer index */
+	uint32_t check;			/* seq ^ producer check value */
+} stress_futex_queue_item_t;
+
+typedef struct {
+	volatile uint64_t seq;		/* slot sequence */
+	stress_futex_queue_item_t item;	/* queued work item */
+} stress_futex_queue_slot_t;
+
+/*
+ *  event count, waiters sleep on seq and wakers only issue
+ *  a futex wake if there are any registered waiters
+ */
+typedef struct {
+	uint32_t seq;			/* futex word */
+	uint32_t waiters;		/* number of registered waiters */
+} ALIGN64 stress_futex_queue_event_t;
+
+typedef struct {
+	volatile uint64_t enq ALIGN64;	/* enqueue position */
+	volatile uint64_t deq ALIGN64;	/* dequeue position */
+	stress_futex_queue_event_t items; /* consumers wait for items */
+	stress_futex_queue_event_t space; /* producers wait for space */
+	uint32_t stop ALIGN64;		/* 1 = shut down, futex for waitv */
+	volatile bool producers_stop;	/* producers should stop */
+	int wait;			/* FUTEX_QUEUE_WAIT_* */
+	uint32_t batch;			/* items per wake */
+	uint32_t spin;			/* spins before waiting */
+	stress_futex_queue_slot_t slots[FUTEX_QUEUE_SLOTS];
+} stress_futex_queue_t;
+
+typedef struct {
+	stress_args_t *args;		/* stressor args */
+	stress_futex_queue_t *queue;	/* shared work queue */
+	pthread_t pthread;		/* thread */
+	int ret;			/* pthread_create return */
+	uint32_t id;			/* producer or consumer index */
+	uint32_t producers;		/* number of producers */
+	uint64_t items;			/* items produced or consumed */
+	uint64_t wakes;			/* futex wake system calls */
+	uint64_t waits;			/* futex wait system calls */
+	uint64_t spin_hits;		/* items found while spinning */
+	uint64_t errors;		/* corrupt or out of order items */
+	uint64_t *last_seq;		/* consumer, last seq per producer */
+	stress_latency_t latency;	/* consumer, handoff latency */
+} stress_futex_queue_thread_t;
+
+static inline void stress_futex_queue_relax(void)
+{
+#if defined(STRESS_ARCH_X86) &&	\
+    defined(HAVE_ASM_X86_PAUSE)
+	stress_asm_x86_pause();
+#endif
+}
+
+/*
+ *  stress_futex_queue_push()
+ *	bounded mpmc queue enqueue, returns false if full
+ */
+static inline bool stress_futex_queue_push(
+	stress_futex_queue_t *queue,
+	const stress_futex_queue_item_t *item)
+{
+	stress_futex_queue_slot_t *slot;
+	uint64_t pos = __atomic_load_n(&queue->enq, __ATOMIC_RELAXED);
+
+	for (;;) {
+		int64_t diff;
+
+		slot = &queue->slots[pos & FUTEX_QUEUE_SLOTS_MASK];
+		diff = (int64_t)__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) - (int64_t)pos;
+		if (diff == 0) {
+			if (__atomic_compare_exchange_n(&queue->enq, &pos, pos + 1, false,
+							__ATOMIC_RELAXED, __ATOMIC_RELAXED))
+				break;
+		} else if (diff < 0) {
+			return false;
+		} else {
+			pos = __atomic_load_n(&queue->enq, __ATOMIC_RELAXED);
+		}
+	}
+	slot->item = *item;
+	__atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+	return true;
+}
+
+/*
+ *  stress_futex_queue_pop()
+ *	bounded mpmc queue dequeue, returns false if empty
+ */
+static inline bool stress_futex_queue_pop(
+	stress_futex_queue_t *queue,
+	stress_futex_queue_item_t *item)
+{
+	stress_futex_queue_slot_t *slot;
+	uint64_t pos = __atomic_load_n(&queue->deq, __ATOMIC_RELAXED);
+
+	for (;;) {
+		int64_t diff;
+
+		slot = &queue->slots[pos & FUTEX_QUEUE_SLOTS_MASK];
+		diff = (int64_t)__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) - (int64_t)(pos + 1);
+		if (diff == 0) {
+			if (__atomic_compare_exchange_n(&queue->deq, &pos, pos + 1, false,
+							__ATOMIC_RELAXED, __ATOMIC_RELAXED))
+				break;
+		} else if (diff < 0) {
+			return false;
+		} else {
+			pos = __atomic_load_n(&queue->deq, __ATOMIC_RELAXED);
+		}
+	}
+	*item = slot->item;
+	__atomic_store_n(&slot->seq, pos + FUTEX_QUEUE_SLOTS, __ATOMIC_RELEASE);
+	return true;
+}
+
+/*
+ *  stress_futex_queue_wake()
+ *	wake up to n waiters on a futex word
+ */
+static int stress_futex_queue_wake(const int wait, uint32_t *futex, const int n)
+{
+#if defined(STRESS_FUTEX_QUEUE_FUTEX2)
+	if (wait == FUTEX_QUEUE_WAIT_FUTEX2)
+		return (int)syscall(__NR_futex_wake, futex, FUTEX_BITSET_MATCH_ANY,
+			n, FUTEX2_SIZE_U32 | FUTEX2_PRIVATE);
+#else
+	(void)wait;
+#endif
+	return (int)syscall(__NR_futex, futex, FUTEX_WAKE_PRIVATE, n, NULL, NULL, 0);
+}
+
+/*
+ *  stress_futex_queue_sleep()
+ *	wait until the futex word moves on from val or the
+ *	queue is shut down, a timeout guards against lost wakeups
+ */
+static int stress_futex_queue_sleep(
+	stress_futex_queue_t *queue,
+	uint32_t *futex,
+	const uint32_t val)
+{
+	struct timespec timeout;
+
+#if defined(STRESS_FUTEX_QUEUE_WAITV)
+	if (queue->wait == FUTEX_QUEUE_WAIT_WAITV) {
+		struct shim_futex_waitv w[2];
+
+		/* wait for either more items or a shutdown */
+		if (clock_gettime(CLOCK_MONOTONIC, &timeout) < 0)
+			return -1;
+		timeout.tv_nsec += FUTEX_QUEUE_WAIT_NS;
+		if (timeout.tv_nsec >= STRESS_NANOSECOND) {
+			timeout.tv_sec++;
+			timeout.tv_nsec -= STRESS_NANOSECOND;
+		}
+		(void)shim_memset(w, 0, sizeof(w));
+		w[0].val = (uint64_t)val;
+		w[0].uaddr = (uint64_t)(uintptr_t)futex;
+		w[0].flags = FUTEX_32 | FUTEX_PRIVATE_FLAG;
+		w[1].val = 0;
+		w[1].uaddr = (uint64_t)(uintptr_t)&queue->stop;
+		w[1].flags = FUTEX_32 | FUTEX_PRIVATE_FLAG;
+		return shim_futex_waitv(w, 2, 0, &timeout, CLOCK_MONOTONIC);
+	}
+#endif
+#if defined(STRESS_FUTEX_QUEUE_FUTEX2)
+	if (queue->wait == FUTEX_QUEUE_WAIT_FUTEX2) {
+		if (clock_gettime(CLOCK_MONOTONIC, &timeout) < 0)
+			return -1;
+		timeout.tv_nsec += FUTEX_QUEUE_WAIT_NS;
+		if (timeout.tv_nsec >= STRESS_NANOSECOND) {
+			timeout.tv_sec++;
+			timeout.tv_nsec -= STRESS_NANOSECOND;
+		}
+		return (int)syscall(__NR_futex_wait, futex, (unsigned long)val,
+			FUTEX_BITSET_MATCH_ANY, FUTEX2_SIZE_U32 | FUTEX2_PRIVATE,
+			&timeout, CLOCK_MONOTONIC);
+	}
+#endif
+	timeout.tv_sec = 0;
+	timeout.tv_nsec = FUTEX_QUEUE_WAIT_NS;
+	return (int)syscall(__NR_futex, futex, FUTEX_WAIT_PRIVATE, val, &timeout, NULL, 0);
+}
+
+/*
+ *  stress_futex_queue_post()
+ *	bump an event count and wake up to n of its waiters
+ */
+static inline void stress_futex_queue_post(
+	stress_futex_queue_t *queue,
+	stress_futex_queue_event_t *ev,
+	const uint32_t n,
+	stress_futex_queue_thread_t *thread)
+{
+	uint32_t waiters;
+
+	(void)__atomic_add_fetch(&ev->seq, 1, __ATOMIC_SEQ_CST);
+	waiters = __atomic_load_n(&ev->waiters, __ATOMIC_SEQ_CST);
+	if (LIKELY(waiters == 0))
+		return;
+	thread->wakes++;
+	(void)stress_futex_queue_wake(queue->wait, &ev->seq,
+		(int)((n < waiters) ? n : waiters));
+}
+
+/*
+ *  stress_futex_queue_producer()
+ *	queue sequenced, time stamped items, waking consumers
+ *	once per batch of items
+ */
+static void *stress_futex_queue_producer(void *arg)
+{
+	static void *nowt = NULL;
+	stress_futex_queue_thread_t *thread = (stress_futex_queue_thread_t *)arg;
+	stress_futex_queue_t *queue = thread->queue;
+	stress_futex_queue_item_t item;
+	uint32_t pending = 0;
+
+	item.producer = thread->id;
+	item.seq = 0;
+
+	while (!queue->producers_stop && stress_continue_flag()) {
+		item.seq++;
+		item.check = (uint32_t)item.seq ^ thread->id;
+		item.stamp = stress_time_now();
+
+		while (!stress_futex_queue_push(queue, &item)) {
+			uint32_t seq;
+
+			if (UNLIKELY(queue->producers_stop || !stress_continue_flag()))
+				goto done;
+			/* queue full, make sure consumers are awake then wait */
+			if (pending) {
+				stress_futex_queue_post(queue, &queue->items, pending, thread);
+				pending = 0;
+			}
+			seq = __atomic_load_n(&queue->space.seq, __ATOMIC_SEQ_CST);
+			(void)__atomic_add_fetch(&queue->space.waiters, 1, __ATOMIC_SEQ_CST);
+			if (stress_futex_queue_push(queue, &item)) {
+				(void)__atomic_sub_fetch(&queue->space.waiters, 1, __ATOMIC_SEQ_CST);
+				break;
+			}
+			thread->waits++;
+			(void)stress_futex_queue_sleep(queue, &queue->space.seq, seq);
+			(void)__atomic_sub_fetch(&queue->space.waiters, 1, __ATOMIC_SEQ_CST);
+		}
+		thread->items++;
+		if (++pending >= queue->batch) {
+			stress_futex_queue_post(queue, &queue->items, pending, thread);
+			pending = 0;
+		}
+	}
+done:
+	if (pending)
+		stress_futex_queue_post(queue, &queue->items, pending, thread);
+	return &nowt;
+}
+
+/*
+ *  stress_futex_queue_consumer()
+ *	take items off the queue, spinning then waiting when
+ *	the queue is empty, check and time each item
+ */
+static void *stress_futex_queue_consumer(void *arg)
+{
+	static void *nowt = NULL;
+	stress_futex_queue_thread_t *thread = (stress_futex_queue_thread_t *)arg;
+	stress_futex_queue_t *queue = thread->queue;
+	const uint32_t spin = queue->spin;
+
+	for (;;) {
+		stress_futex_queue_item_t item;
+		double now;
+		uint32_t i;
+
+		if (stress_futex_queue_pop(queue, &item))
+			goto got_item;
+		for (i = 0; i < spin; i++) {
+			stress_futex_queue_relax();
+			if (stress_futex_queue_pop(queue, &item)) {
+				thread->spin_hits++;
+				goto got_item;
+			}
+		}
+		for (;;) {
+			uint32_t seq;
+
+			/*
+			 *  drained queue after shutdown, all done; stop is only
+			 *  set once the producers are joined and the queue is
+			 *  drained, so late pushes are never left behind
+			 */
+			if (__atomic_load_n(&queue->stop, __ATOMIC_SEQ_CST))
+				return &nowt;
+			seq = __atomic_load_n(&queue->items.seq, __ATOMIC_SEQ_CST);
+			(void)__atomic_add_fetch(&queue->items.waiters, 1, __ATOMIC_SEQ_CST);
+			if (stress_futex_queue_pop(queue, &item)) {
+				(void)__atomic_sub_fetch(&queue->items.waiters, 1, __ATOMIC_SEQ_CST);
+				goto got_item;
+			}
+			thread->waits++;
+			(void)stress_futex_queue_sleep(queue, &queue->items.seq, seq);
+			(void)__atomic_sub_fetch(&queue->items.waiters, 1, __ATOMIC_SEQ_CST);
+			if (stress_futex_queue_pop(queue, &item))
+				goto got_item;
+		}
+got_item:
+		now = stress_time_now();
+		stress_futex_queue_post(queue, &queue->space, 1, thread);
+
+		/* per producer sequence numbers must increase */
+		if (UNLIKELY((item.producer >= thread->producers) ||
+			     (item.check != ((uint32_t)item.seq ^ item.producer)) ||
+			     (item.seq <= thread->last_seq[item.producer]))) {
+			thread->errors++;
+		} else {
+			thread->last_seq[item.producer] = item.seq;
+		}
+		if (LIKELY(now >= item.stamp))
+			stress_latency_add(&thread->latency,
+				(uint64_t)((now - item.stamp) * STRESS_DBL_NANOSECOND));
+		__atomic_store_n(&thread->items, thread->items + 1, __ATOMIC_RELAXED);
+	}
+	return &nowt;
+}
+
+/*
+ *  stress_futex_queue_supported()
+ *	check the chosen wait method works
+ */
+static bool stress_futex_queue_supported(stress_futex_queue_t *queue)
+{
+	uint32_t futex = 0;
+
+	if (queue->wait == FUTEX_QUEUE_WAIT_WAITV) {
+#if !defined(STRESS_FUTEX_QUEUE_WAITV)
+		return false;
+#endif
+	} else if (queue->wait == FUTEX_QUEUE_WAIT_FUTEX2) {
+#if !defined(STRESS_FUTEX_QUEUE_FUTEX2)
+		return false;
+#endif
+	}
+	/* a wait on a futex that does not match the value returns EAGAIN */
+	if ((stress_futex_queue_sleep(queue, &futex, 1) < 0) && (errno != EAGAIN))
+		return false;
+	if (stress_futex_queue_wake(queue->wait, &futex, 1) < 0)
+		return false;
+	return true;
+}
+
+/*
+ *  stress_futex_queue()
+ *	stress futex based work queue handoff between
+ *	producer and consumer threads
+ */
+static int stress_futex_queue(stress_args_t *args)
+{
+	stress_futex_queue_t *queue;
+	stress_futex_queue_thread_t *threads;
+	stress_latency_t latency;
+	uint32_t futex_queue_producers = DEFAULT_FUTEX_QUEUE_PRODUCERS;
+	uint32_t futex_queue_consumers = DEFAULT_FUTEX_QUEUE_CONSUMERS;
+	uint32_t futex_queue_batch = 1, futex_queue_spin = 0;
+	uint32_t i, n_threads, producers_created = 0, consumers_created = 0;
+	int futex_queue_wait = FUTEX_QUEUE_WAIT_FUTEX;
+	uint64_t *last_seqs;
+	uint64_t produced = 0, consumed = 0, wakes = 0, waits = 0, spin_hits = 0, errors = 0;
+	uint64_t leftover = 0;
+	bool drain_timeout = false;
+	double t_start, t_drain, duration, rate;
+	int rc = EXIT_SUCCESS;
+
+	(void)stress_get_setting("futex-queue-batch", &futex_queue_batch);
+	(void)stress_get_setting("futex-queue-consumers", &futex_queue_consumers);
+	(void)stress_get_setting("futex-queue-producers", &futex_queue_producers);
+	(void)stress_get_setting("futex-queue-spin", &futex_queue_spin);
+	(void)stress_get_setting("futex-queue-wait", &futex_queue_wait);
+
+	n_threads = futex_queue_producers + futex_queue_consumers;
+	queue = (stress_futex_queue_t *)stress_mmap_populate(NULL, sizeof(*queue),
+		PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+	if (queue == MAP_FAILED) {
+		pr_inf_skip("%s: cannot mmap work queue, skipping stressor\n", args->name);
+		return EXIT_NO_RESOURCE;
+	}
+	threads = (stress_futex_queue_thread_t *)calloc(n_threads, sizeof(*threads));
+	last_seqs = (uint64_t *)calloc((size_t)futex_queue_consumers * futex_queue_producers, sizeof(*last_seqs));
+	if (!threads || !last_seqs) {
+		pr_inf_skip("%s: cannot allocate thread state, skipping stressor\n", args->name);
+		rc = EXIT_NO_RESOURCE;
+		goto tidy;
+	}
+
+	(void)shim_memset(queue, 0, sizeof(*queue));
+	for (i = 0; i < FUTEX_QUEUE_SLOTS; i++)
+		queue->slots[i].seq = i;
+	queue->wait = futex_queue_wait;
+	queue->batch = futex_queue_batch;
+	queue->spin = futex_queue_spin;
+
+	if (!stress_futex_queue_supported(queue)) {
+		if (args->instance == 0)
+			pr_inf_skip("%s: %s wait method not supported, skipping stressor\n",
+				args->name, stress_futex_queue_waits[futex_queue_wait]);
+		rc = EXIT_NOT_IMPLEMENTED;
+		goto tidy;
+	}
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+	/* consumers first so producers start with consumers waiting */
+	for (i = 0; i < n_threads; i++) {
+		stress_futex_queue_thread_t *thread = &threads[i];
+		const bool consumer = (i < futex_queue_consumers);
+
+		thread->args = args;
+		thread->queue = queue;
+		thread->producers = futex_queue_producers;
+		thread->id = consumer ? i : i - futex_queue_consumers;
+		thread->last_seq = consumer ? &last_seqs[(size_t)i * futex_queue_producers] : NULL;
+		stress_latency_init(&thread->latency);
+		thread->ret = pthread_create(&thread->pthread, NULL,
+			consumer ? stress_futex_queue_consumer : stress_futex_queue_producer,
+			(void *)thread);
+		if (thread->ret == 0) {
+			if (consumer)
+				consumers_created++;
+			else
+				producers_created++;
+		}
+	}
+	if ((producers_created == 0) || (consumers_created == 0)) {
+		pr_inf_skip("%s: could not create producer and consumer pthreads, "
+			"skipping stressor\n", args->name);
+		rc = EXIT_NO_RESOURCE;
+		queue->producers_stop = true;
+		__atomic_store_n(&queue->stop, 1, __ATOMIC_SEQ_CST);
+		goto join;
+	}
+
+	t_start = stress_time_now();
+	do {
+		uint64_t total = 0;
+
+		(void)shim_usleep(10000);
+		for (i = 0; i < futex_queue_consumers; i++)
+			total += __atomic_load_n(&threads[i].items, __ATOMIC_RELAXED);
+		stress_bogo_set(args, total);
+	} while (stress_continue(args));
+	duration = stress_time_now() - t_start;
+
+	/* stop producers, let consumers drain the queue then stop them */
+	queue->producers_stop = true;
+	(void)__atomic_add_fetch(&queue->space.seq, 1, __ATOMIC_SEQ_CST);
+	(void)stress_futex_queue_wake(queue->wait, &queue->space.seq, INT_MAX);
+	for (i = futex_queue_consumers; i < n_threads; i++) {
+		if (threads[i].ret == 0)
+			(void)pthread_join(threads[i].pthread, NULL);
+	}
+	t_drain = stress_time_now() + FUTEX_QUEUE_DRAIN_SECS;
+	while (__atomic_load_n(&queue->deq, __ATOMIC_SEQ_CST) != __atomic_load_n(&queue->enq, __ATOMIC_SEQ_CST)) {
+		if (stress_time_now() > t_drain) {
+			drain_timeout = true;
+			break;
+		}
+		(void)shim_usleep(1000);
+	}
+	__atomic_store_n(&queue->stop, 1, __ATOMIC_SEQ_CST);
+	(void)__atomic_add_fetch(&queue->items.seq, 1, __ATOMIC_SEQ_CST);
+	(void)stress_futex_queue_wake(queue->wait, &queue->items.seq, INT_MAX);
+	(void)stress_futex_queue_wake(queue->wait, &queue->stop, INT_MAX);
+join:
+	for (i = 0; i < futex_queue_consumers; i++) {
+		if (threads[i].ret == 0)
+			(void)pthread_join(threads[i].pthread, NULL);
+	}
+	if (rc != EXIT_SUCCESS) {
+		for (i = futex_queue_consumers; i < n_threads; i++) {
+			if (threads[i].ret == 0)
+				(void)pthread_join(threads[i].pthread, NULL);
+		}
+		goto tidy;
+	}
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	stress_latency_init(&latency);
+	for (i = 0; i < n_threads; i++) {
+		const stress_futex_queue_thread_t *thread = &threads[i];
+
+		if (i < futex_queue_consumers) {
+			consumed += thread->items;
+			spin_hits += thread->spin_hits;
+			errors += thread->errors;
+			stress_latency_merge(&latency, &thread->latency);
+		} else {
+			produced += thread->items;
+		}
+		wakes += thread->wakes;
+		waits += thread->waits;
+	}
+	stress_bogo_set(args, consumed);
+
+	/* items not consumed after a timed out drain are leftovers, not losses */
+	if (drain_timeout) {
+		leftover = __atomic_load_n(&queue->enq, __ATOMIC_SEQ_CST) -
+			   __atomic_load_n(&queue->deq, __ATOMIC_SEQ_CST);
+		pr_dbg("%s: timed out draining queue, %" PRIu64 " items left\n",
+			args->name, leftover);
+	}
+
+	if (errors) {
+		pr_fail("%s: %" PRIu64 " corrupt or out of order work items\n",
+			args->name, errors);
+		rc = EXIT_FAILURE;
+	}
+	if (produced != consumed + leftover) {
+		pr_fail("%s: %" PRIu64 " work items produced but %" PRIu64 " consumed\n",
+			args->name, produced, consumed);
+		rc = EXIT_FAILURE;
+	}
+
+	rate = (duration > 0.0) ? (double)consumed / duration : 0.0;
+	stress_metrics_set(args, 0, "work items per sec", rate, STRESS_HARMONIC_MEAN);
+	stress_metrics_set(args, 1, "futex wakes per work item",
+		consumed ? (double)wakes / (double)consumed : 0.0, STRESS_GEOMETRIC_MEAN);
+	stress_metrics_set(args, 2, "futex waits per work item",
+		consumed ? (double)waits / (double)consumed : 0.0, STRESS_GEOMETRIC_MEAN);
+	stress_metrics_set(args, 3, "% work items taken while spinning",
+		consumed ? 100.0 * (double)spin_hits / (double)consumed : 0.0, STRESS_GEOMETRIC_MEAN);
+	(void)stress_latency_metrics_set(args, 4, "handoff", &latency);
+
+	if (args->instance == 0) {
+		pr_inf("%s: %" PRIu32 " producer%s, %" PRIu32 " consumer%s, %s wait, "
+			"batch %" PRIu32 ", spin %" PRIu32 ": %.0f items/sec, "
+			"%.3f wakes/item, %.3f waits/item\n", args->name,
+			futex_queue_producers, (futex_queue_producers == 1) ? "" : "s",
+			futex_queue_consumers, (futex_queue_consumers == 1) ? "" : "s",
+			stress_futex_queue_waits[futex_queue_wait],
+			futex_queue_batch, futex_queue_spin, rate,
+			consumed ? (double)wakes / (double)consumed : 0.0,
+			consumed ? (double)waits / (double)consumed : 0.0);
+		stress_latency_report(args, "handoff", &latency);
+	}
+
+tidy:
+	free(last_seqs);
+	free(threads);
+	(void)munmap((void *)queue, sizeof(*queue));
+
+	return rc;
+}
+
+stressor_info_t stress_futex_queue_info = {
+	.stressor = stress_futex_queue,
+	.class = CLASS_SCHEDULER | CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
+	.verify = VERIFY_ALWAYS,
+	.help = help
+};
+#else
+stressor_info_t stress_futex_queue_info = {
+	.stressor = stress_unimplemented,
+	.class = CLASS_SCHEDULER | CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
+	.verify = VERIFY_ALWAYS,
+	.help = help,
+	.unimplemented_reason = "built without pthread support, linux/futex.h, futex() or atomic builtins"
+};
+#endif
@@ -0,0 +1,547 @@
+/*
+ * Copyright (C) 2024 Colin Ian King.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+#include "core-builtin.h"
+#include "core-latency.h"
+#include "core-pthread.h"
+
+#define MIN_GROUP_COMMIT_WRITERS	(1)
+#define MAX_GROUP_COMMIT_WRITERS	(256)
+#define DEFAULT_GROUP_COMMIT_WRITERS	(4)
+
+#define MIN_GROUP_COMMIT_RECORD		(16)
+#define MAX_GROUP_COMMIT_RECORD		(64 * KB)
+#define DEFAULT_GROUP_COMMIT_RECORD	(128)
+
+#define GROUP_COMMIT_LOG_BYTES		(16 * MB)
+
+static const stress_help_t help[] = {
+	{ NULL,	"group-commit N",		"start N workers exercising write-ahead log group commits" },
+	{ NULL,	"group-commit-method M",	"select commit method, default is fdatasync" },
+	{ NULL,	"group-commit-ops N",		"stop after N group commit bogo operations" },
+	{ NULL,	"group-commit-record N",	"size of each log record in bytes" },
+	{ NULL,	"group-commit-writers N",	"number of log writer threads" },
+	{ NULL,	NULL,				NULL }
+};
+
+typedef int (*stress_group_commit_func)(const int fd, const void *buf,
+					const size_t len, const off_t offset);
+
+typedef struct {
+	const char *name;			/* method name */
+	const stress_group_commit_func func;	/* write + sync method */
+} stress_group_commit_method_t;
+
+/*
+ *  stress_group_commit_pwrite()
+ *	write all of buf at offset, handle short writes
+ */
+static int stress_group_commit_pwrite(
+	const int fd,
+	const void *buf,
+	const size_t len,
+	const off_t offset)
+{
+	const uint8_t *ptr = (const uint8_t *)buf;
+	size_t n = len;
+	off_t off = offset;
+
+	while (n > 0) {
+		const ssize_t ret = pwrite(fd, ptr, n, off);
+
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		if (ret == 0) {
+			errno = ENOSPC;
+			return -1;
+		}
+		ptr += ret;
+		off += (off_t)ret;
+		n -= (size_t)ret;
+	}
+	return 0;
+}
+
+/*
+ *  stress_group_commit_fdatasync()
+ *	write batch and commit using fdatasync
+ */
+static int stress_group_commit_fdatasync(
+	const int fd,
+	const void *buf,
+	const size_t len,
+	const off_t offset)
+{
+	if (stress_group_commit_pwrite(fd, buf, len, offset) < 0)
+		return -1;
+	return shim_fdatasync(fd);
+}
+
+/*
+ *  stress_group_commit_fsync()
+ *	write batch and commit using fsync
+ */
+static int stress_group_commit_fsync(
+	const int fd,
+	const void *buf,
+	const size_t len,
+	const off_t offset)
+{
+	if (stress_group_commit_pwrite(fd, buf, len, offset) < 0)
+		return -1;
+	return shim_fsync(fd);
+}
+
+#if defined(HAVE_PWRITEV2) &&	\
+    defined(RWF_DSYNC)
+/*
+ *  stress_group_commit_dsync()
+ *	write batch and commit using a RWF_DSYNC write
+ */
+static int stress_group_commit_dsync(
+	const int fd,
+	const void *buf,
+	const size_t len,
+	const off_t offset)
+{
+	struct iovec iov;
+	ssize_t ret;
+
+	iov.iov_base = (void *)shim_unconstify_ptr(buf);
+	iov.iov_len = len;
+
+	do {
+		ret = pwritev2(fd, &iov, 1, offset, RWF_DSYNC);
+	} while ((ret < 0) && (errno == EINTR));
+	if (ret < 0)
+		return -1;
+	if ((size_t)ret != len) {
+		/* short write, complete it the slow way */
+		return stress_group_commit_fdatasync(fd, (const uint8_t *)buf + ret,
+			len - (size_t)ret, offset + (off_t)ret);
+	}
+	return 0;
+}
+#endif
+
+#if defined(HAVE_SYNC_FILE_RANGE) &&		\
+    defined(SYNC_FILE_RANGE_WAIT_BEFORE) &&	\
+    defined(SYNC_FILE_RANGE_WRITE) &&		\
+    defined(SYNC_FILE_RANGE_WAIT_AFTER)
+/*
+ *  stress_group_commit_sync_file_range()
+ *	write batch and write back just the batch range using
+ *	sync_file_range, note that this does not flush metadata
+ *	or the device write cache
+ */
+static int stress_group_commit_sync_file_range(
+	const int fd,
+	const void *buf,
+	const size_t len,
+	const off_t offset)
+{
+	if (stress_group_commit_pwrite(fd, buf, len, offset) < 0)
+		return -1;
+	return shim_sync_file_range(fd, (shim_off64_t)offset, (shim_off64_t)len,
+		SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE |
+		SYNC_FILE_RANGE_WAIT_AFTER);
+}
+#endif
+
+static const stress_group_commit_method_t group_commit_methods[] = {
+	{ "fdatasync",		stress_group_commit_fdatasync },
+	{ "fsync",		stress_group_commit_fsync },
+#if defined(HAVE_PWRITEV2) &&	\
+    defined(RWF_DSYNC)
+	{ "dsync",		stress_group_commit_dsync },
+#endif
+#if defined(HAVE_SYNC_FILE_RANGE) &&		\
+    defined(SYNC_FILE_RANGE_WAIT_BEFORE) &&	\
+    defined(SYNC_FILE_RANGE_WRITE) &&		\
+    defined(SYNC_FILE_RANGE_WAIT_AFTER)
+	{ "sync-file-range",	stress_group_commit_sync_file_range },
+#endif
+};
+
+static int stress_set_group_commit_method(const char *name)
+{
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(group_commit_methods); i++) {
+		if (!strcmp(group_commit_methods[i].name, name)) {
+			stress_set_setting("group-commit-method", TYPE_ID_SIZE_T, &i);
+			return 0;
+		}
+	}
+
+	(void)fprintf(stderr, "group-commit-method must be one of:");
+	for (i = 0; i < SIZEOF_ARRAY(group_commit_methods); i++) {
+		(void)fprintf(stderr, " %s", group_commit_methods[i].name);
+	}
+	(void)fprintf(stderr, "\n");
+
+	return -1;
+}
+
+static int stress_set_group_commit_record(const char *opt)
+{
+	size_t group_commit_record;
+
+	group_commit_record = (size_t)stress_get_uint64_byte(opt);
+	stress_check_range_bytes("group-commit-record", (uint64_t)group_commit_record,
+		MIN_GROUP_COMMIT_RECORD, MAX_GROUP_COMMIT_RECORD);
+	return stress_set_setting("group-commit-record", TYPE_ID_SIZE_T, &group_commit_record);
+}
+
+static int stress_set_group_commit_writers(const char *opt)
+{
+	size_t group_commit_writers;
+
+	group_commit_writers = (size_t)stress_get_uint64(opt);
+	stress_check_range("group-commit-writers", (uint64_t)group_commit_writers,
+		MIN_GROUP_COMMIT_WRITERS, MAX_GROUP_COMMIT_WRITERS);
+	return stress_set_setting("group-commit-writers", TYPE_ID_SIZE_T, &group_commit_writers);
+}
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_group_commit_method,	stress_set_group_commit_method },
+	{ OPT_group_commit_record,	stress_set_group_commit_record },
+	{ OPT_group_commit_writers,	stress_set_group_commit_writers },
+	{ 0,				NULL }
+};
+
+#if defined(HAVE_LIB_PTHREAD)
+
+/*
+ *  In-memory double buffered log, writers append records to
+ *  the fill buffer and wait for their record to be committed,
+ *  the committer swaps buffers and writes and syncs a whole
+ *  batch of records at once.
+ */
+typedef struct {
+	pthread_mutex_t lock;		/* protects all the fields below */
+	pthread_cond_t appended;	/* signals committer, records appended */
+	pthread_cond_t committed;	/* signals writers, batch committed */
+	uint8_t *buf[2];		/* log buffers */
+	size_t buf_idx;			/* index of buffer being filled */
+	size_t buf_used;		/* bytes used in fill buffer */
+	size_t record_size;		/* size of a log record */
+	uint64_t lsn_appended;		/* last appended log sequence number */
+	uint64_t lsn_committed;		/* last committed log sequence number */
+	bool stop;			/* true to stop writers */
+} stress_group_commit_log_t;
+
+typedef struct {
+	stress_args_t *args;		/* stressor args */
+	stress_group_commit_log_t *log;	/* shared log */
+	pthread_t pthread;		/* writer thread */
+	int ret;			/* pthread_create return */
+	uint8_t id;			/* writer id, record fill pattern */
+	stress_latency_t latency;	/* append to commit latency */
+} stress_group_commit_writer_t;
+
+/*
+ *  stress_group_commit_writer()
+ *	append records to the log and wait for each one to be committed
+ */
+static void *stress_group_commit_writer(void *arg)
+{
+	static void *nowt = NULL;
+	stress_group_commit_writer_t *writer = (stress_group_commit_writer_t *)arg;
+	stress_group_commit_log_t *log = writer->log;
+
+	while (stress_continue_flag()) {
+		uint64_t lsn;
+		uint8_t *record;
+		double t;
+		bool committed;
+
+		if (pthread_mutex_lock(&log->lock) != 0)
+			break;
+		if (log->stop) {
+			(void)pthread_mutex_unlock(&log->lock);
+			break;
+		}
+		t = stress_time_now();
+		lsn = ++log->lsn_appended;
+		record = log->buf[log->buf_idx] + log->buf_used;
+		(void)shim_memset(record, writer->id, log->record_size);
+		(void)shim_memcpy(record, &lsn, sizeof(lsn));
+		log->buf_used += log->record_size;
+		(void)pthread_cond_signal(&log->appended);
+
+		while ((log->lsn_committed < lsn) && !log->stop)
+			(void)pthread_cond_wait(&log->committed, &log->lock);
+		committed = (log->lsn_committed >= lsn);
+		(void)pthread_mutex_unlock(&log->lock);
+
+		if (committed)
+			stress_latency_add(&writer->latency,
+				(uint64_t)((stress_time_now() - t) * STRESS_DBL_NANOSECOND));
+	}
+	return &nowt;
+}
+
+/*
+ *  stress_group_commit_stop()
+ *	tell writers to stop and wake them all up
+ */
+static void stress_group_commit_stop(stress_group_commit_log_t *log)
+{
+	(void)pthread_mutex_lock(&log->lock);
+	log->stop = true;
+	(void)pthread_cond_broadcast(&log->committed);
+	(void)pthread_mutex_unlock(&log->lock);
+}
+
+/*
+ *  stress_group_commit()
+ *	stress write-ahead log style group commits
+ */
+static int stress_group_commit(stress_args_t *args)
+{
+	stress_group_commit_log_t log;
+	stress_group_commit_writer_t *writers;
+	stress_latency_t commit_latency, sync_latency;
+	size_t group_commit_method = 0;
+	size_t group_commit_record = DEFAULT_GROUP_COMMIT_RECORD;
+	size_t group_commit_writers = DEFAULT_GROUP_COMMIT_WRITERS;
+	size_t i, buf_size, created = 0;
+	stress_group_commit_func func;
+	char filename[PATH_MAX];
+	const char *fs_type;
+	off_t log_offset = 0;
+	double commits = 0.0, records = 0.0, t_start, duration;
+	int fd, ret, rc = EXIT_SUCCESS;
+
+	(void)stress_get_setting("group-commit-method", &group_commit_method);
+	(void)stress_get_setting("group-commit-record", &group_commit_record);
+	if (!stress_get_setting("group-commit-writers", &group_commit_writers)) {
+		if (g_opt_flags & OPT_FLAGS_MAXIMIZE)
+			group_commit_writers = MAX_GROUP_COMMIT_WRITERS;
+		if (g_opt_flags & OPT_FLAGS_MINIMIZE)
+			group_commit_writers = MIN_GROUP_COMMIT_WRITERS;
+	}
+	func = group_commit_methods[group_commit_method].func;
+
+	/* each writer has at most one uncommitted record in the log */
+	buf_size = group_commit_record * group_commit_writers;
+
+	(void)shim_memset(&log, 0, sizeof(log));
+	log.record_size = group_commit_record;
+	log.buf[0] = (uint8_t *)stress_mmap_populate(NULL, buf_size * 2,
+		PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+	if (log.buf[0] == MAP_FAILED) {
+		pr_inf_skip("%s: cannot mmap %zd byte log buffers, skipping stressor\n",
+			args->name, buf_size * 2);
+		return EXIT_NO_RESOURCE;
+	}
+	log.buf[1] = log.buf[0] + buf_size;
+
+	writers = (stress_group_commit_writer_t *)calloc(group_commit_writers, sizeof(*writers));
+	if (!writers) {
+		pr_inf_skip("%s: cannot allocate %zd writers, skipping stressor\n",
+			args->name, group_commit_writers);
+		rc = EXIT_NO_RESOURCE;
+		goto unmap_buf;
+	}
+
+	ret = stress_temp_dir_mk_args(args);
+	if (ret < 0) {
+		rc = stress_exit_status(-ret);
+		goto free_writers;
+	}
+	(void)stress_temp_filename_args(args,
+		filename, sizeof(filename), stress_mwc32());
+	if ((fd = open(filename, O_CREAT | O_RDWR, S_IRUSR | S_IWUSR)) < 0) {
+		if ((errno == ENFILE) || (errno == ENOMEM) || (errno == ENOSPC)) {
+			pr_inf_skip("%s: cannot create log file, skipping stressor: errno=%d (%s)\n",
+				args->name, errno, strerror(errno));
+			rc = EXIT_NO_RESOURCE;
+		} else {
+			rc = stress_exit_status(errno);
+			pr_fail("%s: open %s failed, errno=%d (%s)\n",
+				args->name, filename, errno, strerror(errno));
+		}
+		goto rm_dir;
+	}
+	fs_type = stress_get_fs_type(filename);
+	(void)shim_unlink(filename);
+	/* preallocate the log like a WAL segment, ignore failures */
+	(void)shim_fallocate(fd, 0, (off_t)0, (off_t)GROUP_COMMIT_LOG_BYTES);
+
+	stress_latency_init(&commit_latency);
+	stress_latency_init(&sync_latency);
+
+	if ((pthread_mutex_init(&log.lock, NULL) != 0) ||
+	    (pthread_cond_init(&log.appended, NULL) != 0) ||
+	    (pthread_cond_init(&log.committed, NULL) != 0)) {
+		pr_inf_skip("%s: cannot initialize log mutex and condition variables, "
+			"skipping stressor\n", args->name);
+		rc = EXIT_NO_RESOURCE;
+		goto close_fd;
+	}
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+	for (i = 0; i < group_commit_writers; i++) {
+		writers[i].args = args;
+		writers[i].log = &log;
+		writers[i].id = (uint8_t)i;
+		stress_latency_init(&writers[i].latency);
+		writers[i].ret = pthread_create(&writers[i].pthread, NULL,
+			stress_group_commit_writer, (void *)&writers[i]);
+		if (writers[i].ret == 0)
+			created++;
+	}
+	if (created == 0) {
+		pr_inf_skip("%s: could not create any writer pthreads, skipping stressor\n",
+			args->name);
+		rc = EXIT_NO_RESOURCE;
+		goto destroy;
+	}
+
+	t_start = stress_time_now();
+	do {
+		struct timespec abstime;
+		uint8_t *buf;
+		size_t len;
+		uint64_t lsn, n;
+		double t;
+
+		(void)pthread_mutex_lock(&log.lock);
+		if (log.buf_used == 0) {
+			/* nothing to commit yet, wait a short while */
+			if (clock_gettime(CLOCK_REALTIME, &abstime) == 0) {
+				abstime.tv_nsec += 10000000;
+				if (abstime.tv_nsec >= STRESS_NANOSECOND) {
+					abstime.tv_nsec -= STRESS_NANOSECOND;
+					abstime.tv_sec++;
+				}
+				(void)pthread_cond_timedwait(&log.appended, &log.lock, &abstime);
+			}
+			if (log.buf_used == 0) {
+				(void)pthread_mutex_unlock(&log.lock);
+				continue;
+			}
+		}
+		buf = log.buf[log.buf_idx];
+		len = log.buf_used;
+		lsn = log.lsn_appended;
+		n = lsn - log.lsn_committed;
+		log.buf_idx ^= 1;
+		log.buf_used = 0;
+		(void)pthread_mutex_unlock(&log.lock);
+
+		/* circular log, wrap back to the start when full */
+		if (log_offset + (off_t)len > (off_t)GROUP_COMMIT_LOG_BYTES)
+			log_offset = 0;
+
+		t = stress_time_now();
+		if (UNLIKELY(func(fd, buf, len, log_offset) < 0)) {
+			if ((errno == ENOSYS) || (errno == EOPNOTSUPP) || (errno == EINVAL)) {
+				pr_inf_skip("%s: %s commit method not supported%s, skipping stressor\n",
+					args->name, group_commit_methods[group_commit_method].name,
+					fs_type);
+				rc = EXIT_NOT_IMPLEMENTED;
+			} else if (errno == ENOSPC) {
+				pr_inf_skip("%s: out of file system space%s, skipping stressor\n",
+					args->name, fs_type);
+				rc = EXIT_NO_RESOURCE;
+			} else {
+				pr_fail("%s: %s commit failed, errno=%d (%s)%s\n",
+					args->name, group_commit_methods[group_commit_method].name,
+					errno, strerror(errno), fs_type);
+				rc = EXIT_FAILURE;
+			}
+			break;
+		}
+		stress_latency_add(&sync_latency,
+			(uint64_t)((stress_time_now() - t) * STRESS_DBL_NANOSECOND));
+		log_offset += (off_t)len;
+
+		(void)pthread_mutex_lock(&log.lock);
+		log.lsn_committed = lsn;
+		(void)pthread_cond_broadcast(&log.committed);
+		(void)pthread_mutex_unlock(&log.lock);
+
+		commits += 1.0;
+		records += (double)n;
+		stress_bogo_inc(args);
+	} while (stress_continue(args));
+	duration = stress_time_now() - t_start;
+
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	stress_group_commit_stop(&log);
+	for (i = 0; i < group_commit_writers; i++) {
+		if (writers[i].ret)
+			continue;
+		(void)pthread_join(writers[i].pthread, NULL);
+		stress_latency_merge(&commit_latency, &writers[i].latency);
+	}
+
+	stress_metrics_set(args, 0, "commits per sec",
+		(duration > 0.0) ? commits / duration : 0.0, STRESS_HARMONIC_MEAN);
+	stress_metrics_set(args, 1, "records per sec",
+		(duration > 0.0) ? records / duration : 0.0, STRESS_HARMONIC_MEAN);
+	stress_metrics_set(args, 2, "records per commit",
+		(commits > 0.0) ? records / commits : 0.0, STRESS_GEOMETRIC_MEAN);
+	i = stress_latency_metrics_set(args, 3, "commit", &commit_latency);
+	(void)stress_latency_metrics_set(args, i, "write+sync", &sync_latency);
+
+	if (args->instance == 0) {
+		stress_latency_report(args, "commit", &commit_latency);
+		stress_latency_report(args, "write+sync", &sync_latency);
+	}
+
+destroy:
+	(void)pthread_cond_destroy(&log.committed);
+	(void)pthread_cond_destroy(&log.appended);
+	(void)pthread_mutex_destroy(&log.lock);
+close_fd:
+	(void)close(fd);
+rm_dir:
+	(void)stress_temp_dir_rm_args(args);
+free_writers:
+	free(writers);
+unmap_buf:
+	(void)munmap((void *)log.buf[0], buf_size * 2);
+
+	return rc;
+}
+
+stressor_info_t stress_group_commit_info = {
+	.stressor = stress_group_commit,
+	.class = CLASS_IO | CLASS_FILESYSTEM | CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
+	.help = help
+};
+#else
+stressor_info_t stress_group_commit_info = {
+	.stressor = stress_unimplemented,
+	.class = CLASS_IO | CLASS_FILESYSTEM | CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
+	.help = help,
+	.unimplemented_reason = "built without pthread support"
+};
+#endif
@@ -19,6 +19,9 @@
  */
 #include "stress-ng.h"
 #include "core-builtin.h"
+#include "core-killpid.h"
+#include "core-latency.h"
+#include "core-net.h"
 #include "core-out-of-memory.h"
 #include "io-uring.h"
 
@@ -34,13 +37,31 @@
 #include <attr/xattr.h>
 #endif
 
+#include <netinet/in.h>
+
+#if defined(HAVE_NETINET_TCP_H)
+#include <netinet/tcp.h>
+#endif
+
 #if !defined(O_DSYNC)
 #define O_DSYNC		(0)
 #endif
 
+#define MIN_IO_URING_NET_PORT		(1024)
+#define MAX_IO_URING_NET_PORT		(65535)
+#define DEFAULT_IO_URING_NET_PORT	(23000)
+
+#define MAX_IO_URING_NET		(1024)
+#define MIN_IO_URING_NET_SIZE		(8)
+#define MAX_IO_URING_NET_SIZE		(16384)
+#define DEFAULT_IO_URING_NET_SIZE	(64)
+
 static const stress_help_t help[] = {
 	{ NULL,	"io-uring N",		"start N workers that issue io-uring I/O requests" },
 	{ NULL, "io-uring-entries N",	"specify number if io-uring ring entries" },
+	{ NULL,	"io-uring-net N",	"run loopback echo over N io-uring driven connections" },
+	{ NULL,	"io-uring-net-port P",	"use socket port P upwards for io-uring-net mode" },
+	{ NULL,	"io-uring-net-size N",	"specify io-uring-net message size in bytes" },
 	{ NULL,	"io-uring-ops N",	"stop after N bogo io-uring I/O requests" },
 	{ NULL,	NULL,			NULL }
 };
@@ -54,8 +75,39 @@ static int stress_set_io_uring_entries(const char *opt)
         return stress_set_setting("io-uring-entries", TYPE_ID_UINT32, &io_uring_entries);
 }
 
+static int stress_set_io_uring_net(const char *opt)
+{
+	size_t io_uring_net;
+
+	io_uring_net = (size_t)stress_get_uint64(opt);
+	stress_check_range("io-uring-net", (uint64_t)io_uring_net, 0, MAX_IO_URING_NET);
+	return stress_set_setting("io-uring-net", TYPE_ID_SIZE_T, &io_uring_net);
+}
+
+static int stress_set_io_uring_net_port(const char *opt)
+{
+	int io_uring_net_port;
+
+	stress_set_net_port("io-uring-net-port", opt,
+		MIN_IO_URING_NET_PORT, MAX_IO_URING_NET_PORT, &io_uring_net_port);
+	return stress_set_setting("io-uring-net-port", TYPE_ID_INT, &io_uring_net_port);
+}
+
+static int stress_set_io_uring_net_size(const char *opt)
+{
+	size_t io_uring_net_size;
+
+	io_uring_net_size = (size_t)stress_get_uint64_byte(opt);
+	stress_check_range_bytes("io-uring-net-size", (uint64_t)io_uring_net_size,
+		MIN_IO_URING_NET_SIZE, MAX_IO_URING_NET_SIZE);
+	return stress_set_setting("io-uring-net-size", TYPE_ID_SIZE_T, &io_uring_net_size);
+}
+
 static const stress_opt_set_func_t opt_set_funcs[] = {
 	{ OPT_io_uring_entries,	stress_set_io_uring_entries },
+	{ OPT_io_uring_net,	stress_set_io_uring_net },
+	{ OPT_io_uring_net_port, stress_set_io_uring_net_port },
+	{ OPT_io_uring_net_size, stress_set_io_uring_net_size },
 	{ 0,			NULL },
 };
 
@@ -330,10 +382,10 @@ static void stress_close_io_uring(stress_io_uring_submit_t *submit)
 		submit->sqes_mmap = NULL;
 	}
 
-	if (submit->cq_mmap && (submit->cq_mmap != submit->sq_mmap)) {
+	/* cq_mmap may alias sq_mmap, clear it so a second close is a no-op */
+	if (submit->cq_mmap && (submit->cq_mmap != submit->sq_mmap))
 		(void)munmap(submit->cq_mmap, submit->cq_size);
-		submit->cq_mmap = NULL;
-	}
+	submit->cq_mmap = NULL;
 
 	if (submit->sq_mmap) {
 		(void)munmap(submit->sq_mmap, submit->sq_size);
@@ -1069,6 +1121,693 @@ static const char *stress_io_uring_opcode_name(const uint8_t opcode)
 	return "unknown";
 }
 
+#if defined(HAVE_IORING_OP_ACCEPT) &&	\
+    defined(HAVE_IORING_OP_RECV) &&	\
+    defined(HAVE_IORING_OP_SEND) &&	\
+    defined(IORING_ACCEPT_MULTISHOT) &&	\
+    defined(IORING_RECV_MULTISHOT) &&	\
+    defined(IORING_CQE_F_MORE) &&	\
+    defined(IORING_CQE_F_BUFFER) &&	\
+    defined(IOSQE_BUFFER_SELECT) &&	\
+    defined(IOSQE_IO_LINK) &&		\
+    defined(__NR_io_uring_register) &&	\
+    defined(MSG_WAITALL)
+#define STRESS_IO_URING_NET
+
+#define IO_URING_NET_OP_ACCEPT	(1)
+#define IO_URING_NET_OP_RECV	(2)
+#define IO_URING_NET_OP_SEND	(3)
+#define IO_URING_NET_OP_MASK	(0xff)
+#define IO_URING_NET_BGID	(1)
+
+/*
+ *  io-uring-net client connection state
+ */
+typedef struct {
+	int fd;			/* connection fd */
+	uint64_t seq;		/* request sequence number */
+	size_t rx_got;		/* response bytes received so far */
+	double t_sent;		/* time request was sent */
+	char *tx_buf;		/* request buffer */
+	char *rx_buf;		/* response buffer */
+} stress_io_uring_net_conn_t;
+
+/*
+ *  io-uring-net server provided buffer ring
+ */
+typedef struct {
+	struct io_uring_buf_ring *br;	/* provided buffer ring */
+	size_t br_size;			/* size of br mapping */
+	char *bufs;			/* buffer data */
+	size_t bufs_size;		/* size of bufs mapping */
+	size_t buf_size;		/* size of each buffer */
+	unsigned int entries;		/* number of buffers, power of 2 */
+	unsigned int tail;		/* local copy of ring tail */
+} stress_io_uring_net_bufs_t;
+
+/*
+ *  shim_io_uring_register
+ *	wrapper for io_uring_register()
+ */
+static inline int shim_io_uring_register(
+	int fd,
+	unsigned int opcode,
+	void *arg,
+	unsigned int nr_args)
+{
+	return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+/*
+ *  stress_io_uring_net_enter()
+ *	submit any sqes not yet consumed by the kernel and wait for
+ *	wait_nr completions. Only pass the number of pending sqes,
+ *	the kernel does not wait if to_submit is non-zero and there
+ *	is nothing to submit
+ */
+static inline int stress_io_uring_net_enter(
+	stress_io_uring_submit_t *submit,
+	const unsigned int wait_nr)
+{
+	const stress_uring_io_sq_ring_t *sring = &submit->sq_ring;
+	unsigned int to_submit;
+
+	stress_asm_mb();
+	to_submit = *sring->tail - *sring->head;
+	return shim_io_uring_enter(submit->io_uring_fd, to_submit,
+		wait_nr, wait_nr ? IORING_ENTER_GETEVENTS : 0);
+}
+
+/*
+ *  stress_io_uring_net_get_sqe()
+ *	get next free zero'd sqe, submitting pending sqes if
+ *	the submission ring has less than need free entries
+ */
+static struct io_uring_sqe *stress_io_uring_net_get_sqe(
+	stress_io_uring_submit_t *submit,
+	const unsigned int need)
+{
+	stress_uring_io_sq_ring_t *sring = &submit->sq_ring;
+	struct io_uring_sqe *sqe;
+	unsigned int tail, index;
+
+	stress_asm_mb();
+	while ((*sring->tail - *sring->head) + need > *sring->ring_entries) {
+		if (stress_io_uring_net_enter(submit, 0) < 0) {
+			if ((errno != EINTR) && (errno != EBUSY) && (errno != EAGAIN))
+				return NULL;
+		}
+		stress_asm_mb();
+	}
+	tail = *sring->tail;
+	index = tail & *sring->ring_mask;
+	sqe = &submit->sqes_mmap[index];
+	(void)shim_memset(sqe, 0, sizeof(*sqe));
+	sring->array[index] = index;
+	return sqe;
+}
+
+/*
+ *  stress_io_uring_net_commit_sqe()
+ *	make the sqe filled in by the caller visible to the kernel
+ */
+static inline void stress_io_uring_net_commit_sqe(stress_io_uring_submit_t *submit)
+{
+	stress_asm_mb();
+	(*submit->sq_ring.tail)++;
+	stress_asm_mb();
+}
+
+/*
+ *  stress_io_uring_net_prep()
+ *	prepare and commit a socket sqe
+ */
+static int stress_io_uring_net_prep(
+	stress_io_uring_submit_t *submit,
+	const uint8_t opcode,
+	const int fd,
+	void *addr,
+	const size_t len,
+	const uint8_t flags,
+	const uint16_t ioprio,
+	const uint64_t user_data)
+{
+	struct io_uring_sqe *sqe;
+
+	sqe = stress_io_uring_net_get_sqe(submit, (flags & IOSQE_IO_LINK) ? 2 : 1);
+	if (UNLIKELY(!sqe))
+		return -1;
+	sqe->opcode = opcode;
+	sqe->fd = fd;
+	sqe->addr = (uint64_t)(uintptr_t)addr;
+	sqe->len = (uint32_t)len;
+	sqe->flags = flags;
+	sqe->ioprio = ioprio;
+	sqe->user_data = user_data;
+	if (opcode != IORING_OP_ACCEPT)
+		sqe->msg_flags = (flags & IOSQE_BUFFER_SELECT) ? 0 : MSG_WAITALL;
+	if (flags & IOSQE_BUFFER_SELECT)
+		sqe->buf_group = IO_URING_NET_BGID;
+	stress_io_uring_net_commit_sqe(submit);
+	return 0;
+}
+
+/*
+ *  stress_io_uring_net_buf_add()
+ *	hand buffer bid back to the kernel provided buffer ring
+ */
+static inline void stress_io_uring_net_buf_add(
+	stress_io_uring_net_bufs_t *bufs,
+	const unsigned int bid)
+{
+	struct io_uring_buf *buf = &bufs->br->bufs[bufs->tail & (bufs->entries - 1)];
+
+	buf->addr = (uint64_t)(uintptr_t)(bufs->bufs + ((size_t)bid * bufs->buf_size));
+	buf->len = (uint32_t)bufs->buf_size;
+	buf->bid = (uint16_t)bid;
+	bufs->tail++;
+	stress_asm_mb();
+	bufs->br->tail = (uint16_t)bufs->tail;
+}
+
+/*
+ *  stress_io_uring_net_bufs_free()
+ *	unregister and free provided buffer ring
+ */
+static void stress_io_uring_net_bufs_free(
+	stress_io_uring_submit_t *submit,
+	stress_io_uring_net_bufs_t *bufs)
+{
+	if (bufs->br && (bufs->br != MAP_FAILED)) {
+		struct io_uring_buf_reg reg;
+
+		(void)shim_memset(&reg, 0, sizeof(reg));
+		reg.bgid = IO_URING_NET_BGID;
+		(void)shim_io_uring_register(submit->io_uring_fd,
+			IORING_UNREGISTER_PBUF_RING, &reg, 1);
+		(void)munmap((void *)bufs->br, bufs->br_size);
+	}
+	if (bufs->bufs && (bufs->bufs != MAP_FAILED))
+		(void)munmap((void *)bufs->bufs, bufs->bufs_size);
+	bufs->br = NULL;
+	bufs->bufs = NULL;
+}
+
+/*
+ *  stress_io_uring_net_bufs_alloc()
+ *	allocate and register a provided buffer ring of entries
+ *	buffers, returns -1 and errno set on failure
+ */
+static int stress_io_uring_net_bufs_alloc(
+	stress_io_uring_submit_t *submit,
+	stress_io_uring_net_bufs_t *bufs,
+	const unsigned int entries,
+	const size_t buf_size)
+{
+	struct io_uring_buf_reg reg;
+	unsigned int i;
+
+	(void)shim_memset(bufs, 0, sizeof(*bufs));
+	bufs->entries = entries;
+	bufs->buf_size = buf_size;
+	bufs->br_size = entries * sizeof(struct io_uring_buf);
+	bufs->bufs_size = entries * buf_size;
+	bufs->br = (struct io_uring_buf_ring *)stress_mmap_populate(NULL, bufs->br_size,
+		PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+	bufs->bufs = (char *)stress_mmap_populate(NULL, bufs->bufs_size,
+		PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+	if ((bufs->br == MAP_FAILED) || (bufs->bufs == MAP_FAILED)) {
+		const int saved_errno = errno;
+
+		stress_io_uring_net_bufs_free(submit, bufs);
+		errno = saved_errno;
+		return -1;
+	}
+
+	(void)shim_memset(&reg, 0, sizeof(reg));
+	reg.ring_addr = (uint64_t)(uintptr_t)bufs->br;
+	reg.ring_entries = entries;
+	reg.bgid = IO_URING_NET_BGID;
+	if (shim_io_uring_register(submit->io_uring_fd,
+			IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+		const int saved_errno = errno;
+
+		(void)munmap((void *)bufs->br, bufs->br_size);
+		bufs->br = NULL;
+		stress_io_uring_net_bufs_free(submit, bufs);
+		errno = saved_errno;
+		return -1;
+	}
+	for (i = 0; i < entries; i++)
+		stress_io_uring_net_buf_add(bufs, i);
+	return 0;
+}
+
+/*
+ *  stress_io_uring_net_server()
+ *	echo server, multishot accept on the listening socket,
+ *	multishot recv into provided buffers on each connection
+ *	and send each buffer back, recycling it on send completion
+ */
+static void NORETURN stress_io_uring_net_server(
+	stress_args_t *args,
+	const int lfd,
+	const uint32_t io_uring_entries,
+	const size_t io_uring_net,
+	const size_t io_uring_net_size)
+{
+	stress_io_uring_submit_t submit;
+	stress_io_uring_net_bufs_t bufs;
+	stress_uring_io_cq_ring_t *cring = &submit.cq_ring;
+	unsigned int entries = 64;
+	int rc = EXIT_SUCCESS;
+
+	(void)shim_memset(&submit, 0, sizeof(submit));
+	(void)shim_memset(&bufs, 0, sizeof(bufs));
+
+	/* enough buffers for 2 in-flight messages per connection */
+	while (entries < (2 * io_uring_net))
+		entries <<= 1;
+
+	if (stress_setup_io_uring(args, io_uring_entries, &submit) != EXIT_SUCCESS)
+		_exit(EXIT_NO_RESOURCE);
+	if (stress_io_uring_net_bufs_alloc(&submit, &bufs, entries, io_uring_net_size) < 0) {
+		pr_fail("%s: server cannot register provided buffer ring, errno=%d (%s)\n",
+			args->name, errno, strerror(errno));
+		rc = EXIT_FAILURE;
+		goto close_ring;
+	}
+	if (stress_io_uring_net_prep(&submit, IORING_OP_ACCEPT, lfd, NULL, 0, 0,
+			IORING_ACCEPT_MULTISHOT, IO_URING_NET_OP_ACCEPT) < 0) {
+		rc = EXIT_FAILURE;
+		goto free_bufs;
+	}
+
+	while (stress_continue_flag()) {
+		unsigned int head;
+
+		if (UNLIKELY(stress_io_uring_net_enter(&submit, 1) < 0)) {
+			if ((errno == EINTR) || (errno == EBUSY) || (errno == EAGAIN))
+				continue;
+			pr_fail("%s: server io_uring_enter failed, errno=%d (%s)\n",
+				args->name, errno, strerror(errno));
+			rc = EXIT_FAILURE;
+			break;
+		}
+
+		head = *cring->head;
+		for (;;) {
+			const struct io_uring_cqe *cqe;
+			uint64_t user_data;
+			uint32_t flags;
+			int res, fd;
+
+			stress_asm_mb();
+			if (head == *cring->tail)
+				break;
+			cqe = &cring->cqes[head & *cring->ring_mask];
+			user_data = cqe->user_data;
+			res = cqe->res;
+			flags = cqe->flags;
+			head++;
+
+			switch (user_data & IO_URING_NET_OP_MASK) {
+			case IO_URING_NET_OP_ACCEPT:
+				if (res >= 0) {
+#if defined(TCP_NODELAY)
+					int one = 1;
+
+					(void)setsockopt(res, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+#endif
+					(void)stress_io_uring_net_prep(&submit, IORING_OP_RECV, res,
+						NULL, 0, IOSQE_BUFFER_SELECT, IORING_RECV_MULTISHOT,
+						((uint64_t)res << 8) | IO_URING_NET_OP_RECV);
+				}
+				if (!(flags & IORING_CQE_F_MORE))
+					(void)stress_io_uring_net_prep(&submit, IORING_OP_ACCEPT, lfd,
+						NULL, 0, 0, IORING_ACCEPT_MULTISHOT, IO_URING_NET_OP_ACCEPT);
+				break;
+			case IO_URING_NET_OP_RECV:
+				fd = (int)((user_data >> 8) & 0xffffffff);
+				if ((res > 0) && (flags & IORING_CQE_F_BUFFER)) {
+					const unsigned int bid = flags >> IORING_CQE_BUFFER_SHIFT;
+
+					(void)stress_io_uring_net_prep(&submit, IORING_OP_SEND, fd,
+						bufs.bufs + ((size_t)bid * bufs.buf_size), (size_t)res,
+						0, 0, ((uint64_t)bid << 40) | ((uint64_t)fd << 8) |
+						IO_URING_NET_OP_SEND);
+				} else if ((res == 0) || ((res < 0) && (res != -ENOBUFS))) {
+					(void)close(fd);
+					break;
+				}
+				/* multishot terminated, e.g. out of buffers, so re-arm */
+				if (!(flags & IORING_CQE_F_MORE))
+					(void)stress_io_uring_net_prep(&submit, IORING_OP_RECV, fd,
+						NULL, 0, IOSQE_BUFFER_SELECT, IORING_RECV_MULTISHOT,
+						user_data);
+				break;
+			case IO_URING_NET_OP_SEND:
+				stress_io_uring_net_buf_add(&bufs, (unsigned int)(user_data >> 40));
+				break;
+			default:
+				break;
+			}
+		}
+		*cring->head = head;
+		stress_asm_mb();
+	}
+
+free_bufs:
+	stress_io_uring_net_bufs_free(&submit, &bufs);
+close_ring:
+	stress_close_io_uring(&submit);
+	_exit(rc);
+}
+
+/*
+ *  stress_io_uring_net_request()
+ *	submit a request send linked to its response recv
+ */
+static int stress_io_uring_net_request(
+	stress_io_uring_submit_t *submit,
+	stress_io_uring_net_conn_t *conn,
+	const size_t idx,
+	const size_t io_uring_net_size)
+{
+	(void)shim_memcpy(conn->tx_buf, &conn->seq, sizeof(conn->seq));
+	conn->rx_got = 0;
+	conn->t_sent = stress_time_now();
+	if (UNLIKELY(stress_io_uring_net_prep(submit, IORING_OP_SEND, conn->fd,
+			conn->tx_buf, io_uring_net_size, IOSQE_IO_LINK, 0,
+			((uint64_t)idx << 8) | IO_URING_NET_OP_SEND) < 0))
+		return -1;
+	return stress_io_uring_net_prep(submit, IORING_OP_RECV, conn->fd,
+			conn->rx_buf, io_uring_net_size, 0, 0,
+			((uint64_t)idx << 8) | IO_URING_NET_OP_RECV);
+}
+
+/*
+ *  stress_io_uring_net()
+ *	loopback echo over io-uring, the parent is the client that
+ *	drives io_uring_net connections with a linked send+recv per
+ *	request and measures the round trip, a child process is the
+ *	multishot accept/recv echo server
+ */
+static int stress_io_uring_net(
+	stress_args_t *args,
+	const uint32_t io_uring_entries,
+	const size_t io_uring_net)
+{
+	stress_io_uring_submit_t submit;
+	stress_io_uring_net_bufs_t probe;
+	stress_uring_io_cq_ring_t *cring = &submit.cq_ring;
+	stress_io_uring_net_conn_t *conns = NULL;
+	stress_latency_t lat;
+	struct sockaddr *addr = NULL;
+	socklen_t addr_len = 0;
+	struct rusage usage_start, usage_end, usage_child_start, usage_child_end;
+	const pid_t mypid = getpid();
+	size_t io_uring_net_size = DEFAULT_IO_URING_NET_SIZE;
+	int io_uring_net_port = DEFAULT_IO_URING_NET_PORT;
+	size_t i, bufs_size = 0;
+	char *bufs = MAP_FAILED;
+	uint64_t messages = 0;
+	double t_start = 0.0, duration, client_cpu, server_cpu;
+	int lfd, port, reserved_port, so_reuseaddr = 1, rc;
+	pid_t pid = -1;
+
+	(void)stress_get_setting("io-uring-net-port", &io_uring_net_port);
+	(void)stress_get_setting("io-uring-net-size", &io_uring_net_size);
+
+	if (io_uring_net_size < sizeof(uint64_t))
+		io_uring_net_size = sizeof(uint64_t);
+
+	port = io_uring_net_port + (int)args->instance;
+	reserved_port = stress_net_reserve_ports(port, port);
+	if (reserved_port < 0) {
+		pr_inf_skip("%s: cannot reserve port %d, skipping stressor\n",
+			args->name, port);
+		return EXIT_NO_RESOURCE;
+	}
+	port = reserved_port;
+
+	(void)shim_memset(&submit, 0, sizeof(submit));
+	rc = stress_setup_io_uring(args, io_uring_entries, &submit);
+	if (rc != EXIT_SUCCESS)
+		goto release_ports;
+
+	/* check multishot and provided buffer ring support up front */
+	if (stress_io_uring_net_bufs_alloc(&submit, &probe, 1, io_uring_net_size) < 0) {
+		if (args->instance == 0)
+			pr_inf_skip("%s: io-uring provided buffer rings not supported, "
+				"errno=%d (%s), skipping stressor\n",
+				args->name, errno, strerror(errno));
+		rc = EXIT_NOT_IMPLEMENTED;
+		goto close_ring;
+	}
+	stress_io_uring_net_bufs_free(&submit, &probe);
+
+	lfd = socket(AF_INET, SOCK_STREAM, 0);
+	if (lfd < 0) {
+		pr_fail("%s: socket failed, errno=%d (%s)\n",
+			args->name, errno, strerror(errno));
+		rc = EXIT_FAILURE;
+		goto close_ring;
+	}
+	if (setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &so_reuseaddr, sizeof(so_reuseaddr)) < 0) {
+		pr_fail("%s: setsockopt SO_REUSEADDR failed, errno=%d (%s)\n",
+			args->name, errno, strerror(errno));
+		rc = EXIT_FAILURE;
+		goto close_lfd;
+	}
+	if (stress_set_sockaddr(args->name, args->instance, mypid, AF_INET, port,
+			&addr, &addr_len, NET_ADDR_LOOPBACK) < 0) {
+		rc = EXIT_FAILURE;
+		goto close_lfd;
+	}
+	if ((bind(lfd, addr, addr_len) < 0) || (listen(lfd, SOMAXCONN) < 0)) {
+		pr_fail("%s: bind/listen on port %d failed, errno=%d (%s)\n",
+			args->name, port, errno, strerror(errno));
+		rc = EXIT_FAILURE;
+		goto close_lfd;
+	}
+
+again:
+	pid = fork();
+	if (pid < 0) {
+		if (stress_redo_fork(args, errno))
+			goto again;
+		pr_inf_skip("%s: fork failed, errno=%d (%s), skipping stressor\n",
+			args->name, errno, strerror(errno));
+		rc = EXIT_NO_RESOURCE;
+		goto close_lfd;
+	} else if (pid == 0) {
+		stress_parent_died_alarm();
+		(void)sched_settings_apply(true);
+		stress_close_io_uring(&submit);
+		stress_io_uring_net_server(args, lfd, io_uring_entries,
+			io_uring_net, io_uring_net_size);
+	}
+	(void)close(lfd);
+	lfd = -1;
+
+	stress_latency_init(&lat);
+	conns = (stress_io_uring_net_conn_t *)calloc(io_uring_net, sizeof(*conns));
+	bufs_size = 2 * io_uring_net * io_uring_net_size;
+	bufs = (char *)stress_mmap_populate(NULL, bufs_size,
+		PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+	if (!conns || (bufs == MAP_FAILED)) {
+		pr_inf_skip("%s: cannot allocate %zu connections, skipping stressor\n",
+			args->name, io_uring_net);
+		rc = EXIT_NO_RESOURCE;
+		goto free_conns;
+	}
+	for (i = 0; i < io_uring_net; i++) {
+		conns[i].fd = -1;
+		conns[i].tx_buf = bufs + (2 * i * io_uring_net_size);
+		conns[i].rx_buf = conns[i].tx_buf + io_uring_net_size;
+		stress_rndbuf(conns[i].tx_buf, io_uring_net_size);
+	}
+
+	for (i = 0; i < io_uring_net; i++) {
+		const int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+		if (fd < 0) {
+			pr_fail("%s: socket failed, errno=%d (%s)\n",
+				args->name, errno, strerror(errno));
+			rc = EXIT_FAILURE;
+			goto free_conns;
+		}
+		if (connect(fd, addr, addr_len) < 0) {
+			pr_fail("%s: connect failed, errno=%d (%s)\n",
+				args->name, errno, strerror(errno));
+			(void)close(fd);
+			rc = EXIT_FAILURE;
+			goto free_conns;
+		}
+#if defined(TCP_NODELAY)
+		{
+			int one = 1;
+
+			(void)setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+		}
+#endif
+		conns[i].fd = fd;
+	}
+
+	(void)shim_getrusage(RUSAGE_SELF, &usage_start);
+	(void)shim_getrusage(RUSAGE_CHILDREN, &usage_child_start);
+	t_start = stress_time_now();
+	for (i = 0; i < io_uring_net; i++) {
+		if (stress_io_uring_net_request(&submit, &conns[i], i, io_uring_net_size) < 0) {
+			pr_fail("%s: cannot submit request, errno=%d (%s)\n",
+				args->name, errno, strerror(errno));
+			rc = EXIT_FAILURE;
+			goto report;
+		}
+	}
+
+	rc = EXIT_SUCCESS;
+	while (stress_continue(args)) {
+		unsigned int head;
+
+		if (UNLIKELY(stress_io_uring_net_enter(&submit, 1) < 0)) {
+			if ((errno == EINTR) || (errno == EBUSY) || (errno == EAGAIN))
+				continue;
+			pr_fail("%s: io_uring_enter failed, errno=%d (%s)\n",
+				args->name, errno, strerror(errno));
+			rc = EXIT_FAILURE;
+			break;
+		}
+
+		head = *cring->head;
+		for (;;) {
+			const struct io_uring_cqe *cqe;
+			stress_io_uring_net_conn_t *conn;
+			uint64_t user_data, seq;
+			int res;
+
+			stress_asm_mb();
+			if (head == *cring->tail)
+				break;
+			cqe = &cring->cqes[head & *cring->ring_mask];
+			user_data = cqe->user_data;
+			res = cqe->res;
+			head++;
+
+			i = (size_t)(user_data >> 8);
+			if (UNLIKELY(i >= io_uring_net))
+				continue;
+			conn = &conns[i];
+
+			if ((user_data & IO_URING_NET_OP_MASK) == IO_URING_NET_OP_SEND) {
+				if (UNLIKELY(res < 0)) {
+					pr_fail("%s: send completion failed, errno=%d (%s)\n",
+						args->name, -res, strerror(-res));
+					rc = EXIT_FAILURE;
+				}
+				continue;
+			}
+			if (UNLIKELY(res <= 0)) {
+				if ((res == -ECANCELED) || (res == -EINTR))
+					continue;
+				pr_fail("%s: recv completion failed, errno=%d (%s)\n",
+					args->name, -res, strerror(-res));
+				rc = EXIT_FAILURE;
+				continue;
+			}
+			conn->rx_got += (size_t)res;
+			if (conn->rx_got < io_uring_net_size) {
+				/* short read, fetch the remainder */
+				(void)stress_io_uring_net_prep(&submit, IORING_OP_RECV, conn->fd,
+					conn->rx_buf + conn->rx_got, io_uring_net_size - conn->rx_got,
+					0, 0, user_data);
+				continue;
+			}
+			stress_latency_add(&lat, (uint64_t)((stress_time_now() - conn->t_sent) *
+				STRESS_DBL_NANOSECOND));
+			(void)shim_memcpy(&seq, conn->rx_buf, sizeof(seq));
+			if (UNLIKELY((seq != conn->seq) ||
+				     shim_memcmp(conn->rx_buf, conn->tx_buf, io_uring_net_size))) {
+				pr_fail("%s: echo response mismatch on connection %zu, "
+					"sequence %" PRIu64 ", expected %" PRIu64 "\n",
+					args->name, i, seq, conn->seq);
+				rc = EXIT_FAILURE;
+			}
+			conn->seq++;
+			messages++;
+			stress_bogo_inc(args);
+			if (UNLIKELY(stress_io_uring_net_request(&submit, conn, i, io_uring_net_size) < 0)) {
+				pr_fail("%s: cannot submit request, errno=%d (%s)\n",
+					args->name, errno, strerror(errno));
+				rc = EXIT_FAILURE;
+			}
+		}
+		*cring->head = head;
+		stress_asm_mb();
+		if (UNLIKELY(rc != EXIT_SUCCESS))
+			break;
+	}
+
+report:
+	duration = stress_time_now() - t_start;
+	(void)shim_getrusage(RUSAGE_SELF, &usage_end);
+	(void)stress_kill_pid_wait(pid, NULL);
+	pid = -1;
+	(void)shim_getrusage(RUSAGE_CHILDREN, &usage_child_end);
+
+	client_cpu = stress_timeval_to_double(&usage_end.ru_utime) +
+		     stress_timeval_to_double(&usage_end.ru_stime) -
+		     stress_timeval_to_double(&usage_start.ru_utime) -
+		     stress_timeval_to_double(&usage_start.ru_stime);
+	server_cpu = stress_timeval_to_double(&usage_child_end.ru_utime) +
+		     stress_timeval_to_double(&usage_child_end.ru_stime) -
+		     stress_timeval_to_double(&usage_child_start.ru_utime) -
+		     stress_timeval_to_double(&usage_child_start.ru_stime);
+
+	stress_metrics_set(args, 0, "messages per sec",
+		(duration > 0.0) ? (double)messages / duration : 0.0,
+		STRESS_HARMONIC_MEAN);
+	stress_metrics_set(args, 1, "CPU usecs per message",
+		messages ? STRESS_DBL_MICROSECOND * (client_cpu + server_cpu) / (double)messages : 0.0,
+		STRESS_GEOMETRIC_MEAN);
+	(void)stress_latency_metrics_set(args, 2, "round trip", &lat);
+	if (args->instance == 0) {
+		pr_inf("%s: io-uring-net %zu connection%s, %zu byte messages, "
+			"%.2f messages per sec\n", args->name,
+			io_uring_net, io_uring_net == 1 ? "" : "s", io_uring_net_size,
+			(duration > 0.0) ? (double)messages / duration : 0.0);
+		if (messages)
+			pr_inf("%s: CPU per message: client %.3f usecs, server %.3f usecs\n",
+				args->name,
+				STRESS_DBL_MICROSECOND * client_cpu / (double)messages,
+				STRESS_DBL_MICROSECOND * server_cpu / (double)messages);
+		stress_latency_report(args, "round trip", &lat);
+	}
+
+free_conns:
+	if (conns) {
+		for (i = 0; i < io_uring_net; i++) {
+			if (conns[i].fd >= 0)
+				(void)close(conns[i].fd);
+		}
+	}
+	if (bufs != MAP_FAILED)
+		(void)munmap((void *)bufs, bufs_size);
+	free(conns);
+	if (pid > 0)
+		(void)stress_kill_pid_wait(pid, NULL);
+close_lfd:
+	if (lfd >= 0)
+		(void)close(lfd);
+close_ring:
+	stress_close_io_uring(&submit);
+release_ports:
+	stress_net_release_ports(port, port);
+	return rc;
+}
+#endif
+
 /*
  *  stress_io_uring
  *	stress asynchronous I/O
@@ -1087,6 +1826,7 @@ static int stress_io_uring_child(stress_args_t *args, void *context)
 	uint32_t io_uring_entries;
 	stress_io_uring_user_data_t user_data[SIZEOF_ARRAY(stress_io_uring_setups)];
 	const int32_t cpus = stress_get_processors_online();
+	size_t io_uring_net = 0;
 
 	(void)context;
 
@@ -1101,6 +1841,20 @@ static int stress_io_uring_child(stress_args_t *args, void *context)
 		io_uring_entries = 14;
 
 	(void)stress_get_setting("io-uring-entries", &io_uring_entries);
+	(void)stress_get_setting("io-uring-net", &io_uring_net);
+
+	if (io_uring_net > 0) {
+#if defined(STRESS_IO_URING_NET)
+		stress_set_proc_state(args->name, STRESS_STATE_RUN);
+		return stress_io_uring_net(args, (io_uring_entries < 256) ? 256 : io_uring_entries,
+			io_uring_net);
+#else
+		if (args->instance == 0)
+			pr_inf_skip("%s: io-uring-net requires multishot accept/recv "
+				"and provided buffer ring support, skipping stressor\n", args->name);
+		return EXIT_NOT_IMPLEMENTED;
+#endif
+	}
 
 	(void)shim_memset(&submit, 0, sizeof(submit));
 	(void)shim_memset(&io_uring_file, 0, sizeof(io_uring_file));
@@ -20,6 +20,7 @@
 #include "stress-ng.h"
 #include "core-builtin.h"
 #include "core-killpid.h"
+#include "core-pthread.h"
 #include "core-put.h"
 
 #if defined(HAVE_LINUX_FS_H)
@@ -33,12 +34,23 @@
 #define MAX_IOMIX_BYTES		(MAX_FILE_LIMIT)
 #define DEFAULT_IOMIX_BYTES	(1 * GB)
 
+#define MIN_IOMIX_THREADS	(0)
+#define MAX_IOMIX_THREADS	(64)
+#define DEFAULT_IOMIX_THREADS	(0)
+
+#define IOMIX_THREAD_IO_SIZE	(4 * KB)
+#define IOMIX_THREAD_ROUND	(0.25)	/* seconds per thread count round */
+#define IOMIX_THREAD_LEVELS	(8)	/* 1, 2, 4 .. 64 threads */
+
 typedef void (*stress_iomix_func)(stress_args_t *args, const int fd, const char *fs_type, const off_t iomix_bytes);
 
 static const stress_help_t help[] = {
 	{ NULL,	"iomix N",	 "start N workers that have a mix of I/O operations" },
 	{ NULL,	"iomix-bytes N", "write N bytes per iomix worker (default is 1GB)" },
+	{ NULL,	"iomix-lock",	 "use OFD range locks in threaded shared file mode" },
 	{ NULL,	"iomix-ops N",	 "stop iomix workers after N iomix bogo operations" },
+	{ NULL,	"iomix-overlap", "use overlapping ranges in threaded shared file mode" },
+	{ NULL,	"iomix-threads N", "N threads doing pread/pwrite on a shared file" },
 	{ NULL, NULL,		 NULL }
 };
 
@@ -54,6 +66,26 @@ static int stress_set_iomix_bytes(const char *opt)
 	return stress_set_setting("iomix-bytes", TYPE_ID_OFF_T, &iomix_bytes);
 }
 
+static int stress_set_iomix_threads(const char *opt)
+{
+	size_t iomix_threads;
+
+	iomix_threads = (size_t)stress_get_uint64(opt);
+	stress_check_range("iomix-threads", (uint64_t)iomix_threads,
+		MIN_IOMIX_THREADS, MAX_IOMIX_THREADS);
+	return stress_set_setting("iomix-threads", TYPE_ID_SIZE_T, &iomix_threads);
+}
+
+static int stress_set_iomix_overlap(const char *opt)
+{
+	return stress_set_setting_true("iomix-overlap", opt);
+}
+
+static int stress_set_iomix_lock(const char *opt)
+{
+	return stress_set_setting_true("iomix-lock", opt);
+}
+
 /*
  *  stress_iomix_rnd_offset()
  *	generate a random offset between 0..max-1
@@ -1042,6 +1074,246 @@ static stress_iomix_func iomix_funcs[] = {
 #endif
 };
 
+#if defined(HAVE_LIB_PTHREAD)
+typedef struct {
+	stress_args_t *args;		/* stressor args */
+	const char *fs_type;		/* file system type */
+	int fd;				/* per thread open file description */
+	off_t start;			/* start of file range */
+	off_t blocks;			/* number of I/O blocks in range */
+	bool lock;			/* true to use OFD range locks */
+	uint8_t *buf;			/* I/O buffer */
+	double t_end;			/* end time of the round */
+	pthread_t pthread;		/* thread handle */
+	int ret;			/* pthread_create return */
+	bool failed;			/* true if I/O failed */
+	uint64_t ops;			/* I/O ops in the round */
+	double bytes;			/* bytes transferred in the round */
+} stress_iomix_thread_t;
+
+typedef struct {
+	size_t threads;			/* number of active threads */
+	double bytes;			/* total bytes transferred */
+	double duration;		/* total run time */
+	double min_rate;		/* slowest thread rate */
+	double max_rate;		/* fastest thread rate */
+} stress_iomix_level_t;
+
+/*
+ *  stress_iomix_thread_lock()
+ *	apply or release an OFD range lock
+ */
+static int stress_iomix_thread_lock(
+	const int fd,
+	const short int type,
+	const off_t offset,
+	const off_t len)
+{
+#if defined(F_OFD_SETLKW)
+	struct flock f;
+
+	(void)shim_memset(&f, 0, sizeof(f));
+	f.l_type = type;
+	f.l_whence = SEEK_SET;
+	f.l_start = offset;
+	f.l_len = len;
+	f.l_pid = 0;
+
+	return fcntl(fd, F_OFD_SETLKW, &f);
+#else
+	(void)fd;
+	(void)type;
+	(void)offset;
+	(void)len;
+
+	return 0;
+#endif
+}
+
+/*
+ *  stress_iomix_thread()
+ *	random 4K pread/pwrite to the thread's range of the
+ *	shared file until the end of the round
+ */
+static void *stress_iomix_thread(void *arg)
+{
+	static void *nowt = NULL;
+	stress_iomix_thread_t *t = (stress_iomix_thread_t *)arg;
+	stress_args_t *args = t->args;
+
+	while (stress_continue_flag() && (stress_time_now() < t->t_end)) {
+		const off_t offset = t->start +
+			(stress_iomix_rnd_offset(t->blocks) * (off_t)IOMIX_THREAD_IO_SIZE);
+		const bool wr = (bool)stress_mwc1();
+		ssize_t ret;
+
+		if (t->lock && (stress_iomix_thread_lock(t->fd,
+				wr ? F_WRLCK : F_RDLCK, offset, IOMIX_THREAD_IO_SIZE) < 0)) {
+			if (errno == EINTR)
+				continue;
+			/* locking not supported, carry on without locks */
+			t->lock = false;
+		}
+		if (wr)
+			ret = pwrite(t->fd, t->buf, IOMIX_THREAD_IO_SIZE, offset);
+		else
+			ret = pread(t->fd, t->buf, IOMIX_THREAD_IO_SIZE, offset);
+		if (t->lock)
+			(void)stress_iomix_thread_lock(t->fd, F_UNLCK, offset, IOMIX_THREAD_IO_SIZE);
+
+		if (UNLIKELY(ret < 0)) {
+			if ((errno == EINTR) || (errno == ENOSPC))
+				continue;
+			pr_fail("%s: %s at offset %jd failed, errno=%d (%s)%s\n",
+				args->name, wr ? "pwrite" : "pread", (intmax_t)offset,
+				errno, strerror(errno), t->fs_type);
+			t->failed = true;
+			break;
+		}
+		t->ops++;
+		t->bytes += (double)ret;
+	}
+	return &nowt;
+}
+
+/*
+ *  stress_iomix_threads()
+ *	shared file mode, rounds of 1, 2, 4 .. N threads doing
+ *	concurrent pread/pwrite to disjoint or overlapping ranges
+ *	of the same file to measure how throughput scales with
+ *	the number of threads
+ */
+static int stress_iomix_threads(
+	stress_args_t *args,
+	const int *fds,
+	const size_t nthreads,
+	const char *fs_type,
+	const off_t iomix_bytes,
+	const bool overlap,
+	const bool lock)
+{
+	stress_iomix_thread_t threads[MAX_IOMIX_THREADS];
+	stress_iomix_level_t levels[IOMIX_THREAD_LEVELS];
+	const size_t buf_size = nthreads * IOMIX_THREAD_IO_SIZE;
+	const off_t blocks = iomix_bytes / (off_t)IOMIX_THREAD_IO_SIZE;
+	off_t range;
+	size_t i, n, nlevels = 0;
+	uint8_t *buf;
+	int rc = EXIT_SUCCESS;
+
+	range = overlap ? blocks : blocks / (off_t)nthreads;
+	if (range < 1)
+		range = 1;
+
+	buf = (uint8_t *)stress_mmap_populate(NULL, buf_size,
+		PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+	if (buf == MAP_FAILED) {
+		pr_inf_skip("%s: cannot mmap %zd byte I/O buffers, skipping stressor\n",
+			args->name, buf_size);
+		return EXIT_NO_RESOURCE;
+	}
+	stress_rndbuf(buf, buf_size);
+
+	(void)shim_memset(levels, 0, sizeof(levels));
+	for (n = 1; nlevels < IOMIX_THREAD_LEVELS; n <<= 1) {
+		if (n > nthreads)
+			n = nthreads;
+		levels[nlevels++].threads = n;
+		if (n == nthreads)
+			break;
+	}
+
+	(void)shim_memset(threads, 0, sizeof(threads));
+	for (i = 0; i < nthreads; i++) {
+		threads[i].args = args;
+		threads[i].fs_type = fs_type;
+		threads[i].fd = fds[i];
+		threads[i].start = overlap ? 0 : (off_t)i * range * (off_t)IOMIX_THREAD_IO_SIZE;
+		threads[i].blocks = range;
+		threads[i].buf = buf + (i * IOMIX_THREAD_IO_SIZE);
+	}
+
+	do {
+		for (n = 0; (n < nlevels) && stress_continue(args); n++) {
+			stress_iomix_level_t *level = &levels[n];
+			const double t_start = stress_time_now();
+			uint64_t ops = 0;
+			double duration;
+
+			for (i = 0; i < level->threads; i++) {
+				threads[i].lock = lock;
+				threads[i].t_end = t_start + IOMIX_THREAD_ROUND;
+				threads[i].ops = 0;
+				threads[i].bytes = 0.0;
+				threads[i].ret = pthread_create(&threads[i].pthread, NULL,
+					stress_iomix_thread, (void *)&threads[i]);
+			}
+			for (i = 0; i < level->threads; i++) {
+				if (threads[i].ret == 0)
+					(void)pthread_join(threads[i].pthread, NULL);
+			}
+			duration = stress_time_now() - t_start;
+			if (duration <= 0.0)
+				continue;
+
+			for (i = 0; i < level->threads; i++) {
+				const double rate = threads[i].bytes / duration;
+
+				if (threads[i].ret)
+					continue;
+				if (threads[i].failed)
+					rc = EXIT_FAILURE;
+				if ((level->min_rate == 0.0) || (rate < level->min_rate))
+					level->min_rate = rate;
+				if (rate > level->max_rate)
+					level->max_rate = rate;
+				level->bytes += threads[i].bytes;
+				ops += threads[i].ops;
+			}
+			level->duration += duration;
+			stress_bogo_add(args, ops);
+			if (rc != EXIT_SUCCESS)
+				goto done;
+		}
+	} while (stress_continue(args));
+
+done:
+	for (i = 0, n = 0; n < nlevels; n++) {
+		const stress_iomix_level_t *level = &levels[n];
+		const double base = (levels[0].duration > 0.0) ?
+			levels[0].bytes / levels[0].duration : 0.0;
+		double rate, scaling;
+		char str[64];
+
+		if (level->duration <= 0.0)
+			continue;
+		rate = level->bytes / level->duration;
+		scaling = (base > 0.0) ? rate / (base * (double)level->threads) : 0.0;
+
+		(void)snprintf(str, sizeof(str), "MB per sec (%zd threads)", level->threads);
+		stress_metrics_set(args, i++, str, rate / (double)MB, STRESS_HARMONIC_MEAN);
+		if (level->threads == nthreads) {
+			stress_metrics_set(args, i++, "% scaling efficiency at max threads",
+				scaling * 100.0, STRESS_GEOMETRIC_MEAN);
+		}
+		if (args->instance == 0) {
+			if (n == 0)
+				pr_inf("%s: %7s %12s %12s %12s %12s %9s\n", args->name,
+					"threads", "MB/sec", "MB/sec/thrd", "min thrd", "max thrd", "scaling");
+			pr_inf("%s: %7zd %12.2f %12.2f %12.2f %12.2f %8.1f%%\n", args->name,
+				level->threads, rate / (double)MB,
+				rate / (double)MB / (double)level->threads,
+				level->min_rate / (double)MB, level->max_rate / (double)MB,
+				scaling * 100.0);
+		}
+	}
+
+	(void)munmap((void *)buf, buf_size);
+
+	return rc;
+}
+#endif
+
 /*
  *  stress_iomix
  *	stress I/O via random mix of io ops
@@ -1057,6 +1329,10 @@ static int stress_iomix(stress_args_t *args)
 	const char *fs_type;
 	int oflags = O_CREAT | O_RDWR;
 	bool iomix_bytes_shrunk = false;
+	bool iomix_overlap = false;
+	bool iomix_lock = false;
+	size_t iomix_threads = DEFAULT_IOMIX_THREADS;
+	int thread_fds[MAX_IOMIX_THREADS];
 
 	if (stress_sigchld_set_handler(args) < 0)
 		return EXIT_NO_RESOURCE;
@@ -1083,6 +1359,24 @@ static int stress_iomix(stress_args_t *args)
 	if (iomix_bytes < (off_t)page_size)
 		iomix_bytes = (off_t)page_size;
 
+	(void)stress_get_setting("iomix-threads", &iomix_threads);
+	(void)stress_get_setting("iomix-overlap", &iomix_overlap);
+	(void)stress_get_setting("iomix-lock", &iomix_lock);
+#if !defined(HAVE_LIB_PTHREAD)
+	if ((iomix_threads > 0) && (args->instance == 0))
+		pr_inf("%s: pthreads not supported, ignoring --iomix-threads option\n",
+			args->name);
+	iomix_threads = 0;
+#endif
+#if !defined(F_OFD_SETLKW)
+	if (iomix_lock && (iomix_threads > 0) && (args->instance == 0))
+		pr_inf("%s: OFD locks not supported, ignoring --iomix-lock option\n",
+			args->name);
+	iomix_lock = false;
+#endif
+	for (i = 0; i < SIZEOF_ARRAY(thread_fds); i++)
+		thread_fds[i] = -1;
+
 	ret = stress_temp_dir_mk_args(args);
 	if (ret < 0) {
 		ret = stress_exit_status(-ret);
@@ -1098,6 +1392,23 @@ static int stress_iomix(stress_args_t *args)
 		goto lock_destroy;
 	}
 	fs_type = stress_get_fs_type(filename);
+
+	/*
+	 *  Each thread needs its own open file description,
+	 *  OFD locks do not conflict on the same description
+	 */
+	for (i = 0; i < iomix_threads; i++) {
+		thread_fds[i] = open(filename, O_RDWR);
+		if (thread_fds[i] < 0) {
+			const int err = errno;
+
+			ret = stress_exit_status(err);
+			pr_fail("%s: open %s failed, errno=%d (%s)\n",
+				args->name, filename, err, strerror(err));
+			(void)shim_unlink(filename);
+			goto tidy;
+		}
+	}
 	(void)shim_unlink(filename);
 
 	do {
@@ -1135,6 +1446,15 @@ static int stress_iomix(stress_args_t *args)
 
 	stress_file_rw_hint_short(fd);
 
+#if defined(HAVE_LIB_PTHREAD)
+	if (iomix_threads > 0) {
+		stress_set_proc_state(args->name, STRESS_STATE_RUN);
+		ret = stress_iomix_threads(args, thread_fds, iomix_threads,
+			fs_type, iomix_bytes, iomix_overlap, iomix_lock);
+		goto tidy;
+	}
+#endif
+
 	(void)shim_memset(pids, 0, sizeof(pids));
 
 	stress_set_proc_state(args->name, STRESS_STATE_RUN);
@@ -1160,6 +1480,10 @@ reap:
 	stress_kill_and_wait_many(args, pids, SIZEOF_ARRAY(iomix_funcs), SIGALRM, true);
 tidy:
 	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+	for (i = 0; i < SIZEOF_ARRAY(thread_fds); i++) {
+		if (thread_fds[i] >= 0)
+			(void)close(thread_fds[i]);
+	}
 	(void)close(fd);
 	(void)stress_temp_dir_rm_args(args);
 lock_destroy:
@@ -1171,6 +1495,9 @@ lock_destroy:
 
 static const stress_opt_set_func_t opt_set_funcs[] = {
 	{ OPT_iomix_bytes,	stress_set_iomix_bytes },
+	{ OPT_iomix_lock,	stress_set_iomix_lock },
+	{ OPT_iomix_overlap,	stress_set_iomix_overlap },
+	{ OPT_iomix_threads,	stress_set_iomix_threads },
 	{ 0,			NULL }
 };
 
@@ -0,0 +1,649 @@
+/*
+ * Copyright (C) 2024 Colin Ian King.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+#include "core-builtin.h"
+#include "core-latency.h"
+#include "core-pthread.h"
+
+#if defined(HAVE_SYS_XATTR_H)
+#include <sys/xattr.h>
+#undef HAVE_ATTR_XATTR_H
+#elif defined(HAVE_ATTR_XATTR_H)
+#include <attr/xattr.h>
+#endif
+
+#define MIN_METADATA_THREADS		(1)
+#define MAX_METADATA_THREADS		(64)
+#define DEFAULT_METADATA_THREADS	(4)
+
+#define MIN_METADATA_DIRS		(1)
+#define MAX_METADATA_DIRS		(4096)
+#define DEFAULT_METADATA_DIRS		(16)
+
+#define MIN_METADATA_FILES		(1)
+#define MAX_METADATA_FILES		(65536)
+#define DEFAULT_METADATA_FILES		(256)
+
+#define METADATA_MAX_WEIGHT		(100)
+
+static const stress_help_t help[] = {
+	{ NULL,	"metadata N",		"start N workers exercising a mix of metadata operations" },
+	{ NULL,	"metadata-dirs N",	"number of shared directories to spread files across" },
+	{ NULL,	"metadata-files N",	"number of files per thread" },
+	{ NULL,	"metadata-mix M",	"operation mix, e.g. create:1,stat:4,rename:1,unlink:1" },
+	{ NULL,	"metadata-ops N",	"stop after N metadata bogo operations" },
+	{ NULL,	"metadata-threads N",	"number of threads per worker" },
+	{ NULL,	NULL,			NULL }
+};
+
+enum {
+	METADATA_CREATE = 0,
+	METADATA_STAT,
+	METADATA_RENAME,
+	METADATA_UNLINK,
+	METADATA_SETXATTR,
+	METADATA_GETDENTS,
+	METADATA_MAX_OPS,
+};
+
+static const char * const metadata_op_names[METADATA_MAX_OPS] = {
+	"create",
+	"stat",
+	"rename",
+	"unlink",
+	"setxattr",
+	"getdents",
+};
+
+/* default mix, stat heavy as is typical of build workloads */
+static const uint8_t metadata_default_weights[METADATA_MAX_OPS] = {
+	1, 2, 1, 1, 1, 1
+};
+
+/*
+ *  stress_metadata_parse_mix()
+ *	parse comma separated op[:weight] list into weights,
+ *	ops not listed get a zero weight, returns -1 on error
+ */
+static int stress_metadata_parse_mix(const char *opt, uint8_t weights[METADATA_MAX_OPS])
+{
+	char *str, *ptr, *token, *saveptr = NULL;
+	uint32_t total = 0;
+	size_t i;
+
+	str = stress_const_optdup(opt);
+	if (!str) {
+		(void)fprintf(stderr, "metadata-mix: out of memory parsing '%s'\n", opt);
+		return -1;
+	}
+	(void)shim_memset(weights, 0, METADATA_MAX_OPS);
+
+	for (ptr = str; (token = strtok_r(ptr, ",", &saveptr)) != NULL; ptr = NULL) {
+		char *colon = strchr(token, ':');
+		int weight = 1;
+
+		if (colon) {
+			*colon = '\0';
+			weight = atoi(colon + 1);
+			if ((weight < 0) || (weight > METADATA_MAX_WEIGHT)) {
+				(void)fprintf(stderr, "metadata-mix: weight for '%s' must be "
+					"0..%d\n", token, METADATA_MAX_WEIGHT);
+				free(str);
+				return -1;
+			}
+		}
+		for (i = 0; i < METADATA_MAX_OPS; i++) {
+			if (!strcmp(token, metadata_op_names[i])) {
+				weights[i] = (uint8_t)weight;
+				total += (uint32_t)weight;
+				break;
+			}
+		}
+		if (i == METADATA_MAX_OPS) {
+			(void)fprintf(stderr, "metadata-mix: unknown operation '%s', "
+				"operations allowed are:", token);
+			for (i = 0; i < METADATA_MAX_OPS; i++)
+				(void)fprintf(stderr, " %s", metadata_op_names[i]);
+			(void)fprintf(stderr, "\n");
+			free(str);
+			return -1;
+		}
+	}
+	free(str);
+
+	if (total == 0) {
+		(void)fprintf(stderr, "metadata-mix: at least one operation "
+			"needs a non-zero weight\n");
+		return -1;
+	}
+	return 0;
+}
+
+static int stress_set_metadata_mix(const char *opt)
+{
+	uint8_t weights[METADATA_MAX_OPS];
+
+	if (stress_metadata_parse_mix(opt, weights) < 0)
+		return -1;
+	return stress_set_setting("metadata-mix", TYPE_ID_STR, opt);
+}
+
+static int stress_set_metadata_threads(const char *opt)
+{
+	size_t metadata_threads;
+
+	metadata_threads = (size_t)stress_get_uint64(opt);
+	stress_check_range("metadata-threads", (uint64_t)metadata_threads,
+		MIN_METADATA_THREADS, MAX_METADATA_THREADS);
+	return stress_set_setting("metadata-threads", TYPE_ID_SIZE_T, &metadata_threads);
+}
+
+static int stress_set_metadata_dirs(const char *opt)
+{
+	size_t metadata_dirs;
+
+	metadata_dirs = (size_t)stress_get_uint64(opt);
+	stress_check_range("metadata-dirs", (uint64_t)metadata_dirs,
+		MIN_METADATA_DIRS, MAX_METADATA_DIRS);
+	return stress_set_setting("metadata-dirs", TYPE_ID_SIZE_T, &metadata_dirs);
+}
+
+static int stress_set_metadata_files(const char *opt)
+{
+	size_t metadata_files;
+
+	metadata_files = (size_t)stress_get_uint64(opt);
+	stress_check_range("metadata-files", (uint64_t)metadata_files,
+		MIN_METADATA_FILES, MAX_METADATA_FILES);
+	return stress_set_setting("metadata-files", TYPE_ID_SIZE_T, &metadata_files);
+}
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_metadata_dirs,	stress_set_metadata_dirs },
+	{ OPT_metadata_files,	stress_set_metadata_files },
+	{ OPT_metadata_mix,	stress_set_metadata_mix },
+	{ OPT_metadata_threads,	stress_set_metadata_threads },
+	{ 0,			NULL }
+};
+
+#if defined(HAVE_LIB_PTHREAD)
+
+typedef struct {
+	uint16_t dir;		/* shard directory the file is in */
+	bool exists;		/* true if file has been created */
+} stress_metadata_file_t;
+
+typedef struct {
+	stress_args_t *args;		/* stressor args */
+	const char *temp_dir;		/* root of the directory tree */
+	const char *fs_type;		/* file system type */
+	void *counter_lock;		/* bogo counter lock */
+	const uint8_t *weights;		/* op mix weights */
+	uint32_t weight_total;		/* sum of weights */
+	size_t dirs;			/* number of shard directories */
+	size_t nfiles;			/* number of files in files[] */
+	stress_metadata_file_t *files;	/* per thread file state */
+	size_t id;			/* thread number */
+	pthread_t pthread;		/* thread handle */
+	int ret;			/* pthread_create return */
+	bool failed;			/* true if an op failed */
+	stress_latency_t latency[METADATA_MAX_OPS];	/* op latencies */
+} stress_metadata_thread_t;
+
+static volatile bool metadata_xattr_ok = true;
+
+/*
+ *  stress_metadata_dirname()
+ *	path of shard directory n
+ */
+static inline void stress_metadata_dirname(
+	char *path,
+	const size_t len,
+	const char *temp_dir,
+	const size_t n)
+{
+	(void)snprintf(path, len, "%s/d%zu", temp_dir, n);
+}
+
+/*
+ *  stress_metadata_filename()
+ *	path of file i of thread t
+ */
+static inline void stress_metadata_filename(
+	char *path,
+	const size_t len,
+	const stress_metadata_thread_t *t,
+	const size_t i)
+{
+	(void)snprintf(path, len, "%s/d%u/t%zu-f%zu", t->temp_dir,
+		(unsigned int)t->files[i].dir, t->id, i);
+}
+
+/*
+ *  stress_metadata_find()
+ *	find a file with the given existence state starting from
+ *	a random position, returns nfiles if none found
+ */
+static size_t stress_metadata_find(stress_metadata_thread_t *t, const bool exists)
+{
+	const size_t start = (size_t)stress_mwc32modn((uint32_t)t->nfiles);
+	size_t i;
+
+	for (i = 0; i < t->nfiles; i++) {
+		size_t j = start + i;
+
+		if (j >= t->nfiles)
+			j -= t->nfiles;
+		if (t->files[j].exists == exists)
+			return j;
+	}
+	return t->nfiles;
+}
+
+/*
+ *  stress_metadata_pick_op()
+ *	pick a random op based on the mix weights
+ */
+static inline size_t stress_metadata_pick_op(stress_metadata_thread_t *t)
+{
+	uint32_t r = stress_mwc32modn(t->weight_total);
+	size_t i;
+
+	for (i = 0; i < METADATA_MAX_OPS; i++) {
+		if (r < t->weights[i])
+			return i;
+		r -= t->weights[i];
+	}
+	return METADATA_STAT;
+}
+
+/*
+ *  stress_metadata_op()
+ *	perform one metadata op, returns the op actually
+ *	performed or -1 on failure
+ */
+static int stress_metadata_op(stress_metadata_thread_t *t, size_t op, double *duration)
+{
+	stress_args_t *args = t->args;
+	char path[PATH_MAX + 64], newpath[PATH_MAX + 64];
+	struct stat statbuf;
+	size_t i = 0;
+	double t1;
+	int fd, ret = 0;
+
+	/* ops on existing files need a file, create one if there are none */
+	if (op == METADATA_CREATE) {
+		i = stress_metadata_find(t, false);
+		if (i == t->nfiles)
+			op = METADATA_UNLINK;
+	}
+	if ((op != METADATA_CREATE) && (op != METADATA_GETDENTS)) {
+		i = stress_metadata_find(t, true);
+		if (i == t->nfiles) {
+			op = METADATA_CREATE;
+			i = stress_metadata_find(t, false);
+		}
+	}
+	if ((op == METADATA_SETXATTR) && !metadata_xattr_ok)
+		op = METADATA_STAT;
+
+	switch (op) {
+	case METADATA_CREATE:
+		t->files[i].dir = (uint16_t)stress_mwc32modn((uint32_t)t->dirs);
+		stress_metadata_filename(path, sizeof(path), t, i);
+		t1 = stress_time_now();
+		fd = open(path, O_CREAT | O_EXCL | O_WRONLY, S_IRUSR | S_IWUSR);
+		if (fd >= 0) {
+			(void)close(fd);
+			*duration = stress_time_now() - t1;
+			t->files[i].exists = true;
+		} else {
+			if ((errno == ENOSPC) || (errno == EDQUOT) || (errno == ENFILE) ||
+			    (errno == EMFILE) || (errno == ENOMEM))
+				return -2;
+			pr_fail("%s: create %s failed, errno=%d (%s)%s\n",
+				args->name, path, errno, strerror(errno), t->fs_type);
+			ret = -1;
+		}
+		break;
+	case METADATA_STAT:
+		stress_metadata_filename(path, sizeof(path), t, i);
+		t1 = stress_time_now();
+		if (shim_stat(path, &statbuf) == 0) {
+			*duration = stress_time_now() - t1;
+		} else {
+			pr_fail("%s: stat %s failed, errno=%d (%s)%s\n",
+				args->name, path, errno, strerror(errno), t->fs_type);
+			ret = -1;
+		}
+		break;
+	case METADATA_RENAME: {
+			const uint16_t old_dir = t->files[i].dir;
+
+			stress_metadata_filename(path, sizeof(path), t, i);
+			t->files[i].dir = (uint16_t)stress_mwc32modn((uint32_t)t->dirs);
+			stress_metadata_filename(newpath, sizeof(newpath), t, i);
+			t1 = stress_time_now();
+			if (rename(path, newpath) == 0) {
+				*duration = stress_time_now() - t1;
+			} else {
+				t->files[i].dir = old_dir;
+				if ((errno == ENOSPC) || (errno == EDQUOT))
+					return -2;
+				pr_fail("%s: rename %s to %s failed, errno=%d (%s)%s\n",
+					args->name, path, newpath, errno, strerror(errno), t->fs_type);
+				ret = -1;
+			}
+		}
+		break;
+	case METADATA_UNLINK:
+		stress_metadata_filename(path, sizeof(path), t, i);
+		t1 = stress_time_now();
+		if (shim_unlink(path) == 0) {
+			*duration = stress_time_now() - t1;
+			t->files[i].exists = false;
+		} else {
+			pr_fail("%s: unlink %s failed, errno=%d (%s)%s\n",
+				args->name, path, errno, strerror(errno), t->fs_type);
+			ret = -1;
+		}
+		break;
+	case METADATA_SETXATTR: {
+			char value[32];
+
+			stress_metadata_filename(path, sizeof(path), t, i);
+			(void)snprintf(value, sizeof(value), "%" PRIx32, stress_mwc32());
+			t1 = stress_time_now();
+			if (shim_setxattr(path, "user.stress-ng", value, strlen(value), 0) == 0) {
+				*duration = stress_time_now() - t1;
+			} else if ((errno == ENOTSUP) || (errno == ENOSYS) || (errno == EPERM)) {
+				/* no xattr support, fall back to stat from now on */
+				metadata_xattr_ok = false;
+				return METADATA_MAX_OPS;
+			} else if ((errno == ENOSPC) || (errno == EDQUOT)) {
+				return -2;
+			} else {
+				pr_fail("%s: setxattr %s failed, errno=%d (%s)%s\n",
+					args->name, path, errno, strerror(errno), t->fs_type);
+				ret = -1;
+			}
+		}
+		break;
+	case METADATA_GETDENTS: {
+			DIR *dir;
+
+			stress_metadata_dirname(path, sizeof(path), t->temp_dir,
+				(size_t)stress_mwc32modn((uint32_t)t->dirs));
+			t1 = stress_time_now();
+			dir = opendir(path);
+			if (dir) {
+				while (readdir(dir) != NULL)
+					;
+				(void)closedir(dir);
+				*duration = stress_time_now() - t1;
+			} else {
+				if ((errno == EMFILE) || (errno == ENFILE) || (errno == ENOMEM))
+					return -2;
+				pr_fail("%s: opendir %s failed, errno=%d (%s)%s\n",
+					args->name, path, errno, strerror(errno), t->fs_type);
+				ret = -1;
+			}
+		}
+		break;
+	default:
+		break;
+	}
+	return (ret < 0) ? ret : (int)op;
+}
+
+/*
+ *  stress_metadata_thread()
+ *	run a mix of metadata ops until told to stop
+ */
+static void *stress_metadata_thread(void *arg)
+{
+	static void *nowt = NULL;
+	stress_metadata_thread_t *t = (stress_metadata_thread_t *)arg;
+	stress_args_t *args = t->args;
+
+	while (stress_bogo_inc_lock(args, t->counter_lock, false)) {
+		double duration = 0.0;
+		const int op = stress_metadata_op(t, stress_metadata_pick_op(t), &duration);
+
+		if (op == -1) {
+			t->failed = true;
+			break;
+		}
+		if ((op < 0) || (op >= METADATA_MAX_OPS)) {
+			/* resource exhaustion, retry a little later */
+			(void)shim_sched_yield();
+			continue;
+		}
+		stress_latency_add(&t->latency[op], (uint64_t)(duration * STRESS_DBL_NANOSECOND));
+		if (!stress_bogo_inc_lock(args, t->counter_lock, true))
+			break;
+	}
+	return &nowt;
+}
+
+/*
+ *  stress_metadata_cleanup()
+ *	remove all files and shard directories
+ */
+static void stress_metadata_cleanup(
+	stress_metadata_thread_t *threads,
+	const size_t nthreads,
+	const char *temp_dir,
+	const size_t dirs)
+{
+	char path[PATH_MAX + 64];
+	size_t i, j;
+
+	for (i = 0; i < nthreads; i++) {
+		stress_metadata_thread_t *t = &threads[i];
+
+		if (!t->files)
+			continue;
+		for (j = 0; j < t->nfiles; j++) {
+			if (t->files[j].exists) {
+				stress_metadata_filename(path, sizeof(path), t, j);
+				(void)shim_unlink(path);
+			}
+		}
+	}
+	for (i = 0; i < dirs; i++) {
+		stress_metadata_dirname(path, sizeof(path), temp_dir, i);
+		(void)shim_rmdir(path);
+	}
+}
+
+/*
+ *  stress_metadata()
+ *	stress file system metadata ops across a sharded directory tree
+ */
+static int stress_metadata(stress_args_t *args)
+{
+	stress_metadata_thread_t *threads;
+	stress_latency_t latency[METADATA_MAX_OPS];
+	uint8_t weights[METADATA_MAX_OPS];
+	uint32_t weight_total = 0;
+	size_t metadata_threads = DEFAULT_METADATA_THREADS;
+	size_t metadata_dirs = DEFAULT_METADATA_DIRS;
+	size_t metadata_files = DEFAULT_METADATA_FILES;
+	char *metadata_mix = NULL;
+	char temp_dir[PATH_MAX], path[PATH_MAX + 64];
+	const char *fs_type;
+	void *counter_lock;
+	size_t i, j, created = 0, dirs_made = 0;
+	double t_start, duration;
+	int ret, rc = EXIT_SUCCESS;
+
+	(void)stress_get_setting("metadata-mix", &metadata_mix);
+	if (!stress_get_setting("metadata-threads", &metadata_threads)) {
+		if (g_opt_flags & OPT_FLAGS_MAXIMIZE)
+			metadata_threads = MAX_METADATA_THREADS;
+		if (g_opt_flags & OPT_FLAGS_MINIMIZE)
+			metadata_threads = MIN_METADATA_THREADS;
+	}
+	(void)stress_get_setting("metadata-dirs", &metadata_dirs);
+	(void)stress_get_setting("metadata-files", &metadata_files);
+
+	if (metadata_mix) {
+		if (stress_metadata_parse_mix(metadata_mix, weights) < 0)
+			return EXIT_FAILURE;
+	} else {
+		(void)shim_memcpy(weights, metadata_default_weights, sizeof(weights));
+	}
+	for (i = 0; i < METADATA_MAX_OPS; i++)
+		weight_total += weights[i];
+
+	counter_lock = stress_lock_create();
+	if (!counter_lock) {
+		pr_inf_skip("%s: failed to create counter lock. skipping stressor\n", args->name);
+		return EXIT_NO_RESOURCE;
+	}
+
+	threads = (stress_metadata_thread_t *)calloc(metadata_threads, sizeof(*threads));
+	if (!threads) {
+		pr_inf_skip("%s: cannot allocate %zd thread contexts, skipping stressor\n",
+			args->name, metadata_threads);
+		rc = EXIT_NO_RESOURCE;
+		goto lock_destroy;
+	}
+
+	stress_temp_dir_args(args, temp_dir, sizeof(temp_dir));
+	ret = stress_temp_dir_mk_args(args);
+	if (ret < 0) {
+		rc = stress_exit_status(-ret);
+		goto free_threads;
+	}
+	fs_type = stress_get_fs_type(temp_dir);
+
+	for (dirs_made = 0; dirs_made < metadata_dirs; dirs_made++) {
+		stress_metadata_dirname(path, sizeof(path), temp_dir, dirs_made);
+		if (mkdir(path, S_IRUSR | S_IWUSR | S_IXUSR) < 0) {
+			pr_inf_skip("%s: mkdir %s failed, errno=%d (%s)%s, skipping stressor\n",
+				args->name, path, errno, strerror(errno), fs_type);
+			rc = EXIT_NO_RESOURCE;
+			goto cleanup;
+		}
+	}
+
+	for (i = 0; i < metadata_threads; i++) {
+		stress_metadata_thread_t *t = &threads[i];
+
+		t->files = (stress_metadata_file_t *)calloc(metadata_files, sizeof(*t->files));
+		if (!t->files) {
+			pr_inf_skip("%s: cannot allocate file table, skipping stressor\n",
+				args->name);
+			rc = EXIT_NO_RESOURCE;
+			goto cleanup;
+		}
+		t->args = args;
+		t->temp_dir = temp_dir;
+		t->fs_type = fs_type;
+		t->counter_lock = counter_lock;
+		t->weights = weights;
+		t->weight_total = weight_total;
+		t->dirs = metadata_dirs;
+		t->nfiles = metadata_files;
+		t->id = i;
+		for (j = 0; j < METADATA_MAX_OPS; j++)
+			stress_latency_init(&t->latency[j]);
+	}
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+	t_start = stress_time_now();
+	for (i = 0; i < metadata_threads; i++) {
+		threads[i].ret = pthread_create(&threads[i].pthread, NULL,
+			stress_metadata_thread, (void *)&threads[i]);
+		if (threads[i].ret == 0)
+			created++;
+	}
+	if (created == 0) {
+		pr_inf_skip("%s: could not create any pthreads, skipping stressor\n",
+			args->name);
+		rc = EXIT_NO_RESOURCE;
+		goto cleanup;
+	}
+
+	for (i = 0; i < metadata_threads; i++) {
+		if (threads[i].ret == 0)
+			(void)pthread_join(threads[i].pthread, NULL);
+	}
+	duration = stress_time_now() - t_start;
+
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	for (j = 0; j < METADATA_MAX_OPS; j++)
+		stress_latency_init(&latency[j]);
+	for (i = 0; i < metadata_threads; i++) {
+		if (threads[i].ret)
+			continue;
+		if (threads[i].failed)
+			rc = EXIT_FAILURE;
+		for (j = 0; j < METADATA_MAX_OPS; j++)
+			stress_latency_merge(&latency[j], &threads[i].latency[j]);
+	}
+
+	for (i = 0, j = 0; j < METADATA_MAX_OPS; j++) {
+		char str[64];
+
+		if (latency[j].count == 0)
+			continue;
+		(void)snprintf(str, sizeof(str), "%s ops per sec", metadata_op_names[j]);
+		stress_metrics_set(args, i, str,
+			(duration > 0.0) ? (double)latency[j].count / duration : 0.0,
+			STRESS_HARMONIC_MEAN);
+		i = stress_latency_metrics_set(args, i + 1, metadata_op_names[j], &latency[j]);
+		if (args->instance == 0)
+			stress_latency_report(args, metadata_op_names[j], &latency[j]);
+	}
+
+cleanup:
+	stress_metadata_cleanup(threads, metadata_threads, temp_dir, dirs_made);
+	for (i = 0; i < metadata_threads; i++)
+		free(threads[i].files);
+	(void)stress_temp_dir_rm_args(args);
+free_threads:
+	free(threads);
+lock_destroy:
+	(void)stress_lock_destroy(counter_lock);
+
+	return rc;
+}
+
+stressor_info_t stress_metadata_info = {
+	.stressor = stress_metadata,
+	.class = CLASS_FILESYSTEM | CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
+	.verify = VERIFY_ALWAYS,
+	.help = help
+};
+#else
+stressor_info_t stress_metadata_info = {
+	.stressor = stress_unimplemented,
+	.class = CLASS_FILESYSTEM | CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
+	.verify = VERIFY_ALWAYS,
+	.help = help,
+	.unimplemented_reason = "built without pthread support"
+};
+#endif
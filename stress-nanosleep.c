@@ -20,8 +20,27 @@
 #include "stress-ng.h"
 #include "core-builtin.h"
 #include "core-cpuidle.h"
+#include "core-latency.h"
 #include "core-pthread.h"
 
+#if defined(HAVE_SYS_EPOLL_H)
+#include <sys/epoll.h>
+#endif
+
+#if defined(HAVE_SYS_PRCTL_H)
+#include <sys/prctl.h>
+#endif
+
+#if defined(HAVE_SYS_TIMERFD_H)
+#include <sys/timerfd.h>
+#endif
+
+#if defined(HAVE_SYS_PRCTL_H) &&	\
+    defined(HAVE_PRCTL) &&		\
+    defined(PR_SET_TIMERSLACK)
+#define STRESS_NANOSLEEP_TIMER_SLACK
+#endif
+
 #define MIN_NANOSLEEP_THREADS		(1)
 #define MAX_NANOSLEEP_THREADS		(1024)
 #define DEFAULT_NANOSLEEP_THREADS	(8)
@@ -70,6 +89,7 @@ static const stress_help_t help[] = {
 	{ NULL,	"nanosleep-ops N",	"stop after N bogo sleep operations" },
 	{ NULL,	"nanosleep-threads N",	"number of threads to run concurrently (default 8)" },
 	{ NULL,	"nanosleep-method M",	"select nanosleep sleep time method [ all | cstate | random ]" },
+	{ NULL,	"nanosleep-sweep",	"sweep sleep interval and timer slack measuring overshoot" },
 	{ NULL,	NULL,			NULL }
 };
 
@@ -116,9 +136,15 @@ static int stress_set_nanosleep_method(const char *name)
 	return -1;
 }
 
+static int stress_set_nanosleep_sweep(const char *opt)
+{
+	return stress_set_setting_true("nanosleep-sweep", opt);
+}
+
 static const stress_opt_set_func_t opt_set_funcs[] = {
 	{ OPT_nanosleep_threads,	stress_set_nanosleep_threads },
 	{ OPT_nanosleep_method,		stress_set_nanosleep_method },
+	{ OPT_nanosleep_sweep,		stress_set_nanosleep_sweep },
 	{ 0,				NULL }
 };
 
@@ -221,6 +247,400 @@ static void *stress_nanosleep_pthread(void *c)
 	return &nowt;
 }
 
+#if defined(HAVE_CLOCK_GETTIME) &&	\
+    defined(CLOCK_MONOTONIC)
+#define STRESS_NANOSLEEP_SWEEP
+#define STRESS_NANOSLEEP_SWEEP_CELL_TIME	(0.05)	/* max secs per interval/slack/method cell */
+#define STRESS_NANOSLEEP_SWEEP_CELL_SAMPLES	(100)	/* max samples per cell per sweep */
+#define STRESS_NANOSLEEP_SWEEP_USEFUL_PCT	(10.0)	/* useful if p99 overshoot <= 10% of interval */
+
+#define STRESS_NANOSLEEP_SWEEP_CLOCK_NS		(0)
+#define STRESS_NANOSLEEP_SWEEP_TIMERFD		(1)
+#define STRESS_NANOSLEEP_SWEEP_EPOLL		(2)
+#define STRESS_NANOSLEEP_SWEEP_BUSY_POLL	(3)
+#define STRESS_NANOSLEEP_SWEEP_METHODS		(4)
+
+static const uint64_t stress_nanosleep_sweep_intervals[] = {
+	1000, 10000, 50000, 100000, 500000, 1000000, 10000000
+};
+
+#if defined(STRESS_NANOSLEEP_TIMER_SLACK)
+static const uint64_t stress_nanosleep_sweep_slacks[] = {
+	1, 1000, 10000, 50000, 500000
+};
+#else
+/* 0 = slack cannot be changed, use whatever the default is */
+static const uint64_t stress_nanosleep_sweep_slacks[] = {
+	0
+};
+#endif
+
+#define STRESS_NANOSLEEP_SWEEP_INTERVALS	(SIZEOF_ARRAY(stress_nanosleep_sweep_intervals))
+#define STRESS_NANOSLEEP_SWEEP_SLACKS		(SIZEOF_ARRAY(stress_nanosleep_sweep_slacks))
+
+static const char * const stress_nanosleep_sweep_methods[] = {
+	"clock_nanosleep",
+	"timerfd",
+	"epoll",
+	"busy-poll",
+};
+
+typedef struct {
+	int timerfd;		/* one shot timerfd, -1 if not available */
+	int epollfd;		/* empty epoll set, -1 if not available */
+	bool epoll_pwait2;	/* epoll_pwait2 nanosecond timeouts work */
+} stress_nanosleep_sweep_t;
+
+/*
+ *  stress_nanosleep_sweep_now()
+ *	CLOCK_MONOTONIC time in nanoseconds
+ */
+static inline uint64_t stress_nanosleep_sweep_now(void)
+{
+	struct timespec ts;
+
+	(void)clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * STRESS_NANOSECOND) + (uint64_t)ts.tv_nsec;
+}
+
+/*
+ *  stress_nanosleep_sweep_sleep()
+ *	sleep for nsec nanoseconds using the given method,
+ *	returns the time slept in nanoseconds or 0 on failure
+ */
+static uint64_t stress_nanosleep_sweep_sleep(
+	stress_nanosleep_sweep_t *sweep,
+	const int method,
+	const uint64_t nsec)
+{
+	struct timespec ts;
+	uint64_t t1, t2;
+	int ret = -1;
+
+	ts.tv_sec = (time_t)(nsec / STRESS_NANOSECOND);
+	ts.tv_nsec = (long)(nsec % STRESS_NANOSECOND);
+
+	t1 = stress_nanosleep_sweep_now();
+	switch (method) {
+	case STRESS_NANOSLEEP_SWEEP_CLOCK_NS:
+#if defined(HAVE_CLOCK_NANOSLEEP)
+		/* returns the error number, not -1 */
+		ret = clock_nanosleep(CLOCK_MONOTONIC, 0, &ts, NULL);
+		if (ret) {
+			errno = ret;
+			ret = -1;
+		}
+#else
+		ret = nanosleep(&ts, NULL);
+#endif
+		break;
+#if defined(HAVE_SYS_TIMERFD_H) &&	\
+    defined(HAVE_TIMERFD_CREATE) &&	\
+    defined(HAVE_TIMERFD_SETTIME)
+	case STRESS_NANOSLEEP_SWEEP_TIMERFD:
+		{
+			struct itimerspec its;
+			uint64_t expirations;
+
+			(void)shim_memset(&its, 0, sizeof(its));
+			its.it_value = ts;
+			if (timerfd_settime(sweep->timerfd, 0, &its, NULL) < 0)
+				break;
+			if (read(sweep->timerfd, &expirations, sizeof(expirations)) == (ssize_t)sizeof(expirations))
+				ret = 0;
+		}
+		break;
+#endif
+#if defined(HAVE_SYS_EPOLL_H) &&	\
+    defined(HAVE_EPOLL_CREATE)
+	case STRESS_NANOSLEEP_SWEEP_EPOLL:
+		{
+			struct epoll_event event;
+
+#if defined(__NR_epoll_pwait2) &&	\
+    defined(HAVE_SYSCALL)
+			if (sweep->epoll_pwait2) {
+				ret = (int)syscall(__NR_epoll_pwait2, sweep->epollfd, &event, 1, &ts, NULL, 0);
+				if ((ret < 0) && (errno == ENOSYS))
+					sweep->epoll_pwait2 = false;
+				else
+					break;
+			}
+#endif
+			/* millisecond timeouts, round up so we never wake early */
+			ret = epoll_wait(sweep->epollfd, &event, 1,
+				(int)((nsec + 999999) / 1000000));
+		}
+		break;
+#endif
+	case STRESS_NANOSLEEP_SWEEP_BUSY_POLL:
+		while (stress_nanosleep_sweep_now() - t1 < nsec)
+			;
+		ret = 0;
+		break;
+	default:
+		break;
+	}
+	if (ret < 0)
+		return 0;
+	t2 = stress_nanosleep_sweep_now();
+	return (t2 > t1) ? t2 - t1 : 1;
+}
+
+/*
+ *  stress_nanosleep_sweep_interval_str()
+ *	human readable sleep interval
+ */
+static void stress_nanosleep_sweep_interval_str(const uint64_t nsec, char *buf, const size_t len)
+{
+	if (nsec >= 1000000)
+		(void)snprintf(buf, len, "%" PRIu64 "ms", nsec / 1000000);
+	else
+		(void)snprintf(buf, len, "%" PRIu64 "us", nsec / 1000);
+}
+
+/*
+ *  stress_nanosleep_sweep_useful()
+ *	finest interval where the p99 overshoot for the best slack
+ *	setting is within the useful percentage, 0 if none are
+ */
+static uint64_t stress_nanosleep_sweep_useful(
+	stress_latency_t cells[][STRESS_NANOSLEEP_SWEEP_SLACKS][STRESS_NANOSLEEP_SWEEP_INTERVALS],
+	const int method)
+{
+	size_t i, s;
+
+	for (i = 0; i < STRESS_NANOSLEEP_SWEEP_INTERVALS; i++) {
+		const double limit = (double)stress_nanosleep_sweep_intervals[i] *
+			STRESS_NANOSLEEP_SWEEP_USEFUL_PCT / 100.0;
+
+		for (s = 0; s < STRESS_NANOSLEEP_SWEEP_SLACKS; s++) {
+			const stress_latency_t *lat = &cells[method][s][i];
+
+			if ((lat->count > 0) &&
+			    ((double)stress_latency_percentile(lat, 99.0) <= limit))
+				return stress_nanosleep_sweep_intervals[i];
+		}
+	}
+	return 0;
+}
+
+/*
+ *  stress_nanosleep_sweep_table()
+ *	slack x interval table of p50 and p99 overshoot in
+ *	microseconds for a sleep method
+ */
+static void stress_nanosleep_sweep_table(
+	stress_args_t *args,
+	stress_latency_t cells[][STRESS_NANOSLEEP_SWEEP_SLACKS][STRESS_NANOSLEEP_SWEEP_INTERVALS],
+	const int method)
+{
+	char line[256];
+	size_t i, s;
+	int len;
+
+	pr_inf("%s: %s p50/p99 overshoot (usec):\n", args->name,
+		stress_nanosleep_sweep_methods[method]);
+	len = snprintf(line, sizeof(line), "%-8s", "slack");
+	for (i = 0; i < STRESS_NANOSLEEP_SWEEP_INTERVALS; i++) {
+		char interval[32];
+
+		stress_nanosleep_sweep_interval_str(stress_nanosleep_sweep_intervals[i],
+			interval, sizeof(interval));
+		len += snprintf(line + len, sizeof(line) - (size_t)len, " %15s", interval);
+	}
+	pr_inf("%s: %s\n", args->name, line);
+
+	for (s = 0; s < STRESS_NANOSLEEP_SWEEP_SLACKS; s++) {
+		const uint64_t slack = stress_nanosleep_sweep_slacks[s];
+		char slack_str[32];
+
+		if (slack == 0)
+			(void)snprintf(slack_str, sizeof(slack_str), "default");
+		else if (slack >= 1000)
+			(void)snprintf(slack_str, sizeof(slack_str), "%" PRIu64 "us", slack / 1000);
+		else
+			(void)snprintf(slack_str, sizeof(slack_str), "%" PRIu64 "ns", slack);
+		len = snprintf(line, sizeof(line), "%-8s", slack_str);
+		for (i = 0; i < STRESS_NANOSLEEP_SWEEP_INTERVALS; i++) {
+			const stress_latency_t *lat = &cells[method][s][i];
+			char cell[32];
+
+			if (lat->count == 0)
+				(void)snprintf(cell, sizeof(cell), "-");
+			else
+				(void)snprintf(cell, sizeof(cell), "%.1f/%.1f",
+					(double)stress_latency_percentile(lat, 50.0) / 1000.0,
+					(double)stress_latency_percentile(lat, 99.0) / 1000.0);
+			len += snprintf(line + len, sizeof(line) - (size_t)len, " %15s", cell);
+		}
+		pr_inf("%s: %s\n", args->name, line);
+	}
+}
+
+/*
+ *  stress_nanosleep_sweep()
+ *	sweep the requested sleep interval from 1us to 10ms against
+ *	the timer slack for each sleep method, measuring how far
+ *	each sleep overshoots the requested interval
+ */
+static int stress_nanosleep_sweep(stress_args_t *args)
+{
+	stress_latency_t (*cells)[STRESS_NANOSLEEP_SWEEP_SLACKS][STRESS_NANOSLEEP_SWEEP_INTERVALS];
+	bool supported[STRESS_NANOSLEEP_SWEEP_METHODS];
+	stress_nanosleep_sweep_t sweep;
+	uint64_t underruns = 0;
+	size_t i, s, idx = 0;
+	int m, rc = EXIT_SUCCESS;
+
+	cells = calloc(STRESS_NANOSLEEP_SWEEP_METHODS, sizeof(*cells));
+	if (!cells) {
+		pr_inf_skip("%s: cannot allocate overshoot histograms, skipping stressor\n", args->name);
+		return EXIT_NO_RESOURCE;
+	}
+	for (m = 0; m < STRESS_NANOSLEEP_SWEEP_METHODS; m++) {
+		supported[m] = true;
+		for (s = 0; s < STRESS_NANOSLEEP_SWEEP_SLACKS; s++)
+			for (i = 0; i < STRESS_NANOSLEEP_SWEEP_INTERVALS; i++)
+				stress_latency_init(&cells[m][s][i]);
+	}
+
+	sweep.timerfd = -1;
+	sweep.epollfd = -1;
+	sweep.epoll_pwait2 = true;
+#if defined(HAVE_SYS_TIMERFD_H) &&	\
+    defined(HAVE_TIMERFD_CREATE) &&	\
+    defined(HAVE_TIMERFD_SETTIME)
+	sweep.timerfd = timerfd_create(CLOCK_MONOTONIC, 0);
+#endif
+	supported[STRESS_NANOSLEEP_SWEEP_TIMERFD] = (sweep.timerfd >= 0);
+#if defined(HAVE_SYS_EPOLL_H) &&	\
+    defined(HAVE_EPOLL_CREATE)
+	sweep.epollfd = epoll_create(1);
+#endif
+	supported[STRESS_NANOSLEEP_SWEEP_EPOLL] = (sweep.epollfd >= 0);
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+	/*
+	 *  Each sweep visits every slack, interval and method cell
+	 *  for a short slice, results accumulate over sweeps until
+	 *  the run ends
+	 */
+	do {
+		for (s = 0; (s < STRESS_NANOSLEEP_SWEEP_SLACKS) && stress_continue(args); s++) {
+#if defined(STRESS_NANOSLEEP_TIMER_SLACK)
+			(void)prctl(PR_SET_TIMERSLACK, (unsigned long)stress_nanosleep_sweep_slacks[s]);
+#endif
+			for (i = 0; (i < STRESS_NANOSLEEP_SWEEP_INTERVALS) && stress_continue(args); i++) {
+				const uint64_t nsec = stress_nanosleep_sweep_intervals[i];
+
+				for (m = 0; (m < STRESS_NANOSLEEP_SWEEP_METHODS) && stress_continue(args); m++) {
+					const double t_end = stress_time_now() + STRESS_NANOSLEEP_SWEEP_CELL_TIME;
+					int n;
+
+					if (!supported[m])
+						continue;
+					for (n = 0; n < STRESS_NANOSLEEP_SWEEP_CELL_SAMPLES; n++) {
+						const uint64_t slept = stress_nanosleep_sweep_sleep(&sweep, m, nsec);
+
+						if (slept == 0) {
+							if (errno != EINTR) {
+								pr_dbg("%s: %s failed, errno=%d (%s), disabling method\n",
+									args->name, stress_nanosleep_sweep_methods[m],
+									errno, strerror(errno));
+								supported[m] = false;
+							}
+							break;
+						}
+						/* a signal at the end of the run can cut a sleep short */
+						if (slept < nsec) {
+							if (!stress_continue(args))
+								break;
+							underruns++;
+						} else {
+							stress_latency_add(&cells[m][s][i], slept - nsec);
+						}
+						stress_bogo_inc(args);
+						if ((stress_time_now() >= t_end) || !stress_continue(args))
+							break;
+					}
+				}
+			}
+		}
+	} while (stress_continue(args));
+
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	/* put back the default slack and then any --timer-slack setting */
+#if defined(STRESS_NANOSLEEP_TIMER_SLACK)
+	(void)prctl(PR_SET_TIMERSLACK, 0UL);
+#endif
+	stress_set_timer_slack();
+
+	if (underruns > 0) {
+		pr_fail("%s: detected %" PRIu64 " sleeps that woke up early\n",
+			args->name, underruns);
+		rc = EXIT_FAILURE;
+	}
+
+	for (m = 0; m < STRESS_NANOSLEEP_SWEEP_METHODS; m++) {
+		const uint64_t useful = stress_nanosleep_sweep_useful(cells, m);
+		char desc[64];
+
+		if (!supported[m])
+			continue;
+		if (useful > 0) {
+			(void)snprintf(desc, sizeof(desc), "usec finest useful %s interval",
+				stress_nanosleep_sweep_methods[m]);
+			stress_metrics_set(args, idx++, desc,
+				(double)useful / 1000.0, STRESS_GEOMETRIC_MEAN);
+		}
+		if (cells[m][0][0].count > 0) {
+			(void)snprintf(desc, sizeof(desc), "usec p99 %s 1us overshoot",
+				stress_nanosleep_sweep_methods[m]);
+			stress_metrics_set(args, idx++, desc,
+				(double)stress_latency_percentile(&cells[m][0][0], 99.0) / 1000.0,
+				STRESS_GEOMETRIC_MEAN);
+		}
+	}
+
+	if (args->instance == 0) {
+		pr_block_begin();
+		for (m = 0; m < STRESS_NANOSLEEP_SWEEP_METHODS; m++) {
+			if (supported[m])
+				stress_nanosleep_sweep_table(args, cells, m);
+		}
+		for (m = 0; m < STRESS_NANOSLEEP_SWEEP_METHODS; m++) {
+			char interval[32];
+			const uint64_t useful = stress_nanosleep_sweep_useful(cells, m);
+
+			if (!supported[m])
+				continue;
+			if (useful > 0) {
+				stress_nanosleep_sweep_interval_str(useful, interval, sizeof(interval));
+				pr_inf("%s: %s finest useful interval %s (p99 overshoot <= %.0f%%)\n",
+					args->name, stress_nanosleep_sweep_methods[m],
+					interval, STRESS_NANOSLEEP_SWEEP_USEFUL_PCT);
+			} else {
+				pr_inf("%s: %s has no useful interval (p99 overshoot <= %.0f%%)\n",
+					args->name, stress_nanosleep_sweep_methods[m],
+					STRESS_NANOSLEEP_SWEEP_USEFUL_PCT);
+			}
+		}
+		pr_block_end();
+	}
+
+	if (sweep.timerfd >= 0)
+		(void)close(sweep.timerfd);
+	if (sweep.epollfd >= 0)
+		(void)close(sweep.epollfd);
+	free(cells);
+
+	return rc;
+}
+#endif
+
 /*
  *  stress_nanosleep()
  *	stress nanosleep by many sleeping threads
@@ -233,6 +653,7 @@ static int stress_nanosleep(stress_args_t *args)
 	stress_ctxt_t *ctxts;
 	int ret = EXIT_SUCCESS;
 	int mask = STRESS_NANOSLEEP_ALL;
+	bool nanosleep_sweep = false;
 #if defined(HAVE_CLOCK_GETTIME) &&	\
     defined(CLOCK_MONOTONIC)
 	double overhead_nsec;
@@ -242,6 +663,17 @@ static int stress_nanosleep(stress_args_t *args)
 #endif
 	cpu_cstate_t *cstate_list = stress_cpuidle_cstate_list_head();
 
+	(void)stress_get_setting("nanosleep-sweep", &nanosleep_sweep);
+	if (nanosleep_sweep) {
+#if defined(STRESS_NANOSLEEP_SWEEP)
+		return stress_nanosleep_sweep(args);
+#else
+		if (args->instance == 0)
+			pr_inf("%s: --nanosleep-sweep requires CLOCK_MONOTONIC, ignoring option\n",
+				args->name);
+#endif
+	}
+
 	(void)stress_get_setting("nanosleep-threads", &nanosleep_threads);
 	max_ops = args->max_ops ? (args->max_ops / nanosleep_threads) + 1 : 0;
 
@@ -22,6 +22,7 @@
 #include "core-attribute.h"
 #include "core-bitops.h"
 #include "core-builtin.h"
+#include "core-cgroup.h"
 #include "core-clocksource.h"
 #include "core-cpuidle.h"
 #include "core-config-check.h"
@@ -45,6 +46,7 @@
 #include "core-syslog.h"
 #include "core-thermal-zone.h"
 #include "core-thrash.h"
+#include "core-trace.h"
 #include "core-vmstat.h"
 
 #include <sched.h>
@@ -289,6 +291,9 @@ static const stress_help_t help_generic[] = {
 	{ "a N",	"all N",		"start N workers of each stress test" },
 	{ "b N",	"backoff N",		"wait of N microseconds before work starts" },
 	{ NULL,		"change-cpu",		"force child processes to use different CPU to that of parent" },
+	{ NULL,		"cgroup-cpu-max Q[/P]",	"limit each stressor's cgroup v2 cpu.max to Q usecs per P usecs" },
+	{ NULL,		"cgroup-io-max S",	"limit each stressor's cgroup v2 io.max to \"DEV key=value...\"" },
+	{ NULL,		"cgroup-memory-high N",	"limit each stressor's cgroup v2 memory.high to N bytes" },
 	{ NULL,		"class name",		"specify a class of stressors, use with --sequential" },
 	{ "n",		"dry-run",		"do not run" },
 	{ NULL,		"ftrace",		"enable kernel function call tracing" },
@@ -326,6 +331,8 @@ static const stress_help_t help_generic[] = {
 	{ NULL,		"perf",			"display perf statistics" },
 #endif
 	{ NULL,		"permute N",		"run permutations of stressors with N stressors per permutation" },
+	{ NULL,		"placement P",		"pin instances to CPUs using topology placement policy P" },
+	{ NULL,		"pressurestat S",	"sample pressure stall and cgroup statistics every S seconds" },
 	{ "q",		"quiet",		"quiet output" },
 	{ "r",		"random N",		"start N random workers" },
 	{ NULL,		"sched type",		"set scheduler type" },
@@ -354,6 +361,8 @@ static const stress_help_t help_generic[] = {
 	{ NULL,		"timer-slack N",	"set slack slack to N nanoseconds, 0 for default" },
 	{ NULL,		"times",		"show run time summary at end of the run" },
 	{ NULL,		"timestamp",		"timestamp log output " },
+	{ NULL,		"trace-decode F",	"decode binary trace file F to text and exit" },
+	{ NULL,		"trace-file F",		"record per-instance binary event trace to file F" },
 #if defined(STRESS_THERMAL_ZONES)
 	{ NULL,		"tz",			"collect temperatures from thermal zones (Linux only)" },
 #endif
@@ -561,7 +570,7 @@ static void stress_kill_stressors(const int sig, const bool force_sigkill)
  */
 static void MLOCKED_TEXT stress_sigint_handler(int signum)
 {
-	(void)signum;
+	stress_trace_signal(signum);
 	if (g_shared)
 		g_shared->caught_sigint = true;
 	stress_continue_set_flag(false);
@@ -1001,6 +1010,8 @@ redo:
 	if (ret > 0) {
 		int wexit_status = WEXITSTATUS(status);
 
+		stress_trace_exit(stats, status);
+
 		if (WIFSIGNALED(status)) {
 #if defined(WTERMSIG)
 			const int wterm_signal = WTERMSIG(status);
@@ -1125,9 +1136,10 @@ static void stress_wait_stressors(
 	 *  On systems that support changing CPU affinity
 	 *  we keep on moving processes between processors
 	 *  to impact on memory locality (e.g. NUMA) to
-	 *  try to thrash the system when in aggressive mode
+	 *  try to thrash the system when in aggressive mode,
+	 *  unless instances are pinned with --placement
 	 */
-	if (g_opt_flags & OPT_FLAGS_AGGRESSIVE)
+	if ((g_opt_flags & OPT_FLAGS_AGGRESSIVE) && !stress_placement_enabled())
 		stress_wait_aggressive(ticks_per_sec, stressors_list);
 #else
 	(void)ticks_per_sec;
@@ -1389,6 +1401,9 @@ static int MLOCKED_TEXT stress_run_child(
 
 	sigalarmed = &stats->sigalarmed;
 	child_pid = getpid();
+	stress_trace_instance(stats);
+	stress_cgroup_add_pid(g_stressor_current);
+	stress_placement_set(started_instances);
 
 	(void)stress_munge_underscore(name, g_stressor_current->stressor->name, sizeof(name));
 	stress_set_proc_state(name, STRESS_STATE_START);
@@ -1645,6 +1660,7 @@ again:
 					stats->signalled = false;
 					started_instances++;
 					stress_ftrace_add_pid(pid);
+					stress_trace_fork(stats, g_stressor_current->stressor->name, (uint32_t)j, pid);
 				}
 
 				/* Forced early abort during startup? */
@@ -2377,6 +2393,7 @@ static inline void stress_shared_map(const int32_t num_procs)
 	/* Paraniod */
 	(void)shim_memset(g_shared, 0, sz);
 	g_shared->length = sz;
+	g_shared->stats_count = (uint32_t)num_procs;
 	g_shared->instance_count.started = 0;
 	g_shared->instance_count.exited = 0;
 	g_shared->instance_count.reaped = 0;
@@ -2939,6 +2956,18 @@ next_opt:
 			u32 = stress_get_uint32(optarg);
 			stress_set_setting("cache-ways", TYPE_ID_UINT32, &u32);
 			break;
+		case OPT_cgroup_cpu_max:
+			if (stress_set_cgroup_cpu_max(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_cgroup_io_max:
+			if (stress_set_cgroup_io_max(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_cgroup_memory_high:
+			if (stress_set_cgroup_memory_high(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
 		case OPT_class:
 			ret = stress_get_class(optarg, &u32);
 			if (ret < 0)
@@ -3060,6 +3089,10 @@ next_opt:
 			stress_get_processors(&g_opt_permute);
 			stress_check_max_stressors("permute", g_opt_permute);
 			break;
+		case OPT_placement:
+			if (stress_set_placement(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
 		case OPT_status:
 			if (stress_set_status(optarg) < 0)
 				exit(EXIT_FAILURE);
@@ -3081,6 +3114,12 @@ next_opt:
 		case OPT_timer_slack:
 			(void)stress_set_timer_slack_ns(optarg);
 			break;
+		case OPT_trace_decode:
+			exit(stress_trace_decode(optarg) < 0 ? EXIT_FAILURE : EXIT_SUCCESS);
+		case OPT_trace_file:
+			if (stress_set_trace_file(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
 		case OPT_version:
 			stress_version();
 			exit(EXIT_SUCCESS);
@@ -3099,6 +3138,10 @@ next_opt:
 			if (stress_set_iostat(optarg) < 0)
 				exit(EXIT_FAILURE);
 			break;
+		case OPT_pressurestat:
+			if (stress_set_pressurestat(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
 		case OPT_with:
 			g_opt_flags |= (OPT_FLAGS_WITH | OPT_FLAGS_SET);
 			stress_set_setting_global("with", TYPE_ID_STR, (void *)optarg);
@@ -3671,6 +3714,7 @@ int main(int argc, char **argv, char **envp)
 	 *  across all the child stressors
 	 */
 	stress_shared_map(stress_get_total_num_instances(stressors_head));
+	stress_trace_init();
 
 	/*
 	 *  And now shared memory is created, initialize pr_* lock mechanism
@@ -3743,12 +3787,18 @@ int main(int argc, char **argv, char **envp)
 
 	stress_clear_warn_once();
 	stress_stressors_init();
+	if (stress_cgroup_init(stressors_head) < 0) {
+		ret = EXIT_FAILURE;
+		goto exit_shared_unmap;
+	}
+	stress_placement_init();
 
 	/* Start thrasher process if required */
 	if (g_opt_flags & OPT_FLAGS_THRASH)
 		stress_thrash_start();
 
 	stress_vmstat_start();
+	stress_trace_start();
 	stress_smart_start();
 	stress_klog_start();
 	stress_clocksource_check();
@@ -3769,6 +3819,9 @@ int main(int argc, char **argv, char **envp)
 	/* Stop alarms */
 	(void)alarm(0);
 
+	stress_trace_stop();
+	stress_trace_dump();
+
 	/* Stop thasher process */
 	if (g_opt_flags & OPT_FLAGS_THRASH)
 		stress_thrash_stop();
@@ -3780,6 +3833,7 @@ int main(int argc, char **argv, char **envp)
 	 */
 	if (g_opt_flags & OPT_FLAGS_METRICS)
 		stress_metrics_dump(yaml);
+	stress_cgroup_dump(yaml);
 
 	stress_metrics_check(&success);
 	if (g_opt_flags & OPT_FLAGS_INTERRUPTS)
@@ -3812,6 +3866,9 @@ int main(int argc, char **argv, char **envp)
 	stress_klog_stop(&success);
 	stress_smart_stop();
 	stress_vmstat_stop();
+	stress_pressurestat_dump(yaml);
+	stress_cgroup_deinit();
+	stress_placement_deinit();
 	stress_ftrace_stop();
 	stress_ftrace_free();
 
@@ -632,6 +632,7 @@ typedef struct {
 	struct {
 		uint32_t ready;		/* incremented when rawsock stressor is ready */
 	} rawsock;
+	uint32_t stats_count;		/* Number of stats[] entries */
 	stress_stats_t stats[];		/* Shared statistics */
 } stress_shared_t;
 
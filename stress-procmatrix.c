@@ -0,0 +1,536 @@
+/*
+ * Copyright (C) 2024      Colin Ian King.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+#include "core-builtin.h"
+#include "core-latency.h"
+
+#include <sched.h>
+#include <sys/wait.h>
+
+#if defined(HAVE_SPAWN_H)
+#include <spawn.h>
+#endif
+
+#define MIN_PROCMATRIX_MAX_SIZE		(1 * MB)
+#define MAX_PROCMATRIX_MAX_SIZE		(256ULL * GB)
+#define DEFAULT_PROCMATRIX_MAX_SIZE	(1 * GB)
+
+#define PROCMATRIX_MIN_SIZE		(1 * MB)
+#define PROCMATRIX_SIZE_SHIFT		(2)		/* sizes step up by x4 */
+#define PROCMATRIX_MAX_SIZES		(16)
+#define PROCMATRIX_CELL_TIME		(0.1)		/* secs per cell per sweep */
+#define PROCMATRIX_CELL_MAX		(1000)		/* max creates per cell per sweep */
+#define PROCMATRIX_CLONE_STACK_SIZE	(64 * KB)
+
+#define PROCMATRIX_FORK			(0)
+#define PROCMATRIX_VFORK		(1)
+#define PROCMATRIX_CLONE_VM		(2)
+#define PROCMATRIX_CLONE3		(3)
+#define PROCMATRIX_SPAWN		(4)
+#define PROCMATRIX_FORK_EXEC		(5)
+#define PROCMATRIX_VFORK_EXEC		(6)
+#define PROCMATRIX_METHODS		(7)
+
+typedef struct {
+	const char *name;	/* method name */
+	const bool exec;	/* true if method execs stress-ng */
+} stress_procmatrix_method_t;
+
+typedef struct {
+	stress_latency_t latency;	/* create-to-exit latency */
+	uint64_t failed;		/* failed creates or bad exits */
+} stress_procmatrix_cell_t;
+
+static const stress_help_t help[] = {
+	{ NULL,	"procmatrix N",		"start N workers measuring process creation cost vs parent size" },
+	{ NULL,	"procmatrix-max-size N","sweep parent mapped memory from 1MB up to N bytes (default 1GB)" },
+	{ NULL,	"procmatrix-ops N",	"stop after N processes have been created" },
+	{ NULL,	NULL,			NULL }
+};
+
+static const stress_procmatrix_method_t stress_procmatrix_methods[PROCMATRIX_METHODS] = {
+	{ "fork",	false },
+	{ "vfork",	false },
+	{ "clone-vm",	false },
+	{ "clone3",	false },
+	{ "spawn",	true },
+	{ "fork-exec",	true },
+	{ "vfork-exec",	true },
+};
+
+/*
+ *  stress_set_procmatrix_max_size()
+ *	set the largest parent mapping size in the sweep
+ */
+static int stress_set_procmatrix_max_size(const char *opt)
+{
+	uint64_t procmatrix_max_size;
+
+	procmatrix_max_size = stress_get_uint64_byte_memory(opt, 1);
+	stress_check_range_bytes("procmatrix-max-size", procmatrix_max_size,
+		MIN_PROCMATRIX_MAX_SIZE, MAX_PROCMATRIX_MAX_SIZE);
+	return stress_set_setting("procmatrix-max-size", TYPE_ID_UINT64, &procmatrix_max_size);
+}
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_procmatrix_max_size,	stress_set_procmatrix_max_size },
+	{ 0,				NULL }
+};
+
+#if defined(HAVE_CLONE) &&	\
+    defined(CLONE_VM)
+static int stress_procmatrix_clone_func(void *arg)
+{
+	(void)arg;
+
+	return 0;
+}
+#endif
+
+/*
+ *  stress_procmatrix_create()
+ *	create a process that exits immediately using the given
+ *	method and reap it, returns the pid or -1 on failure and
+ *	sets *exit_ok if it exited with EXIT_SUCCESS
+ */
+static pid_t stress_procmatrix_create(
+	const int method,
+	char *exec_path,
+	char *stack_top,
+	bool *clone3_ok,
+	bool *exit_ok)
+{
+	static char *argv_new[] = { NULL, "--exec-exit", NULL };
+	static char *env_new[] = { NULL };
+	pid_t pid = -1;
+	int status;
+
+	argv_new[0] = exec_path;
+	*exit_ok = false;
+
+	switch (method) {
+	case PROCMATRIX_FORK:
+		pid = fork();
+		if (pid == 0)
+			_exit(EXIT_SUCCESS);
+		break;
+	case PROCMATRIX_VFORK:
+		pid = shim_vfork();
+		if (pid == 0)
+			_exit(EXIT_SUCCESS);
+		break;
+	case PROCMATRIX_CLONE_VM:
+#if defined(HAVE_CLONE) &&	\
+    defined(CLONE_VM)
+		pid = clone(stress_procmatrix_clone_func,
+			stress_align_stack(stack_top), CLONE_VM | SIGCHLD, NULL);
+#else
+		(void)stack_top;
+		errno = ENOSYS;
+#endif
+		break;
+	case PROCMATRIX_CLONE3:
+		if (*clone3_ok) {
+			struct shim_clone_args cl_args;
+
+			(void)shim_memset(&cl_args, 0, sizeof(cl_args));
+			cl_args.exit_signal = SIGCHLD;
+			pid = (pid_t)shim_clone3(&cl_args, sizeof(cl_args));
+			if (pid == 0)
+				_exit(EXIT_SUCCESS);
+			if ((pid < 0) && (errno == ENOSYS))
+				*clone3_ok = false;
+		} else {
+			errno = ENOSYS;
+		}
+		break;
+	case PROCMATRIX_SPAWN:
+#if defined(HAVE_SPAWN_H) &&	\
+    defined(HAVE_POSIX_SPAWN)
+		{
+			const int ret = posix_spawn(&pid, exec_path, NULL, NULL, argv_new, env_new);
+
+			if (ret != 0) {
+				errno = ret;
+				pid = -1;
+			}
+		}
+#else
+		errno = ENOSYS;
+#endif
+		break;
+	case PROCMATRIX_FORK_EXEC:
+		pid = fork();
+		if (pid == 0) {
+			(void)execve(exec_path, argv_new, env_new);
+			_exit(EXIT_NOT_IMPLEMENTED);
+		}
+		break;
+	case PROCMATRIX_VFORK_EXEC:
+		pid = shim_vfork();
+		if (pid == 0) {
+			(void)execve(exec_path, argv_new, env_new);
+			_exit(EXIT_NOT_IMPLEMENTED);
+		}
+		break;
+	default:
+		errno = EINVAL;
+		break;
+	}
+	if (pid < 0)
+		return -1;
+	if (shim_waitpid(pid, &status, 0) < 0)
+		return -1;
+	/* exec failed in the child, e.g. stress-ng is not accessible */
+	if (stress_procmatrix_methods[method].exec &&
+	    WIFEXITED(status) && (WEXITSTATUS(status) == EXIT_NOT_IMPLEMENTED)) {
+		errno = ENOEXEC;
+		return -1;
+	}
+	*exit_ok = WIFEXITED(status) && (WEXITSTATUS(status) == EXIT_SUCCESS);
+	return pid;
+}
+
+/*
+ *  stress_procmatrix_supported()
+ *	return true if method is built in and allowed to run
+ */
+static bool stress_procmatrix_supported(const int method, const char *exec_path)
+{
+	if (stress_procmatrix_methods[method].exec) {
+		/*
+		 *  Like the exec and spawn stressors, don't exec
+		 *  stress-ng when running as root
+		 */
+		if (!exec_path || (geteuid() == 0))
+			return false;
+	}
+	switch (method) {
+	case PROCMATRIX_CLONE_VM:
+#if defined(HAVE_CLONE) &&	\
+    defined(CLONE_VM)
+		return true;
+#else
+		return false;
+#endif
+	case PROCMATRIX_SPAWN:
+#if defined(HAVE_SPAWN_H) &&	\
+    defined(HAVE_POSIX_SPAWN)
+		return true;
+#else
+		return false;
+#endif
+	default:
+		break;
+	}
+	return true;
+}
+
+/*
+ *  stress_procmatrix_map()
+ *	map and populate size bytes of private anonymous memory,
+ *	with or without transparent huge pages
+ */
+static void *stress_procmatrix_map(
+	stress_args_t *args,
+	const size_t size,
+	const bool thp,
+	bool *thp_ok)
+{
+	uint8_t *ptr, *end;
+
+	ptr = (uint8_t *)mmap(NULL, size, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (ptr == MAP_FAILED)
+		return NULL;
+#if defined(MADV_HUGEPAGE) &&	\
+    defined(MADV_NOHUGEPAGE)
+	if (shim_madvise((void *)ptr, size, thp ? MADV_HUGEPAGE : MADV_NOHUGEPAGE) < 0) {
+		if (thp)
+			*thp_ok = false;
+	}
+#else
+	(void)thp;
+	*thp_ok = false;
+#endif
+	/* touch every page so the parent RSS is the mapping size */
+	for (end = ptr + size; ptr < end; ptr += args->page_size)
+		*ptr = 1;
+	return (void *)(end - size);
+}
+
+static void stress_procmatrix_size_str(const size_t size, char *buf, const size_t len)
+{
+	if (size >= GB)
+		(void)snprintf(buf, len, "%zuG", size / (size_t)GB);
+	else
+		(void)snprintf(buf, len, "%zuM", size / (size_t)MB);
+}
+
+/*
+ *  stress_procmatrix_table()
+ *	print a size/THP x method latency table in microseconds
+ */
+static void stress_procmatrix_table(
+	stress_args_t *args,
+	stress_procmatrix_cell_t cells[][2][PROCMATRIX_METHODS],
+	const size_t *sizes,
+	const size_t n_sizes,
+	const bool *thp_rows,
+	const bool *supported,
+	const double percentile)
+{
+	char line[256];
+	size_t i, t;
+	int m, len;
+
+	len = snprintf(line, sizeof(line), "%-6s %-3s", "size", "THP");
+	for (m = 0; m < PROCMATRIX_METHODS; m++)
+		len += snprintf(line + len, sizeof(line) - (size_t)len, " %10s",
+			stress_procmatrix_methods[m].name);
+	if (percentile > 0.0)
+		pr_inf("%s: p%.0f create-to-exit latency (usec):\n", args->name, percentile);
+	else
+		pr_inf("%s: mean create-to-exit latency (usec):\n", args->name);
+	pr_inf("%s: %s\n", args->name, line);
+
+	for (i = 0; i < n_sizes; i++) {
+		for (t = 0; t < 2; t++) {
+			char sz[16];
+
+			if (!thp_rows[t])
+				continue;
+			stress_procmatrix_size_str(sizes[i], sz, sizeof(sz));
+			len = snprintf(line, sizeof(line), "%-6s %-3s", sz, t ? "yes" : "no");
+			for (m = 0; m < PROCMATRIX_METHODS; m++) {
+				const stress_latency_t *lat = &cells[i][t][m].latency;
+
+				if (!supported[m] || (lat->count == 0)) {
+					len += snprintf(line + len, sizeof(line) - (size_t)len, " %10s", "-");
+				} else {
+					const double usec = (percentile > 0.0) ?
+						(double)stress_latency_percentile(lat, percentile) / 1000.0 :
+						stress_latency_mean(lat) / 1000.0;
+
+					len += snprintf(line + len, sizeof(line) - (size_t)len, " %10.1f", usec);
+				}
+			}
+			pr_inf("%s: %s\n", args->name, line);
+		}
+	}
+}
+
+/*
+ *  stress_procmatrix()
+ *	measure process creation cost for each creation method
+ *	against parent RSS, with and without transparent huge pages
+ */
+static int stress_procmatrix(stress_args_t *args)
+{
+	uint64_t procmatrix_max_size = DEFAULT_PROCMATRIX_MAX_SIZE;
+	size_t sizes[PROCMATRIX_MAX_SIZES], n_sizes = 0, size, max_size;
+	size_t shmall, freemem, totalmem, freeswap, totalswap;
+	size_t i, t, idx;
+	stress_procmatrix_cell_t (*cells)[2][PROCMATRIX_METHODS];
+	bool supported[PROCMATRIX_METHODS];
+	bool thp_rows[2] = { true, true };
+	bool clone3_ok = true;
+	char exec_path_buf[PATH_MAX];
+	char *exec_path;
+	void *stack;
+	char *stack_top;
+	uint64_t failed = 0;
+	int m, rc = EXIT_SUCCESS;
+
+	(void)stress_get_setting("procmatrix-max-size", &procmatrix_max_size);
+
+	/* don't let all the instances map more than half the free memory */
+	stress_get_memlimits(&shmall, &freemem, &totalmem, &freeswap, &totalswap);
+	max_size = (size_t)procmatrix_max_size;
+	if (freemem > 0) {
+		const size_t limit = freemem / 2 / (size_t)args->num_instances;
+
+		if (max_size > limit) {
+			if (args->instance == 0)
+				pr_inf("%s: limiting parent mapping sizes to %zuMB, not enough free memory\n",
+					args->name, limit / (size_t)MB);
+			max_size = limit;
+		}
+	}
+	for (size = PROCMATRIX_MIN_SIZE; size && (size <= max_size) && (n_sizes < PROCMATRIX_MAX_SIZES); size <<= PROCMATRIX_SIZE_SHIFT)
+		sizes[n_sizes++] = size;
+	if (n_sizes == 0) {
+		pr_inf_skip("%s: not enough free memory for a %zuMB mapping, skipping stressor\n",
+			args->name, (size_t)PROCMATRIX_MIN_SIZE / (size_t)MB);
+		return EXIT_NO_RESOURCE;
+	}
+
+	exec_path = stress_get_proc_self_exe(exec_path_buf, sizeof(exec_path_buf));
+	for (m = 0; m < PROCMATRIX_METHODS; m++)
+		supported[m] = stress_procmatrix_supported(m, exec_path);
+	if ((args->instance == 0) && (geteuid() == 0))
+		pr_inf("%s: running as root, skipping the spawn and exec methods\n", args->name);
+
+	cells = calloc(n_sizes, sizeof(*cells));
+	if (!cells) {
+		pr_inf_skip("%s: cannot allocate latency matrix, skipping stressor\n", args->name);
+		return EXIT_NO_RESOURCE;
+	}
+	for (i = 0; i < n_sizes; i++)
+		for (t = 0; t < 2; t++)
+			for (m = 0; m < PROCMATRIX_METHODS; m++)
+				stress_latency_init(&cells[i][t][m].latency);
+
+	stack = mmap(NULL, PROCMATRIX_CLONE_STACK_SIZE, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (stack == MAP_FAILED) {
+		pr_inf_skip("%s: cannot mmap clone stack, skipping stressor\n", args->name);
+		free(cells);
+		return EXIT_NO_RESOURCE;
+	}
+	stack_top = (char *)stress_get_stack_top(stack, PROCMATRIX_CLONE_STACK_SIZE);
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+	/*
+	 *  Each sweep maps every size with and without THP and
+	 *  runs each method for a short slice, results accumulate
+	 *  over sweeps until the run ends
+	 */
+	do {
+		for (i = 0; (i < n_sizes) && stress_continue(args); i++) {
+			for (t = 0; (t < 2) && stress_continue(args); t++) {
+				void *mapping;
+
+				if (!thp_rows[t])
+					continue;
+				mapping = stress_procmatrix_map(args, sizes[i], t == 1, &thp_rows[1]);
+				if (!mapping) {
+					pr_dbg("%s: cannot mmap %zu bytes, errno=%d (%s)\n",
+						args->name, sizes[i], errno, strerror(errno));
+					continue;
+				}
+				if (!thp_rows[t]) {
+					(void)munmap(mapping, sizes[i]);
+					continue;
+				}
+				for (m = 0; (m < PROCMATRIX_METHODS) && stress_continue(args); m++) {
+					stress_procmatrix_cell_t *cell = &cells[i][t][m];
+					const double t_end = stress_time_now() + PROCMATRIX_CELL_TIME;
+					int n;
+
+					if (!supported[m])
+						continue;
+					for (n = 0; n < PROCMATRIX_CELL_MAX; n++) {
+						const double t1 = stress_time_now();
+						double t2;
+						bool exit_ok;
+						pid_t pid;
+
+						pid = stress_procmatrix_create(m, exec_path, stack_top, &clone3_ok, &exit_ok);
+						t2 = stress_time_now();
+						if (pid < 0) {
+							if ((errno == ENOSYS) || (errno == EPERM) ||
+							    (errno == EACCES) || (errno == ENOENT) ||
+							    (errno == ENOEXEC)) {
+								pr_dbg("%s: %s not usable, errno=%d (%s), disabling method\n",
+									args->name, stress_procmatrix_methods[m].name,
+									errno, strerror(errno));
+								supported[m] = false;
+								break;
+							}
+							if ((errno != EAGAIN) && (errno != ENOMEM) && (errno != EINTR))
+								cell->failed++;
+							break;
+						}
+						if (exit_ok)
+							stress_latency_add(&cell->latency, (uint64_t)((t2 - t1) * STRESS_DBL_NANOSECOND));
+						else
+							cell->failed++;
+						stress_bogo_inc(args);
+						if ((t2 >= t_end) || !stress_continue(args))
+							break;
+					}
+				}
+				(void)munmap(mapping, sizes[i]);
+			}
+		}
+	} while (stress_continue(args));
+
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	/*
+	 *  Metrics for the smallest and largest sizes, the full
+	 *  matrix is too large for the metrics table
+	 */
+	idx = 0;
+	for (t = 0; t < 2; t++) {
+		const size_t rows[2] = { 0, n_sizes - 1 };
+		size_t r;
+
+		if (!thp_rows[t])
+			continue;
+		for (r = 0; r < ((n_sizes > 1) ? 2 : 1); r++) {
+			char sz[16];
+
+			stress_procmatrix_size_str(sizes[rows[r]], sz, sizeof(sz));
+			for (m = 0; m < PROCMATRIX_METHODS; m++) {
+				const stress_latency_t *lat = &cells[rows[r]][t][m].latency;
+				char desc[64];
+
+				if (!supported[m] || (lat->count == 0))
+					continue;
+				(void)snprintf(desc, sizeof(desc), "usec %s %s%s",
+					stress_procmatrix_methods[m].name, sz, t ? " thp" : "");
+				stress_metrics_set(args, idx++, desc,
+					stress_latency_mean(lat) / 1000.0, STRESS_GEOMETRIC_MEAN);
+			}
+		}
+	}
+
+	for (i = 0; i < n_sizes; i++)
+		for (t = 0; t < 2; t++)
+			for (m = 0; m < PROCMATRIX_METHODS; m++)
+				failed += cells[i][t][m].failed;
+	if (failed > 0) {
+		pr_fail("%s: %" PRIu64 " process creations failed or exited with an error\n",
+			args->name, failed);
+		rc = EXIT_FAILURE;
+	}
+
+	if (args->instance == 0) {
+		pr_block_begin();
+		stress_procmatrix_table(args, cells, sizes, n_sizes, thp_rows, supported, 0.0);
+		stress_procmatrix_table(args, cells, sizes, n_sizes, thp_rows, supported, 99.0);
+		pr_block_end();
+	}
+
+	(void)munmap(stack, PROCMATRIX_CLONE_STACK_SIZE);
+	free(cells);
+
+	return rc;
+}
+
+stressor_info_t stress_procmatrix_info = {
+	.stressor = stress_procmatrix,
+	.class = CLASS_SCHEDULER | CLASS_OS | CLASS_VM,
+	.opt_set_funcs = opt_set_funcs,
+	.verify = VERIFY_ALWAYS,
+	.help = help
+};
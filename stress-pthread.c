@@ -20,6 +20,7 @@
 #include "stress-ng.h"
 #include "core-arch.h"
 #include "core-builtin.h"
+#include "core-latency.h"
 #include "core-pthread.h"
 
 #if defined(HAVE_MODIFY_LDT)
@@ -52,6 +53,7 @@
 
 static const stress_help_t help[] = {
 	{ NULL,	"pthread N",	 "start N workers that create multiple threads" },
+	{ NULL,	"pthread-bench", "benchmark thread create+join against a futex worker pool" },
 	{ NULL,	"pthread-max P", "create P threads at a time by each worker" },
 	{ NULL,	"pthread-ops N", "stop pthread workers after N bogo threads created" },
 	{ NULL,	NULL,		 NULL }
@@ -91,7 +93,13 @@ static int stress_set_pthread_max(const char *opt)
 	return stress_set_setting("pthread-max", TYPE_ID_UINT64, &pthread_max);
 }
 
+static int stress_set_pthread_bench(const char *opt)
+{
+	return stress_set_setting_true("pthread-bench", opt);
+}
+
 static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_pthread_bench,	stress_set_pthread_bench },
 	{ OPT_pthread_max,	stress_set_pthread_max },
 	{ 0,			NULL }
 };
@@ -433,6 +441,465 @@ die:
 	return &nowt;
 }
 
+#define PTHREAD_BENCH_STACKS		(5)
+#define PTHREAD_BENCH_LIVE_MAX		(9)
+#define PTHREAD_BENCH_LIVE_SHIFT	(2)
+#define PTHREAD_BENCH_CELL_TIME		(0.1)
+#define PTHREAD_BENCH_WAIT_NS		(10000000)
+
+#if defined(HAVE_LINUX_FUTEX_H) &&	\
+    defined(__NR_futex) &&		\
+    defined(HAVE_SYSCALL) &&		\
+    defined(HAVE_ATOMIC_LOAD) &&	\
+    defined(HAVE_ATOMIC_STORE) &&	\
+    defined(HAVE_ATOMIC_ADD_FETCH)
+#define STRESS_PTHREAD_POOL
+#endif
+
+/* per stack size and live thread count benchmark results */
+typedef struct {
+	stress_latency_t create;	/* pthread_create call latency */
+	stress_latency_t first_run;	/* create or post to first run latency */
+	stress_latency_t churn;		/* create+join or job cost per thread */
+	uint64_t limited;		/* rounds cut short by EAGAIN */
+} stress_pthread_bench_cell_t;
+
+#if defined(STRESS_PTHREAD_POOL)
+/* reusable pool worker, woken by a futex handoff */
+typedef struct {
+	pthread_t pthread;		/* The pthread */
+	int	  ret;			/* pthread create return */
+	uint32_t  go;			/* futex, bumped for each job */
+	volatile double t_post;		/* time job was posted */
+	volatile double t_run;		/* time worker started the job */
+} ALIGN64 stress_pthread_pool_worker_t;
+
+static uint32_t pool_done;		/* futex, jobs done this round */
+static uint32_t pool_jobs;		/* jobs posted this round */
+static uint32_t pool_stop;		/* 1 = workers should exit */
+#endif
+
+/*
+ *  stress_pthread_bench_func()
+ *	short lived thread, just note when it first ran
+ */
+static void *stress_pthread_bench_func(void *parg)
+{
+	static void *nowt = NULL;
+	stress_pthread_info_t *pthread_info = (stress_pthread_info_t *)parg;
+
+	pthread_info->t_run = stress_time_now();
+	return &nowt;
+}
+
+/*
+ *  stress_pthread_bench_spawn()
+ *	create live threads back to back then join them all,
+ *	returns false on an unexpected pthread failure
+ */
+static bool stress_pthread_bench_spawn(
+	stress_args_t *args,
+	pthread_attr_t *attr,
+	const uint32_t live,
+	stress_pthread_bench_cell_t *cell)
+{
+	uint32_t i, j;
+	bool ok = true;
+	const double t_start = stress_time_now();
+	double t_end;
+
+	for (i = 0; i < live; i++) {
+		double t;
+
+		pthreads[i].t_create = stress_time_now();
+		pthreads[i].t_run = pthreads[i].t_create;
+		pthreads[i].ret = pthread_create(&pthreads[i].pthread, attr,
+			stress_pthread_bench_func, (void *)&pthreads[i]);
+		t = stress_time_now();
+		if (pthreads[i].ret) {
+			if ((pthreads[i].ret == EAGAIN) || (pthreads[i].ret == ENOMEM)) {
+				cell->limited++;
+			} else {
+				pr_fail("%s: pthread_create failed, errno=%d (%s)\n",
+					args->name, pthreads[i].ret, strerror(pthreads[i].ret));
+				ok = false;
+			}
+			break;
+		}
+		stress_latency_add(&cell->create,
+			(uint64_t)((t - pthreads[i].t_create) * STRESS_DBL_NANOSECOND));
+		stress_bogo_inc(args);
+	}
+
+	for (j = 0; j < i; j++) {
+		int ret;
+
+		ret = pthread_join(pthreads[j].pthread, NULL);
+		if ((ret) && (ret != ESRCH)) {
+			pr_fail("%s: pthread_join failed, errno=%d (%s)\n",
+				args->name, ret, strerror(ret));
+			ok = false;
+			continue;
+		}
+		if (pthreads[j].t_run >= pthreads[j].t_create)
+			stress_latency_add(&cell->first_run,
+				(uint64_t)((pthreads[j].t_run - pthreads[j].t_create) * STRESS_DBL_NANOSECOND));
+	}
+	t_end = stress_time_now();
+	if (i > 0)
+		stress_latency_add(&cell->churn,
+			(uint64_t)(((t_end - t_start) / (double)i) * STRESS_DBL_NANOSECOND));
+	return ok;
+}
+
+#if defined(STRESS_PTHREAD_POOL)
+/*
+ *  stress_pthread_pool_func()
+ *	pool worker, sleep on the go futex until a job
+ *	is posted, note when it ran and flag it as done
+ */
+static void *stress_pthread_pool_func(void *parg)
+{
+	static void *nowt = NULL;
+	stress_pthread_pool_worker_t *worker = (stress_pthread_pool_worker_t *)parg;
+	uint32_t seen = 0;
+
+	for (;;) {
+		const uint32_t go = __atomic_load_n(&worker->go, __ATOMIC_ACQUIRE);
+
+		if (go == seen) {
+			struct timespec timeout;
+
+			if (__atomic_load_n(&pool_stop, __ATOMIC_ACQUIRE))
+				break;
+			timeout.tv_sec = 0;
+			timeout.tv_nsec = PTHREAD_BENCH_WAIT_NS;
+			(void)shim_futex_wait(&worker->go, (int)seen, &timeout);
+			continue;
+		}
+		seen = go;
+		worker->t_run = stress_time_now();
+		if (__atomic_add_fetch(&pool_done, 1, __ATOMIC_RELEASE) >=
+		    __atomic_load_n(&pool_jobs, __ATOMIC_ACQUIRE))
+			(void)shim_futex_wake(&pool_done, 1);
+	}
+	return &nowt;
+}
+
+/*
+ *  stress_pthread_bench_pool()
+ *	start a pool of live workers and hand each one a job
+ *	per round for the cell time, returns false on an
+ *	unexpected pthread failure
+ */
+static bool stress_pthread_bench_pool(
+	stress_args_t *args,
+	stress_pthread_pool_worker_t *workers,
+	const uint32_t live,
+	stress_pthread_bench_cell_t *cell)
+{
+	uint32_t i, j, n;
+	bool ok = true;
+	const double t_end = stress_time_now() + PTHREAD_BENCH_CELL_TIME;
+
+	__atomic_store_n(&pool_stop, 0, __ATOMIC_RELEASE);
+	for (n = 0; n < live; n++) {
+		workers[n].go = 0;
+		workers[n].ret = pthread_create(&workers[n].pthread, NULL,
+			stress_pthread_pool_func, (void *)&workers[n]);
+		if (workers[n].ret) {
+			if ((workers[n].ret == EAGAIN) || (workers[n].ret == ENOMEM)) {
+				cell->limited++;
+			} else {
+				pr_fail("%s: pthread_create failed, errno=%d (%s)\n",
+					args->name, workers[n].ret, strerror(workers[n].ret));
+				ok = false;
+			}
+			break;
+		}
+	}
+
+	while (ok && (n > 0) && keep_running() && stress_continue(args)) {
+		uint32_t done;
+		double t_start, t;
+
+		__atomic_store_n(&pool_done, 0, __ATOMIC_RELEASE);
+		__atomic_store_n(&pool_jobs, n, __ATOMIC_RELEASE);
+		t_start = stress_time_now();
+		for (i = 0; i < n; i++) {
+			workers[i].t_post = stress_time_now();
+			(void)__atomic_add_fetch(&workers[i].go, 1, __ATOMIC_RELEASE);
+			(void)shim_futex_wake(&workers[i].go, 1);
+		}
+		while ((done = __atomic_load_n(&pool_done, __ATOMIC_ACQUIRE)) < n) {
+			struct timespec timeout;
+
+			timeout.tv_sec = 0;
+			timeout.tv_nsec = PTHREAD_BENCH_WAIT_NS;
+			(void)shim_futex_wait(&pool_done, (int)done, &timeout);
+			if (!keep_running())
+				break;
+		}
+		if (done < n)
+			break;
+		t = stress_time_now();
+		for (i = 0; i < n; i++) {
+			if (workers[i].t_run >= workers[i].t_post)
+				stress_latency_add(&cell->first_run,
+					(uint64_t)((workers[i].t_run - workers[i].t_post) * STRESS_DBL_NANOSECOND));
+		}
+		stress_latency_add(&cell->churn,
+			(uint64_t)(((t - t_start) / (double)n) * STRESS_DBL_NANOSECOND));
+		stress_bogo_add(args, (uint64_t)n);
+		if (t >= t_end)
+			break;
+	}
+
+	__atomic_store_n(&pool_stop, 1, __ATOMIC_RELEASE);
+	for (j = 0; j < n; j++) {
+		int ret;
+
+		(void)__atomic_add_fetch(&workers[j].go, 1, __ATOMIC_RELEASE);
+		(void)shim_futex_wake(&workers[j].go, 1);
+		ret = pthread_join(workers[j].pthread, NULL);
+		if ((ret) && (ret != ESRCH)) {
+			pr_fail("%s: pthread_join failed, errno=%d (%s)\n",
+				args->name, ret, strerror(ret));
+			ok = false;
+		}
+	}
+	return ok;
+}
+#endif
+
+/*
+ *  stress_pthread_bench_stack_str()
+ *	human readable stack size
+ */
+static void stress_pthread_bench_stack_str(const size_t size, char *buf, const size_t len)
+{
+	if (size == 0)
+		(void)snprintf(buf, len, "default");
+	else if (size >= MB)
+		(void)snprintf(buf, len, "%zuM", size / (size_t)MB);
+	else
+		(void)snprintf(buf, len, "%zuK", size / (size_t)KB);
+}
+
+/*
+ *  stress_pthread_bench_table()
+ *	print a stack size x live threads table in microseconds,
+ *	the last row is the futex worker pool
+ */
+static void stress_pthread_bench_table(
+	stress_args_t *args,
+	stress_pthread_bench_cell_t cells[][PTHREAD_BENCH_LIVE_MAX],
+	const size_t *stacks,
+	const size_t n_stacks,
+	const uint32_t *lives,
+	const size_t n_lives,
+	const bool churn)
+{
+	char line[256];
+	size_t s, l;
+	int len;
+
+	if (churn)
+		pr_inf("%s: mean create+join cost per thread, pool job cost per thread (usec):\n", args->name);
+	else
+		pr_inf("%s: p99 create to first run, pool post to first run latency (usec):\n", args->name);
+	len = snprintf(line, sizeof(line), "%-8s", "stack");
+	for (l = 0; l < n_lives; l++)
+		len += snprintf(line + len, sizeof(line) - (size_t)len, " %9" PRIu32, lives[l]);
+	pr_inf("%s: %s\n", args->name, line);
+
+	for (s = 0; s <= n_stacks; s++) {
+		char sz[16];
+
+		if (s < n_stacks)
+			stress_pthread_bench_stack_str(stacks[s], sz, sizeof(sz));
+		else
+			(void)snprintf(sz, sizeof(sz), "pool");
+		len = snprintf(line, sizeof(line), "%-8s", sz);
+		for (l = 0; l < n_lives; l++) {
+			const stress_latency_t *lat = churn ?
+				&cells[s][l].churn : &cells[s][l].first_run;
+
+			if (lat->count == 0) {
+				len += snprintf(line + len, sizeof(line) - (size_t)len, " %9s", "-");
+			} else {
+				const double usec = churn ?
+					stress_latency_mean(lat) / 1000.0 :
+					(double)stress_latency_percentile(lat, 99.0) / 1000.0;
+
+				len += snprintf(line + len, sizeof(line) - (size_t)len, " %9.2f", usec);
+			}
+		}
+		pr_inf("%s: %s\n", args->name, line);
+	}
+}
+
+/*
+ *  stress_pthread_bench()
+ *	benchmark short lived thread churn, sweeping stack size
+ *	and the number of concurrently live threads, against
+ *	handing the same work to a reusable futex worker pool
+ */
+static int stress_pthread_bench(stress_args_t *args, const uint64_t pthread_max)
+{
+	size_t stacks[PTHREAD_BENCH_STACKS], n_stacks = 0;
+	uint32_t lives[PTHREAD_BENCH_LIVE_MAX], live;
+	size_t n_lives = 0, s, l, idx;
+	stress_pthread_bench_cell_t (*cells)[PTHREAD_BENCH_LIVE_MAX];
+#if defined(STRESS_PTHREAD_POOL)
+	stress_pthread_pool_worker_t *workers;
+#endif
+	uint64_t limited = 0;
+	int rc = EXIT_SUCCESS;
+	bool ok = true;
+
+#if defined(HAVE_PTHREAD_ATTR_SETSTACK)
+	{
+		static const size_t stack_sizes[] = {
+			64 * KB, 256 * KB, 1 * MB, 8 * MB
+		};
+		const size_t stack_min = STRESS_MAXIMUM(DEFAULT_STACK_MIN, stress_get_min_pthread_stack_size());
+
+		stacks[n_stacks++] = stack_min;
+		for (s = 0; s < SIZEOF_ARRAY(stack_sizes); s++)
+			if (stack_sizes[s] > stack_min)
+				stacks[n_stacks++] = stack_sizes[s];
+	}
+#else
+	stacks[n_stacks++] = 0;
+#endif
+	for (live = 1; (live <= pthread_max) && (n_lives < PTHREAD_BENCH_LIVE_MAX - 1); live <<= PTHREAD_BENCH_LIVE_SHIFT)
+		lives[n_lives++] = live;
+	if (lives[n_lives - 1] != (uint32_t)pthread_max)
+		lives[n_lives++] = (uint32_t)pthread_max;
+
+	cells = calloc(n_stacks + 1, sizeof(*cells));
+	if (!cells) {
+		pr_inf_skip("%s: cannot allocate benchmark results, skipping stressor\n", args->name);
+		return EXIT_NO_RESOURCE;
+	}
+	for (s = 0; s <= n_stacks; s++) {
+		for (l = 0; l < n_lives; l++) {
+			stress_latency_init(&cells[s][l].create);
+			stress_latency_init(&cells[s][l].first_run);
+			stress_latency_init(&cells[s][l].churn);
+		}
+	}
+#if defined(STRESS_PTHREAD_POOL)
+	workers = calloc((size_t)pthread_max, sizeof(*workers));
+	if (!workers) {
+		pr_inf_skip("%s: cannot allocate worker pool, skipping stressor\n", args->name);
+		free(cells);
+		return EXIT_NO_RESOURCE;
+	}
+#endif
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+	/*
+	 *  Each sweep runs every stack size and live thread count
+	 *  cell followed by the pool for a short slice, results
+	 *  accumulate over sweeps until the run ends
+	 */
+	do {
+		for (s = 0; ok && (s < n_stacks) && keep_running() && stress_continue(args); s++) {
+			pthread_attr_t attr;
+			int ret;
+
+			ret = pthread_attr_init(&attr);
+			if (ret) {
+				pr_fail("%s: pthread_attr_init failed, errno=%d (%s)\n",
+					args->name, ret, strerror(ret));
+				ok = false;
+				break;
+			}
+#if defined(HAVE_PTHREAD_ATTR_SETSTACK)
+			ret = pthread_attr_setstacksize(&attr, stacks[s]);
+			if (ret) {
+				pr_fail("%s: pthread_attr_setstacksize %zu failed, errno=%d (%s)\n",
+					args->name, stacks[s], ret, strerror(ret));
+				(void)pthread_attr_destroy(&attr);
+				ok = false;
+				break;
+			}
+#endif
+			for (l = 0; ok && (l < n_lives) && keep_running() && stress_continue(args); l++) {
+				const double t_end = stress_time_now() + PTHREAD_BENCH_CELL_TIME;
+
+				do {
+					ok = stress_pthread_bench_spawn(args, &attr, lives[l], &cells[s][l]);
+				} while (ok && (stress_time_now() < t_end) &&
+					 keep_running() && stress_continue(args));
+			}
+			(void)pthread_attr_destroy(&attr);
+		}
+#if defined(STRESS_PTHREAD_POOL)
+		for (l = 0; ok && (l < n_lives) && keep_running() && stress_continue(args); l++)
+			ok = stress_pthread_bench_pool(args, workers, lives[l], &cells[n_stacks][l]);
+#endif
+	} while (ok && keep_running() && stress_continue(args));
+
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	if (!ok)
+		rc = EXIT_FAILURE;
+
+	/*
+	 *  Metrics for a single thread and the largest number of live
+	 *  threads with the smallest stack and the pool, the full
+	 *  sweep is too large for the metrics table
+	 */
+	idx = 0;
+	idx = stress_latency_metrics_set(args, idx, "create+join", &cells[0][0].churn);
+	idx = stress_latency_metrics_set(args, idx, "create to run", &cells[0][0].first_run);
+	idx = stress_latency_metrics_set(args, idx, "pool job", &cells[n_stacks][0].churn);
+	idx = stress_latency_metrics_set(args, idx, "pool post to run", &cells[n_stacks][0].first_run);
+	if (n_lives > 1) {
+		const stress_latency_t *churn = &cells[0][n_lives - 1].churn;
+		const stress_latency_t *pool = &cells[n_stacks][n_lives - 1].churn;
+		char desc[64];
+
+		if (churn->count > 0) {
+			(void)snprintf(desc, sizeof(desc), "usec create+join per thread, %" PRIu32 " live",
+				lives[n_lives - 1]);
+			stress_metrics_set(args, idx++, desc,
+				stress_latency_mean(churn) / 1000.0, STRESS_GEOMETRIC_MEAN);
+		}
+		if (pool->count > 0) {
+			(void)snprintf(desc, sizeof(desc), "usec pool job per thread, %" PRIu32 " live",
+				lives[n_lives - 1]);
+			stress_metrics_set(args, idx++, desc,
+				stress_latency_mean(pool) / 1000.0, STRESS_GEOMETRIC_MEAN);
+		}
+	}
+
+	for (s = 0; s <= n_stacks; s++)
+		for (l = 0; l < n_lives; l++)
+			limited += cells[s][l].limited;
+	if (limited > 0)
+		pr_dbg("%s: %" PRIu64 " rounds were limited by thread resources\n",
+			args->name, limited);
+
+	if (args->instance == 0) {
+		pr_block_begin();
+		stress_pthread_bench_table(args, cells, stacks, n_stacks, lives, n_lives, true);
+		stress_pthread_bench_table(args, cells, stacks, n_stacks, lives, n_lives, false);
+		pr_block_end();
+	}
+
+#if defined(STRESS_PTHREAD_POOL)
+	free(workers);
+#endif
+	free(cells);
+
+	return rc;
+}
+
 /*
  *  stress_pthread()
  *	stress by creating pthreads
@@ -440,7 +907,7 @@ die:
 static int stress_pthread(stress_args_t *args)
 {
 	char msg[64];
-	bool locked = false;
+	bool locked = false, pthread_bench = false;
 	uint64_t limited = 0, attempted = 0, maximum = 0;
 	uint64_t pthread_max = DEFAULT_PTHREAD;
 	int ret;
@@ -476,6 +943,9 @@ static int stress_pthread(stress_args_t *args)
 		if (g_opt_flags & OPT_FLAGS_MINIMIZE)
 			pthread_max = MIN_PTHREAD;
 	}
+	(void)stress_get_setting("pthread-bench", &pthread_bench);
+	if (pthread_bench)
+		return stress_pthread_bench(args, pthread_max);
 
 	ret = pthread_cond_init(&cond, NULL);
 	if (ret) {
@@ -39,6 +39,13 @@ static const stress_help_t help[] = {
 #define	MIN_BLKSZ	((int)512)
 #define	MAX_BLKSZ	((int)(128 * KB))
 
+#define RAWDEV_SWEEP_MIN_SZ	((size_t)512)
+#define RAWDEV_SWEEP_MAX_SZ	((size_t)(4 * MB))
+#define RAWDEV_SWEEP_SIZES	(14)	/* 512 bytes .. 4MB in powers of 2 */
+#define RAWDEV_SWEEP_ALIGNS	(8)	/* maximum alignment offsets to sweep */
+#define RAWDEV_SWEEP_ALIGN_SPAN	((size_t)4096)
+#define RAWDEV_SWEEP_KNEE	(0.90)	/* knee is at 90% of peak throughput */
+
 #if defined(HAVE_SYS_SYSMACROS_H) &&	\
     defined(BLKGETSIZE) && 		\
     defined(BLKSSZGET)
@@ -53,6 +60,15 @@ typedef struct {
 	const stress_rawdev_func func;
 } stress_rawdev_method_info_t;
 
+typedef struct {
+	double	duration;	/* total time spent reading */
+	double	bytes;		/* total bytes read */
+	double	count;		/* number of reads */
+} stress_rawdev_sweep_t;
+
+static stress_rawdev_sweep_t rawdev_sweep_sizes[RAWDEV_SWEEP_SIZES];
+static stress_rawdev_sweep_t rawdev_sweep_aligns[RAWDEV_SWEEP_ALIGNS];
+
 /*
  *  stress_rawdev_supported()
  *      check if we can run this as root
@@ -300,6 +316,153 @@ static int stress_rawdev_burst(
 	return 0;
 }
 
+/*
+ *  stress_rawdev_blksweep_naligns()
+ *	number of alignment offsets (in logical block size steps)
+ *	to sweep across, at least 1 (the aligned case)
+ */
+static inline size_t stress_rawdev_blksweep_naligns(const size_t blksz)
+{
+	const size_t naligns = RAWDEV_SWEEP_ALIGN_SPAN / blksz;
+
+	if (naligns < 1)
+		return 1;
+	return (naligns > RAWDEV_SWEEP_ALIGNS) ? RAWDEV_SWEEP_ALIGNS : naligns;
+}
+
+/*
+ *  stress_rawdev_blksweep()
+ *	read at random locations across a device with request sizes
+ *	from 512 bytes to 4MB, each one at a range of alignment offsets.
+ *	The buffer must be at least RAWDEV_SWEEP_MAX_SZ bytes in size.
+ */
+static int stress_rawdev_blksweep(
+	stress_args_t *args,
+	const int fd,
+	char *buffer,
+	const size_t blks,
+	const size_t blksz,
+	stress_metrics_t *metrics)
+{
+	/* BLKGETSIZE reports the device size in 512 byte sectors */
+	const off_t dev_size = (off_t)blks * 512;
+	const size_t naligns = stress_rawdev_blksweep_naligns(blksz);
+	size_t i, sz;
+
+	for (i = 0, sz = RAWDEV_SWEEP_MIN_SZ;
+	     (i < RAWDEV_SWEEP_SIZES) && stress_continue(args);
+	     i++, sz <<= 1) {
+		size_t j;
+		off_t base;
+
+		if (sz < blksz)
+			continue;
+		if ((off_t)(sz + RAWDEV_SWEEP_ALIGN_SPAN) >= dev_size)
+			break;
+		/* random request size aligned start position */
+		base = (off_t)sz * (off_t)stress_mwc64modn(
+			(uint64_t)((dev_size - (off_t)(sz + RAWDEV_SWEEP_ALIGN_SPAN)) / (off_t)sz));
+
+		for (j = 0; (j < naligns) && stress_continue(args); j++) {
+			ssize_t ret;
+			const off_t offset = base + (off_t)(j * blksz);
+			double t;
+
+			t = stress_time_now();
+			ret = pread(fd, buffer, sz, offset);
+			if (UNLIKELY(ret < 0)) {
+				if (errno != EINTR) {
+					pr_fail("%s: pread of %zd bytes at %ju failed, errno=%d (%s)\n",
+						args->name, sz, (intmax_t)offset, errno, strerror(errno));
+					return -1;
+				}
+			} else {
+				const double duration = stress_time_now() - t;
+
+				metrics->duration += duration;
+				metrics->count += ret;
+
+				rawdev_sweep_sizes[i].duration += duration;
+				rawdev_sweep_sizes[i].bytes += ret;
+				rawdev_sweep_sizes[i].count += 1.0;
+				rawdev_sweep_aligns[j].duration += duration;
+				rawdev_sweep_aligns[j].bytes += ret;
+				rawdev_sweep_aligns[j].count += 1.0;
+				stress_bogo_inc(args);
+			}
+		}
+	}
+	return 0;
+}
+
+/*
+ *  stress_rawdev_blksweep_report()
+ *	report throughput and latency per request size and per
+ *	alignment offset and find the knee where throughput
+ *	saturates, returns the knee size or 0 if not known
+ */
+static size_t stress_rawdev_blksweep_report(
+	stress_args_t *args,
+	const size_t blksz,
+	double *knee_rate)
+{
+	const size_t naligns = stress_rawdev_blksweep_naligns(blksz);
+	size_t i, sz, knee = 0;
+	double peak = 0.0;
+
+	*knee_rate = 0.0;
+	for (i = 0; i < RAWDEV_SWEEP_SIZES; i++) {
+		const stress_rawdev_sweep_t *s = &rawdev_sweep_sizes[i];
+
+		if (s->duration > 0.0) {
+			const double rate = s->bytes / s->duration;
+
+			if (rate > peak)
+				peak = rate;
+		}
+	}
+	if (peak <= 0.0)
+		return 0;
+
+	if (args->instance == 0) {
+		pr_inf("%s: %10s %12s %14s\n", args->name,
+			"size", "MB per sec", "latency (us)");
+	}
+	for (i = 0, sz = RAWDEV_SWEEP_MIN_SZ; i < RAWDEV_SWEEP_SIZES; i++, sz <<= 1) {
+		const stress_rawdev_sweep_t *s = &rawdev_sweep_sizes[i];
+		double rate;
+
+		if ((s->duration <= 0.0) || (s->count <= 0.0))
+			continue;
+		rate = s->bytes / s->duration;
+		if ((knee == 0) && (rate >= peak * RAWDEV_SWEEP_KNEE)) {
+			knee = sz;
+			*knee_rate = rate;
+		}
+		if (args->instance == 0) {
+			pr_inf("%s: %9zdK %12.2f %14.2f%s\n", args->name,
+				sz / (size_t)KB, rate / (double)MB,
+				STRESS_DBL_MICROSECOND * s->duration / s->count,
+				(sz == knee) ? " (knee)" : "");
+		}
+	}
+
+	if ((args->instance == 0) && (naligns > 1)) {
+		pr_inf("%s: %10s %12s %14s\n", args->name,
+			"offset", "MB per sec", "latency (us)");
+		for (i = 0; i < naligns; i++) {
+			const stress_rawdev_sweep_t *s = &rawdev_sweep_aligns[i];
+
+			if ((s->duration <= 0.0) || (s->count <= 0.0))
+				continue;
+			pr_inf("%s: %10zd %12.2f %14.2f\n", args->name,
+				i * blksz, (s->bytes / s->duration) / (double)MB,
+				STRESS_DBL_MICROSECOND * s->duration / s->count);
+		}
+	}
+	return knee;
+}
+
 static int stress_rawdev_all(
 	stress_args_t *args,
 	const int fd,
@@ -318,6 +481,7 @@ static const stress_rawdev_method_info_t rawdev_methods[] = {
 	{ "ends",	stress_rawdev_ends },
 	{ "random",	stress_rawdev_random },
 	{ "burst",	stress_rawdev_burst },
+	{ "blksweep",	stress_rawdev_blksweep },
 };
 
 /*
@@ -398,7 +562,7 @@ static int stress_rawdev(stress_args_t *args)
 	int ret, fd;
 	char *devpath, *buffer;
 	const char *path = stress_get_temp_path();
-	size_t blks, blksz = 0, mmapsz;
+	size_t blks, blksz = 0, bufsz, mmapsz;
 	size_t i, j, rawdev_method = 0;
 	const size_t page_size = args->page_size;
 	stress_rawdev_func func;
@@ -462,13 +626,16 @@ static int stress_rawdev(stress_args_t *args)
 	if (blksz < MIN_BLKSZ)
 		blksz = MIN_BLKSZ;
 
-	mmapsz = ((blksz + page_size - 1) & ~(page_size - 1));
+	/* blksweep method needs a buffer for the largest request size */
+	bufsz = ((func == stress_rawdev_all) || (func == stress_rawdev_blksweep)) ?
+		RAWDEV_SWEEP_MAX_SZ : blksz;
+	mmapsz = ((bufsz + page_size - 1) & ~(page_size - 1));
 	buffer = stress_mmap_populate(NULL, mmapsz,
 			PROT_READ | PROT_WRITE,
 			MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
 	if (buffer == MAP_FAILED) {
 		pr_inf("%s: cannot allocate buffer of %zd bytes with %zd allocation\n",
-			args->name, blksz, mmapsz);
+			args->name, bufsz, mmapsz);
 		(void)close(fd);
 		free(metrics);
 		return EXIT_NO_RESOURCE;
@@ -510,6 +677,18 @@ static int stress_rawdev(stress_args_t *args)
 			j++;
 		}
 	}
+	if ((func == stress_rawdev_all) || (func == stress_rawdev_blksweep)) {
+		double knee_rate;
+		const size_t knee = stress_rawdev_blksweep_report(args, blksz, &knee_rate);
+
+		if (knee > 0) {
+			stress_metrics_set(args, j, "KB request size at throughput knee",
+				(double)knee / (double)KB, STRESS_GEOMETRIC_MEAN);
+			j++;
+			stress_metrics_set(args, j, "MB per sec read rate at throughput knee",
+				knee_rate / (double)MB, STRESS_HARMONIC_MEAN);
+		}
+	}
 
 	(void)munmap((void *)buffer, mmapsz);
 	(void)close(fd);
@@ -0,0 +1,507 @@
+/*
+ * Copyright (C) 2024 Colin Ian King.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+#include "core-builtin.h"
+
+#define MIN_READPATH_BYTES		(1 * MB)
+#define MAX_READPATH_BYTES		(MAX_FILE_LIMIT)
+#define DEFAULT_READPATH_BYTES		(64 * MB)
+
+#define MIN_READPATH_BLOCK_SIZE		(4 * KB)
+#define MAX_READPATH_BLOCK_SIZE		(4 * MB)
+#define DEFAULT_READPATH_BLOCK_SIZE	(64 * KB)
+
+#define READPATH_ALIGNMENT		(4096)
+#define READPATH_MAX_BLOCKS		(16 * 1024 * 1024)
+
+static const stress_help_t help[] = {
+	{ NULL,	"readpath N",		  "start N workers comparing buffered, O_DIRECT and mmap reads" },
+	{ NULL,	"readpath-block-size N",  "size of each read (default is 64K)" },
+	{ NULL,	"readpath-bytes N",	  "size of file to read (default is 64MB)" },
+	{ NULL,	"readpath-ops N",	  "stop after N readpath block reads" },
+	{ NULL,	"readpath-random",	  "read blocks in random rather than sequential order" },
+	{ NULL,	NULL,			  NULL }
+};
+
+static int stress_set_readpath_bytes(const char *opt)
+{
+	uint64_t readpath_bytes;
+
+	readpath_bytes = stress_get_uint64_byte_filesystem(opt, 1);
+	stress_check_range_bytes("readpath-bytes", readpath_bytes,
+		MIN_READPATH_BYTES, MAX_READPATH_BYTES);
+	return stress_set_setting("readpath-bytes", TYPE_ID_UINT64, &readpath_bytes);
+}
+
+static int stress_set_readpath_block_size(const char *opt)
+{
+	size_t readpath_block_size;
+
+	readpath_block_size = (size_t)stress_get_uint64_byte(opt);
+	stress_check_range_bytes("readpath-block-size", (uint64_t)readpath_block_size,
+		MIN_READPATH_BLOCK_SIZE, MAX_READPATH_BLOCK_SIZE);
+	if (readpath_block_size & (READPATH_ALIGNMENT - 1)) {
+		(void)fprintf(stderr, "Value for option --readpath-block-size %zu must be a multiple of %d\n",
+			readpath_block_size, READPATH_ALIGNMENT);
+		longjmp(g_error_env, 1);
+	}
+	return stress_set_setting("readpath-block-size", TYPE_ID_SIZE_T, &readpath_block_size);
+}
+
+static int stress_set_readpath_random(const char *opt)
+{
+	return stress_set_setting_true("readpath-random", opt);
+}
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_readpath_block_size,	stress_set_readpath_block_size },
+	{ OPT_readpath_bytes,		stress_set_readpath_bytes },
+	{ OPT_readpath_random,		stress_set_readpath_random },
+	{ 0,				NULL }
+};
+
+struct stress_readpath;
+
+typedef int (*stress_readpath_func_t)(struct stress_readpath *rp, const size_t block);
+
+/*
+ *  per read path state, each path reads the same blocks
+ *  in the same order with the same block size
+ */
+typedef struct stress_readpath {
+	stress_args_t *args;		/* stressor args */
+	const char *fs_type;		/* file system type */
+	const char *filename;		/* file to read */
+	uint8_t *buf;			/* aligned read buffer */
+	size_t block_size;		/* read size */
+	int fd;				/* fd for current path */
+	uint8_t *mapped;		/* mmap'd file for mmap path */
+	uint64_t file_size;		/* size of file */
+} stress_readpath_t;
+
+typedef struct {
+	const char *name;		/* read path name */
+	int (*open)(stress_readpath_t *rp);
+	stress_readpath_func_t read;	/* read a block */
+	void (*close)(stress_readpath_t *rp);
+	double duration;		/* total time reading */
+	double cpu_time;		/* total user + system time */
+	double bytes;			/* total bytes read */
+	double faults;			/* total page faults */
+	bool skipped;			/* true if path not supported */
+} stress_readpath_method_t;
+
+/*
+ *  stress_readpath_drop_cache()
+ *	drop cached pages of the file so each path starts cold
+ */
+static void stress_readpath_drop_cache(const int fd, const uint64_t file_size)
+{
+#if defined(HAVE_POSIX_FADVISE) &&	\
+    defined(POSIX_FADV_DONTNEED)
+	(void)posix_fadvise(fd, 0, (off_t)file_size, POSIX_FADV_DONTNEED);
+#else
+	(void)fd;
+	(void)file_size;
+#endif
+}
+
+static int stress_readpath_buffered_open(stress_readpath_t *rp)
+{
+	rp->fd = open(rp->filename, O_RDONLY);
+	return (rp->fd < 0) ? -1 : 0;
+}
+
+static int stress_readpath_direct_open(stress_readpath_t *rp)
+{
+#if defined(O_DIRECT)
+	rp->fd = open(rp->filename, O_RDONLY | O_DIRECT);
+	return (rp->fd < 0) ? -1 : 0;
+#else
+	(void)rp;
+
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
+static void stress_readpath_fd_close(stress_readpath_t *rp)
+{
+	(void)close(rp->fd);
+	rp->fd = -1;
+}
+
+/*
+ *  stress_readpath_pread()
+ *	read a block with pread, used for buffered and O_DIRECT paths
+ */
+static int stress_readpath_pread(stress_readpath_t *rp, const size_t block)
+{
+	const off_t offset = (off_t)block * (off_t)rp->block_size;
+	ssize_t ret;
+
+	do {
+		ret = pread(rp->fd, rp->buf, rp->block_size, offset);
+	} while ((ret < 0) && (errno == EINTR));
+
+	if (UNLIKELY(ret < 0)) {
+		pr_fail("%s: pread at offset %jd failed, errno=%d (%s)%s\n",
+			rp->args->name, (intmax_t)offset, errno, strerror(errno),
+			rp->fs_type);
+		return -1;
+	}
+	if (UNLIKELY((size_t)ret != rp->block_size)) {
+		pr_fail("%s: pread at offset %jd returned %zd bytes, expected %zu%s\n",
+			rp->args->name, (intmax_t)offset, ret, rp->block_size,
+			rp->fs_type);
+		return -1;
+	}
+	return 0;
+}
+
+static int stress_readpath_mmap_open(stress_readpath_t *rp)
+{
+	rp->fd = open(rp->filename, O_RDONLY);
+	if (rp->fd < 0)
+		return -1;
+	rp->mapped = (uint8_t *)mmap(NULL, (size_t)rp->file_size, PROT_READ,
+		MAP_SHARED, rp->fd, 0);
+	if (rp->mapped == MAP_FAILED) {
+		(void)close(rp->fd);
+		rp->fd = -1;
+		rp->mapped = NULL;
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ *  stress_readpath_mmap_read()
+ *	copy a block out of the mapping, the same copy that
+ *	read() performs, page faults do the actual I/O
+ */
+static int stress_readpath_mmap_read(stress_readpath_t *rp, const size_t block)
+{
+	const size_t offset = block * rp->block_size;
+
+	(void)shim_memcpy(rp->buf, rp->mapped + offset, rp->block_size);
+	return 0;
+}
+
+static void stress_readpath_mmap_close(stress_readpath_t *rp)
+{
+	(void)munmap((void *)rp->mapped, (size_t)rp->file_size);
+	rp->mapped = NULL;
+	stress_readpath_fd_close(rp);
+}
+
+static stress_readpath_method_t readpath_methods[] = {
+	{ "buffered",	stress_readpath_buffered_open,	stress_readpath_pread,
+			stress_readpath_fd_close,	0.0, 0.0, 0.0, 0.0, false },
+	{ "direct",	stress_readpath_direct_open,	stress_readpath_pread,
+			stress_readpath_fd_close,	0.0, 0.0, 0.0, 0.0, false },
+	{ "mmap",	stress_readpath_mmap_open,	stress_readpath_mmap_read,
+			stress_readpath_mmap_close,	0.0, 0.0, 0.0, 0.0, false },
+};
+
+/*
+ *  stress_readpath_rusage()
+ *	get CPU time and page faults so far
+ */
+static void stress_readpath_rusage(double *cpu_time, double *faults)
+{
+	struct rusage usage;
+
+	if (shim_getrusage(RUSAGE_SELF, &usage) < 0) {
+		*cpu_time = 0.0;
+		*faults = 0.0;
+		return;
+	}
+	*cpu_time = (double)usage.ru_utime.tv_sec + ((double)usage.ru_utime.tv_usec / STRESS_DBL_MICROSECOND) +
+		    (double)usage.ru_stime.tv_sec + ((double)usage.ru_stime.tv_usec / STRESS_DBL_MICROSECOND);
+	*faults = (double)usage.ru_minflt + (double)usage.ru_majflt;
+}
+
+/*
+ *  stress_readpath_verify()
+ *	check the block stamp written at the start of each block
+ */
+static int stress_readpath_verify(
+	stress_readpath_t *rp,
+	const char *name,
+	const size_t block)
+{
+	uint64_t stamp;
+
+	(void)shim_memcpy(&stamp, rp->buf, sizeof(stamp));
+	if (UNLIKELY(stamp != (uint64_t)block)) {
+		pr_fail("%s: %s read of block %zu contained data from block %" PRIu64 "\n",
+			rp->args->name, name, block, stamp);
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ *  stress_readpath_fill()
+ *	create the file, each block is stamped with its block number
+ */
+static int stress_readpath_fill(
+	stress_readpath_t *rp,
+	const int fd,
+	const size_t nblocks)
+{
+	size_t i;
+
+	stress_rndbuf(rp->buf, rp->block_size);
+	for (i = 0; i < nblocks; ) {
+		const off_t offset = (off_t)i * (off_t)rp->block_size;
+		const uint64_t stamp = (uint64_t)i;
+		ssize_t ret;
+
+		if (!stress_continue_flag())
+			return -1;
+		(void)shim_memcpy(rp->buf, &stamp, sizeof(stamp));
+		ret = pwrite(fd, rp->buf, rp->block_size, offset);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == ENOSPC)
+				break;
+			pr_fail("%s: pwrite failed, errno=%d (%s)%s\n",
+				rp->args->name, errno, strerror(errno), rp->fs_type);
+			return -1;
+		}
+		i++;
+	}
+	(void)shim_fsync(fd);
+	return (int)i;
+}
+
+/*
+ *  stress_readpath
+ *	read the same file via buffered read, O_DIRECT pread and
+ *	mmap page faults with the same access pattern and block
+ *	size and compare throughput, page faults and CPU cost
+ */
+static int stress_readpath(stress_args_t *args)
+{
+	stress_readpath_t rp;
+	uint64_t readpath_bytes = DEFAULT_READPATH_BYTES;
+	size_t readpath_block_size = DEFAULT_READPATH_BLOCK_SIZE;
+	bool readpath_random = false, header = false;
+	char filename[PATH_MAX];
+	uint32_t *order;
+	size_t i, nblocks, order_size;
+	int fd, ret, rc = EXIT_SUCCESS;
+
+	if (!stress_get_setting("readpath-bytes", &readpath_bytes)) {
+		if (g_opt_flags & OPT_FLAGS_MAXIMIZE)
+			readpath_bytes = MAXIMIZED_FILE_SIZE;
+		if (g_opt_flags & OPT_FLAGS_MINIMIZE)
+			readpath_bytes = MIN_READPATH_BYTES;
+	}
+	(void)stress_get_setting("readpath-block-size", &readpath_block_size);
+	(void)stress_get_setting("readpath-random", &readpath_random);
+
+	readpath_bytes /= args->num_instances;
+	if (readpath_bytes < MIN_READPATH_BYTES)
+		readpath_bytes = MIN_READPATH_BYTES;
+	nblocks = (size_t)(readpath_bytes / readpath_block_size);
+	if (nblocks > READPATH_MAX_BLOCKS)
+		nblocks = READPATH_MAX_BLOCKS;
+	if (nblocks < 1)
+		nblocks = 1;
+
+	(void)shim_memset(&rp, 0, sizeof(rp));
+	rp.args = args;
+	rp.block_size = readpath_block_size;
+	rp.fd = -1;
+
+	if (posix_memalign((void **)&rp.buf, READPATH_ALIGNMENT, readpath_block_size) || !rp.buf) {
+		pr_inf_skip("%s: cannot allocate %zu byte read buffer, skipping stressor\n",
+			args->name, readpath_block_size);
+		return EXIT_NO_RESOURCE;
+	}
+
+	order_size = nblocks * sizeof(*order);
+	order = (uint32_t *)stress_mmap_populate(NULL, order_size,
+		PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+	if (order == MAP_FAILED) {
+		pr_inf_skip("%s: cannot mmap %zu byte block order array, skipping stressor\n",
+			args->name, order_size);
+		free(rp.buf);
+		return EXIT_NO_RESOURCE;
+	}
+
+	ret = stress_temp_dir_mk_args(args);
+	if (ret < 0) {
+		rc = stress_exit_status(-ret);
+		goto free_order;
+	}
+	(void)stress_temp_filename_args(args,
+		filename, sizeof(filename), stress_mwc32());
+	rp.filename = filename;
+
+	fd = open(filename, O_CREAT | O_RDWR | O_TRUNC, S_IRUSR | S_IWUSR);
+	if (fd < 0) {
+		rc = stress_exit_status(errno);
+		pr_fail("%s: open %s failed, errno=%d (%s)\n",
+			args->name, filename, errno, strerror(errno));
+		goto tidy_dir;
+	}
+	rp.fs_type = stress_get_fs_type(filename);
+
+	ret = stress_readpath_fill(&rp, fd, nblocks);
+	if (ret <= 0) {
+		if (ret == 0) {
+			pr_inf_skip("%s: no space to create file%s, skipping stressor\n",
+				args->name, rp.fs_type);
+			rc = EXIT_NO_RESOURCE;
+		}
+		(void)close(fd);
+		goto tidy_file;
+	}
+	nblocks = (size_t)ret;
+	rp.file_size = (uint64_t)nblocks * readpath_block_size;
+
+	/*
+	 *  Same block order for all paths, sequential or a
+	 *  random shuffle of the blocks
+	 */
+	for (i = 0; i < nblocks; i++)
+		order[i] = (uint32_t)i;
+	if (readpath_random) {
+		for (i = nblocks - 1; i > 0; i--) {
+			const size_t j = (size_t)stress_mwc32modn((uint32_t)i + 1);
+			const uint32_t tmp = order[i];
+
+			order[i] = order[j];
+			order[j] = tmp;
+		}
+	}
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+	do {
+		for (i = 0; (i < SIZEOF_ARRAY(readpath_methods)) && stress_continue(args); i++) {
+			stress_readpath_method_t *method = &readpath_methods[i];
+			double t_start, cpu_start, faults_start;
+			double t_end, cpu_end, faults_end;
+			size_t j;
+
+			if (method->skipped)
+				continue;
+
+			stress_readpath_drop_cache(fd, rp.file_size);
+			if (method->open(&rp) < 0) {
+				if (args->instance == 0)
+					pr_inf("%s: cannot use %s read path, errno=%d (%s)%s, skipping it\n",
+						args->name, method->name, errno, strerror(errno), rp.fs_type);
+				method->skipped = true;
+				continue;
+			}
+
+			stress_readpath_rusage(&cpu_start, &faults_start);
+			t_start = stress_time_now();
+			for (j = 0; j < nblocks; j++) {
+				const size_t block = (size_t)order[j];
+
+				if (UNLIKELY(!stress_continue(args)))
+					break;
+				if (UNLIKELY(method->read(&rp, block) < 0)) {
+					rc = EXIT_FAILURE;
+					break;
+				}
+				if (UNLIKELY(stress_readpath_verify(&rp, method->name, block) < 0)) {
+					rc = EXIT_FAILURE;
+					break;
+				}
+				stress_bogo_inc(args);
+			}
+			t_end = stress_time_now();
+			stress_readpath_rusage(&cpu_end, &faults_end);
+			method->close(&rp);
+
+			method->duration += t_end - t_start;
+			method->cpu_time += cpu_end - cpu_start;
+			method->faults += faults_end - faults_start;
+			method->bytes += (double)j * (double)readpath_block_size;
+
+			if (rc != EXIT_SUCCESS)
+				goto done;
+		}
+	} while (stress_continue(args));
+
+done:
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+	(void)close(fd);
+
+	for (i = 0; i < SIZEOF_ARRAY(readpath_methods); i++) {
+		const stress_readpath_method_t *method = &readpath_methods[i];
+		double rate, gbytes;
+		char str[64];
+
+		if ((method->duration <= 0.0) || (method->bytes <= 0.0))
+			continue;
+		rate = method->bytes / method->duration;
+		gbytes = method->bytes / (double)GB;
+
+		(void)snprintf(str, sizeof(str), "MB per sec %s read rate", method->name);
+		stress_metrics_set(args, (i * 3) + 0, str,
+			rate / (double)MB, STRESS_HARMONIC_MEAN);
+		(void)snprintf(str, sizeof(str), "page faults per GB %s read", method->name);
+		stress_metrics_set(args, (i * 3) + 1, str,
+			method->faults / gbytes, STRESS_GEOMETRIC_MEAN);
+		(void)snprintf(str, sizeof(str), "CPU secs per GB %s read", method->name);
+		stress_metrics_set(args, (i * 3) + 2, str,
+			method->cpu_time / gbytes, STRESS_GEOMETRIC_MEAN);
+
+		if (args->instance == 0) {
+			if (!header) {
+				pr_inf("%s: %8s %12s %14s %14s (%s, %zuK blocks)\n",
+					args->name, "path", "MB/sec", "faults/GB", "CPU secs/GB",
+					readpath_random ? "random" : "sequential",
+					readpath_block_size / 1024);
+				header = true;
+			}
+			pr_inf("%s: %8s %12.2f %14.2f %14.4f\n",
+				args->name, method->name, rate / (double)MB,
+				method->faults / gbytes, method->cpu_time / gbytes);
+		}
+	}
+
+tidy_file:
+	(void)shim_unlink(filename);
+tidy_dir:
+	(void)stress_temp_dir_rm_args(args);
+free_order:
+	(void)munmap((void *)order, order_size);
+	free(rp.buf);
+
+	return rc;
+}
+
+stressor_info_t stress_readpath_info = {
+	.stressor = stress_readpath,
+	.class = CLASS_IO | CLASS_FILESYSTEM | CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
+	.verify = VERIFY_ALWAYS,
+	.help = help
+};
@@ -21,6 +21,7 @@
 #include "core-builtin.h"
 #include "core-capabilities.h"
 #include "core-killpid.h"
+#include "core-latency.h"
 
 #include <sched.h>
 
@@ -112,7 +113,38 @@ static const int policies[] = {
 #endif
 };
 
-static inline void stress_schedmix_waste_time(stress_args_t *args)
+#define STRESS_SCHEDMIX_POLICIES	(SIZEOF_ARRAY(policies))
+
+/* per child scheduling statistics accumulated while in a policy */
+typedef struct {
+	uint64_t run_ns;		/* time on a CPU */
+	uint64_t wait_ns;		/* time waiting on a run queue */
+	uint64_t timeslices;		/* number of times run on a CPU */
+	double duration;		/* wall clock time in the policy */
+	stress_latency_t wakeup;	/* sleep wakeup latency */
+} stress_schedmix_stats_t;
+
+typedef struct {
+	stress_schedmix_stats_t policy[STRESS_SCHEDMIX_POLICIES];
+} stress_schedmix_child_stats_t;
+
+/*
+ *  stress_schedmix_sleep()
+ *	sleep for nsec nanoseconds, recording how late the
+ *	wakeup was compared to the requested sleep time
+ */
+static void stress_schedmix_sleep(const uint64_t nsec, stress_latency_t *wakeup)
+{
+	const double t = stress_time_now();
+	double late;
+
+	if ((shim_nanosleep_uint64(nsec) < 0) || !stress_continue_flag() || !wakeup)
+		return;
+	late = ((stress_time_now() - t) * STRESS_DBL_NANOSECOND) - (double)nsec;
+	stress_latency_add(wakeup, (late > 0.0) ? (uint64_t)late : 0);
+}
+
+static inline void stress_schedmix_waste_time(stress_args_t *args, stress_latency_t *wakeup)
 {
 	int i, n, status;
 	pid_t pid;
@@ -141,12 +173,12 @@ redo:
 			shim_sched_yield();
 		break;
 	case 2:
-		shim_nanosleep_uint64(stress_mwc32modn(1000000));
+		stress_schedmix_sleep(stress_mwc32modn(1000000), wakeup);
 		break;
 	case 3:
 		n = stress_mwc8();
 		for (i = 0; stress_continue(args) && (i < n); i++)
-			shim_nanosleep_uint64(stress_mwc32modn(10000));
+			stress_schedmix_sleep(stress_mwc32modn(10000), wakeup);
 		break;
 	case 4:
 		for (i = 0; stress_continue(args) && (i < 1000000); i++)
@@ -313,9 +345,48 @@ static void stress_schedmix_itimer_handler(int signum)
 }
 #endif
 
-static int stress_schedmix_child(stress_args_t *args)
+/*
+ *  stress_schedmix_get_policy()
+ *	get the calling process scheduling policy
+ */
+static int stress_schedmix_get_policy(void)
+{
+	const int policy = sched_getscheduler(0);
+
+#if defined(SCHED_RESET_ON_FORK)
+	return policy & ~SCHED_RESET_ON_FORK;
+#else
+	return policy;
+#endif
+}
+
+/*
+ *  stress_schedmix_policy_index()
+ *	map a scheduling policy to its policies[] index, -1 if not found
+ */
+static int stress_schedmix_policy_index(const int policy)
+{
+	size_t i;
+
+	for (i = 0; i < STRESS_SCHEDMIX_POLICIES; i++) {
+		if (policies[i] == policy)
+			return (int)i;
+	}
+	return -1;
+}
+
+static int stress_schedmix_child(stress_args_t *args, stress_schedmix_child_stats_t *stats)
 {
 	int old_policy = -1;
+	stress_schedstat_t prev;
+	double t_prev;
+	bool schedstat_ok;
+	size_t i;
+
+	for (i = 0; i < STRESS_SCHEDMIX_POLICIES; i++)
+		stress_latency_init(&stats->policy[i].wakeup);
+	schedstat_ok = (stress_get_schedstat(0, &prev) == 0);
+	t_prev = stress_time_now();
 
 #if defined(HAVE_SETITIMER) &&	\
     defined(ITIMER_PROF)
@@ -457,7 +528,30 @@ case_sched_fifo:
 					new_policy_name);
 			}
 		}
-		stress_schedmix_waste_time(args);
+		/*
+		 *  Account the time wasted to the policy actually in
+		 *  use, the policy change may have been on the parent
+		 *  or may have failed
+		 */
+		policy = stress_schedmix_policy_index(stress_schedmix_get_policy());
+		if (policy >= 0) {
+			stress_schedmix_stats_t *ps = &stats->policy[policy];
+			stress_schedstat_t now;
+			double t_now;
+
+			stress_schedmix_waste_time(args, &ps->wakeup);
+			t_now = stress_time_now();
+			if (schedstat_ok && (stress_get_schedstat(0, &now) == 0)) {
+				ps->run_ns += now.run_ns - prev.run_ns;
+				ps->wait_ns += now.wait_ns - prev.wait_ns;
+				ps->timeslices += now.timeslices - prev.timeslices;
+				ps->duration += t_now - t_prev;
+				prev = now;
+			}
+			t_prev = t_now;
+		} else {
+			stress_schedmix_waste_time(args, NULL);
+		}
 		stress_bogo_inc(args);
 	} while (stress_continue(args));
 
@@ -469,12 +563,83 @@ case_sched_fifo:
 	return EXIT_SUCCESS;
 }
 
+/*
+ *  stress_schedmix_report()
+ *	per policy CPU share fairness between the child processes,
+ *	run queue wait and sleep wakeup latency
+ */
+static void stress_schedmix_report(
+	stress_args_t *args,
+	const stress_schedmix_child_stats_t *stats,
+	const pid_t *pids,
+	const size_t schedmix_procs)
+{
+	double shares[MAX_SCHEDMIX_PROCS];
+	size_t i, j, idx = 0;
+
+	if (args->instance == 0) {
+		pr_block_begin();
+		pr_inf("%s: %-10s %5s %10s %8s %13s %13s %13s\n", args->name,
+			"policy", "tasks", "cpu share", "Jain", "rq wait/run",
+			"p99 wakeup", "max wakeup");
+		pr_inf("%s: %-10s %5s %10s %8s %13s %13s %13s\n", args->name,
+			"", "", "(%)", "index", "(usec)", "(usec)", "(usec)");
+	}
+	for (i = 0; i < STRESS_SCHEDMIX_POLICIES; i++) {
+		const char *name = stress_get_sched_name(policies[i]);
+		stress_latency_t wakeup;
+		uint64_t wait_ns = 0, timeslices = 0;
+		double share_total = 0.0, fairness, wait_usec;
+		size_t n = 0;
+
+		stress_latency_init(&wakeup);
+		for (j = 0; j < schedmix_procs; j++) {
+			const stress_schedmix_stats_t *ps = &stats[j].policy[i];
+
+			if ((pids[j] <= 0) || (ps->duration <= 0.0))
+				continue;
+			shares[n] = ((double)ps->run_ns / STRESS_DBL_NANOSECOND) / ps->duration;
+			share_total += shares[n];
+			n++;
+			wait_ns += ps->wait_ns;
+			timeslices += ps->timeslices;
+			stress_latency_merge(&wakeup, &ps->wakeup);
+		}
+		if (n == 0)
+			continue;
+		fairness = stress_sched_fairness(shares, n);
+		wait_usec = timeslices ? ((double)wait_ns / (double)timeslices) / 1000.0 : 0.0;
+
+		if (args->instance == 0) {
+			pr_inf("%s: %-10s %5zu %10.2f %8.4f %13.2f %13.2f %13.2f\n",
+				args->name, name, n, 100.0 * share_total / (double)n,
+				fairness, wait_usec,
+				(double)stress_latency_percentile(&wakeup, 99.0) / 1000.0,
+				(double)wakeup.max_ns / 1000.0);
+		}
+		if (idx + 2 <= STRESS_MISC_METRICS_MAX) {
+			char desc[64];
+
+			(void)snprintf(desc, sizeof(desc), "Jain fairness index %s", name);
+			stress_metrics_set(args, idx++, desc, fairness, STRESS_GEOMETRIC_MEAN);
+			(void)snprintf(desc, sizeof(desc), "usec max wakeup latency %s", name);
+			stress_metrics_set(args, idx++, desc,
+				(double)wakeup.max_ns / 1000.0, STRESS_GEOMETRIC_MEAN);
+		}
+	}
+	if (args->instance == 0)
+		pr_block_end();
+}
+
 static int stress_schedmix(stress_args_t *args)
 {
 	pid_t pids[MAX_SCHEDMIX_PROCS];
 	size_t i;
 	size_t schedmix_procs = DEFAULT_SCHEDMIX_PROCS;
 	const int parent_cpu = stress_get_cpu();
+	stress_schedmix_child_stats_t *stats;
+	const size_t stats_size = sizeof(*stats) * MAX_SCHEDMIX_PROCS;
+	int rc;
 
 	if (SIZEOF_ARRAY(policies) == (0)) {
 		if (args->instance == 0) {
@@ -502,6 +667,23 @@ static int stress_schedmix(stress_args_t *args)
 
 	(void)stress_get_setting("schedmix-procs", &schedmix_procs);
 
+	stats = (stress_schedmix_child_stats_t *)
+		stress_mmap_populate(NULL, stats_size,
+			PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (stats == MAP_FAILED) {
+		pr_inf_skip("%s: cannot mmap %zu bytes for scheduling statistics, "
+			"errno=%d (%s), skipping stressor\n",
+			args->name, stats_size, errno, strerror(errno));
+#if defined(HAVE_SCHEDMIX_SEM)
+		if (schedmix_sem) {
+			(void)sem_destroy(&schedmix_sem->sem);
+			(void)munmap((void *)schedmix_sem, sizeof(*schedmix_sem));
+		}
+#endif
+		return EXIT_NO_RESOURCE;
+	}
+
 	stress_set_proc_state(args->name, STRESS_STATE_RUN);
 
 	for (i = 0; i < schedmix_procs; i++) {
@@ -514,7 +696,7 @@ static int stress_schedmix(stress_args_t *args)
 			VOID_RET(int, nice(stress_mwc8modn(7)));
 			stress_parent_died_alarm();
 			(void)stress_change_cpu(args, parent_cpu);
-			_exit(stress_schedmix_child(args));
+			_exit(stress_schedmix_child(args, &stats[i]));
 		}
 	}
 
@@ -531,7 +713,11 @@ static int stress_schedmix(stress_args_t *args)
 	}
 #endif
 
-	return stress_kill_and_wait_many(args, pids, schedmix_procs, SIGALRM, true);
+	rc = stress_kill_and_wait_many(args, pids, schedmix_procs, SIGALRM, true);
+	stress_schedmix_report(args, stats, pids, schedmix_procs);
+	(void)munmap((void *)stats, stats_size);
+
+	return rc;
 }
 
 stressor_info_t stress_schedmix_info = {
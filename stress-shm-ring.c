@@ -0,0 +1,823 @@
+/*
+ * Copyright (C) 2024 Colin Ian King.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+#include "core-arch.h"
+#include "core-asm-x86.h"
+#include "core-attribute.h"
+#include "core-builtin.h"
+#include "core-killpid.h"
+#include "core-latency.h"
+
+#if defined(HAVE_SYS_EVENTFD_H)
+#include <sys/eventfd.h>
+#endif
+
+#if defined(HAVE_POLL_H)
+#include <poll.h>
+#endif
+
+#define MIN_SHM_RING_PROCS		(1)
+#define MAX_SHM_RING_PROCS		(16)
+
+#define MIN_SHM_RING_MSG_SIZE		(32)
+#define MAX_SHM_RING_MSG_SIZE		(4 * KB)
+
+#define SHM_RING_SLOTS			(256)
+#define SHM_RING_SLOTS_MASK		(SHM_RING_SLOTS - 1)
+#define SHM_RING_SLICE			(0.1)
+#define SHM_RING_WAIT_NS		(100000000)
+
+#define SHM_RING_WAKE_POLL		(0)
+#define SHM_RING_WAKE_FUTEX		(1)
+#define SHM_RING_WAKE_EVENTFD		(2)
+#define SHM_RING_WAKE_METHODS		(3)
+#define SHM_RING_WAKE_ALL		(SHM_RING_WAKE_METHODS)
+
+static const stress_help_t help[] = {
+	{ NULL,	"shm-ring N",		"start N workers passing messages through a shared memory ring" },
+	{ NULL,	"shm-ring-consumers N",	"number of consumer processes (default 1)" },
+	{ NULL,	"shm-ring-msg-size N",	"message size, 0 sweeps 32 bytes to 4K (default 0)" },
+	{ NULL,	"shm-ring-ops N",	"stop after N shm-ring messages" },
+	{ NULL,	"shm-ring-producers N",	"number of producer processes (default 1)" },
+	{ NULL,	"shm-ring-wake M",	"wake method: poll, futex, eventfd or all (default all)" },
+	{ NULL,	NULL,			NULL }
+};
+
+static const char * const stress_shm_ring_wake_names[] = {
+	"poll",
+	"futex",
+	"eventfd",
+};
+
+static const size_t stress_shm_ring_sizes[] = {
+	32, 64, 256, 1 * KB, 4 * KB
+};
+
+static int stress_set_shm_ring_producers(const char *opt)
+{
+	uint32_t shm_ring_producers;
+
+	shm_ring_producers = stress_get_uint32(opt);
+	stress_check_range("shm-ring-producers", (uint64_t)shm_ring_producers,
+		MIN_SHM_RING_PROCS, MAX_SHM_RING_PROCS);
+	return stress_set_setting("shm-ring-producers", TYPE_ID_UINT32, &shm_ring_producers);
+}
+
+static int stress_set_shm_ring_consumers(const char *opt)
+{
+	uint32_t shm_ring_consumers;
+
+	shm_ring_consumers = stress_get_uint32(opt);
+	stress_check_range("shm-ring-consumers", (uint64_t)shm_ring_consumers,
+		MIN_SHM_RING_PROCS, MAX_SHM_RING_PROCS);
+	return stress_set_setting("shm-ring-consumers", TYPE_ID_UINT32, &shm_ring_consumers);
+}
+
+static int stress_set_shm_ring_msg_size(const char *opt)
+{
+	size_t shm_ring_msg_size;
+
+	shm_ring_msg_size = (size_t)stress_get_uint64_byte(opt);
+	if (shm_ring_msg_size != 0)
+		stress_check_range_bytes("shm-ring-msg-size", (uint64_t)shm_ring_msg_size,
+			MIN_SHM_RING_MSG_SIZE, MAX_SHM_RING_MSG_SIZE);
+	return stress_set_setting("shm-ring-msg-size", TYPE_ID_SIZE_T, &shm_ring_msg_size);
+}
+
+/*
+ *  stress_set_shm_ring_wake()
+ *	set the method used to wake a blocked producer or consumer
+ */
+static int stress_set_shm_ring_wake(const char *opt)
+{
+	int shm_ring_wake;
+
+	for (shm_ring_wake = 0; shm_ring_wake < SHM_RING_WAKE_METHODS; shm_ring_wake++) {
+		if (!strcmp(opt, stress_shm_ring_wake_names[shm_ring_wake]))
+			return stress_set_setting("shm-ring-wake", TYPE_ID_INT, &shm_ring_wake);
+	}
+	if (!strcmp(opt, "all"))
+		return stress_set_setting("shm-ring-wake", TYPE_ID_INT, &shm_ring_wake);
+
+	(void)fprintf(stderr, "shm-ring-wake option '%s' not known, options are: poll, futex, eventfd, all\n", opt);
+	return -1;
+}
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_shm_ring_consumers,	stress_set_shm_ring_consumers },
+	{ OPT_shm_ring_msg_size,	stress_set_shm_ring_msg_size },
+	{ OPT_shm_ring_producers,	stress_set_shm_ring_producers },
+	{ OPT_shm_ring_wake,		stress_set_shm_ring_wake },
+	{ 0,				NULL }
+};
+
+#if defined(HAVE_ATOMIC_LOAD) &&		\
+    defined(HAVE_ATOMIC_STORE) &&		\
+    defined(HAVE_ATOMIC_ADD_FETCH) &&		\
+    defined(HAVE_ATOMIC_SUB_FETCH) &&		\
+    defined(HAVE_ATOMIC_COMPARE_EXCHANGE)
+
+#if defined(__NR_futex)
+#define STRESS_SHM_RING_FUTEX
+#endif
+
+#if defined(HAVE_SYS_EVENTFD_H) &&	\
+    defined(HAVE_EVENTFD) &&		\
+    defined(HAVE_POLL_H)
+#define STRESS_SHM_RING_EVENTFD
+#endif
+
+/*
+ *  message header, the rest of the message is payload
+ */
+typedef struct {
+	uint64_t seq;			/* per producer sequence number */
+	double stamp;			/* time message was produced */
+	uint32_t producer;		/* producer index */
+	uint32_t size;			/* total message size */
+} stress_shm_ring_hdr_t;
+
+typedef struct {
+	volatile uint64_t seq;		/* mpmc slot sequence */
+	uint8_t data[MAX_SHM_RING_MSG_SIZE];
+} ALIGN64 stress_shm_ring_slot_t;
+
+/*
+ *  event count, waiters sleep on seq and posters only
+ *  issue a wake system call if there are any waiters
+ */
+typedef struct {
+	uint32_t seq;			/* futex word, bumped on each post */
+	uint32_t waiters;		/* number of sleeping waiters */
+	int efd;			/* eventfd for eventfd wakes */
+} ALIGN64 stress_shm_ring_event_t;
+
+typedef struct {
+	uint64_t msgs;			/* messages produced or consumed */
+	uint64_t wakes;			/* wake system calls */
+	uint64_t sleeps;		/* wait system calls */
+	uint64_t errors;		/* corrupt or out of order messages */
+	stress_latency_t latency;	/* one-way latency, consumers only */
+} stress_shm_ring_proc_t;
+
+typedef struct {
+	stress_shm_ring_event_t data;	/* consumers wait for data */
+	stress_shm_ring_event_t space;	/* producers wait for space */
+	volatile uint64_t enq ALIGN64;	/* enqueue (head) position */
+	volatile uint64_t deq ALIGN64;	/* dequeue (tail) position */
+	volatile uint32_t ready ALIGN64; /* processes ready to start */
+	volatile bool go;		/* start the slice */
+	volatile bool stop;		/* end the slice */
+	bool mpmc;			/* true = mpmc, false = spsc */
+	bool latency;			/* true = one message in flight */
+	int wake;			/* SHM_RING_WAKE_* */
+	size_t msg_size;		/* message size */
+	uint64_t capacity;		/* max messages in the ring */
+	stress_shm_ring_proc_t procs[MAX_SHM_RING_PROCS * 2];
+	stress_shm_ring_slot_t slots[SHM_RING_SLOTS];
+} stress_shm_ring_t;
+
+typedef struct {
+	double duration;		/* throughput slice duration */
+	uint64_t msgs;			/* throughput slice messages */
+	uint64_t wakes;			/* throughput slice wake syscalls */
+	uint64_t sleeps;		/* throughput slice wait syscalls */
+	stress_latency_t latency;	/* latency slice one-way latency */
+} stress_shm_ring_stats_t;
+
+static inline void stress_shm_ring_relax(void)
+{
+#if defined(STRESS_ARCH_X86) &&	\
+    defined(HAVE_ASM_X86_PAUSE)
+	stress_asm_x86_pause();
+#endif
+}
+
+/*
+ *  stress_shm_ring_post()
+ *	bump the event count and wake one waiter if any are asleep
+ */
+static inline void stress_shm_ring_post(
+	stress_shm_ring_event_t *ev,
+	const int wake,
+	stress_shm_ring_proc_t *proc)
+{
+	if (wake == SHM_RING_WAKE_POLL)
+		return;
+	(void)__atomic_add_fetch(&ev->seq, 1, __ATOMIC_SEQ_CST);
+	if (LIKELY(__atomic_load_n(&ev->waiters, __ATOMIC_SEQ_CST) == 0))
+		return;
+
+	proc->wakes++;
+#if defined(STRESS_SHM_RING_FUTEX)
+	if (wake == SHM_RING_WAKE_FUTEX) {
+		(void)shim_futex_wake(&ev->seq, 1);
+		return;
+	}
+#endif
+#if defined(STRESS_SHM_RING_EVENTFD)
+	if (wake == SHM_RING_WAKE_EVENTFD) {
+		const uint64_t val = 1;
+
+		VOID_RET(ssize_t, write(ev->efd, &val, sizeof(val)));
+	}
+#endif
+}
+
+/*
+ *  stress_shm_ring_sleep()
+ *	sleep until the event count moves on from seq, a short
+ *	timeout allows the end of slice flag to be checked
+ */
+static void stress_shm_ring_sleep(
+	stress_shm_ring_event_t *ev,
+	const int wake,
+	const uint32_t seq,
+	stress_shm_ring_proc_t *proc)
+{
+	proc->sleeps++;
+#if defined(STRESS_SHM_RING_FUTEX)
+	if (wake == SHM_RING_WAKE_FUTEX) {
+		struct timespec timeout;
+
+		timeout.tv_sec = 0;
+		timeout.tv_nsec = SHM_RING_WAIT_NS;
+		(void)shim_futex_wait(&ev->seq, (int)seq, &timeout);
+		return;
+	}
+#endif
+#if defined(STRESS_SHM_RING_EVENTFD)
+	if (wake == SHM_RING_WAKE_EVENTFD) {
+		struct pollfd pfd;
+		uint64_t val;
+
+		(void)seq;
+		pfd.fd = ev->efd;
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+		if (poll(&pfd, 1, SHM_RING_WAIT_NS / 1000000) > 0)
+			VOID_RET(ssize_t, read(ev->efd, &val, sizeof(val)));
+		return;
+	}
+#endif
+	(void)ev;
+	(void)wake;
+	(void)seq;
+}
+
+/*
+ *  stress_shm_ring_push()
+ *	copy a message into the ring, returns false if full
+ */
+static inline bool stress_shm_ring_push(
+	stress_shm_ring_t *ring,
+	const uint8_t *msg,
+	const size_t size,
+	uint64_t *cached_deq)
+{
+	stress_shm_ring_slot_t *slot;
+	uint64_t pos;
+
+	if (!ring->mpmc) {
+		/* single producer, only the consumer moves deq */
+		pos = ring->enq;
+		if (pos - *cached_deq >= ring->capacity) {
+			*cached_deq = __atomic_load_n(&ring->deq, __ATOMIC_ACQUIRE);
+			if (pos - *cached_deq >= ring->capacity)
+				return false;
+		}
+		slot = &ring->slots[pos & SHM_RING_SLOTS_MASK];
+		shim_memcpy(slot->data, msg, size);
+		__atomic_store_n(&ring->enq, pos + 1, __ATOMIC_RELEASE);
+		return true;
+	}
+
+	/* bounded mpmc queue, each slot sequence gates its owner */
+	pos = __atomic_load_n(&ring->enq, __ATOMIC_RELAXED);
+	for (;;) {
+		int64_t diff;
+
+		slot = &ring->slots[pos & SHM_RING_SLOTS_MASK];
+		diff = (int64_t)__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) - (int64_t)pos;
+		if (diff == 0) {
+			if (pos - __atomic_load_n(&ring->deq, __ATOMIC_ACQUIRE) >= ring->capacity)
+				return false;
+			if (__atomic_compare_exchange_n(&ring->enq, &pos, pos + 1, false,
+							__ATOMIC_RELAXED, __ATOMIC_RELAXED))
+				break;
+		} else if (diff < 0) {
+			return false;
+		} else {
+			pos = __atomic_load_n(&ring->enq, __ATOMIC_RELAXED);
+		}
+	}
+	shim_memcpy(slot->data, msg, size);
+	__atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+	return true;
+}
+
+/*
+ *  stress_shm_ring_pop()
+ *	copy a message out of the ring, returns false if empty
+ */
+static inline bool stress_shm_ring_pop(
+	stress_shm_ring_t *ring,
+	uint8_t *msg,
+	const size_t size,
+	uint64_t *cached_enq)
+{
+	stress_shm_ring_slot_t *slot;
+	uint64_t pos;
+
+	if (!ring->mpmc) {
+		/* single consumer, only the producer moves enq */
+		pos = ring->deq;
+		if (pos == *cached_enq) {
+			*cached_enq = __atomic_load_n(&ring->enq, __ATOMIC_ACQUIRE);
+			if (pos == *cached_enq)
+				return false;
+		}
+		slot = &ring->slots[pos & SHM_RING_SLOTS_MASK];
+		shim_memcpy(msg, slot->data, size);
+		__atomic_store_n(&ring->deq, pos + 1, __ATOMIC_RELEASE);
+		return true;
+	}
+
+	(void)cached_enq;
+	pos = __atomic_load_n(&ring->deq, __ATOMIC_RELAXED);
+	for (;;) {
+		int64_t diff;
+
+		slot = &ring->slots[pos & SHM_RING_SLOTS_MASK];
+		diff = (int64_t)__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) - (int64_t)(pos + 1);
+		if (diff == 0) {
+			if (__atomic_compare_exchange_n(&ring->deq, &pos, pos + 1, false,
+							__ATOMIC_RELAXED, __ATOMIC_RELAXED))
+				break;
+		} else if (diff < 0) {
+			return false;
+		} else {
+			pos = __atomic_load_n(&ring->deq, __ATOMIC_RELAXED);
+		}
+	}
+	shim_memcpy(msg, slot->data, size);
+	__atomic_store_n(&slot->seq, pos + SHM_RING_SLOTS, __ATOMIC_RELEASE);
+	return true;
+}
+
+static inline bool stress_shm_ring_running(const stress_shm_ring_t *ring)
+{
+	return !ring->stop && stress_continue_flag();
+}
+
+/*
+ *  stress_shm_ring_start()
+ *	tell the parent this process is ready and wait for the go
+ */
+static void stress_shm_ring_start(stress_shm_ring_t *ring)
+{
+	(void)__atomic_add_fetch(&ring->ready, 1, __ATOMIC_SEQ_CST);
+	while (!ring->go && stress_shm_ring_running(ring))
+		(void)shim_sched_yield();
+}
+
+/*
+ *  stress_shm_ring_producer()
+ *	produce sequenced, stamped messages until the slice ends
+ */
+static void stress_shm_ring_producer(
+	stress_shm_ring_t *ring,
+	const uint32_t producer,
+	stress_shm_ring_proc_t *proc)
+{
+	uint8_t msg[MAX_SHM_RING_MSG_SIZE] ALIGN64;
+	stress_shm_ring_hdr_t *hdr = (stress_shm_ring_hdr_t *)msg;
+	const size_t size = ring->msg_size;
+	const int wake = ring->wake;
+	uint64_t cached_deq = 0;
+
+	(void)shim_memset(msg, (int)producer, sizeof(msg));
+	hdr->producer = producer;
+	hdr->size = (uint32_t)size;
+	hdr->seq = 0;
+
+	stress_shm_ring_start(ring);
+	while (stress_shm_ring_running(ring)) {
+		hdr->seq++;
+		msg[sizeof(*hdr)] = (uint8_t)hdr->seq;
+		msg[size - 1] = (uint8_t)hdr->seq;
+
+		for (;;) {
+			uint32_t seq;
+
+			/* stamp each attempt so waiting for room is not timed */
+			if (ring->latency)
+				hdr->stamp = stress_time_now();
+			if (stress_shm_ring_push(ring, msg, size, &cached_deq))
+				break;
+			if (UNLIKELY(!stress_shm_ring_running(ring)))
+				return;
+			if (wake == SHM_RING_WAKE_POLL) {
+				stress_shm_ring_relax();
+				continue;
+			}
+			/* register as a waiter then re-check before sleeping */
+			seq = __atomic_load_n(&ring->space.seq, __ATOMIC_SEQ_CST);
+			(void)__atomic_add_fetch(&ring->space.waiters, 1, __ATOMIC_SEQ_CST);
+			if (ring->latency)
+				hdr->stamp = stress_time_now();
+			if (stress_shm_ring_push(ring, msg, size, &cached_deq)) {
+				(void)__atomic_sub_fetch(&ring->space.waiters, 1, __ATOMIC_SEQ_CST);
+				break;
+			}
+			stress_shm_ring_sleep(&ring->space, wake, seq, proc);
+			(void)__atomic_sub_fetch(&ring->space.waiters, 1, __ATOMIC_SEQ_CST);
+		}
+		proc->msgs++;
+		stress_shm_ring_post(&ring->data, wake, proc);
+	}
+}
+
+/*
+ *  stress_shm_ring_consumer()
+ *	consume messages, check their sequence numbers and contents
+ *	and record the one-way latency
+ */
+static void stress_shm_ring_consumer(
+	stress_shm_ring_t *ring,
+	const uint32_t producers,
+	stress_shm_ring_proc_t *proc)
+{
+	uint8_t msg[MAX_SHM_RING_MSG_SIZE] ALIGN64;
+	const stress_shm_ring_hdr_t *hdr = (const stress_shm_ring_hdr_t *)msg;
+	uint64_t last_seq[MAX_SHM_RING_PROCS];
+	const size_t size = ring->msg_size;
+	const int wake = ring->wake;
+	uint64_t cached_enq = 0;
+
+	(void)shim_memset(last_seq, 0, sizeof(last_seq));
+
+	stress_shm_ring_start(ring);
+	while (stress_shm_ring_running(ring)) {
+		uint8_t check;
+		double now;
+
+		for (;;) {
+			uint32_t seq;
+
+			if (stress_shm_ring_pop(ring, msg, size, &cached_enq))
+				break;
+			if (UNLIKELY(!stress_shm_ring_running(ring)))
+				return;
+			if (wake == SHM_RING_WAKE_POLL) {
+				stress_shm_ring_relax();
+				continue;
+			}
+			seq = __atomic_load_n(&ring->data.seq, __ATOMIC_SEQ_CST);
+			(void)__atomic_add_fetch(&ring->data.waiters, 1, __ATOMIC_SEQ_CST);
+			if (stress_shm_ring_pop(ring, msg, size, &cached_enq)) {
+				(void)__atomic_sub_fetch(&ring->data.waiters, 1, __ATOMIC_SEQ_CST);
+				break;
+			}
+			stress_shm_ring_sleep(&ring->data, wake, seq, proc);
+			(void)__atomic_sub_fetch(&ring->data.waiters, 1, __ATOMIC_SEQ_CST);
+		}
+		now = stress_time_now();
+		stress_shm_ring_post(&ring->space, wake, proc);
+
+		/*
+		 *  per producer sequence numbers must increase, with a
+		 *  single consumer they must also be contiguous
+		 */
+		check = (uint8_t)hdr->seq;
+		if (UNLIKELY((hdr->producer >= producers) ||
+			     (hdr->size != size) ||
+			     (hdr->seq <= last_seq[hdr->producer]) ||
+			     (!ring->mpmc && (hdr->seq != last_seq[hdr->producer] + 1)) ||
+			     (msg[sizeof(*hdr)] != check) ||
+			     (msg[size - 1] != check))) {
+			proc->errors++;
+		} else {
+			last_seq[hdr->producer] = hdr->seq;
+		}
+		if (ring->latency && (now >= hdr->stamp))
+			stress_latency_add(&proc->latency,
+				(uint64_t)((now - hdr->stamp) * STRESS_DBL_NANOSECOND));
+		proc->msgs++;
+	}
+}
+
+/*
+ *  stress_shm_ring_slice()
+ *	fork the producers and consumers, run them for a time slice
+ *	and merge their statistics, returns the number of corrupt
+ *	messages or -1 on a fork failure
+ */
+static int64_t stress_shm_ring_slice(
+	stress_args_t *args,
+	stress_shm_ring_t *ring,
+	const uint32_t producers,
+	const uint32_t consumers,
+	const bool latency,
+	stress_shm_ring_stats_t *stats)
+{
+	pid_t pids[MAX_SHM_RING_PROCS * 2];
+	const uint32_t nprocs = producers + consumers;
+	uint32_t i;
+	int64_t errors = 0;
+	double t_start, t_end;
+
+	ring->enq = 0;
+	ring->deq = 0;
+	ring->ready = 0;
+	ring->go = false;
+	ring->stop = false;
+	ring->latency = latency;
+	ring->capacity = latency ? 1 : SHM_RING_SLOTS;
+	ring->data.seq = 0;
+	ring->data.waiters = 0;
+	ring->space.seq = 0;
+	ring->space.waiters = 0;
+	for (i = 0; i < SHM_RING_SLOTS; i++)
+		ring->slots[i].seq = i;
+	for (i = 0; i < nprocs; i++) {
+		(void)shim_memset(&ring->procs[i], 0, sizeof(ring->procs[i]));
+		stress_latency_init(&ring->procs[i].latency);
+	}
+
+	for (i = 0; i < nprocs; i++) {
+again:
+		pids[i] = fork();
+		if (pids[i] < 0) {
+			if (stress_redo_fork(args, errno))
+				goto again;
+			ring->stop = true;
+			break;
+		} else if (pids[i] == 0) {
+			stress_parent_died_alarm();
+			(void)sched_settings_apply(true);
+			if (i < producers)
+				stress_shm_ring_producer(ring, i, &ring->procs[i]);
+			else
+				stress_shm_ring_consumer(ring, producers, &ring->procs[i]);
+			_exit(EXIT_SUCCESS);
+		}
+	}
+	if (i < nprocs) {
+		uint32_t j;
+
+		for (j = 0; j < i; j++)
+			(void)stress_kill_pid_wait(pids[j], NULL);
+		if (!stress_continue(args))
+			return 0;
+		pr_inf_skip("%s: fork failed, errno=%d (%s), skipping stressor\n",
+			args->name, errno, strerror(errno));
+		return -1;
+	}
+
+	while ((ring->ready < nprocs) && stress_continue(args))
+		(void)shim_usleep(1000);
+	t_start = stress_time_now();
+	ring->go = true;
+	while (stress_continue(args) && (stress_time_now() < t_start + SHM_RING_SLICE))
+		(void)shim_usleep(10000);
+	ring->stop = true;
+	t_end = stress_time_now();
+
+	/* kick any sleepers so they see the stop flag */
+	if (ring->wake != SHM_RING_WAKE_POLL) {
+		stress_shm_ring_proc_t dummy;
+
+		/* wake counts of the stop kick are not reported */
+		(void)shim_memset(&dummy, 0, sizeof(dummy));
+		(void)__atomic_add_fetch(&ring->data.waiters, 1, __ATOMIC_SEQ_CST);
+		(void)__atomic_add_fetch(&ring->space.waiters, 1, __ATOMIC_SEQ_CST);
+		for (i = 0; i < nprocs; i++) {
+			stress_shm_ring_post(&ring->data, ring->wake, &dummy);
+			stress_shm_ring_post(&ring->space, ring->wake, &dummy);
+		}
+	}
+	for (i = 0; i < nprocs; i++) {
+		int status;
+
+		if (shim_waitpid(pids[i], &status, 0) < 0)
+			(void)stress_kill_pid_wait(pids[i], NULL);
+	}
+
+	for (i = producers; i < nprocs; i++) {
+		const stress_shm_ring_proc_t *proc = &ring->procs[i];
+
+		errors += (int64_t)proc->errors;
+		if (latency) {
+			stress_latency_merge(&stats->latency, &proc->latency);
+		} else {
+			stats->msgs += proc->msgs;
+		}
+		stress_bogo_add(args, proc->msgs);
+	}
+	if (!latency) {
+		for (i = 0; i < nprocs; i++) {
+			stats->wakes += ring->procs[i].wakes;
+			stats->sleeps += ring->procs[i].sleeps;
+		}
+		stats->duration += t_end - t_start;
+	}
+	return errors;
+}
+
+/*
+ *  stress_shm_ring()
+ *	stress shared memory ring buffer message passing
+ */
+static int stress_shm_ring(stress_args_t *args)
+{
+	stress_shm_ring_t *ring;
+	stress_shm_ring_stats_t *stats;
+	uint32_t shm_ring_producers = 1, shm_ring_consumers = 1;
+	size_t shm_ring_msg_size = 0;
+	int shm_ring_wake = SHM_RING_WAKE_ALL;
+	bool wake_supported[SHM_RING_WAKE_METHODS];
+	const size_t *sizes;
+	size_t n_sizes, i, idx;
+	const size_t stats_size = sizeof(*stats) * SHM_RING_WAKE_METHODS * SIZEOF_ARRAY(stress_shm_ring_sizes);
+	int wake, rc = EXIT_SUCCESS;
+
+	(void)stress_get_setting("shm-ring-consumers", &shm_ring_consumers);
+	(void)stress_get_setting("shm-ring-msg-size", &shm_ring_msg_size);
+	(void)stress_get_setting("shm-ring-producers", &shm_ring_producers);
+	(void)stress_get_setting("shm-ring-wake", &shm_ring_wake);
+
+	if (shm_ring_msg_size) {
+		sizes = &shm_ring_msg_size;
+		n_sizes = 1;
+	} else {
+		sizes = stress_shm_ring_sizes;
+		n_sizes = SIZEOF_ARRAY(stress_shm_ring_sizes);
+	}
+
+	ring = (stress_shm_ring_t *)stress_mmap_populate(NULL, sizeof(*ring),
+		PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_SHARED, -1, 0);
+	if (ring == MAP_FAILED) {
+		pr_inf_skip("%s: cannot mmap %zu byte shared ring, errno=%d (%s), "
+			"skipping stressor\n", args->name, sizeof(*ring),
+			errno, strerror(errno));
+		return EXIT_NO_RESOURCE;
+	}
+	stats = (stress_shm_ring_stats_t *)calloc(1, stats_size);
+	if (!stats) {
+		pr_inf_skip("%s: cannot allocate statistics, skipping stressor\n", args->name);
+		(void)munmap((void *)ring, sizeof(*ring));
+		return EXIT_NO_RESOURCE;
+	}
+	for (i = 0; i < SHM_RING_WAKE_METHODS * SIZEOF_ARRAY(stress_shm_ring_sizes); i++)
+		stress_latency_init(&stats[i].latency);
+
+	ring->mpmc = (shm_ring_producers > 1) || (shm_ring_consumers > 1);
+	ring->data.efd = -1;
+	ring->space.efd = -1;
+
+	wake_supported[SHM_RING_WAKE_POLL] = true;
+#if defined(STRESS_SHM_RING_FUTEX)
+	wake_supported[SHM_RING_WAKE_FUTEX] = true;
+#else
+	wake_supported[SHM_RING_WAKE_FUTEX] = false;
+#endif
+	wake_supported[SHM_RING_WAKE_EVENTFD] = false;
+#if defined(STRESS_SHM_RING_EVENTFD)
+	ring->data.efd = eventfd(0, EFD_NONBLOCK);
+	ring->space.efd = eventfd(0, EFD_NONBLOCK);
+	if ((ring->data.efd >= 0) && (ring->space.efd >= 0))
+		wake_supported[SHM_RING_WAKE_EVENTFD] = true;
+#endif
+	if ((shm_ring_wake != SHM_RING_WAKE_ALL) && !wake_supported[shm_ring_wake]) {
+		if (args->instance == 0)
+			pr_inf_skip("%s: %s wake method not supported, skipping stressor\n",
+				args->name, stress_shm_ring_wake_names[shm_ring_wake]);
+		rc = EXIT_NOT_IMPLEMENTED;
+		goto tidy;
+	}
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+	/*
+	 *  each pass runs a throughput slice with a full ring and
+	 *  a latency slice with one message in flight per method
+	 *  and message size
+	 */
+	while (stress_continue(args)) {
+		for (wake = 0; (wake < SHM_RING_WAKE_METHODS) && stress_continue(args); wake++) {
+			if (!wake_supported[wake])
+				continue;
+			if ((shm_ring_wake != SHM_RING_WAKE_ALL) && (wake != shm_ring_wake))
+				continue;
+			ring->wake = wake;
+			for (i = 0; (i < n_sizes) && stress_continue(args); i++) {
+				stress_shm_ring_stats_t *stat = &stats[(wake * SIZEOF_ARRAY(stress_shm_ring_sizes)) + i];
+				int64_t errors;
+
+				ring->msg_size = sizes[i];
+				errors = stress_shm_ring_slice(args, ring,
+					shm_ring_producers, shm_ring_consumers, false, stat);
+				if (errors == 0)
+					errors = stress_shm_ring_slice(args, ring,
+						shm_ring_producers, shm_ring_consumers, true, stat);
+				if (errors < 0) {
+					rc = EXIT_NO_RESOURCE;
+					goto tidy;
+				}
+				if (errors > 0) {
+					pr_fail("%s: %" PRId64 " corrupt or out of order %zu byte "
+						"messages using %s wakes\n", args->name, errors,
+						sizes[i], stress_shm_ring_wake_names[wake]);
+					rc = EXIT_FAILURE;
+					goto tidy;
+				}
+			}
+		}
+	}
+
+	if (args->instance == 0) {
+		pr_inf("%s: %s ring, %" PRIu32 " producer%s, %" PRIu32 " consumer%s, %d slots\n",
+			args->name, ring->mpmc ? "mpmc" : "spsc",
+			shm_ring_producers, (shm_ring_producers == 1) ? "" : "s",
+			shm_ring_consumers, (shm_ring_consumers == 1) ? "" : "s",
+			SHM_RING_SLOTS);
+		pr_inf("%s: %-7s %6s %12s %10s %10s %10s %10s\n", args->name,
+			"wake", "size", "msgs/sec", "MB/sec", "mean ns", "p99 ns", "wakes/msg");
+	}
+	for (idx = 0, wake = 0; wake < SHM_RING_WAKE_METHODS; wake++) {
+		for (i = 0; i < n_sizes; i++) {
+			const stress_shm_ring_stats_t *stat = &stats[(wake * SIZEOF_ARRAY(stress_shm_ring_sizes)) + i];
+			const char *name = stress_shm_ring_wake_names[wake];
+			double rate, mean;
+			uint64_t p99;
+			char desc[64];
+
+			if ((stat->duration <= 0.0) || (stat->msgs == 0))
+				continue;
+			rate = (double)stat->msgs / stat->duration;
+			mean = stress_latency_mean(&stat->latency);
+			p99 = stress_latency_percentile(&stat->latency, 99.0);
+
+			if (args->instance == 0)
+				pr_inf("%s: %-7s %6zu %12.0f %10.2f %10.0f %10" PRIu64 " %10.3f\n",
+					args->name, name, sizes[i], rate,
+					rate * (double)sizes[i] / (double)MB, mean, p99,
+					(double)stat->wakes / (double)stat->msgs);
+
+			(void)snprintf(desc, sizeof(desc), "%s %zu byte msgs per sec", name, sizes[i]);
+			stress_metrics_set(args, idx++, desc, rate, STRESS_HARMONIC_MEAN);
+			if (stat->latency.count == 0)
+				continue;
+			(void)snprintf(desc, sizeof(desc), "%s %zu byte mean latency (ns)", name, sizes[i]);
+			stress_metrics_set(args, idx++, desc, mean, STRESS_GEOMETRIC_MEAN);
+			(void)snprintf(desc, sizeof(desc), "%s %zu byte p99 latency (ns)", name, sizes[i]);
+			stress_metrics_set(args, idx++, desc, (double)p99, STRESS_GEOMETRIC_MEAN);
+		}
+	}
+
+tidy:
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+	if (ring->data.efd >= 0)
+		(void)close(ring->data.efd);
+	if (ring->space.efd >= 0)
+		(void)close(ring->space.efd);
+	free(stats);
+	(void)munmap((void *)ring, sizeof(*ring));
+
+	return rc;
+}
+
+stressor_info_t stress_shm_ring_info = {
+	.stressor = stress_shm_ring,
+	.class = CLASS_MEMORY | CLASS_SCHEDULER | CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
+	.verify = VERIFY_ALWAYS,
+	.help = help
+};
+#else
+stressor_info_t stress_shm_ring_info = {
+	.stressor = stress_unimplemented,
+	.class = CLASS_MEMORY | CLASS_SCHEDULER | CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
+	.verify = VERIFY_ALWAYS,
+	.help = help,
+	.unimplemented_reason = "built without atomic load, store, add, sub or compare exchange builtins"
+};
+#endif
@@ -22,9 +22,18 @@
 #include "core-attribute.h"
 #include "core-builtin.h"
 #include "core-killpid.h"
+#include "core-latency.h"
 #include "core-madvise.h"
 #include "core-net.h"
 
+#if defined(HAVE_LINUX_ERRQUEUE_H)
+#include <linux/errqueue.h>
+#endif
+
+#if defined(HAVE_POLL_H)
+#include <poll.h>
+#endif
+
 #if defined(HAVE_LINUX_SOCKIOS_H)
 #include <linux/sockios.h>
 #else
@@ -66,6 +75,21 @@ UNEXPECTED
 #define MAX_SOCKET_MSGS		(10000000)
 #define DEFAULT_SOCKET_MSGS	(5000)
 
+#define MIN_SOCKET_RPC		(0)
+#define MAX_SOCKET_RPC		(1024)
+#define DEFAULT_SOCKET_RPC	(0)
+
+#define MIN_SOCKET_RPC_SIZE	(1)
+#define MAX_SOCKET_RPC_SIZE	(MMAP_IO_SIZE)
+#define DEFAULT_SOCKET_RPC_SIZE	(64)
+
+#define MIN_SOCKET_RPC_PIPELINE	(1)
+#define MAX_SOCKET_RPC_PIPELINE	(64)	/* Must be a power of 2 */
+#define DEFAULT_SOCKET_RPC_PIPELINE (1)
+
+/* limit on bytes in flight per connection to avoid send deadlocks */
+#define SOCKET_RPC_MAX_INFLIGHT	(65536)
+
 #define MMAP_BUF_SIZE		(65536)
 #define MMAP_IO_SIZE		(8192)	/* Must be less or equal to 8192 */
 
@@ -84,6 +108,14 @@ UNEXPECTED
 
 #define MSGVEC_SIZE		(4)
 
+/* zerocopy sweep, time per message size per mode and max outstanding sends */
+#define SOCKET_ZC_SLICE		(0.1)
+#define SOCKET_ZC_MAX_INFLIGHT	(256)
+#define SOCKET_ZC_MAGIC		(0x5a43a5e1)
+#define SOCKET_ZC_MODE_COPY	(0)
+#define SOCKET_ZC_MODE_ZEROCOPY	(1)
+#define SOCKET_ZC_MODES		(2)
+
 #define PROC_CONG_CTRLS		"/proc/sys/net/ipv4/tcp_allowed_congestion_control"
 
 typedef struct {
@@ -101,8 +133,12 @@ static const stress_help_t help[] = {
 	{ NULL,	"sock-opts option", 	"socket options [send|sendmsg|sendmmsg]" },
 	{ NULL,	"sock-port P",		"use socket ports P to P + number of workers - 1" },
 	{ NULL, "sock-protocol",	"use socket protocol P, default is tcp, can be mptcp" },
+	{ NULL,	"sock-rpc N",		"use N persistent connections for request/response messages" },
+	{ NULL,	"sock-rpc-pipeline K",	"keep K requests outstanding per rpc connection" },
+	{ NULL,	"sock-rpc-size N",	"size of rpc request and response messages in bytes" },
 	{ NULL,	"sock-type T",		"socket type (stream, seqpacket)" },
 	{ NULL, "sock-zerocopy",	"enable zero copy sends" },
+	{ NULL, "sock-zerocopy-sweep",	"compare copy vs zero copy send/receive over message sizes" },
 	{ NULL,	NULL,			NULL }
 };
 
@@ -217,6 +253,48 @@ static int stress_set_sock_port(const char *opt)
 	return stress_set_setting("sock-port", TYPE_ID_INT, &sock_port);
 }
 
+/*
+ *  stress_set_sock_rpc()
+ *	set number of persistent rpc connections
+ */
+static int stress_set_sock_rpc(const char *opt)
+{
+	size_t sock_rpc;
+
+	sock_rpc = (size_t)stress_get_uint64(opt);
+	stress_check_range("sock-rpc", (uint64_t)sock_rpc,
+		MIN_SOCKET_RPC, MAX_SOCKET_RPC);
+	return stress_set_setting("sock-rpc", TYPE_ID_SIZE_T, &sock_rpc);
+}
+
+/*
+ *  stress_set_sock_rpc_pipeline()
+ *	set number of outstanding rpc requests per connection
+ */
+static int stress_set_sock_rpc_pipeline(const char *opt)
+{
+	size_t sock_rpc_pipeline;
+
+	sock_rpc_pipeline = (size_t)stress_get_uint64(opt);
+	stress_check_range("sock-rpc-pipeline", (uint64_t)sock_rpc_pipeline,
+		MIN_SOCKET_RPC_PIPELINE, MAX_SOCKET_RPC_PIPELINE);
+	return stress_set_setting("sock-rpc-pipeline", TYPE_ID_SIZE_T, &sock_rpc_pipeline);
+}
+
+/*
+ *  stress_set_sock_rpc_size()
+ *	set size of rpc request and response messages
+ */
+static int stress_set_sock_rpc_size(const char *opt)
+{
+	size_t sock_rpc_size;
+
+	sock_rpc_size = (size_t)stress_get_uint64_byte(opt);
+	stress_check_range_bytes("sock-rpc-size", (uint64_t)sock_rpc_size,
+		MIN_SOCKET_RPC_SIZE, MAX_SOCKET_RPC_SIZE);
+	return stress_set_setting("sock-rpc-size", TYPE_ID_SIZE_T, &sock_rpc_size);
+}
+
 static int stress_set_sock_if(const char *name)
 {
 	return stress_set_setting("sock-if", TYPE_ID_STR, name);
@@ -270,6 +348,21 @@ static int stress_set_sock_zerocopy(const char *opt)
 #endif
 }
 
+/*
+ *  stress_set_sock_zerocopy_sweep()
+ *	set the sock zerocopy sweep option
+ */
+static int stress_set_sock_zerocopy_sweep(const char *opt)
+{
+#if defined(MSG_ZEROCOPY)
+	return stress_set_setting_true("sock-zerocopy-sweep", opt);
+#else
+	(void)opt;
+	pr_inf("sock: cannot enable sock-zerocopy-sweep, MSG_ZEROCOPY is not available\n");
+	return 0;
+#endif
+}
+
 /*
  *  stress_get_congestion_controls()
  *	get congestion controls, currently only for AF_INET. ctrls is a
@@ -588,6 +681,55 @@ static const int sol_socket_so_opts[] = {
 };
 
 
+#if defined(MSG_ZEROCOPY) &&		\
+    defined(SO_ZEROCOPY) &&		\
+    defined(MSG_ERRQUEUE) &&		\
+    defined(HAVE_LINUX_ERRQUEUE_H) &&	\
+    defined(SO_EE_ORIGIN_ZEROCOPY)
+#define STRESS_SOCK_ZEROCOPY_REAP
+/*
+ *  stress_sock_zerocopy_reap()
+ *	reap MSG_ZEROCOPY send completion notifications from the
+ *	socket error queue without blocking, returns number of
+ *	sends completed; copied is bumped for sends the kernel
+ *	fell back to copying
+ */
+static uint64_t stress_sock_zerocopy_reap(const int fd, uint64_t *copied)
+{
+	uint64_t completed = 0;
+
+	for (;;) {
+		char control[128];
+		struct msghdr msg;
+		struct cmsghdr *cmsg;
+
+		(void)shim_memset(&msg, 0, sizeof(msg));
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+		if (recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+			break;
+
+		for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+			const struct sock_extended_err *serr;
+			uint64_t n;
+
+			if (!(((cmsg->cmsg_level == SOL_IP) && (cmsg->cmsg_type == IP_RECVERR)) ||
+			      ((cmsg->cmsg_level == SOL_IPV6) && (cmsg->cmsg_type == IPV6_RECVERR))))
+				continue;
+			serr = (const struct sock_extended_err *)CMSG_DATA(cmsg);
+			if ((serr->ee_errno != 0) || (serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY))
+				continue;
+			/* ee_info..ee_data is the inclusive range of completed send ids */
+			n = (uint64_t)(serr->ee_data - serr->ee_info) + 1;
+			completed += n;
+			if (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+				*copied += n;
+		}
+	}
+	return completed;
+}
+#endif
+
 /*
  *  stress_sock_client()
  *	client reader
@@ -1038,6 +1180,9 @@ static int OPTIMIZE3 stress_sock_server(
 #if defined(SIOCOUTQ)
 	uint32_t count = 0;
 #endif
+#if defined(STRESS_SOCK_ZEROCOPY_REAP)
+	uint64_t zc_completed = 0, zc_copied = 0;
+#endif
 
 	(void)stress_get_setting("sock-msgs", &sock_msgs);
 
@@ -1241,6 +1386,12 @@ static int OPTIMIZE3 stress_sock_server(
 retry_send:
 						if (UNLIKELY(send(sfd, buf, i, flag) < 0)) {
 							if (errno == ENOBUFS) {
+#if defined(STRESS_SOCK_ZEROCOPY_REAP)
+								/* out of notification memory, reap and retry */
+								if ((flag & MSG_ZEROCOPY) &&
+								    (stress_sock_zerocopy_reap(sfd, &zc_copied) > 0))
+									goto retry_send;
+#endif
 								flag = 0;
 								goto retry_send;
 							}
@@ -1308,6 +1459,10 @@ retry_sendmmsg:
 					(void)close(sfd);
 					goto die_close;
 				}
+#if defined(STRESS_SOCK_ZEROCOPY_REAP)
+				if (sendflag & MSG_ZEROCOPY)
+					zc_completed += stress_sock_zerocopy_reap(sfd, &zc_copied);
+#endif
 				stress_bogo_inc(args);
 			}
 			if (UNLIKELY(getpeername(sfd, &saddr, &len) < 0)) {
@@ -1349,6 +1504,13 @@ retry_sendmmsg:
 	metric = (outq_samples > 0) ? (double)outq_bytes / (double)outq_samples : 0.0;
 	stress_metrics_set(args, 1, "byte average out queue length",
 		metric, STRESS_HARMONIC_MEAN);
+#if defined(STRESS_SOCK_ZEROCOPY_REAP)
+	if (sendflag & MSG_ZEROCOPY) {
+		metric = (zc_completed > 0) ? 100.0 * (double)zc_copied / (double)zc_completed : 0.0;
+		stress_metrics_set(args, 2, "% zerocopy sends copied by kernel",
+			metric, STRESS_GEOMETRIC_MEAN);
+	}
+#endif
 
 die_close:
 	(void)close(fd);
@@ -1368,6 +1530,469 @@ die:
 	return rc;
 }
 
+#if defined(HAVE_POLL_H)
+/*
+ *  per connection rpc state, requests and responses are the
+ *  same size and responses arrive in request order, so the
+ *  request send times are kept in a ring indexed by sequence
+ */
+typedef struct {
+	char *buf;			/* message receive buffer */
+	size_t rx_len;			/* bytes of current message received */
+	uint32_t tx_seq;		/* next request sequence number */
+	uint32_t rx_seq;		/* next expected response sequence number */
+	double ts[MAX_SOCKET_RPC_PIPELINE]; /* request send times */
+} stress_sock_rpc_conn_t;
+
+/*
+ *  stress_sock_rpc_nodelay()
+ *	disable Nagle if --sock-nodelay is set
+ */
+static void stress_sock_rpc_nodelay(const int fd, const int sock_domain)
+{
+#if defined(SOL_TCP) &&	\
+    defined(TCP_NODELAY)
+	if ((g_opt_flags & OPT_FLAGS_SOCKET_NODELAY) && (sock_domain != AF_UNIX)) {
+		int one = 1;
+
+		(void)setsockopt(fd, SOL_TCP, TCP_NODELAY, &one, sizeof(one));
+	}
+#else
+	(void)fd;
+	(void)sock_domain;
+#endif
+}
+
+/*
+ *  stress_sock_rpc_send()
+ *	send an entire rpc message, handling short sends
+ */
+static int stress_sock_rpc_send(const int fd, const char *buf, const size_t size)
+{
+	size_t sent = 0;
+
+	while (sent < size) {
+		const ssize_t n = send(fd, buf + sent, size - sent, 0);
+
+		if (UNLIKELY(n < 0)) {
+			if (errno == EINTR) {
+				if (!stress_continue_flag())
+					return -1;
+				continue;
+			}
+			return -1;
+		}
+		sent += (size_t)n;
+	}
+	return 0;
+}
+
+/*
+ *  stress_sock_rpc_recv()
+ *	receive as much of the current message as is available,
+ *	returns 1 when a complete message has been received, 0 if
+ *	more data is required and -1 on error or connection close
+ */
+static int stress_sock_rpc_recv(
+	const int fd,
+	stress_sock_rpc_conn_t *conn,
+	const size_t size,
+	const int flags)
+{
+	const ssize_t n = recv(fd, conn->buf + conn->rx_len, size - conn->rx_len, flags);
+
+	if (UNLIKELY(n <= 0)) {
+		if ((n < 0) && ((errno == EINTR) || (errno == EAGAIN) || (errno == EWOULDBLOCK)))
+			return 0;
+		return -1;
+	}
+	conn->rx_len += (size_t)n;
+	if (conn->rx_len < size)
+		return 0;
+	conn->rx_len = 0;
+	return 1;
+}
+
+/*
+ *  stress_sock_rpc_client_request()
+ *	send a request stamped with its sequence number
+ */
+static int stress_sock_rpc_client_request(
+	const int fd,
+	stress_sock_rpc_conn_t *conn,
+	char *buf,
+	const size_t size)
+{
+	const uint32_t seq = conn->tx_seq;
+
+	(void)shim_memcpy(buf, &seq, size < sizeof(seq) ? size : sizeof(seq));
+	conn->ts[seq & (MAX_SOCKET_RPC_PIPELINE - 1)] = stress_time_now();
+	if (UNLIKELY(stress_sock_rpc_send(fd, buf, size) < 0))
+		return -1;
+	conn->tx_seq++;
+	return 0;
+}
+
+/*
+ *  stress_sock_rpc_client()
+ *	rpc client, open sock_rpc persistent connections and keep
+ *	sock_rpc_pipeline requests in flight on each connection,
+ *	measuring the request to response round trip time. This
+ *	runs in the parent so the results can be reported before
+ *	the server child is reaped
+ */
+static int stress_sock_rpc_client(
+	stress_args_t *args,
+	char *buf,
+	const pid_t pid,
+	const pid_t mypid,
+	const int sock_domain,
+	const int sock_type,
+	const int sock_protocol,
+	const int sock_port,
+	const char *sock_if,
+	const size_t sock_rpc,
+	const size_t sock_rpc_pipeline,
+	const size_t sock_rpc_size)
+{
+	stress_sock_rpc_conn_t *conns;
+	struct pollfd *pfds;
+	struct sockaddr *addr = NULL;
+	socklen_t addr_len = 0;
+	stress_latency_t lat;
+	char *rx_bufs;
+	const size_t rx_bufs_size = sock_rpc * sock_rpc_size;
+	size_t i, active = 0;
+	uint64_t transactions = 0;
+	double t_start, duration;
+	int rc = EXIT_FAILURE;
+
+	stress_latency_init(&lat);
+
+	conns = (stress_sock_rpc_conn_t *)calloc(sock_rpc, sizeof(*conns));
+	pfds = (struct pollfd *)calloc(sock_rpc, sizeof(*pfds));
+	rx_bufs = (char *)stress_mmap_populate(NULL, rx_bufs_size,
+		PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+	if (!conns || !pfds || (rx_bufs == MAP_FAILED)) {
+		pr_inf_skip("%s: cannot allocate %zu rpc connections, skipping stressor\n",
+			args->name, sock_rpc);
+		rc = EXIT_NO_RESOURCE;
+		goto free_conns;
+	}
+	for (i = 0; i < sock_rpc; i++) {
+		pfds[i].fd = -1;
+		conns[i].buf = rx_bufs + (i * sock_rpc_size);
+	}
+	(void)shim_memset(buf, stress_ascii64[args->instance & 63], sock_rpc_size);
+
+	if (stress_set_sockaddr_if(args->name, args->instance, mypid,
+			sock_domain, sock_port, sock_if,
+			&addr, &addr_len, NET_ADDR_ANY) < 0)
+		goto close_conns;
+
+	for (i = 0; i < sock_rpc; i++) {
+		int fd, retries = 0;
+retry:
+		if (!stress_continue_flag()) {
+			rc = EXIT_SUCCESS;
+			goto close_conns;
+		}
+		fd = socket(sock_domain, sock_type, sock_protocol);
+		if (fd < 0) {
+			pr_fail("%s: socket failed, errno=%d (%s)\n",
+				args->name, errno, strerror(errno));
+			goto close_conns;
+		}
+		if (connect(fd, addr, addr_len) < 0) {
+			const int errno_tmp = errno;
+
+			(void)close(fd);
+			(void)shim_usleep(10000);
+			if (++retries > 100) {
+				pr_fail("%s: connect failed, errno=%d (%s)\n",
+					args->name, errno_tmp, strerror(errno_tmp));
+				goto close_conns;
+			}
+			goto retry;
+		}
+		stress_sock_rpc_nodelay(fd, sock_domain);
+		pfds[i].fd = fd;
+		pfds[i].events = POLLIN;
+		active++;
+	}
+
+	/* Prime each connection with the pipeline of requests */
+	for (i = 0; i < sock_rpc; i++) {
+		size_t j;
+
+		for (j = 0; j < sock_rpc_pipeline; j++) {
+			if (stress_sock_rpc_client_request(pfds[i].fd, &conns[i], buf, sock_rpc_size) < 0) {
+				if (stress_send_error(errno))
+					pr_fail("%s: send failed, errno=%d (%s)\n",
+						args->name, errno, strerror(errno));
+				goto close_conns;
+			}
+		}
+	}
+
+	t_start = stress_time_now();
+	while ((active > 0) && stress_continue(args)) {
+		int ret;
+
+		ret = poll(pfds, (nfds_t)sock_rpc, 1000);
+		if (UNLIKELY(ret < 0)) {
+			if (errno == EINTR)
+				continue;
+			pr_fail("%s: poll failed, errno=%d (%s)\n",
+				args->name, errno, strerror(errno));
+			goto report;
+		}
+		for (i = 0; (i < sock_rpc) && (ret > 0); i++) {
+			stress_sock_rpc_conn_t *conn = &conns[i];
+			const int fd = pfds[i].fd;
+			int flags = 0;
+
+			if ((fd < 0) || (pfds[i].revents == 0))
+				continue;
+			ret--;
+
+			/* drain all complete responses that are available */
+			for (;;) {
+				const int got = stress_sock_rpc_recv(fd, conn, sock_rpc_size, flags);
+				double t;
+				uint32_t seq;
+
+				if (got == 0)
+					break;
+				if (got < 0) {
+					(void)close(fd);
+					pfds[i].fd = -1;
+					active--;
+					break;
+				}
+				t = stress_time_now();
+				stress_latency_add(&lat, (uint64_t)((t -
+					conn->ts[conn->rx_seq & (MAX_SOCKET_RPC_PIPELINE - 1)]) * STRESS_DBL_NANOSECOND));
+				if (sock_rpc_size >= sizeof(seq)) {
+					(void)shim_memcpy(&seq, conn->buf, sizeof(seq));
+					if (UNLIKELY(seq != conn->rx_seq)) {
+						pr_fail("%s: rpc response sequence number %" PRIu32
+							" did not match expected %" PRIu32 "\n",
+							args->name, seq, conn->rx_seq);
+						goto report;
+					}
+				}
+				conn->rx_seq++;
+				transactions++;
+				stress_bogo_inc(args);
+
+				if (UNLIKELY(stress_sock_rpc_client_request(fd, conn, buf, sock_rpc_size) < 0)) {
+					if (stress_send_error(errno)) {
+						pr_fail("%s: send failed, errno=%d (%s)\n",
+							args->name, errno, strerror(errno));
+						goto report;
+					}
+					break;
+				}
+				flags = MSG_DONTWAIT;
+			}
+		}
+	}
+	rc = EXIT_SUCCESS;
+report:
+	duration = stress_time_now() - t_start;
+	stress_metrics_set(args, 0, "transactions per sec",
+		(duration > 0.0) ? (double)transactions / duration : 0.0,
+		STRESS_HARMONIC_MEAN);
+	(void)stress_latency_metrics_set(args, 1, "round trip", &lat);
+	if (args->instance == 0) {
+		pr_inf("%s: rpc %zu connection%s, %zu outstanding request%s, %zu byte messages, "
+			"%.2f transactions per sec\n", args->name,
+			sock_rpc, sock_rpc == 1 ? "" : "s",
+			sock_rpc_pipeline, sock_rpc_pipeline == 1 ? "" : "s",
+			sock_rpc_size,
+			(duration > 0.0) ? (double)transactions / duration : 0.0);
+		stress_latency_report(args, "round trip", &lat);
+	}
+
+close_conns:
+	for (i = 0; i < sock_rpc; i++) {
+		if (pfds[i].fd >= 0) {
+			(void)shutdown(pfds[i].fd, SHUT_RDWR);
+			(void)close(pfds[i].fd);
+		}
+	}
+free_conns:
+	if (rx_bufs != MAP_FAILED)
+		(void)munmap((void *)rx_bufs, rx_bufs_size);
+	free(pfds);
+	free(conns);
+	(void)stress_kill_pid_wait(pid, NULL);
+#if defined(AF_UNIX) &&		\
+    defined(HAVE_SOCKADDR_UN)
+	if (addr && (sock_domain == AF_UNIX)) {
+		const struct sockaddr_un *addr_un = (struct sockaddr_un *)addr;
+
+		(void)shim_unlink(addr_un->sun_path);
+	}
+#endif
+	return rc;
+}
+
+/*
+ *  stress_sock_rpc_server()
+ *	rpc server, accept sock_rpc connections and echo each
+ *	complete request back to the client as the response
+ */
+static int stress_sock_rpc_server(
+	stress_args_t *args,
+	const pid_t ppid,
+	const int sock_domain,
+	const int sock_type,
+	const int sock_protocol,
+	const int sock_port,
+	const char *sock_if,
+	const size_t sock_rpc,
+	const size_t sock_rpc_size)
+{
+	stress_sock_rpc_conn_t *conns = NULL;
+	struct pollfd *pfds = NULL;
+	struct sockaddr *addr = NULL;
+	socklen_t addr_len = 0;
+	char *rx_bufs = MAP_FAILED;
+	const size_t rx_bufs_size = sock_rpc * sock_rpc_size;
+	size_t i, active = 0;
+	int fd, so_reuseaddr = 1, rc = EXIT_SUCCESS;
+
+	stress_parent_died_alarm();
+	(void)sched_settings_apply(true);
+
+	if ((fd = socket(sock_domain, sock_type, sock_protocol)) < 0) {
+		rc = stress_exit_status(errno);
+		pr_fail("%s: socket failed, errno=%d (%s)\n",
+			args->name, errno, strerror(errno));
+		goto die;
+	}
+	if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR,
+		&so_reuseaddr, sizeof(so_reuseaddr)) < 0) {
+		pr_fail("%s: setsockopt failed, errno=%d (%s)\n",
+			args->name, errno, strerror(errno));
+		rc = EXIT_FAILURE;
+		goto die_close;
+	}
+	if (stress_set_sockaddr_if(args->name, args->instance, ppid,
+			sock_domain, sock_port, sock_if,
+			&addr, &addr_len, NET_ADDR_ANY) < 0) {
+		goto die_close;
+	}
+	if (bind(fd, addr, addr_len) < 0) {
+		rc = stress_exit_status(errno);
+		pr_fail("%s: bind failed on port %d, errno=%d (%s)\n",
+			args->name, sock_port, errno, strerror(errno));
+		goto die_close;
+	}
+	if (listen(fd, (int)sock_rpc) < 0) {
+		pr_fail("%s: listen failed, errno=%d (%s)\n",
+			args->name, errno, strerror(errno));
+		rc = EXIT_FAILURE;
+		goto die_close;
+	}
+
+	conns = (stress_sock_rpc_conn_t *)calloc(sock_rpc, sizeof(*conns));
+	pfds = (struct pollfd *)calloc(sock_rpc, sizeof(*pfds));
+	rx_bufs = (char *)stress_mmap_populate(NULL, rx_bufs_size,
+		PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+	if (!conns || !pfds || (rx_bufs == MAP_FAILED)) {
+		pr_inf("%s: cannot allocate %zu rpc connections\n",
+			args->name, sock_rpc);
+		rc = EXIT_NO_RESOURCE;
+		goto die_close;
+	}
+	for (i = 0; i < sock_rpc; i++) {
+		pfds[i].fd = -1;
+		conns[i].buf = rx_bufs + (i * sock_rpc_size);
+	}
+
+	while ((active < sock_rpc) && stress_continue(args)) {
+		const int sfd = accept(fd, (struct sockaddr *)NULL, NULL);
+
+		if (sfd < 0) {
+			if (errno == EINTR)
+				continue;
+			pr_fail("%s: accept failed, errno=%d (%s)\n",
+				args->name, errno, strerror(errno));
+			rc = EXIT_FAILURE;
+			goto die_close;
+		}
+		stress_sock_rpc_nodelay(sfd, sock_domain);
+		pfds[active].fd = sfd;
+		pfds[active].events = POLLIN;
+		active++;
+	}
+
+	while ((active > 0) && stress_continue(args)) {
+		int ret;
+
+		ret = poll(pfds, (nfds_t)sock_rpc, 1000);
+		if (UNLIKELY(ret < 0)) {
+			if (errno == EINTR)
+				continue;
+			pr_fail("%s: poll failed, errno=%d (%s)\n",
+				args->name, errno, strerror(errno));
+			rc = EXIT_FAILURE;
+			break;
+		}
+		for (i = 0; (i < sock_rpc) && (ret > 0); i++) {
+			stress_sock_rpc_conn_t *conn = &conns[i];
+			const int sfd = pfds[i].fd;
+			int flags = 0;
+
+			if ((sfd < 0) || (pfds[i].revents == 0))
+				continue;
+			ret--;
+
+			for (;;) {
+				const int got = stress_sock_rpc_recv(sfd, conn, sock_rpc_size, flags);
+
+				if (got == 0)
+					break;
+				if ((got < 0) ||
+				    (stress_sock_rpc_send(sfd, conn->buf, sock_rpc_size) < 0)) {
+					(void)close(sfd);
+					pfds[i].fd = -1;
+					active--;
+					break;
+				}
+				flags = MSG_DONTWAIT;
+			}
+		}
+	}
+
+die_close:
+	if (pfds) {
+		for (i = 0; i < sock_rpc; i++) {
+			if (pfds[i].fd >= 0)
+				(void)close(pfds[i].fd);
+		}
+	}
+	(void)close(fd);
+die:
+	if (rx_bufs != MAP_FAILED)
+		(void)munmap((void *)rx_bufs, rx_bufs_size);
+	free(pfds);
+	free(conns);
+#if defined(AF_UNIX) &&		\
+    defined(HAVE_SOCKADDR_UN)
+	if (addr && (sock_domain == AF_UNIX)) {
+		const struct sockaddr_un *addr_un = (struct sockaddr_un *)addr;
+
+		(void)shim_unlink(addr_un->sun_path);
+	}
+#endif
+	return rc;
+}
+#endif
+
 static void stress_sock_sigpipe_handler(int signum)
 {
 	(void)signum;
@@ -1375,6 +2000,523 @@ static void stress_sock_sigpipe_handler(int signum)
 	stress_continue_set_flag(false);
 }
 
+#if defined(STRESS_SOCK_ZEROCOPY_REAP) &&	\
+    defined(HAVE_POLL_H)
+#define STRESS_SOCK_ZEROCOPY_SWEEP
+
+static const size_t stress_sock_zc_sizes[] = {
+	1 * KB, 4 * KB, 16 * KB, 64 * KB, 256 * KB, 1 * MB
+};
+
+#define SOCKET_ZC_SIZES		(SIZEOF_ARRAY(stress_sock_zc_sizes))
+#define SOCKET_ZC_MAX_SIZE	(1 * MB)
+
+/*
+ *  per mode, per message size sweep statistics, tx fields are
+ *  written by the sender, rx fields by the receiver
+ */
+typedef struct {
+	uint64_t tx_bytes;		/* bytes sent */
+	uint64_t zc_sends;		/* MSG_ZEROCOPY sends issued */
+	uint64_t zc_completed;		/* zerocopy completions reaped */
+	uint64_t zc_copied;		/* completions flagged as copied */
+	double tx_duration;		/* send phase duration */
+	double tx_cpu;			/* sender CPU time */
+	uint64_t rx_bytes;		/* bytes received */
+	uint64_t rx_zc_bytes;		/* bytes mapped by TCP_ZEROCOPY_RECEIVE */
+	double rx_cpu;			/* receiver CPU time */
+} stress_sock_zc_stats_t;
+
+typedef struct {
+	uint32_t magic;			/* SOCKET_ZC_MAGIC */
+	uint32_t mode;			/* SOCKET_ZC_MODE_* */
+	uint32_t size_idx;		/* index into stress_sock_zc_sizes */
+	uint32_t pad;
+} stress_sock_zc_hdr_t;
+
+/*
+ *  stress_sock_zc_cpu()
+ *	user + system CPU time used by this process
+ */
+static double stress_sock_zc_cpu(void)
+{
+	struct rusage usage;
+
+	if (shim_getrusage(RUSAGE_SELF, &usage) < 0)
+		return 0.0;
+	return stress_timeval_to_double(&usage.ru_utime) +
+	       stress_timeval_to_double(&usage.ru_stime);
+}
+
+/*
+ *  stress_sock_zc_recv_copy()
+ *	receive into buf until EOF, returns bytes received
+ */
+static uint64_t stress_sock_zc_recv_copy(const int fd, char *buf, const size_t size)
+{
+	uint64_t bytes = 0;
+
+	for (;;) {
+		const ssize_t n = recv(fd, buf, size, 0);
+
+		if (n <= 0) {
+			if ((n < 0) && (errno == EINTR) && stress_continue_flag())
+				continue;
+			break;
+		}
+		bytes += (uint64_t)n;
+	}
+	return bytes;
+}
+
+#if defined(TCP_ZEROCOPY_RECEIVE)
+/*
+ *  stress_sock_zc_recv_zerocopy()
+ *	receive until EOF by mapping socket pages into a
+ *	TCP_ZEROCOPY_RECEIVE mmap'd window, the unaligned
+ *	remainder the kernel cannot map is received by copying
+ */
+static uint64_t stress_sock_zc_recv_zerocopy(
+	const int fd,
+	char *buf,
+	const size_t size,
+	const size_t page_size,
+	uint64_t *zc_bytes)
+{
+	const size_t map_size = (size + page_size - 1) & ~(page_size - 1);
+	uint64_t bytes = 0;
+	void *addr;
+
+	addr = mmap(NULL, map_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (addr == MAP_FAILED)
+		return stress_sock_zc_recv_copy(fd, buf, size);
+
+	for (;;) {
+		struct tcp_zerocopy_receive zc;
+		socklen_t zc_len = sizeof(zc);
+		ssize_t n;
+
+		(void)shim_memset(&zc, 0, sizeof(zc));
+		zc.address = (uint64_t)(uintptr_t)addr;
+		zc.length = (uint32_t)map_size;
+		if (getsockopt(fd, IPPROTO_TCP, TCP_ZEROCOPY_RECEIVE, &zc, &zc_len) < 0) {
+			bytes += stress_sock_zc_recv_copy(fd, buf, size);
+			break;
+		}
+		if (zc.length > 0) {
+			const volatile uint8_t *ptr = (uint8_t *)addr;
+			size_t i;
+
+			/* touch each mapped page as the consumer would */
+			for (i = 0; i < zc.length; i += page_size)
+				(void)ptr[i];
+			bytes += zc.length;
+			*zc_bytes += zc.length;
+		}
+		if (zc.recv_skip_hint > 0) {
+			n = recv(fd, buf, (zc.recv_skip_hint < size) ? zc.recv_skip_hint : size, 0);
+			if (n > 0)
+				bytes += (uint64_t)n;
+			else if (n == 0)
+				break;
+		} else if (zc.length == 0) {
+			struct pollfd pfd;
+
+			/* nothing mapped, wait for data or EOF */
+			pfd.fd = fd;
+			pfd.events = POLLIN;
+			pfd.revents = 0;
+			if (poll(&pfd, 1, 1000) < 0) {
+				if ((errno == EINTR) && stress_continue_flag())
+					continue;
+				break;
+			}
+			n = recv(fd, buf, 1, MSG_PEEK | MSG_DONTWAIT);
+			if (n == 0)
+				break;
+			if ((n < 0) && (errno != EAGAIN) && (errno != EINTR))
+				break;
+		}
+	}
+	(void)munmap(addr, map_size);
+	return bytes;
+}
+#endif
+
+/*
+ *  stress_sock_zc_receiver()
+ *	child, accept one connection per sweep phase, receive until
+ *	the sender shuts down and record the receive side stats,
+ *	closing the connection acknowledges the end of the phase
+ */
+static int stress_sock_zc_receiver(
+	stress_args_t *args,
+	const pid_t mypid,
+	const int sock_domain,
+	const int sock_port,
+	const char *sock_if,
+	stress_sock_zc_stats_t *stats)
+{
+	struct sockaddr *addr = NULL;
+	socklen_t addr_len = 0;
+	int fd, so_reuseaddr = 1;
+	char *buf;
+
+	buf = (char *)stress_mmap_populate(NULL, SOCKET_ZC_MAX_SIZE,
+		PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+	if (buf == MAP_FAILED)
+		return EXIT_NO_RESOURCE;
+
+	fd = socket(sock_domain, SOCK_STREAM, 0);
+	if (fd < 0) {
+		(void)munmap((void *)buf, SOCKET_ZC_MAX_SIZE);
+		return EXIT_FAILURE;
+	}
+	(void)setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &so_reuseaddr, sizeof(so_reuseaddr));
+	if ((stress_set_sockaddr_if(args->name, args->instance, mypid,
+			sock_domain, sock_port, sock_if,
+			&addr, &addr_len, NET_ADDR_ANY) < 0) ||
+	    (bind(fd, addr, addr_len) < 0) ||
+	    (listen(fd, 10) < 0)) {
+		pr_fail("%s: zerocopy receiver bind/listen failed on port %d, errno=%d (%s)\n",
+			args->name, sock_port, errno, strerror(errno));
+		(void)close(fd);
+		(void)munmap((void *)buf, SOCKET_ZC_MAX_SIZE);
+		return EXIT_FAILURE;
+	}
+
+	while (stress_continue_flag()) {
+		stress_sock_zc_hdr_t hdr;
+		stress_sock_zc_stats_t *stat;
+		size_t size;
+		double cpu;
+		ssize_t n;
+		const int sfd = accept(fd, NULL, NULL);
+
+		if (sfd < 0)
+			continue;
+		n = recv(sfd, &hdr, sizeof(hdr), MSG_WAITALL);
+		if ((n != (ssize_t)sizeof(hdr)) || (hdr.magic != SOCKET_ZC_MAGIC) ||
+		    (hdr.mode >= SOCKET_ZC_MODES) || (hdr.size_idx >= SOCKET_ZC_SIZES)) {
+			(void)close(sfd);
+			continue;
+		}
+		stat = &stats[(hdr.mode * SOCKET_ZC_SIZES) + hdr.size_idx];
+		size = stress_sock_zc_sizes[hdr.size_idx];
+
+		cpu = stress_sock_zc_cpu();
+#if defined(TCP_ZEROCOPY_RECEIVE)
+		if (hdr.mode == SOCKET_ZC_MODE_ZEROCOPY)
+			stat->rx_bytes += stress_sock_zc_recv_zerocopy(sfd, buf, size,
+						args->page_size, &stat->rx_zc_bytes);
+		else
+#endif
+			stat->rx_bytes += stress_sock_zc_recv_copy(sfd, buf, size);
+		stat->rx_cpu += stress_sock_zc_cpu() - cpu;
+		(void)close(sfd);
+	}
+	(void)close(fd);
+	(void)munmap((void *)buf, SOCKET_ZC_MAX_SIZE);
+	return EXIT_SUCCESS;
+}
+
+/*
+ *  stress_sock_zc_send_phase()
+ *	connect and stream messages of size bytes for SOCKET_ZC_SLICE
+ *	seconds, optionally with MSG_ZEROCOPY reaping the completions
+ *	from the error queue, then wait for the receiver to finish
+ */
+static int stress_sock_zc_send_phase(
+	stress_args_t *args,
+	const struct sockaddr *addr,
+	const socklen_t addr_len,
+	const int sock_domain,
+	const uint32_t mode,
+	const uint32_t size_idx,
+	const char *buf,
+	stress_sock_zc_stats_t *stat)
+{
+	const size_t size = stress_sock_zc_sizes[size_idx];
+	const int flags = (mode == SOCKET_ZC_MODE_ZEROCOPY) ? MSG_ZEROCOPY : 0;
+	stress_sock_zc_hdr_t hdr;
+	double t_start, t_end, cpu;
+	uint64_t zc_sends = 0, zc_completed = 0, zc_copied = 0;
+	int fd, retries = 0;
+	char ack;
+
+	fd = socket(sock_domain, SOCK_STREAM, 0);
+	if (fd < 0) {
+		pr_fail("%s: socket failed, errno=%d (%s)\n",
+			args->name, errno, strerror(errno));
+		return -1;
+	}
+	if (mode == SOCKET_ZC_MODE_ZEROCOPY) {
+		int so_zerocopy = 1;
+
+		if (setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &so_zerocopy, sizeof(so_zerocopy)) < 0) {
+			(void)close(fd);
+			return 1;
+		}
+	}
+	while (connect(fd, addr, addr_len) < 0) {
+		if ((++retries > 100) || !stress_continue(args)) {
+			if (retries > 100)
+				pr_fail("%s: connect failed, errno=%d (%s)\n",
+					args->name, errno, strerror(errno));
+			(void)close(fd);
+			return -1;
+		}
+		(void)shim_usleep(10000);
+	}
+
+	hdr.magic = SOCKET_ZC_MAGIC;
+	hdr.mode = mode;
+	hdr.size_idx = size_idx;
+	hdr.pad = 0;
+	if (send(fd, &hdr, sizeof(hdr), 0) != (ssize_t)sizeof(hdr)) {
+		(void)close(fd);
+		return -1;
+	}
+
+	cpu = stress_sock_zc_cpu();
+	t_start = stress_time_now();
+	t_end = t_start + SOCKET_ZC_SLICE;
+	do {
+		size_t sent = 0;
+
+		while ((sent < size) && stress_continue(args)) {
+			const ssize_t n = send(fd, buf + sent, size - sent, flags);
+
+			if (n < 0) {
+				if (errno == EINTR)
+					continue;
+				/* too many notifications outstanding, reap them */
+				if ((errno == ENOBUFS) && flags) {
+					zc_completed += stress_sock_zerocopy_reap(fd, &zc_copied);
+					continue;
+				}
+				if (stress_send_error(errno))
+					pr_fail("%s: send failed, errno=%d (%s)\n",
+						args->name, errno, strerror(errno));
+				goto done;
+			}
+			sent += (size_t)n;
+			stat->tx_bytes += (uint64_t)n;
+			if (flags)
+				zc_sends++;
+		}
+		if (flags && ((zc_sends - zc_completed) >= SOCKET_ZC_MAX_INFLIGHT / 2))
+			zc_completed += stress_sock_zerocopy_reap(fd, &zc_copied);
+		stress_bogo_inc(args);
+	} while ((stress_time_now() < t_end) && stress_continue(args));
+
+	/* wait a short while for the remaining completions */
+	while (flags && (zc_completed < zc_sends) && (stress_time_now() < t_end + 0.1)) {
+		struct pollfd pfd;
+
+		pfd.fd = fd;
+		pfd.events = 0;
+		pfd.revents = 0;
+		if (poll(&pfd, 1, 10) < 0)
+			break;
+		zc_completed += stress_sock_zerocopy_reap(fd, &zc_copied);
+	}
+done:
+	stat->tx_duration += stress_time_now() - t_start;
+	stat->tx_cpu += stress_sock_zc_cpu() - cpu;
+	stat->zc_sends += zc_sends;
+	stat->zc_completed += zc_completed;
+	stat->zc_copied += zc_copied;
+
+	/* receiver closes after recording its stats */
+	(void)shutdown(fd, SHUT_WR);
+	while (recv(fd, &ack, sizeof(ack), 0) > 0)
+		;
+	(void)close(fd);
+	return 0;
+}
+
+/*
+ *  stress_sock_zc_sweep()
+ *	parent, sweep message sizes sending with and without
+ *	MSG_ZEROCOPY (receiver with and without TCP_ZEROCOPY_RECEIVE)
+ *	and report throughput, CPU per GB and the crossover size
+ */
+static int stress_sock_zc_sweep(
+	stress_args_t *args,
+	const pid_t mypid,
+	const int sock_domain,
+	const int sock_type,
+	const int sock_port,
+	const char *sock_if)
+{
+	stress_sock_zc_stats_t *stats;
+	const size_t stats_size = sizeof(*stats) * SOCKET_ZC_MODES * SOCKET_ZC_SIZES;
+	struct sockaddr *addr = NULL;
+	socklen_t addr_len = 0;
+	char *buf;
+	size_t i, idx;
+	pid_t pid;
+	int rc = EXIT_SUCCESS;
+	ssize_t crossover_tput = -1, crossover_cpu = -1;
+
+	if (((sock_domain != AF_INET) && (sock_domain != AF_INET6)) ||
+	    (sock_type != SOCK_STREAM)) {
+		if (args->instance == 0)
+			pr_inf_skip("%s: --sock-zerocopy-sweep requires the ipv4 or ipv6 "
+				"domain and stream socket type, skipping stressor\n", args->name);
+		return EXIT_NOT_IMPLEMENTED;
+	}
+
+	stats = (stress_sock_zc_stats_t *)stress_mmap_populate(NULL, stats_size,
+		PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_SHARED, -1, 0);
+	if (stats == MAP_FAILED) {
+		pr_inf_skip("%s: cannot mmap zerocopy statistics, skipping stressor\n",
+			args->name);
+		return EXIT_NO_RESOURCE;
+	}
+	buf = (char *)stress_mmap_populate(NULL, SOCKET_ZC_MAX_SIZE,
+		PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+	if (buf == MAP_FAILED) {
+		pr_inf_skip("%s: cannot mmap send buffer, skipping stressor\n",
+			args->name);
+		(void)munmap((void *)stats, stats_size);
+		return EXIT_NO_RESOURCE;
+	}
+	stress_rndbuf(buf, SOCKET_ZC_MAX_SIZE);
+	(void)shim_memset(stats, 0, stats_size);
+
+again:
+	pid = fork();
+	if (pid < 0) {
+		if (stress_redo_fork(args, errno))
+			goto again;
+		pr_inf_skip("%s: fork failed, errno=%d (%s), skipping stressor\n",
+			args->name, errno, strerror(errno));
+		rc = EXIT_NO_RESOURCE;
+		goto unmap;
+	} else if (pid == 0) {
+		stress_parent_died_alarm();
+		(void)sched_settings_apply(true);
+		(void)munmap((void *)buf, SOCKET_ZC_MAX_SIZE);
+		_exit(stress_sock_zc_receiver(args, mypid, sock_domain,
+			sock_port, sock_if, stats));
+	}
+
+	if (stress_set_sockaddr_if(args->name, args->instance, mypid,
+			sock_domain, sock_port, sock_if,
+			&addr, &addr_len, NET_ADDR_ANY) < 0) {
+		rc = EXIT_FAILURE;
+		goto reap;
+	}
+
+	while (stress_continue(args)) {
+		for (i = 0; (i < SOCKET_ZC_SIZES) && stress_continue(args); i++) {
+			uint32_t mode;
+
+			for (mode = 0; (mode < SOCKET_ZC_MODES) && stress_continue(args); mode++) {
+				const int ret = stress_sock_zc_send_phase(args, addr, addr_len,
+					sock_domain, mode, (uint32_t)i, buf,
+					&stats[(mode * SOCKET_ZC_SIZES) + i]);
+
+				if (ret < 0) {
+					rc = EXIT_FAILURE;
+					goto reap;
+				}
+				if ((ret > 0) && (mode == SOCKET_ZC_MODE_ZEROCOPY)) {
+					if (args->instance == 0)
+						pr_inf_skip("%s: SO_ZEROCOPY not supported, "
+							"skipping stressor\n", args->name);
+					rc = EXIT_NOT_IMPLEMENTED;
+					goto reap;
+				}
+			}
+		}
+	}
+
+	/*
+	 *  throughput and CPU per GB (sender plus receiver) for
+	 *  each message size, the crossover is the smallest size
+	 *  from which zero copy stays ahead of copying
+	 */
+	if (args->instance == 0)
+		pr_inf("%s: %8s %12s %12s %12s %12s %9s %9s\n", args->name,
+			"size", "copy MB/s", "zc MB/s", "copy CPU/GB", "zc CPU/GB",
+			"%tx copied", "%rx zc");
+	for (idx = 0, i = 0; i < SOCKET_ZC_SIZES; i++) {
+		const stress_sock_zc_stats_t *copy = &stats[(SOCKET_ZC_MODE_COPY * SOCKET_ZC_SIZES) + i];
+		const stress_sock_zc_stats_t *zc = &stats[(SOCKET_ZC_MODE_ZEROCOPY * SOCKET_ZC_SIZES) + i];
+		const size_t size_kb = (size_t)(stress_sock_zc_sizes[i] / KB);
+		double copy_rate, zc_rate, copy_cpu, zc_cpu, tx_copied, rx_zc;
+		char desc[64];
+
+		if ((copy->tx_duration <= 0.0) || (zc->tx_duration <= 0.0) ||
+		    (copy->rx_bytes == 0) || (zc->rx_bytes == 0)) {
+			crossover_tput = -1;
+			crossover_cpu = -1;
+			continue;
+		}
+		copy_rate = (double)copy->rx_bytes / (copy->tx_duration * (double)MB);
+		zc_rate = (double)zc->rx_bytes / (zc->tx_duration * (double)MB);
+		copy_cpu = (copy->tx_cpu + copy->rx_cpu) * (double)GB / (double)copy->rx_bytes;
+		zc_cpu = (zc->tx_cpu + zc->rx_cpu) * (double)GB / (double)zc->rx_bytes;
+		tx_copied = zc->zc_completed ? 100.0 * (double)zc->zc_copied / (double)zc->zc_completed : 0.0;
+		rx_zc = 100.0 * (double)zc->rx_zc_bytes / (double)zc->rx_bytes;
+
+		if (zc_rate > copy_rate) {
+			if (crossover_tput < 0)
+				crossover_tput = (ssize_t)i;
+		} else {
+			crossover_tput = -1;
+		}
+		if (zc_cpu < copy_cpu) {
+			if (crossover_cpu < 0)
+				crossover_cpu = (ssize_t)i;
+		} else {
+			crossover_cpu = -1;
+		}
+
+		if (args->instance == 0)
+			pr_inf("%s: %7zuK %12.1f %12.1f %12.3f %12.3f %9.1f %9.1f\n", args->name,
+				size_kb, copy_rate, zc_rate, copy_cpu, zc_cpu, tx_copied, rx_zc);
+
+		(void)snprintf(desc, sizeof(desc), "MB per sec copy %zuK", size_kb);
+		stress_metrics_set(args, idx++, desc, copy_rate, STRESS_HARMONIC_MEAN);
+		(void)snprintf(desc, sizeof(desc), "MB per sec zerocopy %zuK", size_kb);
+		stress_metrics_set(args, idx++, desc, zc_rate, STRESS_HARMONIC_MEAN);
+		(void)snprintf(desc, sizeof(desc), "CPU secs per GB copy %zuK", size_kb);
+		stress_metrics_set(args, idx++, desc, copy_cpu, STRESS_GEOMETRIC_MEAN);
+		(void)snprintf(desc, sizeof(desc), "CPU secs per GB zerocopy %zuK", size_kb);
+		stress_metrics_set(args, idx++, desc, zc_cpu, STRESS_GEOMETRIC_MEAN);
+	}
+	stress_metrics_set(args, idx++, "KB zerocopy throughput crossover size",
+		(crossover_tput < 0) ? 0.0 : (double)(stress_sock_zc_sizes[crossover_tput] / KB),
+		STRESS_GEOMETRIC_MEAN);
+	stress_metrics_set(args, idx++, "KB zerocopy CPU per GB crossover size",
+		(crossover_cpu < 0) ? 0.0 : (double)(stress_sock_zc_sizes[crossover_cpu] / KB),
+		STRESS_GEOMETRIC_MEAN);
+	if (args->instance == 0) {
+		if (crossover_tput < 0)
+			pr_inf("%s: zero copy throughput does not beat copying at any size\n", args->name);
+		else
+			pr_inf("%s: zero copy throughput beats copying from %zuK\n", args->name,
+				(size_t)(stress_sock_zc_sizes[crossover_tput] / KB));
+		if (crossover_cpu < 0)
+			pr_inf("%s: zero copy CPU per GB does not beat copying at any size\n", args->name);
+		else
+			pr_inf("%s: zero copy CPU per GB beats copying from %zuK\n", args->name,
+				(size_t)(stress_sock_zc_sizes[crossover_cpu] / KB));
+	}
+
+reap:
+	(void)stress_kill_pid_wait(pid, NULL);
+unmap:
+	(void)munmap((void *)buf, SOCKET_ZC_MAX_SIZE);
+	(void)munmap((void *)stats, stats_size);
+	return rc;
+}
+#endif
+
 /*
  *  stress_sock_kernel_rt()
  * 	return true if kernel is PREEMPT_RT, true if
@@ -1412,6 +2554,10 @@ static int stress_sock(stress_args_t *args)
 	int sock_port = DEFAULT_SOCKET_PORT;
 	int sock_protocol = 0;
 	int sock_zerocopy = false;
+	bool sock_zerocopy_sweep = false;
+	size_t sock_rpc = DEFAULT_SOCKET_RPC;
+	size_t sock_rpc_pipeline = DEFAULT_SOCKET_RPC_PIPELINE;
+	size_t sock_rpc_size = DEFAULT_SOCKET_RPC_SIZE;
 	int rc = EXIT_SUCCESS, reserved_port, parent_cpu;
 	const bool rt = stress_sock_kernel_rt();
 	char *mmap_buffer;
@@ -1427,6 +2573,33 @@ static int stress_sock(stress_args_t *args)
 	(void)stress_get_setting("sock-port", &sock_port);
 	(void)stress_get_setting("sock-opts", &sock_opts);
 	(void)stress_get_setting("sock-zerocopy", &sock_zerocopy);
+	(void)stress_get_setting("sock-zerocopy-sweep", &sock_zerocopy_sweep);
+	(void)stress_get_setting("sock-rpc", &sock_rpc);
+	(void)stress_get_setting("sock-rpc-pipeline", &sock_rpc_pipeline);
+	(void)stress_get_setting("sock-rpc-size", &sock_rpc_size);
+
+	if (sock_rpc > 0) {
+#if defined(HAVE_POLL_H)
+		if (sock_type == SOCK_DGRAM) {
+			if (args->instance == 0)
+				pr_inf("%s: --sock-rpc requires a connection based socket type, "
+					"ignoring option\n", args->name);
+			sock_rpc = 0;
+		}
+		if ((sock_rpc_pipeline * sock_rpc_size) > SOCKET_RPC_MAX_INFLIGHT) {
+			sock_rpc_pipeline = SOCKET_RPC_MAX_INFLIGHT / sock_rpc_size;
+			if (args->instance == 0)
+				pr_inf("%s: reducing --sock-rpc-pipeline to %zu to limit "
+					"bytes in flight per connection\n",
+					args->name, sock_rpc_pipeline);
+		}
+#else
+		if (args->instance == 0)
+			pr_inf("%s: --sock-rpc requires poll.h, ignoring option\n",
+				args->name);
+		sock_rpc = 0;
+#endif
+	}
 
 	if (sock_if) {
 		int ret;
@@ -1454,6 +2627,19 @@ static int stress_sock(stress_args_t *args)
 	if (stress_sighandler(args->name, SIGPIPE, stress_sock_sigpipe_handler, NULL) < 0)
 		return EXIT_NO_RESOURCE;
 
+	if (sock_zerocopy_sweep) {
+		stress_set_proc_state(args->name, STRESS_STATE_RUN);
+#if defined(STRESS_SOCK_ZEROCOPY_SWEEP)
+		rc = stress_sock_zc_sweep(args, mypid, sock_domain, sock_type, sock_port, sock_if);
+#else
+		if (args->instance == 0)
+			pr_inf_skip("%s: --sock-zerocopy-sweep requires MSG_ZEROCOPY and "
+				"error queue support, skipping stressor\n", args->name);
+		rc = EXIT_NOT_IMPLEMENTED;
+#endif
+		goto finish;
+	}
+
 	mmap_buffer = (char *)stress_mmap_populate(NULL, MMAP_BUF_SIZE,
 				PROT_READ | PROT_WRITE,
 				MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
@@ -1482,12 +2668,31 @@ again:
 	} else if (pid == 0) {
 		(void)stress_change_cpu(args, parent_cpu);
 
+#if defined(HAVE_POLL_H)
+		if (sock_rpc > 0) {
+			rc = stress_sock_rpc_server(args, mypid,
+				sock_domain, sock_type, sock_protocol,
+				sock_port, sock_if, sock_rpc, sock_rpc_size);
+			(void)munmap((void *)mmap_buffer, MMAP_BUF_SIZE);
+			_exit(rc);
+		}
+#endif
 		rc = stress_sock_client(args, mmap_buffer, mypid, sock_opts,
 			sock_domain, sock_type, sock_protocol,
 			sock_port, sock_if, rt, sock_zerocopy);
 		(void)munmap((void *)mmap_buffer, MMAP_BUF_SIZE);
 		_exit(rc);
 	} else {
+#if defined(HAVE_POLL_H)
+		if (sock_rpc > 0) {
+			rc = stress_sock_rpc_client(args, mmap_buffer, pid, mypid,
+				sock_domain, sock_type, sock_protocol,
+				sock_port, sock_if, sock_rpc,
+				sock_rpc_pipeline, sock_rpc_size);
+			(void)munmap((void *)mmap_buffer, MMAP_BUF_SIZE);
+			goto finish;
+		}
+#endif
 		rc = stress_sock_server(args, mmap_buffer, pid, mypid, sock_opts,
 			sock_domain, sock_type, sock_protocol,
 			sock_port, sock_if, rt, sock_zerocopy);
@@ -1509,7 +2714,11 @@ static const stress_opt_set_func_t opt_set_funcs[] = {
 	{ OPT_sock_type,	stress_set_sock_type },
 	{ OPT_sock_port,	stress_set_sock_port },
 	{ OPT_sock_protocol,	stress_set_sock_protocol },
+	{ OPT_sock_rpc,		stress_set_sock_rpc },
+	{ OPT_sock_rpc_pipeline, stress_set_sock_rpc_pipeline },
+	{ OPT_sock_rpc_size,	stress_set_sock_rpc_size },
 	{ OPT_sock_zerocopy,	stress_set_sock_zerocopy },
+	{ OPT_sock_zerocopy_sweep, stress_set_sock_zerocopy_sweep },
 	{ 0,			NULL }
 };
 
@@ -0,0 +1,708 @@
+/*
+ * Copyright (C) 2024 Colin Ian King.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+#include "core-builtin.h"
+#include "core-latency.h"
+#include "core-net.h"
+#include "core-pthread.h"
+
+#if defined(HAVE_LINUX_IN_H)
+#include <linux/in.h>
+#endif
+
+#define MIN_SOCKCHURN_PORT	(1024)
+#define MAX_SOCKCHURN_PORT	(65535)
+#define DEFAULT_SOCKCHURN_PORT	(25000)
+
+#define MIN_SOCKCHURN_PORTS	(0)
+#define MAX_SOCKCHURN_PORTS	(16384)
+#define DEFAULT_SOCKCHURN_PORTS	(4096)
+#define SOCKCHURN_CLIENT_PORT_BASE (32768)
+
+#define MIN_SOCKCHURN_THREADS	(1)
+#define MAX_SOCKCHURN_THREADS	(64)
+#define DEFAULT_SOCKCHURN_THREADS (4)
+
+#define MIN_SOCKCHURN_BACKLOG	(1)
+#define MAX_SOCKCHURN_BACKLOG	(65535)
+#define DEFAULT_SOCKCHURN_BACKLOG (128)
+
+#define MIN_SOCKCHURN_RATE	(0)
+#define MAX_SOCKCHURN_RATE	(10000000)
+
+#define SOCKCHURN_CLOSE_CLIENT	(0)
+#define SOCKCHURN_CLOSE_SERVER	(1)
+
+#define SOCKCHURN_TIMEOUT_US	(100000)	/* socket timeouts */
+#define SOCKCHURN_SAMPLE_SECS	(1.0)		/* sampling interval */
+
+static const stress_help_t help[] = {
+	{ NULL,	"sockchurn N",		"start N workers opening and closing short lived TCP connections" },
+	{ NULL,	"sockchurn-backlog N",	"listen backlog, default 128" },
+	{ NULL,	"sockchurn-close S",	"side that closes first: client or server, default client" },
+	{ NULL,	"sockchurn-domain D",	"specify socket domain, default is ipv4" },
+	{ NULL,	"sockchurn-ops N",	"stop after N connections" },
+	{ NULL,	"sockchurn-port P",	"use socket ports P to P + number of workers - 1" },
+	{ NULL,	"sockchurn-ports N",	"reserve N client ports per worker, 0 uses the system range" },
+	{ NULL,	"sockchurn-rate N",	"target N connections per second per worker, 0 is unlimited" },
+	{ NULL,	"sockchurn-threads N",	"number of client and of server threads, default 4" },
+	{ NULL,	NULL,			NULL }
+};
+
+static const char * const stress_sockchurn_closes[] = {
+	"client",
+	"server",
+};
+
+static int stress_set_sockchurn_backlog(const char *opt)
+{
+	uint32_t sockchurn_backlog;
+
+	sockchurn_backlog = stress_get_uint32(opt);
+	stress_check_range("sockchurn-backlog", (uint64_t)sockchurn_backlog,
+		MIN_SOCKCHURN_BACKLOG, MAX_SOCKCHURN_BACKLOG);
+	return stress_set_setting("sockchurn-backlog", TYPE_ID_UINT32, &sockchurn_backlog);
+}
+
+static int stress_set_sockchurn_close(const char *opt)
+{
+	int sockchurn_close;
+
+	for (sockchurn_close = 0; sockchurn_close < (int)SIZEOF_ARRAY(stress_sockchurn_closes); sockchurn_close++) {
+		if (!strcmp(opt, stress_sockchurn_closes[sockchurn_close]))
+			return stress_set_setting("sockchurn-close", TYPE_ID_INT, &sockchurn_close);
+	}
+	(void)fprintf(stderr, "sockchurn-close option '%s' not known, options are: client, server\n", opt);
+	return -1;
+}
+
+static int stress_set_sockchurn_domain(const char *name)
+{
+	int ret, sockchurn_domain;
+
+	ret = stress_set_net_domain(DOMAIN_INET_ALL, "sockchurn-domain",
+				     name, &sockchurn_domain);
+	stress_set_setting("sockchurn-domain", TYPE_ID_INT, &sockchurn_domain);
+
+	return ret;
+}
+
+static int stress_set_sockchurn_port(const char *opt)
+{
+	int sockchurn_port;
+
+	stress_set_net_port("sockchurn-port", opt,
+		MIN_SOCKCHURN_PORT, MAX_SOCKCHURN_PORT, &sockchurn_port);
+	return stress_set_setting("sockchurn-port", TYPE_ID_INT, &sockchurn_port);
+}
+
+static int stress_set_sockchurn_ports(const char *opt)
+{
+	uint32_t sockchurn_ports;
+
+	sockchurn_ports = stress_get_uint32(opt);
+	stress_check_range("sockchurn-ports", (uint64_t)sockchurn_ports,
+		MIN_SOCKCHURN_PORTS, MAX_SOCKCHURN_PORTS);
+	return stress_set_setting("sockchurn-ports", TYPE_ID_UINT32, &sockchurn_ports);
+}
+
+static int stress_set_sockchurn_rate(const char *opt)
+{
+	uint32_t sockchurn_rate;
+
+	sockchurn_rate = stress_get_uint32(opt);
+	stress_check_range("sockchurn-rate", (uint64_t)sockchurn_rate,
+		MIN_SOCKCHURN_RATE, MAX_SOCKCHURN_RATE);
+	return stress_set_setting("sockchurn-rate", TYPE_ID_UINT32, &sockchurn_rate);
+}
+
+static int stress_set_sockchurn_threads(const char *opt)
+{
+	uint32_t sockchurn_threads;
+
+	sockchurn_threads = stress_get_uint32(opt);
+	stress_check_range("sockchurn-threads", (uint64_t)sockchurn_threads,
+		MIN_SOCKCHURN_THREADS, MAX_SOCKCHURN_THREADS);
+	return stress_set_setting("sockchurn-threads", TYPE_ID_UINT32, &sockchurn_threads);
+}
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_sockchurn_backlog,	stress_set_sockchurn_backlog },
+	{ OPT_sockchurn_close,		stress_set_sockchurn_close },
+	{ OPT_sockchurn_domain,		stress_set_sockchurn_domain },
+	{ OPT_sockchurn_port,		stress_set_sockchurn_port },
+	{ OPT_sockchurn_ports,		stress_set_sockchurn_ports },
+	{ OPT_sockchurn_rate,		stress_set_sockchurn_rate },
+	{ OPT_sockchurn_threads,	stress_set_sockchurn_threads },
+	{ 0,				NULL }
+};
+
+#if defined(HAVE_LIB_PTHREAD) &&	\
+    defined(SO_RCVTIMEO) &&		\
+    defined(SO_SNDTIMEO)
+
+typedef struct {
+	struct sockaddr *addr;		/* server address */
+	socklen_t addr_len;		/* server address length */
+	int domain;			/* AF_INET or AF_INET6 */
+	int listen_fd;			/* listening socket */
+	int close_side;			/* SOCKCHURN_CLOSE_* */
+	uint32_t port_range;		/* IP_LOCAL_PORT_RANGE value, 0 = none */
+	double interval;		/* per client secs between connects */
+	volatile bool stop;		/* threads should stop */
+} stress_sockchurn_ctxt_t;
+
+typedef struct {
+	stress_args_t *args;		/* stressor args */
+	stress_sockchurn_ctxt_t *ctxt;	/* shared context */
+	pthread_t pthread;		/* thread */
+	int ret;			/* pthread_create return */
+	uint64_t connects;		/* client, connections completed */
+	uint64_t accepts;		/* server, connections accepted */
+	uint64_t addr_unavail;		/* client, EADDRNOTAVAIL failures */
+	uint64_t timeouts;		/* client, connect/recv timeouts */
+	uint64_t errors;		/* unexpected failures */
+	uint64_t range_failed;		/* IP_LOCAL_PORT_RANGE setsockopt failed */
+	stress_latency_t latency;	/* client, connect latency */
+} stress_sockchurn_thread_t;
+
+/*
+ *  system wide TCP counters, these are per network
+ *  namespace so include other users of the namespace
+ */
+typedef struct {
+	uint64_t listen_overflows;	/* TcpExt ListenOverflows */
+	uint64_t listen_drops;		/* TcpExt ListenDrops */
+	int64_t time_wait;		/* sockets in TIME_WAIT, -1 unknown */
+} stress_sockchurn_tcp_t;
+
+/*
+ *  stress_sockchurn_timeouts()
+ *	set send (connect) and receive timeouts so threads
+ *	never block for long and can notice a stop request
+ */
+static void stress_sockchurn_timeouts(const int fd)
+{
+	struct timeval tv;
+
+	tv.tv_sec = 0;
+	tv.tv_usec = SOCKCHURN_TIMEOUT_US;
+	(void)setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+	(void)setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+
+/*
+ *  stress_sockchurn_tcp_sample()
+ *	read listen queue overflow and TIME_WAIT counts
+ */
+static void stress_sockchurn_tcp_sample(stress_sockchurn_tcp_t *tcp)
+{
+	FILE *fp;
+	char hdr[4096], val[4096];
+
+	tcp->listen_overflows = 0;
+	tcp->listen_drops = 0;
+	tcp->time_wait = -1;
+
+	fp = fopen("/proc/net/netstat", "r");
+	if (fp) {
+		/* pairs of lines, field names then values */
+		while (fgets(hdr, sizeof(hdr), fp) && fgets(val, sizeof(val), fp)) {
+			char *hsave = NULL, *vsave = NULL, *h, *v;
+
+			if (strncmp(hdr, "TcpExt:", 7))
+				continue;
+			h = strtok_r(hdr, " \n", &hsave);
+			v = strtok_r(val, " \n", &vsave);
+			while (h && v) {
+				if (!strcmp(h, "ListenOverflows"))
+					tcp->listen_overflows = (uint64_t)strtoull(v, NULL, 10);
+				else if (!strcmp(h, "ListenDrops"))
+					tcp->listen_drops = (uint64_t)strtoull(v, NULL, 10);
+				h = strtok_r(NULL, " \n", &hsave);
+				v = strtok_r(NULL, " \n", &vsave);
+			}
+			break;
+		}
+		(void)fclose(fp);
+	}
+
+	fp = fopen("/proc/net/sockstat", "r");
+	if (fp) {
+		while (fgets(hdr, sizeof(hdr), fp)) {
+			const char *tw;
+
+			if (strncmp(hdr, "TCP:", 4))
+				continue;
+			tw = strstr(hdr, " tw ");
+			if (tw)
+				tcp->time_wait = (int64_t)strtoll(tw + 4, NULL, 10);
+			break;
+		}
+		(void)fclose(fp);
+	}
+}
+
+/*
+ *  stress_sockchurn_server()
+ *	accept connections, send a byte and close either
+ *	at once or after the client has closed
+ */
+static void *stress_sockchurn_server(void *arg)
+{
+	static void *nowt = NULL;
+	stress_sockchurn_thread_t *thread = (stress_sockchurn_thread_t *)arg;
+	stress_sockchurn_ctxt_t *ctxt = thread->ctxt;
+
+	while (!ctxt->stop && stress_continue_flag()) {
+		char buf = 'C';
+		int fd;
+
+		fd = accept(ctxt->listen_fd, NULL, NULL);
+		if (fd < 0) {
+			if ((errno == EAGAIN) || (errno == EWOULDBLOCK) ||
+			    (errno == EINTR) || (errno == ECONNABORTED) ||
+			    (errno == EMFILE) || (errno == ENFILE) ||
+			    (errno == ENOBUFS) || (errno == ENOMEM))
+				continue;
+			/* listening socket shut down */
+			break;
+		}
+		thread->accepts++;
+		stress_sockchurn_timeouts(fd);
+		if (UNLIKELY(send(fd, &buf, sizeof(buf), 0) < 0)) {
+			(void)close(fd);
+			continue;
+		}
+		/* wait for the client to close first */
+		if (ctxt->close_side == SOCKCHURN_CLOSE_CLIENT) {
+			while (!ctxt->stop && (recv(fd, &buf, sizeof(buf), 0) < 0) &&
+			       ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR)))
+				;
+		}
+		(void)close(fd);
+	}
+	return &nowt;
+}
+
+/*
+ *  stress_sockchurn_client()
+ *	connect, receive a byte and close, paced to the
+ *	target rate if one is set
+ */
+static void *stress_sockchurn_client(void *arg)
+{
+	static void *nowt = NULL;
+	stress_sockchurn_thread_t *thread = (stress_sockchurn_thread_t *)arg;
+	stress_sockchurn_ctxt_t *ctxt = thread->ctxt;
+	double next = stress_time_now();
+
+	while (!ctxt->stop && stress_continue_flag()) {
+		double t;
+		char buf;
+		int fd;
+
+		if (ctxt->interval > 0.0) {
+			const double now = stress_time_now();
+
+			next += ctxt->interval;
+			/* fell too far behind, don't try to catch up in a burst */
+			if (next < now - 1.0)
+				next = now;
+			if (next > now)
+				(void)shim_nanosleep_uint64((uint64_t)((next - now) * STRESS_DBL_NANOSECOND));
+		}
+
+		fd = socket(ctxt->domain, SOCK_STREAM, 0);
+		if (UNLIKELY(fd < 0)) {
+			if ((errno == EMFILE) || (errno == ENFILE) ||
+			    (errno == ENOBUFS) || (errno == ENOMEM)) {
+				(void)shim_usleep(1000);
+				continue;
+			}
+			thread->errors++;
+			break;
+		}
+#if defined(IP_LOCAL_PORT_RANGE)
+		if (ctxt->port_range) {
+			if (setsockopt(fd, IPPROTO_IP, IP_LOCAL_PORT_RANGE,
+					&ctxt->port_range, sizeof(ctxt->port_range)) < 0)
+				thread->range_failed++;
+		}
+#endif
+		stress_sockchurn_timeouts(fd);
+
+		t = stress_time_now();
+		if (connect(fd, ctxt->addr, ctxt->addr_len) < 0) {
+			const int saved_errno = errno;
+
+			(void)close(fd);
+			switch (saved_errno) {
+			case EADDRNOTAVAIL:
+				/* out of ephemeral ports, back off */
+				thread->addr_unavail++;
+				(void)shim_usleep(1000);
+				break;
+			case EINPROGRESS:
+			case EAGAIN:
+			case ETIMEDOUT:
+				thread->timeouts++;
+				break;
+			case EINTR:
+			case ECONNREFUSED:
+			case ECONNRESET:
+				break;
+			default:
+				thread->errors++;
+				break;
+			}
+			continue;
+		}
+		stress_latency_add(&thread->latency,
+			(uint64_t)((stress_time_now() - t) * STRESS_DBL_NANOSECOND));
+
+		/* only count connections the server accepted and served */
+		if (recv(fd, &buf, sizeof(buf), 0) != sizeof(buf)) {
+			if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+				thread->timeouts++;
+			(void)close(fd);
+			continue;
+		}
+		if (ctxt->close_side == SOCKCHURN_CLOSE_SERVER) {
+			/* wait for the server to close first */
+			while (!ctxt->stop && (recv(fd, &buf, sizeof(buf), 0) < 0) &&
+			       ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR)))
+				;
+		}
+		(void)close(fd);
+		__atomic_store_n(&thread->connects, thread->connects + 1, __ATOMIC_RELAXED);
+	}
+	return &nowt;
+}
+
+/*
+ *  stress_sockchurn_listen()
+ *	create the listening socket
+ */
+static int stress_sockchurn_listen(
+	stress_args_t *args,
+	stress_sockchurn_ctxt_t *ctxt,
+	const uint32_t backlog)
+{
+	int fd, so_reuseaddr = 1;
+
+	fd = socket(ctxt->domain, SOCK_STREAM, 0);
+	if (fd < 0) {
+		pr_fail("%s: socket failed, errno=%d (%s)\n",
+			args->name, errno, strerror(errno));
+		return -1;
+	}
+	if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR,
+			&so_reuseaddr, sizeof(so_reuseaddr)) < 0) {
+		pr_fail("%s: setsockopt SO_REUSEADDR failed, errno=%d (%s)\n",
+			args->name, errno, strerror(errno));
+		(void)close(fd);
+		return -1;
+	}
+	if (bind(fd, ctxt->addr, ctxt->addr_len) < 0) {
+		pr_fail("%s: bind failed, errno=%d (%s)\n",
+			args->name, errno, strerror(errno));
+		(void)close(fd);
+		return -1;
+	}
+	if (listen(fd, (int)backlog) < 0) {
+		pr_fail("%s: listen failed, errno=%d (%s)\n",
+			args->name, errno, strerror(errno));
+		(void)close(fd);
+		return -1;
+	}
+	stress_sockchurn_timeouts(fd);
+	return fd;
+}
+
+/*
+ *  stress_sockchurn()
+ *	stress TCP connection set up and tear down rates
+ */
+static int stress_sockchurn(stress_args_t *args)
+{
+	stress_sockchurn_ctxt_t ctxt;
+	stress_sockchurn_thread_t *threads;
+	stress_sockchurn_tcp_t tcp_start, tcp_prev, tcp_now;
+	stress_latency_t latency;
+	int sockchurn_port = DEFAULT_SOCKCHURN_PORT;
+	int sockchurn_domain = AF_INET;
+	int sockchurn_close = SOCKCHURN_CLOSE_CLIENT;
+	uint32_t sockchurn_backlog = DEFAULT_SOCKCHURN_BACKLOG;
+	uint32_t sockchurn_ports = DEFAULT_SOCKCHURN_PORTS;
+	uint32_t sockchurn_rate = 0;
+	uint32_t sockchurn_threads = DEFAULT_SOCKCHURN_THREADS;
+	uint32_t i, n_threads, clients = 0, servers = 0;
+	uint64_t connects = 0, accepts = 0, addr_unavail = 0, timeouts = 0;
+	uint64_t errors = 0, range_failed = 0, prev_connects = 0, prev_unavail = 0;
+	int reserved_port, client_port = -1;
+	int64_t max_time_wait = -1;
+	double t_start, t_prev, duration, rate;
+	int rc = EXIT_SUCCESS;
+
+	(void)stress_get_setting("sockchurn-backlog", &sockchurn_backlog);
+	(void)stress_get_setting("sockchurn-close", &sockchurn_close);
+	(void)stress_get_setting("sockchurn-domain", &sockchurn_domain);
+	(void)stress_get_setting("sockchurn-port", &sockchurn_port);
+	(void)stress_get_setting("sockchurn-ports", &sockchurn_ports);
+	(void)stress_get_setting("sockchurn-rate", &sockchurn_rate);
+	(void)stress_get_setting("sockchurn-threads", &sockchurn_threads);
+
+	sockchurn_port += args->instance;
+	reserved_port = stress_net_reserve_ports(sockchurn_port, sockchurn_port);
+	if (reserved_port < 0) {
+		pr_inf_skip("%s: cannot reserve port %d, skipping stressor\n",
+			args->name, sockchurn_port);
+		return EXIT_NO_RESOURCE;
+	}
+	sockchurn_port = reserved_port;
+
+	(void)shim_memset(&ctxt, 0, sizeof(ctxt));
+	ctxt.domain = sockchurn_domain;
+	ctxt.close_side = sockchurn_close;
+	ctxt.interval = sockchurn_rate ? (double)sockchurn_threads / (double)sockchurn_rate : 0.0;
+
+	/*
+	 *  give each instance its own block of client ports so
+	 *  instances and other network stressors don't compete
+	 *  for the same ephemeral ports
+	 */
+	if (sockchurn_ports) {
+#if defined(IP_LOCAL_PORT_RANGE)
+		/* IP_LOCAL_PORT_RANGE is an IPv4 socket option */
+		if (sockchurn_domain != AF_INET) {
+			if (args->instance == 0)
+				pr_inf("%s: --sockchurn-ports is only supported with the ipv4 domain, "
+					"using the system ephemeral port range\n", args->name);
+		} else {
+			client_port = stress_net_reserve_ports(SOCKCHURN_CLIENT_PORT_BASE,
+				SOCKCHURN_CLIENT_PORT_BASE + (int)sockchurn_ports - 1);
+			if (client_port < 0) {
+				pr_inf("%s: cannot reserve %" PRIu32 " client ports, "
+					"using the system ephemeral port range\n",
+					args->name, sockchurn_ports);
+			} else {
+				ctxt.port_range = ((uint32_t)(client_port + (int)sockchurn_ports - 1) << 16) |
+						  (uint32_t)client_port;
+				pr_dbg("%s: process [%d] using server port %d, client ports %d..%d\n",
+					args->name, (int)args->pid, sockchurn_port,
+					client_port, client_port + (int)sockchurn_ports - 1);
+			}
+		}
+#else
+		if (args->instance == 0)
+			pr_inf("%s: IP_LOCAL_PORT_RANGE not supported, "
+				"using the system ephemeral port range\n", args->name);
+#endif
+	}
+
+	if (stress_set_sockaddr(args->name, args->instance, getpid(),
+			sockchurn_domain, sockchurn_port,
+			&ctxt.addr, &ctxt.addr_len, NET_ADDR_LOOPBACK) < 0) {
+		rc = EXIT_FAILURE;
+		goto release;
+	}
+	ctxt.listen_fd = stress_sockchurn_listen(args, &ctxt, sockchurn_backlog);
+	if (ctxt.listen_fd < 0) {
+		rc = EXIT_FAILURE;
+		goto release;
+	}
+
+	n_threads = sockchurn_threads * 2;
+	threads = (stress_sockchurn_thread_t *)calloc(n_threads, sizeof(*threads));
+	if (!threads) {
+		pr_inf_skip("%s: cannot allocate thread state, skipping stressor\n", args->name);
+		rc = EXIT_NO_RESOURCE;
+		goto close_listen;
+	}
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+	stress_sockchurn_tcp_sample(&tcp_start);
+	tcp_prev = tcp_start;
+	max_time_wait = tcp_start.time_wait;
+
+	/* servers first, then clients */
+	for (i = 0; i < n_threads; i++) {
+		stress_sockchurn_thread_t *thread = &threads[i];
+		const bool server = (i < sockchurn_threads);
+
+		thread->args = args;
+		thread->ctxt = &ctxt;
+		stress_latency_init(&thread->latency);
+		thread->ret = pthread_create(&thread->pthread, NULL,
+			server ? stress_sockchurn_server : stress_sockchurn_client,
+			(void *)thread);
+		if (thread->ret == 0) {
+			if (server)
+				servers++;
+			else
+				clients++;
+		}
+	}
+	if ((servers == 0) || (clients == 0)) {
+		pr_inf_skip("%s: could not create client and server pthreads, "
+			"skipping stressor\n", args->name);
+		rc = EXIT_NO_RESOURCE;
+		ctxt.stop = true;
+		goto join;
+	}
+
+	if (args->instance == 0)
+		pr_inf("%s: %8s %12s %10s %12s %10s %12s\n", args->name,
+			"time", "connects/s", "TIME_WAIT", "overflows", "drops", "no-ports");
+
+	t_start = stress_time_now();
+	t_prev = t_start;
+	do {
+		uint64_t total = 0, unavail = 0;
+		double now;
+
+		(void)shim_usleep(10000);
+		for (i = sockchurn_threads; i < n_threads; i++) {
+			total += __atomic_load_n(&threads[i].connects, __ATOMIC_RELAXED);
+			unavail += __atomic_load_n(&threads[i].addr_unavail, __ATOMIC_RELAXED);
+		}
+		stress_bogo_set(args, total);
+
+		now = stress_time_now();
+		if (now - t_prev < SOCKCHURN_SAMPLE_SECS)
+			continue;
+
+		/* connection rate, TIME_WAIT and listen queue overflows over time */
+		stress_sockchurn_tcp_sample(&tcp_now);
+		if (tcp_now.time_wait > max_time_wait)
+			max_time_wait = tcp_now.time_wait;
+		if (args->instance == 0)
+			pr_inf("%s: %7.1fs %12.0f %10" PRId64 " %12" PRIu64 " %10" PRIu64 " %12" PRIu64 "\n",
+				args->name, now - t_start,
+				(double)(total - prev_connects) / (now - t_prev),
+				tcp_now.time_wait,
+				tcp_now.listen_overflows - tcp_prev.listen_overflows,
+				tcp_now.listen_drops - tcp_prev.listen_drops,
+				unavail - prev_unavail);
+		tcp_prev = tcp_now;
+		prev_connects = total;
+		prev_unavail = unavail;
+		t_prev = now;
+	} while (stress_continue(args));
+	duration = stress_time_now() - t_start;
+
+	ctxt.stop = true;
+	/* wake servers blocked in accept */
+	(void)shutdown(ctxt.listen_fd, SHUT_RDWR);
+join:
+	for (i = 0; i < n_threads; i++) {
+		if (threads[i].ret == 0)
+			(void)pthread_join(threads[i].pthread, NULL);
+	}
+	if (rc != EXIT_SUCCESS)
+		goto free_threads;
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	stress_sockchurn_tcp_sample(&tcp_now);
+	if (tcp_now.time_wait > max_time_wait)
+		max_time_wait = tcp_now.time_wait;
+
+	stress_latency_init(&latency);
+	for (i = 0; i < n_threads; i++) {
+		const stress_sockchurn_thread_t *thread = &threads[i];
+
+		connects += thread->connects;
+		accepts += thread->accepts;
+		addr_unavail += thread->addr_unavail;
+		timeouts += thread->timeouts;
+		errors += thread->errors;
+		range_failed += thread->range_failed;
+		stress_latency_merge(&latency, &thread->latency);
+	}
+	stress_bogo_set(args, connects);
+
+	if (errors) {
+		pr_fail("%s: %" PRIu64 " unexpected socket, connect or accept failures\n",
+			args->name, errors);
+		rc = EXIT_FAILURE;
+	}
+	if (connects > accepts) {
+		pr_fail("%s: %" PRIu64 " connections completed but only %" PRIu64 " accepted\n",
+			args->name, connects, accepts);
+		rc = EXIT_FAILURE;
+	}
+	if (range_failed)
+		pr_inf("%s: IP_LOCAL_PORT_RANGE failed on %" PRIu64 " sockets, "
+			"those used the system ephemeral port range\n",
+			args->name, range_failed);
+
+	rate = (duration > 0.0) ? (double)connects / duration : 0.0;
+	stress_metrics_set(args, 0, "connects per sec", rate, STRESS_HARMONIC_MEAN);
+	stress_metrics_set(args, 1, "listen queue overflows",
+		(double)(tcp_now.listen_overflows - tcp_start.listen_overflows), STRESS_GEOMETRIC_MEAN);
+	stress_metrics_set(args, 2, "listen queue drops",
+		(double)(tcp_now.listen_drops - tcp_start.listen_drops), STRESS_GEOMETRIC_MEAN);
+	stress_metrics_set(args, 3, "max sockets in TIME_WAIT",
+		(max_time_wait < 0) ? 0.0 : (double)max_time_wait, STRESS_GEOMETRIC_MEAN);
+	stress_metrics_set(args, 4, "connects out of ports",
+		(double)addr_unavail, STRESS_GEOMETRIC_MEAN);
+	stress_metrics_set(args, 5, "connect or recv timeouts",
+		(double)timeouts, STRESS_GEOMETRIC_MEAN);
+	(void)stress_latency_metrics_set(args, 6, "connect", &latency);
+
+	if (args->instance == 0) {
+		pr_inf("%s: %.0f connects/sec, %" PRIu64 " listen overflows, %" PRIu64
+			" listen drops, max %" PRId64 " TIME_WAIT sockets, %" PRIu64
+			" connects out of ports, %" PRIu64 " timeouts\n", args->name, rate,
+			tcp_now.listen_overflows - tcp_start.listen_overflows,
+			tcp_now.listen_drops - tcp_start.listen_drops,
+			max_time_wait, addr_unavail, timeouts);
+		stress_latency_report(args, "connect", &latency);
+	}
+
+free_threads:
+	free(threads);
+close_listen:
+	(void)close(ctxt.listen_fd);
+release:
+	if (client_port >= 0)
+		stress_net_release_ports(client_port, client_port + (int)sockchurn_ports - 1);
+	stress_net_release_ports(sockchurn_port, sockchurn_port);
+
+	return rc;
+}
+
+stressor_info_t stress_sockchurn_info = {
+	.stressor = stress_sockchurn,
+	.class = CLASS_NETWORK | CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
+	.verify = VERIFY_ALWAYS,
+	.help = help
+};
+#else
+stressor_info_t stress_sockchurn_info = {
+	.stressor = stress_unimplemented,
+	.class = CLASS_NETWORK | CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
+	.verify = VERIFY_ALWAYS,
+	.help = help,
+	.unimplemented_reason = "built without pthread support or socket timeouts"
+};
+#endif
@@ -21,6 +21,7 @@
 #include "core-affinity.h"
 #include "core-builtin.h"
 #include "core-killpid.h"
+#include "core-latency.h"
 #include "core-out-of-memory.h"
 #include "core-pragma.h"
 #include <sys/socket.h>
@@ -28,12 +29,81 @@
 #define MAX_SOCKET_PAIRS	(32768)
 #define SOCKET_PAIR_BUF         (4096)	/* Socket pair I/O buffer size */
 
+#define MIN_SOCKET_PAIR_FDS	(1)
+#define MAX_SOCKET_PAIR_FDS	(64)
+#define DEFAULT_SOCKET_PAIR_FDS	(1)
+
+#define SOCKET_PAIR_SWEEP_MAX_SIZE	(64 * KB)
+#define SOCKET_PAIR_SWEEP_SLICE		(0.05)	/* seconds per measurement */
+#define SOCKET_PAIR_SWEEP_PING		('P')	/* ping, receiver acks */
+#define SOCKET_PAIR_SWEEP_STREAM	('T')	/* throughput, no ack */
+#define SOCKET_PAIR_SWEEP_DONE		('D')	/* receiver drained */
+
 static const stress_help_t help[] = {
 	{ NULL,	"sockpair N",	  "start N workers exercising socket pair I/O activity" },
+	{ NULL,	"sockpair-fds N", "pass N file descriptors per SCM_RIGHTS message in sweep mode" },
 	{ NULL,	"sockpair-ops N", "stop after N socket pair bogo operations" },
+	{ NULL,	"sockpair-sweep", "sweep socket types, message sizes and SCM_RIGHTS, report throughput and latency" },
 	{ NULL,	NULL,		  NULL }
 };
 
+typedef struct {
+	const char *name;	/* socket type name */
+	const int type;		/* socket type */
+} stress_sockpair_type_t;
+
+static const stress_sockpair_type_t stress_sockpair_types[] = {
+	{ "stream",	SOCK_STREAM },
+	{ "dgram",	SOCK_DGRAM },
+	{ "seqpacket",	SOCK_SEQPACKET },
+};
+
+static const size_t stress_sockpair_sizes[] = {
+	64, 512, 4 * KB, 16 * KB, SOCKET_PAIR_SWEEP_MAX_SIZE,
+};
+
+#define SOCKET_PAIR_SWEEP_TYPES	(SIZEOF_ARRAY(stress_sockpair_types))
+#define SOCKET_PAIR_SWEEP_SIZES	(SIZEOF_ARRAY(stress_sockpair_sizes))
+#define SOCKET_PAIR_SWEEP_CELLS	(SOCKET_PAIR_SWEEP_TYPES * SOCKET_PAIR_SWEEP_SIZES * 2)
+
+/*
+ *  per socket type, message size and fd passing statistics,
+ *  rx_* fields are filled in by the receiver via shared memory
+ */
+typedef struct {
+	uint64_t tx_bytes;		/* bytes sent, throughput slices */
+	uint64_t tx_msgs;		/* messages sent, throughput slices */
+	uint64_t tx_total_bytes;	/* all bytes sent */
+	uint64_t tx_total_fds;		/* all fds sent */
+	double duration;		/* throughput slices duration */
+	uint64_t rx_bytes;		/* all bytes received */
+	uint64_t rx_fds;		/* all fds received */
+	uint64_t rx_errors;		/* short or truncated messages */
+	bool interrupted;		/* stopped before the receiver drained */
+	stress_latency_t latency;	/* message + 1 byte ack round trip */
+} stress_sockpair_sweep_stats_t;
+
+static int stress_set_sockpair_fds(const char *opt)
+{
+	uint32_t sockpair_fds;
+
+	sockpair_fds = stress_get_uint32(opt);
+	stress_check_range("sockpair-fds", (uint64_t)sockpair_fds,
+		MIN_SOCKET_PAIR_FDS, MAX_SOCKET_PAIR_FDS);
+	return stress_set_setting("sockpair-fds", TYPE_ID_UINT32, &sockpair_fds);
+}
+
+static int stress_set_sockpair_sweep(const char *opt)
+{
+	return stress_set_setting_true("sockpair-sweep", opt);
+}
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_sockpair_fds,	stress_set_sockpair_fds },
+	{ OPT_sockpair_sweep,	stress_set_sockpair_sweep },
+	{ 0,			NULL }
+};
+
 /*
  *  socket_pair_memset()
  *	set data to be incrementing chars from val upwards
@@ -333,6 +403,409 @@ finish:
 	return EXIT_SUCCESS;
 }
 
+/*
+ *  stress_sockpair_sweep_send()
+ *	send a message of size bytes, attaching nfds copies of fd
+ *	if nfds is non-zero, returns bytes sent or -1 on error
+ */
+static ssize_t stress_sockpair_sweep_send(
+	const int sfd,
+	char *buf,
+	const size_t size,
+	const int fd,
+	const uint32_t nfds)
+{
+	struct msghdr msg;
+	struct iovec iov;
+	char ctrl[CMSG_SPACE(sizeof(int) * MAX_SOCKET_PAIR_FDS)] ALIGN64;
+	size_t sent = 0;
+
+	while (sent < size) {
+		ssize_t ret;
+
+		(void)shim_memset(&msg, 0, sizeof(msg));
+		iov.iov_base = buf + sent;
+		iov.iov_len = size - sent;
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		/* fds go with the first chunk only */
+		if (nfds && (sent == 0)) {
+			struct cmsghdr *cmsg;
+			int *fds;
+			uint32_t i;
+
+			(void)shim_memset(ctrl, 0, sizeof(ctrl));
+			msg.msg_control = ctrl;
+			msg.msg_controllen = CMSG_SPACE(sizeof(int) * nfds);
+			cmsg = CMSG_FIRSTHDR(&msg);
+			cmsg->cmsg_level = SOL_SOCKET;
+			cmsg->cmsg_type = SCM_RIGHTS;
+			cmsg->cmsg_len = CMSG_LEN(sizeof(int) * nfds);
+			fds = (int *)(void *)CMSG_DATA(cmsg);
+			for (i = 0; i < nfds; i++)
+				fds[i] = fd;
+		}
+		ret = sendmsg(sfd, &msg, 0);
+		if (UNLIKELY(ret < 0)) {
+			/* too many fds in flight, let the receiver catch up */
+			if ((errno == EAGAIN) || (errno == EINTR) ||
+			    (errno == ETOOMANYREFS) || (errno == ENOBUFS)) {
+				if (!stress_continue_flag())
+					return -1;
+				shim_sched_yield();
+				continue;
+			}
+			return -1;
+		}
+		sent += (size_t)ret;
+	}
+	return (ssize_t)sent;
+}
+
+/*
+ *  stress_sockpair_sweep_recv()
+ *	receive up to size bytes, closing any passed fds, if
+ *	exact is true keep reading until size bytes are read,
+ *	returns bytes received, 0 on end of data, -1 on error
+ */
+static ssize_t stress_sockpair_sweep_recv(
+	const int sfd,
+	char *buf,
+	const size_t size,
+	const bool exact,
+	stress_sockpair_sweep_stats_t *stats)
+{
+	char ctrl[CMSG_SPACE(sizeof(int) * MAX_SOCKET_PAIR_FDS)] ALIGN64;
+	size_t got = 0;
+
+	do {
+		struct msghdr msg;
+		struct iovec iov;
+		struct cmsghdr *cmsg;
+		ssize_t ret;
+
+		(void)shim_memset(&msg, 0, sizeof(msg));
+		iov.iov_base = buf + got;
+		iov.iov_len = size - got;
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		msg.msg_control = ctrl;
+		msg.msg_controllen = sizeof(ctrl);
+
+		ret = recvmsg(sfd, &msg, 0);
+		if (UNLIKELY(ret < 0)) {
+			if (errno == EINTR) {
+				if (!stress_continue_flag())
+					return -1;
+				continue;
+			}
+			return -1;
+		}
+		if (msg.msg_flags & (MSG_CTRUNC | MSG_TRUNC))
+			stats->rx_errors++;
+		for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+			if ((cmsg->cmsg_level == SOL_SOCKET) &&
+			    (cmsg->cmsg_type == SCM_RIGHTS)) {
+				const int *fds = (int *)(void *)CMSG_DATA(cmsg);
+				const size_t n = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+				size_t i;
+
+				for (i = 0; i < n; i++)
+					(void)close(fds[i]);
+				stats->rx_fds += n;
+			}
+		}
+		if (ret == 0)
+			return (ssize_t)got;
+		got += (size_t)ret;
+		stats->rx_bytes += (uint64_t)ret;
+	} while (exact && (got < size));
+
+	return (ssize_t)got;
+}
+
+/*
+ *  stress_sockpair_sweep_receiver()
+ *	child, ack ping messages and drain throughput
+ *	messages until the sender shuts down
+ */
+static void stress_sockpair_sweep_receiver(
+	const int sfd,
+	const int type,
+	const size_t size,
+	stress_sockpair_sweep_stats_t *stats)
+{
+	static char buf[SOCKET_PAIR_SWEEP_MAX_SIZE] ALIGN64;
+	const bool stream = (type == SOCK_STREAM);
+	bool ping = true;
+	char ack = SOCKET_PAIR_SWEEP_PING;
+
+	for (;;) {
+		const ssize_t n = stress_sockpair_sweep_recv(sfd, buf, size, stream && ping, stats);
+
+		if (n <= 0)
+			break;
+		if (!stream && (n == 1) && (buf[0] == SOCKET_PAIR_SWEEP_DONE))
+			break;
+		/* message boundaries are preserved by dgram and seqpacket */
+		if (!stream && ((size_t)n != size))
+			stats->rx_errors++;
+		if (ping) {
+			if (buf[0] == SOCKET_PAIR_SWEEP_STREAM) {
+				ping = false;
+				continue;
+			}
+			if (UNLIKELY(send(sfd, &ack, sizeof(ack), 0) < 0))
+				break;
+		}
+	}
+	ack = SOCKET_PAIR_SWEEP_DONE;
+	VOID_RET(ssize_t, send(sfd, &ack, sizeof(ack), 0));
+}
+
+/*
+ *  stress_sockpair_sweep_cell()
+ *	measure message + ack round trip latency and then
+ *	throughput for one socket type, size and fd count
+ */
+static int stress_sockpair_sweep_cell(
+	stress_args_t *args,
+	const int type,
+	const size_t size,
+	const uint32_t nfds,
+	const int fd,
+	char *buf,
+	stress_sockpair_sweep_stats_t *stats)
+{
+	int sv[2], rc = 0;
+	pid_t pid;
+	double t, t_end;
+	char ack;
+
+	if (socketpair(AF_UNIX, type, 0, sv) < 0) {
+		if ((errno == EAFNOSUPPORT) || (errno == EPROTONOSUPPORT) ||
+		    (errno == EOPNOTSUPP) || (errno == EMFILE) || (errno == ENFILE))
+			return 1;
+		pr_fail("%s: socketpair failed, errno=%d (%s)\n",
+			args->name, errno, strerror(errno));
+		return -1;
+	}
+again:
+	pid = fork();
+	if (pid < 0) {
+		if (stress_redo_fork(args, errno))
+			goto again;
+		(void)close(sv[0]);
+		(void)close(sv[1]);
+		return stress_continue(args) ? 1 : 0;
+	} else if (pid == 0) {
+		stress_parent_died_alarm();
+		(void)sched_settings_apply(true);
+		(void)close(sv[0]);
+		stress_sockpair_sweep_receiver(sv[1], type, size, stats);
+		(void)close(sv[1]);
+		_exit(EXIT_SUCCESS);
+	}
+	(void)close(sv[1]);
+
+	/* one message in flight, round trip to the 1 byte ack */
+	buf[0] = SOCKET_PAIR_SWEEP_PING;
+	t_end = stress_time_now() + SOCKET_PAIR_SWEEP_SLICE;
+	do {
+		t = stress_time_now();
+		if (UNLIKELY(stress_sockpair_sweep_send(sv[0], buf, size, fd, nfds) < 0))
+			goto err;
+		stats->tx_total_bytes += size;
+		stats->tx_total_fds += nfds;
+		if (UNLIKELY(recv(sv[0], &ack, sizeof(ack), 0) != sizeof(ack)))
+			goto err;
+		stress_latency_add(&stats->latency,
+			(uint64_t)((stress_time_now() - t) * STRESS_DBL_NANOSECOND));
+		stress_bogo_inc(args);
+	} while (stress_continue(args) && (stress_time_now() < t_end));
+
+	/* back to back messages until the slice ends, then drain */
+	buf[0] = SOCKET_PAIR_SWEEP_STREAM;
+	t = stress_time_now();
+	t_end = t + SOCKET_PAIR_SWEEP_SLICE;
+	do {
+		if (UNLIKELY(stress_sockpair_sweep_send(sv[0], buf, size, fd, nfds) < 0))
+			goto err;
+		stats->tx_bytes += size;
+		stats->tx_msgs++;
+		stats->tx_total_bytes += size;
+		stats->tx_total_fds += nfds;
+		stress_bogo_inc(args);
+	} while (stress_continue_flag() && (stress_time_now() < t_end));
+	/* dgram shutdown is not seen by the peer, send an end message */
+	if (type == SOCK_DGRAM) {
+		ack = SOCKET_PAIR_SWEEP_DONE;
+		if (UNLIKELY(send(sv[0], &ack, sizeof(ack), 0) != sizeof(ack)))
+			goto err;
+		stats->tx_total_bytes += sizeof(ack);
+	} else {
+		(void)shutdown(sv[0], SHUT_WR);
+	}
+	if (recv(sv[0], &ack, sizeof(ack), 0) != sizeof(ack))
+		goto err;
+	stats->duration += stress_time_now() - t;
+	goto reap;
+err:
+	/* a failure after a stop request is not an error */
+	if (stress_continue_flag()) {
+		pr_fail("%s: %s socket pair I/O failed, errno=%d (%s)\n",
+			args->name, (type == SOCK_STREAM) ? "stream" :
+			(type == SOCK_DGRAM) ? "dgram" : "seqpacket",
+			errno, strerror(errno));
+		rc = -1;
+	} else {
+		stats->interrupted = true;
+	}
+reap:
+	(void)close(sv[0]);
+	(void)stress_kill_pid_wait(pid, NULL);
+	return rc;
+}
+
+/*
+ *  stress_sockpair_sweep()
+ *	sweep AF_UNIX socket types, message sizes and SCM_RIGHTS
+ *	fd passing, report throughput and round trip latency
+ */
+static int stress_sockpair_sweep(stress_args_t *args)
+{
+	stress_sockpair_sweep_stats_t *stats;
+	const size_t stats_size = sizeof(*stats) * SOCKET_PAIR_SWEEP_CELLS;
+	uint32_t sockpair_fds = DEFAULT_SOCKET_PAIR_FDS;
+	char *buf;
+	size_t t, s, f, idx;
+	int pipefds[2], rc = EXIT_SUCCESS;
+
+	(void)stress_get_setting("sockpair-fds", &sockpair_fds);
+
+	stats = (stress_sockpair_sweep_stats_t *)stress_mmap_populate(NULL, stats_size,
+		PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_SHARED, -1, 0);
+	if (stats == MAP_FAILED) {
+		pr_inf_skip("%s: cannot mmap sweep statistics, skipping stressor\n",
+			args->name);
+		return EXIT_NO_RESOURCE;
+	}
+	buf = (char *)stress_mmap_populate(NULL, SOCKET_PAIR_SWEEP_MAX_SIZE,
+		PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+	if (buf == MAP_FAILED) {
+		pr_inf_skip("%s: cannot mmap send buffer, skipping stressor\n",
+			args->name);
+		(void)munmap((void *)stats, stats_size);
+		return EXIT_NO_RESOURCE;
+	}
+	/* the fd passed with SCM_RIGHTS */
+	if (pipe(pipefds) < 0) {
+		pr_inf_skip("%s: pipe failed, errno=%d (%s), skipping stressor\n",
+			args->name, errno, strerror(errno));
+		rc = EXIT_NO_RESOURCE;
+		goto unmap;
+	}
+	stress_rndbuf(buf, SOCKET_PAIR_SWEEP_MAX_SIZE);
+	(void)shim_memset(stats, 0, stats_size);
+	for (idx = 0; idx < SOCKET_PAIR_SWEEP_CELLS; idx++)
+		stress_latency_init(&stats[idx].latency);
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+	do {
+		for (idx = 0, t = 0; t < SOCKET_PAIR_SWEEP_TYPES; t++) {
+			for (s = 0; s < SOCKET_PAIR_SWEEP_SIZES; s++) {
+				for (f = 0; f < 2; f++, idx++) {
+					int ret;
+
+					if (!stress_continue(args))
+						goto report;
+					ret = stress_sockpair_sweep_cell(args,
+						stress_sockpair_types[t].type,
+						stress_sockpair_sizes[s],
+						f ? sockpair_fds : 0, pipefds[0],
+						buf, &stats[idx]);
+					if (ret < 0) {
+						rc = EXIT_FAILURE;
+						goto report;
+					}
+				}
+			}
+		}
+	} while (stress_continue(args));
+
+report:
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	if (args->instance == 0)
+		pr_inf("%s: %-9s %6s %4s %10s %12s %10s %10s\n", args->name,
+			"type", "size", "fds", "MB/sec", "msgs/sec",
+			"rtt mean", "rtt p99");
+	for (idx = 0, t = 0; t < SOCKET_PAIR_SWEEP_TYPES; t++) {
+		for (s = 0; s < SOCKET_PAIR_SWEEP_SIZES; s++) {
+			for (f = 0; f < 2; f++, idx++) {
+				const stress_sockpair_sweep_stats_t *st = &stats[idx];
+				const size_t size = stress_sockpair_sizes[s];
+				const uint32_t nfds = f ? sockpair_fds : 0;
+				double mb_rate, msg_rate, rtt_mean;
+				char sz[32], desc[64];
+
+				if ((st->duration <= 0.0) || (st->latency.count == 0))
+					continue;
+
+				/* receiver state is only complete for cells that finished */
+				if ((rc == EXIT_SUCCESS) && !st->interrupted) {
+					if (st->rx_errors) {
+						pr_fail("%s: %s %zu byte messages, %" PRIu64
+							" short or truncated receives\n", args->name,
+							stress_sockpair_types[t].name, size, st->rx_errors);
+						rc = EXIT_FAILURE;
+					}
+					if ((st->rx_bytes != st->tx_total_bytes) ||
+					    (st->rx_fds != st->tx_total_fds)) {
+						pr_fail("%s: %s %zu byte messages, sent %" PRIu64
+							" bytes and %" PRIu64 " fds, received %" PRIu64
+							" bytes and %" PRIu64 " fds\n", args->name,
+							stress_sockpair_types[t].name, size,
+							st->tx_total_bytes, st->tx_total_fds,
+							st->rx_bytes, st->rx_fds);
+						rc = EXIT_FAILURE;
+					}
+				}
+
+				mb_rate = (double)st->tx_bytes / (st->duration * (double)MB);
+				msg_rate = (double)st->tx_msgs / st->duration;
+				rtt_mean = stress_latency_mean(&st->latency) / 1000.0;
+				if (size >= KB)
+					(void)snprintf(sz, sizeof(sz), "%zuK", (size_t)(size / KB));
+				else
+					(void)snprintf(sz, sizeof(sz), "%zu", size);
+
+				if (args->instance == 0)
+					pr_inf("%s: %-9s %6s %4" PRIu32 " %10.1f %12.0f %8.2fus %8.2fus\n",
+						args->name, stress_sockpair_types[t].name, sz, nfds,
+						mb_rate, msg_rate, rtt_mean,
+						(double)stress_latency_percentile(&st->latency, 99.0) / 1000.0);
+
+				(void)snprintf(desc, sizeof(desc), "MB per sec %s %s%s",
+					stress_sockpair_types[t].name, sz, nfds ? " fds" : "");
+				stress_metrics_set(args, idx * 2, desc, mb_rate, STRESS_HARMONIC_MEAN);
+				(void)snprintf(desc, sizeof(desc), "usec rtt %s %s%s",
+					stress_sockpair_types[t].name, sz, nfds ? " fds" : "");
+				stress_metrics_set(args, (idx * 2) + 1, desc, rtt_mean, STRESS_GEOMETRIC_MEAN);
+			}
+		}
+	}
+
+	(void)close(pipefds[0]);
+	(void)close(pipefds[1]);
+unmap:
+	(void)munmap((void *)buf, SOCKET_PAIR_SWEEP_MAX_SIZE);
+	(void)munmap((void *)stats, stats_size);
+
+	return rc;
+}
+
 /*
  *  stress_sockpair
  *	stress by heavy socket_pair I/O
@@ -340,12 +813,18 @@ finish:
 static int stress_sockpair(stress_args_t *args)
 {
 	int rc;
+	bool sockpair_sweep = false;
 
-	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+	(void)stress_get_setting("sockpair-sweep", &sockpair_sweep);
 
 	if (stress_sighandler(args->name, SIGPIPE, stress_sighandler_nop, NULL) < 0)
 		return EXIT_NO_RESOURCE;
 
+	if (sockpair_sweep)
+		return stress_sockpair_sweep(args);
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
 	rc = stress_oomable_child(args, NULL, stress_sockpair_oomable, STRESS_OOMABLE_DROP_CAP);
 
 	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
@@ -356,6 +835,7 @@ static int stress_sockpair(stress_args_t *args)
 stressor_info_t stress_sockpair_info = {
 	.stressor = stress_sockpair,
 	.class = CLASS_NETWORK | CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
 	.verify = VERIFY_OPTIONAL,
 	.help = help
 };
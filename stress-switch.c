@@ -20,7 +20,11 @@
 #include "stress-ng.h"
 #include "core-affinity.h"
 #include "core-builtin.h"
+#include "core-cpu-cache.h"
 #include "core-killpid.h"
+#include "core-latency.h"
+
+#include <sched.h>
 
 #if defined(HAVE_MQUEUE_H)
 #include <mqueue.h>
@@ -39,6 +43,7 @@ static const stress_help_t help[] = {
 	{ NULL, "switch-freq N", 	"set frequency of context switches" },
 	{ NULL, "switch-method M",	"mq | pipe | sem-sysv" },
 	{ NULL,	"switch-ops N",	 	"stop after N context switch bogo operations" },
+	{ NULL, "switch-topology",	"measure wake latency of pinned pairs by cpu topology distance" },
 	{ NULL, NULL, 			NULL }
 };
 
@@ -53,6 +58,8 @@ typedef struct {
 
 #define THRESH_FREQ	(100)		/* Delay adjustment rate in HZ */
 
+#define SWITCH_TOPOLOGY_SLICE	(0.1)	/* Seconds per placement and method */
+
 /*
  *  stress_set_switch_freq()
  *	set context switch freq in Hz from given option
@@ -66,6 +73,11 @@ static int stress_set_switch_freq(const char *opt)
 	return stress_set_setting("switch-freq", TYPE_ID_UINT64, &switch_freq);
 }
 
+static int stress_set_switch_topology(const char *opt)
+{
+	return stress_set_setting_true("switch-topology", opt);
+}
+
 /*
  *  stress_switch_rate()
  *	report context switch duration
@@ -485,6 +497,484 @@ finish:
 }
 #endif
 
+#if defined(HAVE_SCHED_GETAFFINITY) &&	\
+    defined(HAVE_SCHED_SETAFFINITY)
+#define STRESS_SWITCH_TOPOLOGY
+
+#define SWITCH_TO_CHILD		(0)	/* parent wakes child */
+#define SWITCH_TO_PARENT	(1)	/* child wakes parent */
+
+/*
+ *  wake channels in both directions between a pinned
+ *  parent and child
+ */
+typedef struct {
+	int pipefds[2][2];		/* pipe per direction */
+#if defined(HAVE_SEM_SYSV) &&	\
+    defined(HAVE_KEY_T)
+	int sem_id;			/* semaphore per direction */
+#endif
+#if defined(HAVE_MQUEUE_H) &&   \
+    defined(HAVE_LIB_RT) &&     \
+    defined(HAVE_MQ_POSIX)
+	mqd_t mq[2];			/* message queue per direction */
+	char mq_name[2][64];
+#endif
+} stress_switch_chan_t;
+
+typedef struct {
+	const char *name;
+	int (*open)(stress_args_t *args, stress_switch_chan_t *chan);
+	int (*wake)(stress_switch_chan_t *chan, const int dir);
+	int (*wait)(stress_switch_chan_t *chan, const int dir);
+	void (*close)(stress_switch_chan_t *chan);
+} stress_switch_wake_t;
+
+/*
+ *  shared between the parent and child, each side stamps the
+ *  time just before waking the other side, the woken side
+ *  records the one-way wake latency
+ */
+typedef struct {
+	double stamp[2];		/* wake time in each direction */
+	stress_latency_t latency[2];	/* wake latency in each direction */
+	volatile bool stop;		/* child should exit */
+} stress_switch_shared_t;
+
+static int stress_switch_pipe_open(stress_args_t *args, stress_switch_chan_t *chan)
+{
+	if (pipe(chan->pipefds[0]) < 0) {
+		pr_fail("%s: pipe failed, errno=%d (%s)\n",
+			args->name, errno, strerror(errno));
+		return -1;
+	}
+	if (pipe(chan->pipefds[1]) < 0) {
+		pr_fail("%s: pipe failed, errno=%d (%s)\n",
+			args->name, errno, strerror(errno));
+		(void)close(chan->pipefds[0][0]);
+		(void)close(chan->pipefds[0][1]);
+		return -1;
+	}
+	return 0;
+}
+
+static int stress_switch_pipe_wake(stress_switch_chan_t *chan, const int dir)
+{
+	const char ch = 'w';
+
+	return (write(chan->pipefds[dir][1], &ch, sizeof(ch)) == sizeof(ch)) ? 0 : -1;
+}
+
+static int stress_switch_pipe_wait(stress_switch_chan_t *chan, const int dir)
+{
+	char ch;
+
+	return (read(chan->pipefds[dir][0], &ch, sizeof(ch)) == sizeof(ch)) ? 0 : -1;
+}
+
+static void stress_switch_pipe_close(stress_switch_chan_t *chan)
+{
+	(void)close(chan->pipefds[0][0]);
+	(void)close(chan->pipefds[0][1]);
+	(void)close(chan->pipefds[1][0]);
+	(void)close(chan->pipefds[1][1]);
+}
+
+#if defined(HAVE_SEM_SYSV) &&	\
+    defined(HAVE_KEY_T)
+static int stress_switch_sem_sysv_open(stress_args_t *args, stress_switch_chan_t *chan)
+{
+	int i;
+
+	for (i = 0; i < 100; i++) {
+		const key_t key_id = (key_t)stress_mwc16();
+
+		chan->sem_id = semget(key_id, 2, IPC_CREAT | IPC_EXCL | S_IRUSR | S_IWUSR);
+		if (chan->sem_id >= 0)
+			return 0;
+	}
+	pr_err("%s: semaphore init (SYSV) failed: errno=%d (%s)\n",
+		args->name, errno, strerror(errno));
+	return -1;
+}
+
+static int stress_switch_sem_sysv_op(stress_switch_chan_t *chan, const int dir, const short op)
+{
+	struct sembuf sem ALIGN64;
+
+	sem.sem_num = (unsigned short)dir;
+	sem.sem_op = op;
+	sem.sem_flg = 0;
+	return semop(chan->sem_id, &sem, 1);
+}
+
+static int stress_switch_sem_sysv_wake(stress_switch_chan_t *chan, const int dir)
+{
+	return stress_switch_sem_sysv_op(chan, dir, 1);
+}
+
+static int stress_switch_sem_sysv_wait(stress_switch_chan_t *chan, const int dir)
+{
+	return stress_switch_sem_sysv_op(chan, dir, -1);
+}
+
+static void stress_switch_sem_sysv_close(stress_switch_chan_t *chan)
+{
+	(void)semctl(chan->sem_id, 0, IPC_RMID);
+}
+#endif
+
+#if defined(HAVE_MQUEUE_H) &&   \
+    defined(HAVE_LIB_RT) &&     \
+    defined(HAVE_MQ_POSIX)
+static int stress_switch_mq_open(stress_args_t *args, stress_switch_chan_t *chan)
+{
+	struct mq_attr attr;
+	int i;
+
+	attr.mq_flags = 0;
+	attr.mq_maxmsg = 1;
+	attr.mq_msgsize = sizeof(uint64_t);
+	attr.mq_curmsgs = 0;
+
+	for (i = 0; i < 2; i++) {
+		(void)snprintf(chan->mq_name[i], sizeof(chan->mq_name[i]),
+			"/%s-%" PRIdMAX "-%" PRIu32 "-%d",
+			args->name, (intmax_t)args->pid, args->instance, i);
+		chan->mq[i] = mq_open(chan->mq_name[i], O_CREAT | O_RDWR, S_IRUSR | S_IWUSR, &attr);
+		if (chan->mq[i] < 0) {
+			pr_err("%s: message queue open failed: errno=%d (%s)\n",
+				args->name, errno, strerror(errno));
+			if (i > 0) {
+				(void)mq_close(chan->mq[0]);
+				(void)mq_unlink(chan->mq_name[0]);
+			}
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static int stress_switch_mq_wake(stress_switch_chan_t *chan, const int dir)
+{
+	const uint64_t val = 0;
+
+	return mq_send(chan->mq[dir], (const char *)&val, sizeof(val), 0);
+}
+
+static int stress_switch_mq_wait(stress_switch_chan_t *chan, const int dir)
+{
+	uint64_t val;
+	unsigned int prio;
+
+	return (mq_receive(chan->mq[dir], (char *)&val, sizeof(val), &prio) < 0) ? -1 : 0;
+}
+
+static void stress_switch_mq_close(stress_switch_chan_t *chan)
+{
+	int i;
+
+	for (i = 0; i < 2; i++) {
+		(void)mq_close(chan->mq[i]);
+		(void)mq_unlink(chan->mq_name[i]);
+	}
+}
+#endif
+
+static const stress_switch_wake_t stress_switch_wakes[] = {
+#if defined(HAVE_MQUEUE_H) &&   \
+    defined(HAVE_LIB_RT) &&     \
+    defined(HAVE_MQ_POSIX)
+	{ "mq",		stress_switch_mq_open, stress_switch_mq_wake,
+			stress_switch_mq_wait, stress_switch_mq_close },
+#endif
+	{ "pipe",	stress_switch_pipe_open, stress_switch_pipe_wake,
+			stress_switch_pipe_wait, stress_switch_pipe_close },
+#if defined(HAVE_SEM_SYSV) &&	\
+    defined(HAVE_KEY_T)
+	{ "sem-sysv",	stress_switch_sem_sysv_open, stress_switch_sem_sysv_wake,
+			stress_switch_sem_sysv_wait, stress_switch_sem_sysv_close },
+#endif
+};
+
+#define SWITCH_WAKES	(SIZEOF_ARRAY(stress_switch_wakes))
+
+/*
+ *  stress_switch_pin()
+ *	pin the calling process to a single cpu
+ */
+static int stress_switch_pin(const int32_t cpu)
+{
+	cpu_set_t mask;
+
+	CPU_ZERO(&mask);
+	CPU_SET((int)cpu, &mask);
+	return sched_setaffinity(0, sizeof(mask), &mask);
+}
+
+/*
+ *  stress_switch_topology_pair()
+ *	find the nth pair of cpus that are the given distance
+ *	apart, n wraps around the number of matching pairs,
+ *	returns false if there are no pairs at this distance
+ */
+static bool stress_switch_topology_pair(
+	const stress_cpu_topology_t *topology,
+	const uint32_t n_cpus,
+	const stress_cpu_distance_t distance,
+	const uint64_t nth,
+	uint32_t *cpu1,
+	uint32_t *cpu2)
+{
+	uint64_t pairs = 0, target;
+	uint32_t i, j;
+
+	for (i = 0; i < n_cpus; i++) {
+		for (j = i; j < n_cpus; j++) {
+			if (stress_cpu_topology_distance(&topology[i], &topology[j]) == distance)
+				pairs++;
+		}
+	}
+	if (pairs == 0)
+		return false;
+
+	target = nth % pairs;
+	for (pairs = 0, i = 0; i < n_cpus; i++) {
+		for (j = i; j < n_cpus; j++) {
+			if (stress_cpu_topology_distance(&topology[i], &topology[j]) != distance)
+				continue;
+			if (pairs++ == target) {
+				*cpu1 = i;
+				*cpu2 = j;
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+/*
+ *  stress_switch_topology_slice()
+ *	ping-pong between the parent pinned to cpu1 and a child pinned
+ *	to cpu2 for a time slice, recording one-way wake latencies
+ */
+static int stress_switch_topology_slice(
+	stress_args_t *args,
+	const stress_switch_wake_t *wake,
+	const int32_t cpu1,
+	const int32_t cpu2,
+	stress_switch_shared_t *shared,
+	stress_latency_t *latency)
+{
+	stress_switch_chan_t chan;
+	double t_end;
+	pid_t pid;
+	int status;
+
+	if (wake->open(args, &chan) < 0)
+		return -1;
+
+	stress_latency_init(&shared->latency[SWITCH_TO_CHILD]);
+	stress_latency_init(&shared->latency[SWITCH_TO_PARENT]);
+	shared->stop = false;
+	(void)stress_switch_pin(cpu1);
+
+again:
+	pid = fork();
+	if (pid < 0) {
+		if (stress_redo_fork(args, errno))
+			goto again;
+		wake->close(&chan);
+		if (!stress_continue(args))
+			return 0;
+		pr_fail("%s: fork failed, errno=%d (%s)\n",
+			args->name, errno, strerror(errno));
+		return -1;
+	} else if (pid == 0) {
+		stress_parent_died_alarm();
+		(void)sched_settings_apply(true);
+		(void)stress_switch_pin(cpu2);
+
+		while (stress_continue_flag()) {
+			double now;
+
+			if (UNLIKELY(wake->wait(&chan, SWITCH_TO_CHILD) < 0))
+				break;
+			now = stress_time_now();
+			if (shared->stop)
+				break;
+			stress_latency_add(&shared->latency[SWITCH_TO_CHILD],
+				(uint64_t)((now - shared->stamp[SWITCH_TO_CHILD]) * STRESS_DBL_NANOSECOND));
+			shared->stamp[SWITCH_TO_PARENT] = stress_time_now();
+			if (UNLIKELY(wake->wake(&chan, SWITCH_TO_PARENT) < 0))
+				break;
+		}
+		_exit(EXIT_SUCCESS);
+	}
+
+	t_end = stress_time_now() + SWITCH_TOPOLOGY_SLICE;
+	do {
+		double now;
+
+		shared->stamp[SWITCH_TO_CHILD] = stress_time_now();
+		if (UNLIKELY(wake->wake(&chan, SWITCH_TO_CHILD) < 0))
+			break;
+		if (UNLIKELY(wake->wait(&chan, SWITCH_TO_PARENT) < 0))
+			break;
+		now = stress_time_now();
+		stress_latency_add(&shared->latency[SWITCH_TO_PARENT],
+			(uint64_t)((now - shared->stamp[SWITCH_TO_PARENT]) * STRESS_DBL_NANOSECOND));
+		stress_bogo_inc(args);
+	} while (stress_continue(args) && (stress_time_now() < t_end));
+
+	shared->stop = true;
+	(void)wake->wake(&chan, SWITCH_TO_CHILD);
+	if (shim_waitpid(pid, &status, 0) < 0)
+		(void)stress_kill_pid_wait(pid, NULL);
+	wake->close(&chan);
+
+	stress_latency_merge(latency, &shared->latency[SWITCH_TO_CHILD]);
+	stress_latency_merge(latency, &shared->latency[SWITCH_TO_PARENT]);
+	return 0;
+}
+
+/*
+ *  stress_switch_topology()
+ *	measure one-way wake latency between a parent and child
+ *	pinned at each cpu topology distance for each wake method,
+ *	different cpu pairs are used on each pass
+ */
+static int stress_switch_topology(stress_args_t *args)
+{
+	stress_cpu_topology_t *topology;
+	stress_switch_shared_t *shared;
+	stress_latency_t *latencies;
+	uint32_t n_cpus;
+	uint64_t pass;
+	cpu_set_t mask;
+	size_t w, idx;
+	int d, rc = EXIT_SUCCESS;
+	bool found[CPU_DISTANCE_MAX];
+	uint32_t example[CPU_DISTANCE_MAX][2];
+
+	if (sched_getaffinity(0, sizeof(mask), &mask) < 0) {
+		pr_inf_skip("%s: cannot get cpu affinity, errno=%d (%s), skipping stressor\n",
+			args->name, errno, strerror(errno));
+		return EXIT_NO_RESOURCE;
+	}
+	topology = stress_cpu_topology_get(&n_cpus);
+	if (!topology) {
+		pr_inf_skip("%s: cannot determine cpu topology, skipping stressor\n",
+			args->name);
+		return EXIT_NO_RESOURCE;
+	}
+	shared = (stress_switch_shared_t *)stress_mmap_populate(NULL, sizeof(*shared),
+		PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (shared == MAP_FAILED) {
+		pr_inf_skip("%s: cannot mmap shared latency data, skipping stressor\n",
+			args->name);
+		free(topology);
+		return EXIT_NO_RESOURCE;
+	}
+	latencies = (stress_latency_t *)calloc(CPU_DISTANCE_MAX * SWITCH_WAKES, sizeof(*latencies));
+	if (!latencies) {
+		pr_inf_skip("%s: cannot allocate latency data, skipping stressor\n",
+			args->name);
+		(void)munmap((void *)shared, sizeof(*shared));
+		free(topology);
+		return EXIT_NO_RESOURCE;
+	}
+	for (idx = 0; idx < CPU_DISTANCE_MAX * SWITCH_WAKES; idx++)
+		stress_latency_init(&latencies[idx]);
+	(void)shim_memset(found, 0, sizeof(found));
+	(void)shim_memset(example, 0, sizeof(example));
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+	for (pass = 0; stress_continue(args); pass++) {
+		bool any = false;
+
+		for (d = 0; (d < CPU_DISTANCE_MAX) && stress_continue(args); d++) {
+			uint32_t cpu1, cpu2;
+
+			if (!stress_switch_topology_pair(topology, n_cpus,
+					(stress_cpu_distance_t)d, pass + args->instance, &cpu1, &cpu2))
+				continue;
+			if (!found[d]) {
+				found[d] = true;
+				example[d][0] = (uint32_t)topology[cpu1].cpu;
+				example[d][1] = (uint32_t)topology[cpu2].cpu;
+			}
+			any = true;
+			for (w = 0; (w < SWITCH_WAKES) && stress_continue(args); w++) {
+				if (stress_switch_topology_slice(args, &stress_switch_wakes[w],
+						topology[cpu1].cpu, topology[cpu2].cpu, shared,
+						&latencies[(d * SWITCH_WAKES) + w]) < 0) {
+					rc = EXIT_FAILURE;
+					goto restore;
+				}
+			}
+		}
+		if (!any) {
+			pr_inf_skip("%s: cannot pin to any cpus, skipping stressor\n",
+				args->name);
+			rc = EXIT_NO_RESOURCE;
+			goto restore;
+		}
+	}
+
+	if (args->instance == 0) {
+		char hdr[256];
+		size_t len;
+
+		len = (size_t)snprintf(hdr, sizeof(hdr), "%-12s %-11s", "placement", "e.g. cpus");
+		for (w = 0; w < SWITCH_WAKES; w++)
+			len += (size_t)snprintf(hdr + len, sizeof(hdr) - len, " %8s %8s",
+				stress_switch_wakes[w].name, "p99");
+		pr_inf("%s: one-way wake latency (nanosecs) by placement:\n", args->name);
+		pr_inf("%s: %s\n", args->name, hdr);
+	}
+	for (idx = 0, d = 0; d < CPU_DISTANCE_MAX; d++) {
+		const char *name = stress_cpu_topology_distance_name((stress_cpu_distance_t)d);
+		char row[256], cpus[32];
+		size_t len;
+
+		if (!found[d]) {
+			if (args->instance == 0)
+				pr_inf("%s: %-12s %-11s (no cpu pairs)\n", args->name, name, "-");
+			continue;
+		}
+		(void)snprintf(cpus, sizeof(cpus), "%" PRIu32 ",%" PRIu32, example[d][0], example[d][1]);
+		len = (size_t)snprintf(row, sizeof(row), "%-12s %-11s", name, cpus);
+		for (w = 0; w < SWITCH_WAKES; w++) {
+			const stress_latency_t *lat = &latencies[(d * SWITCH_WAKES) + w];
+			char desc[64];
+
+			if (lat->count == 0) {
+				len += (size_t)snprintf(row + len, sizeof(row) - len, " %8s %8s", "-", "-");
+				continue;
+			}
+			len += (size_t)snprintf(row + len, sizeof(row) - len, " %8.0f %8" PRIu64,
+				stress_latency_mean(lat), stress_latency_percentile(lat, 99.0));
+			(void)snprintf(desc, sizeof(desc), "nanosecs %s %s wake latency",
+				name, stress_switch_wakes[w].name);
+			stress_metrics_set(args, idx++, desc, stress_latency_mean(lat),
+				STRESS_GEOMETRIC_MEAN);
+		}
+		if (args->instance == 0)
+			pr_inf("%s: %s\n", args->name, row);
+	}
+
+restore:
+	(void)sched_setaffinity(0, sizeof(mask), &mask);
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+	free(latencies);
+	(void)munmap((void *)shared, sizeof(*shared));
+	free(topology);
+
+	return rc;
+}
+#endif
+
 static stress_switch_method_t stress_switch_methods[] = {
 #if defined(HAVE_MQUEUE_H) &&   \
     defined(HAVE_LIB_RT) &&     \
@@ -530,9 +1020,22 @@ static int stress_switch(stress_args_t *args)
 {
 	uint64_t switch_freq = 0, switch_delay, threshold;
 	size_t switch_method;
+	bool switch_topology = false;
 
 	(void)stress_get_setting("switch-freq", &switch_freq);
 	(void)stress_get_setting("switch-method", &switch_method);
+	(void)stress_get_setting("switch-topology", &switch_topology);
+
+	if (switch_topology) {
+#if defined(STRESS_SWITCH_TOPOLOGY)
+		return stress_switch_topology(args);
+#else
+		if (args->instance == 0)
+			pr_inf_skip("%s: --switch-topology requires sched_setaffinity, "
+				"skipping stressor\n", args->name);
+		return EXIT_NOT_IMPLEMENTED;
+#endif
+	}
 
 	switch_delay = (switch_freq == 0) ? 0 : STRESS_NANOSECOND / switch_freq;
 	threshold = switch_freq / THRESH_FREQ;
@@ -548,6 +1051,7 @@ static void stress_switch_set_default(void)
 static const stress_opt_set_func_t opt_set_funcs[] = {
 	{ OPT_switch_freq,	stress_set_switch_freq },
 	{ OPT_switch_method,	stress_set_switch_method },
+	{ OPT_switch_topology,	stress_set_switch_topology },
 	{ 0,			NULL }
 };
 
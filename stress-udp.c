@@ -50,6 +50,27 @@ UNEXPECTED
 
 #define UDP_BUF			(1024)	/* UDP I/O buffer size */
 
+#define MIN_UDP_BATCH		(0)
+#define MAX_UDP_BATCH		(256)
+#define DEFAULT_UDP_BATCH	(0)
+
+#define UDP_GSO_SEGS		(16)	/* UDP_BUF sized segments per GSO send */
+#define UDP_GRO_BUF		(65536)	/* GRO coalesced receive buffer size */
+
+/*
+ *  send and receive counters, shared between the client
+ *  and server so the parent can report both sides
+ */
+typedef struct {
+	uint64_t tx_packets;	/* datagrams sent, after GSO segmentation */
+	uint64_t tx_bytes;	/* payload bytes sent */
+	uint64_t tx_calls;	/* send system calls */
+	uint64_t rx_packets;	/* datagrams received, before GRO coalescing */
+	uint64_t rx_bytes;	/* payload bytes received */
+	uint64_t rx_calls;	/* receive system calls */
+	double rx_duration;	/* server receive time */
+} stress_udp_stats_t;
+
 /* See bugs section of udplite(7) */
 #if !defined(SOL_UDPLITE)
 #define SOL_UDPLITE		(136)
@@ -63,8 +84,10 @@ UNEXPECTED
 
 static const stress_help_t help[] = {
 	{ NULL,	"udp N",	"start N workers performing UDP send/receives " },
+	{ NULL,	"udp-batch N",	"send and receive N datagrams per sendmmsg/recvmmsg call" },
 	{ NULL,	"udp-domain D",	"specify domain, default is ipv4" },
 	{ NULL, "udp-gro",	"enable UDP-GRO" },
+	{ NULL, "udp-gso",	"enable UDP-GSO segmentation offload in batched mode" },
 	{ NULL,	"udp-if I",	"use network interface I, e.g. lo, eth0, etc." },
 	{ NULL,	"udp-lite",	"use the UDP-Lite (RFC 3828) protocol" },
 	{ NULL,	"udp-ops N",	"stop after N udp bogo operations" },
@@ -105,11 +128,288 @@ static int stress_set_udp_gro(const char *opt)
 	return stress_set_setting_true("udp-gro", opt);
 }
 
+static int stress_set_udp_gso(const char *opt)
+{
+	return stress_set_setting_true("udp-gso", opt);
+}
+
 static int stress_set_udp_if(const char *name)
 {
 	return stress_set_setting("udp-if", TYPE_ID_STR, name);
 }
 
+static int stress_set_udp_batch(const char *opt)
+{
+	size_t udp_batch;
+
+	udp_batch = (size_t)stress_get_uint64(opt);
+	stress_check_range("udp-batch", (uint64_t)udp_batch,
+		MIN_UDP_BATCH, MAX_UDP_BATCH);
+	return stress_set_setting("udp-batch", TYPE_ID_SIZE_T, &udp_batch);
+}
+
+#if defined(HAVE_SENDMMSG)
+/*
+ *  stress_udp_client_batch()
+ *	send udp_batch datagrams per sendmmsg call, with GSO each
+ *	message is UDP_GSO_SEGS segments that the kernel splits
+ *	into UDP_BUF sized datagrams
+ */
+static int OPTIMIZE3 stress_udp_client_batch(
+	stress_args_t *args,
+	const int fd,
+	struct sockaddr *addr,
+	const socklen_t len,
+	const int udp_proto,
+	const int udp_port,
+	const size_t udp_batch,
+	const bool udp_gso,
+	const pid_t pid,
+	stress_udp_stats_t *stats)
+{
+	struct mmsghdr *msgvec;
+	struct iovec iov;
+	size_t i, segs = 1, msg_size;
+	char *buf;
+	int rc = EXIT_SUCCESS;
+
+#if defined(UDP_SEGMENT)
+	if (udp_gso) {
+		int val = UDP_BUF;
+
+		if (setsockopt(fd, udp_proto, UDP_SEGMENT, &val, sizeof(val)) == 0) {
+			segs = UDP_GSO_SEGS;
+		} else if (args->instance == 0) {
+			pr_inf("%s: cannot enable UDP_SEGMENT, errno=%d (%s), "
+				"disabling GSO\n", args->name, errno, strerror(errno));
+		}
+	}
+#else
+	(void)udp_proto;
+	(void)udp_gso;
+#endif
+	msg_size = UDP_BUF * segs;
+
+	msgvec = (struct mmsghdr *)calloc(udp_batch, sizeof(*msgvec));
+	if (!msgvec) {
+		pr_inf("%s: cannot allocate %zu sendmmsg messages\n",
+			args->name, udp_batch);
+		return EXIT_NO_RESOURCE;
+	}
+	buf = (char *)malloc(msg_size);
+	if (!buf) {
+		pr_inf("%s: cannot allocate %zu byte send buffer\n",
+			args->name, msg_size);
+		free(msgvec);
+		return EXIT_NO_RESOURCE;
+	}
+
+	/* each segment is a datagram and starts with the client pid */
+	(void)shim_memset(buf, stress_mwc8(), msg_size);
+	for (i = 0; i < segs; i++)
+		(void)shim_memcpy(buf + (i * UDP_BUF), &pid, sizeof(pid));
+
+	iov.iov_base = buf;
+	iov.iov_len = msg_size;
+	for (i = 0; i < udp_batch; i++) {
+		msgvec[i].msg_hdr.msg_name = addr;
+		msgvec[i].msg_hdr.msg_namelen = len;
+		msgvec[i].msg_hdr.msg_iov = &iov;
+		msgvec[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	do {
+		int ret;
+
+		ret = sendmmsg(fd, msgvec, (unsigned int)udp_batch, 0);
+		if (UNLIKELY(ret < 0)) {
+			if ((errno == EINTR) || (errno == ENETUNREACH))
+				continue;
+			if ((errno == ENOBUFS) || (errno == ENOMEM)) {
+				(void)shim_usleep(10000);
+				continue;
+			}
+			if (errno == EPERM) {
+				(void)shim_usleep(250000);
+				continue;
+			}
+			pr_fail("%s: sendmmsg on port %d failed, errno=%d (%s)\n",
+				args->name, udp_port, errno, strerror(errno));
+			rc = EXIT_FAILURE;
+			break;
+		}
+		stats->tx_calls++;
+		stats->tx_packets += (uint64_t)ret * segs;
+		stats->tx_bytes += (uint64_t)ret * msg_size;
+	} while (stress_continue(args));
+
+	free(buf);
+	free(msgvec);
+
+	return rc;
+}
+#endif
+
+#if defined(HAVE_RECVMMSG)
+/*
+ *  stress_udp_server_gro_size()
+ *	return the GRO segment size of a coalesced datagram, 0 if
+ *	the datagram was not coalesced
+ */
+static int stress_udp_server_gro_size(struct msghdr *msg, const int udp_proto)
+{
+#if defined(UDP_GRO)
+	struct cmsghdr *cmsg;
+
+	for (cmsg = CMSG_FIRSTHDR(msg); cmsg; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+		if ((cmsg->cmsg_level == udp_proto) && (cmsg->cmsg_type == UDP_GRO)) {
+			int gso_size;
+
+			(void)shim_memcpy(&gso_size, CMSG_DATA(cmsg), sizeof(gso_size));
+			return gso_size;
+		}
+	}
+#else
+	(void)msg;
+	(void)udp_proto;
+#endif
+	return 0;
+}
+
+/*
+ *  stress_udp_server_batch()
+ *	receive up to udp_batch datagrams per recvmmsg call, with
+ *	GRO enabled each may be several coalesced datagrams
+ */
+static int OPTIMIZE3 stress_udp_server_batch(
+	stress_args_t *args,
+	const int fd,
+	const int udp_proto,
+	const pid_t client_pid,
+	const size_t udp_batch,
+	const bool udp_gro,
+	stress_udp_stats_t *stats)
+{
+	const size_t buf_size = udp_gro ? UDP_GRO_BUF : UDP_BUF;
+	const size_t bufs_size = buf_size * udp_batch;
+	const size_t ctrl_size = CMSG_SPACE(sizeof(int));
+	struct mmsghdr *msgvec;
+	struct iovec *iov;
+	char *bufs, *ctrls;
+	size_t i;
+	int rc = EXIT_SUCCESS;
+
+	msgvec = (struct mmsghdr *)calloc(udp_batch, sizeof(*msgvec));
+	iov = (struct iovec *)calloc(udp_batch, sizeof(*iov));
+	ctrls = (char *)calloc(udp_batch, ctrl_size);
+	bufs = (char *)stress_mmap_populate(NULL, bufs_size,
+		PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+	if (!msgvec || !iov || !ctrls || (bufs == MAP_FAILED)) {
+		pr_inf_skip("%s: cannot allocate %zu recvmmsg messages, skipping stressor\n",
+			args->name, udp_batch);
+		rc = EXIT_NO_RESOURCE;
+		goto free_bufs;
+	}
+	for (i = 0; i < udp_batch; i++) {
+		iov[i].iov_base = bufs + (i * buf_size);
+		iov[i].iov_len = buf_size;
+		msgvec[i].msg_hdr.msg_iov = &iov[i];
+		msgvec[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	do {
+		int n;
+
+		for (i = 0; i < udp_batch; i++) {
+			msgvec[i].msg_hdr.msg_control = ctrls + (i * ctrl_size);
+			msgvec[i].msg_hdr.msg_controllen = ctrl_size;
+			msgvec[i].msg_hdr.msg_flags = 0;
+		}
+		n = recvmmsg(fd, msgvec, (unsigned int)udp_batch, MSG_WAITFORONE, NULL);
+		if (UNLIKELY(n <= 0)) {
+			if (n == 0)
+				break;
+			if (errno == ENOBUFS) {
+				(void)shim_usleep(10000);
+				continue;
+			}
+			if (errno != EINTR) {
+				pr_fail("%s: recvmmsg failed, errno=%d (%s)\n",
+					args->name, errno, strerror(errno));
+				rc = EXIT_FAILURE;
+			}
+			break;
+		}
+		stats->rx_calls++;
+		for (i = 0; i < (size_t)n; i++) {
+			const size_t len = (size_t)msgvec[i].msg_len;
+			const int gso_size = stress_udp_server_gro_size(&msgvec[i].msg_hdr, udp_proto);
+			const uint64_t packets = (gso_size > 0) ?
+				(uint64_t)((len + (size_t)gso_size - 1) / (size_t)gso_size) : 1;
+			pid_t pid;
+
+			(void)shim_memcpy(&pid, iov[i].iov_base, sizeof(pid));
+			if (UNLIKELY(pid != client_pid)) {
+				pr_fail("%s: server received unexpected data "
+					"contents, got 0x%" PRIxMAX ", "
+					"expected 0x%" PRIxMAX "\n",
+					args->name, (intmax_t)pid,
+					(intmax_t)client_pid);
+				rc = EXIT_FAILURE;
+				goto free_bufs;
+			}
+			stats->rx_packets += packets;
+			stats->rx_bytes += len;
+			stress_bogo_add(args, packets);
+		}
+	} while (stress_continue(args));
+
+free_bufs:
+	if (bufs != MAP_FAILED)
+		(void)munmap((void *)bufs, bufs_size);
+	free(ctrls);
+	free(iov);
+	free(msgvec);
+
+	return rc;
+}
+#endif
+
+/*
+ *  stress_udp_report()
+ *	report packet and byte rates and system calls per packet
+ */
+static void stress_udp_report(
+	stress_args_t *args,
+	const stress_udp_stats_t *stats,
+	const size_t udp_batch,
+	const bool udp_gso,
+	const bool udp_gro)
+{
+	const double duration = stats->rx_duration;
+	const double rx_rate = (duration > 0.0) ? (double)stats->rx_packets / duration : 0.0;
+	const double rx_mb_rate = (duration > 0.0) ? (double)stats->rx_bytes / duration / (double)MB : 0.0;
+	const double tx_rate = (duration > 0.0) ? (double)stats->tx_packets / duration : 0.0;
+	const double rx_calls = (stats->rx_packets > 0) ?
+		(double)stats->rx_calls / (double)stats->rx_packets : 0.0;
+	const double tx_calls = (stats->tx_packets > 0) ?
+		(double)stats->tx_calls / (double)stats->tx_packets : 0.0;
+
+	stress_metrics_set(args, 0, "packets received per sec", rx_rate, STRESS_HARMONIC_MEAN);
+	stress_metrics_set(args, 1, "MB received per sec", rx_mb_rate, STRESS_HARMONIC_MEAN);
+	stress_metrics_set(args, 2, "packets sent per sec", tx_rate, STRESS_HARMONIC_MEAN);
+	stress_metrics_set(args, 3, "receive syscalls per packet", rx_calls, STRESS_GEOMETRIC_MEAN);
+	stress_metrics_set(args, 4, "send syscalls per packet", tx_calls, STRESS_GEOMETRIC_MEAN);
+
+	if ((udp_batch > 0) && (args->instance == 0)) {
+		pr_inf("%s: batch %zu%s%s: %.2f packets/sec, %.2f MB/sec received, "
+			"%.4f receive and %.4f send syscalls per packet\n",
+			args->name, udp_batch,
+			udp_gso ? ", GSO" : "", udp_gro ? ", GRO" : "",
+			rx_rate, rx_mb_rate, rx_calls, tx_calls);
+	}
+}
+
 static int OPTIMIZE3 stress_udp_client(
 	stress_args_t *args,
 	const pid_t mypid,
@@ -117,7 +417,10 @@ static int OPTIMIZE3 stress_udp_client(
 	const int udp_proto,
 	const int udp_port,
 	const bool udp_gro,
-	const char *udp_if)
+	const bool udp_gso,
+	const size_t udp_batch,
+	const char *udp_if,
+	stress_udp_stats_t *stats)
 {
 	struct sockaddr *addr = NULL;
 	int rc = EXIT_FAILURE;
@@ -254,6 +557,19 @@ static int OPTIMIZE3 stress_udp_client(
 		}
 #else
 		UNEXPECTED
+#endif
+#if defined(HAVE_SENDMMSG)
+		if (udp_batch > 0) {
+			rc = stress_udp_client_batch(args, fd, addr, len, udp_proto,
+				udp_port, udp_batch, udp_gso, pid, stats);
+			(void)close(fd);
+			if (rc != EXIT_SUCCESS)
+				goto child_die;
+			continue;
+		}
+#else
+		(void)udp_batch;
+		(void)udp_gso;
 #endif
 		(void)shim_memset(buf, stress_mwc8(), sizeof(buf));
 		*pidptr = pid;
@@ -282,6 +598,9 @@ static int OPTIMIZE3 stress_udp_client(
 					(void)close(fd);
 					goto child_die;
 				}
+				stats->tx_calls++;
+				stats->tx_packets++;
+				stats->tx_bytes += (uint64_t)ret;
 			}
 #if defined(SIOCOUTQ)
 			{
@@ -317,7 +636,9 @@ static int OPTIMIZE3 stress_udp_server(
 	const int udp_proto,
 	const int udp_port,
 	const bool udp_gro,
-	const char *udp_if)
+	const size_t udp_batch,
+	const char *udp_if,
+	stress_udp_stats_t *stats)
 {
 	char ALIGN64 buf[UDP_BUF];
 	int fd;
@@ -327,6 +648,7 @@ static int OPTIMIZE3 stress_udp_server(
 	socklen_t addr_len = 0;
 	struct sockaddr *addr = NULL;
 	int rc = EXIT_FAILURE;
+	double t_start;
 
 	if (stress_sig_stop_stressing(args->name, SIGALRM) < 0)
 		goto die;
@@ -379,6 +701,17 @@ static int OPTIMIZE3 stress_udp_server(
 	}
 #else
 	(void)udp_gro;
+#endif
+	t_start = stress_time_now();
+#if defined(HAVE_RECVMMSG)
+	if (udp_batch > 0) {
+		rc = stress_udp_server_batch(args, fd, udp_proto, client_pid,
+			udp_batch, udp_gro, stats);
+		stats->rx_duration = stress_time_now() - t_start;
+		goto die_close;
+	}
+#else
+	(void)udp_batch;
 #endif
 	do {
 		socklen_t len = addr_len;
@@ -420,9 +753,13 @@ static int OPTIMIZE3 stress_udp_server(
 				rc = EXIT_FAILURE;
 				goto die_close;
 			}
+			stats->rx_calls++;
+			stats->rx_packets++;
+			stats->rx_bytes += (uint64_t)n;
 			stress_bogo_inc(args);
 		}
 	} while (stress_continue(args));
+	stats->rx_duration = stress_time_now() - t_start;
 
 	rc = EXIT_SUCCESS;
 die_close:
@@ -456,7 +793,10 @@ static int stress_udp(stress_args_t *args)
 	bool udp_lite = false;
 #endif
 	bool udp_gro = false;
+	bool udp_gso = false;
+	size_t udp_batch = DEFAULT_UDP_BATCH;
 	char *udp_if = NULL;
+	stress_udp_stats_t *stats;
 
 	if (stress_sigchld_set_handler(args) < 0)
 		return EXIT_NO_RESOURCE;
@@ -493,6 +833,21 @@ static int stress_udp(stress_args_t *args)
 #if defined(UDP_GRO)
 	(void)stress_get_setting("udp-gro", &udp_gro);
 #endif
+	(void)stress_get_setting("udp-gso", &udp_gso);
+	(void)stress_get_setting("udp-batch", &udp_batch);
+#if !defined(HAVE_SENDMMSG) ||	\
+    !defined(HAVE_RECVMMSG)
+	if ((udp_batch > 0) && (args->instance == 0))
+		pr_inf("%s: sendmmsg or recvmmsg not available, ignoring --udp-batch\n",
+			args->name);
+	udp_batch = 0;
+#endif
+	if (udp_gso && ((udp_batch == 0) || (udp_proto != IPPROTO_UDP))) {
+		if (args->instance == 0)
+			pr_inf("%s: --udp-gso requires --udp-batch and UDP, ignoring option\n",
+				args->name);
+		udp_gso = false;
+	}
 	if (udp_if) {
 		int ret;
 		struct sockaddr if_addr;
@@ -505,6 +860,14 @@ static int stress_udp(stress_args_t *args)
 		}
 	}
 
+	stats = (stress_udp_stats_t *)stress_mmap_populate(NULL, sizeof(*stats),
+		PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (stats == MAP_FAILED) {
+		pr_inf_skip("%s: cannot mmap statistics, skipping stressor\n", args->name);
+		return EXIT_NO_RESOURCE;
+	}
+	(void)shim_memset(stats, 0, sizeof(*stats));
+
 	stress_set_proc_state(args->name, STRESS_STATE_RUN);
 again:
 	parent_cpu = stress_get_cpu();
@@ -514,28 +877,35 @@ again:
 			goto again;
 		pr_fail("%s: fork failed, errno=%d (%s)\n",
 			args->name, errno, strerror(errno));
+		(void)munmap((void *)stats, sizeof(*stats));
 		return EXIT_FAILURE;
 	} else if (pid == 0) {
 		(void)stress_change_cpu(args, parent_cpu);
-		rc = stress_udp_client(args, mypid, udp_domain, udp_proto, udp_port, udp_gro, udp_if);
+		rc = stress_udp_client(args, mypid, udp_domain, udp_proto, udp_port,
+			udp_gro, udp_gso, udp_batch, udp_if, stats);
 		_exit(rc);
 	} else {
 		int status;
 
-		rc = stress_udp_server(args, mypid, pid, udp_domain, udp_proto, udp_port, udp_gro, udp_if);
+		rc = stress_udp_server(args, mypid, pid, udp_domain, udp_proto, udp_port,
+			udp_gro, udp_batch, udp_if, stats);
 		(void)stress_kill_pid_wait(pid, &status);
 		if (WIFEXITED(status))
 			if (WEXITSTATUS(status) != EXIT_SUCCESS)
 				rc = WEXITSTATUS(status);
+		stress_udp_report(args, stats, udp_batch, udp_gso, udp_gro);
 	}
+	(void)munmap((void *)stats, sizeof(*stats));
 	return rc;
 }
 
 static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_udp_batch,	stress_set_udp_batch },
 	{ OPT_udp_domain,	stress_set_udp_domain },
 	{ OPT_udp_port,		stress_set_udp_port },
 	{ OPT_udp_lite,		stress_set_udp_lite },
 	{ OPT_udp_gro,		stress_set_udp_gro },
+	{ OPT_udp_gso,		stress_set_udp_gso },
 	{ OPT_udp_if,		stress_set_udp_if },
 	{ 0,			NULL }
 };
@@ -25,6 +25,7 @@
 #include "core-asm-generic.h"
 #include "core-cpu-cache.h"
 #include "core-builtin.h"
+#include "core-latency.h"
 #include "core-pthread.h"
 #include "core-put.h"
 #include "core-target-clones.h"
@@ -41,6 +42,10 @@
 #define WORKLOAD_THREADED	(1)
 #endif
 
+#if defined(HAVE_LIB_PTHREAD)
+#define WORKLOAD_RATE_THREADED	(1)
+#endif
+
 typedef struct {
 #if defined(WORKLOAD_THREADED)
 	pthread_t pthread;
@@ -76,6 +81,8 @@ typedef struct {
 
 #define STRESS_WORKLOAD_THREADS		(4)
 
+#define STRESS_WORKLOAD_QUEUE_SIZE	(4096)	/* open-loop job queue, power of 2 */
+
 #define STRESS_WORKLOAD_METHOD_ALL	(0)
 #define STRESS_WORKLOAD_METHOD_TIME	(1)
 #define STRESS_WORKLOAD_METHOD_NOP	(2)
@@ -119,6 +126,36 @@ typedef struct {
 	uint64_t overflow;
 } stress_workload_bucket_t;
 
+#if defined(WORKLOAD_RATE_THREADED)
+/* open-loop job, stamped with its scheduled arrival time */
+typedef struct {
+	double scheduled;
+	double run_duration_sec;
+} stress_workload_job_t;
+
+typedef struct {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	uint64_t head;			/* next job to be added */
+	uint64_t tail;			/* next job to be taken */
+	uint64_t served;		/* jobs run to completion */
+	bool stop;
+	int workload_method;
+	uint8_t *buffer;
+	size_t buffer_len;
+	stress_workload_job_t jobs[STRESS_WORKLOAD_QUEUE_SIZE];
+} stress_workload_queue_t;
+
+typedef struct {
+	pthread_t pthread;
+	int ret;
+	stress_workload_queue_t *queue;
+	stress_latency_t queue_delay;		/* start - scheduled arrival */
+	stress_latency_t service;		/* end - start */
+	stress_latency_t response;		/* end - scheduled arrival */
+} stress_workload_rate_thread_t;
+#endif
+
 static const stress_help_t help[] = {
 	{ NULL,	"workload N",		"start N workers that exercise a mix of scheduling loads" },
 	{ NULL,	"workload-dist type",	"workload distribution type [random1, random2, random3, cluster]" },
@@ -129,6 +166,7 @@ static const stress_help_t help[] = {
 	{ NULL, "workload-slice-us N",	"duration of workload time load in microseconds" },
 	{ NULL,	"workload-threads N",	"number of workload threads workers to use, default is 0 (disabled)" },
 	{ NULL, "workload-method M",	"select a workload method, default is all" },
+	{ NULL,	"workload-rate N",	"dispatch N jobs per second open-loop to the workload threads" },
 	{ NULL,	NULL,			NULL }
 };
 
@@ -271,6 +309,19 @@ static int stress_set_workload_method(const char *opt)
 	return -1;
 }
 
+/*
+ *  stress_set_workload_rate()
+ *	set open-loop job arrival rate, jobs per second
+ */
+static int stress_set_workload_rate(const char *opt)
+{
+	uint32_t workload_rate;
+
+	workload_rate = stress_get_uint32(opt);
+	stress_check_range("workload-rate", (uint64_t)workload_rate, 0, 10000000);
+	return stress_set_setting("workload-rate", TYPE_ID_UINT32, &workload_rate);
+}
+
 /*
  *  stress_set_workload_threads()
  *	set number of concurrent workload threads
@@ -289,6 +340,7 @@ static const stress_opt_set_func_t opt_set_funcs[] = {
 	{ OPT_workload_load,		stress_set_workload_load },
 	{ OPT_workload_method,		stress_set_workload_method },
 	{ OPT_workload_quanta_us,	stress_set_workload_quanta_us },
+	{ OPT_workload_rate,		stress_set_workload_rate },
 	{ OPT_workload_sched,		stress_set_workload_sched },
 	{ OPT_workload_slice_us,	stress_set_workload_slice_us },
 	{ OPT_workload_threads,		stress_set_workload_threads },
@@ -897,12 +949,276 @@ static void *stress_workload_thread(void *ctxt)
 }
 #endif
 
+#if defined(WORKLOAD_RATE_THREADED)
+/*
+ *  stress_workload_ns()
+ *	convert a duration in seconds to nanoseconds
+ */
+static inline uint64_t stress_workload_ns(const double secs)
+{
+	return (secs > 0.0) ? (uint64_t)(secs * STRESS_DBL_NANOSECOND) : 0;
+}
+
+/*
+ *  stress_workload_rate_thread()
+ *	take jobs off the open-loop queue and run them, queueing
+ *	delay is measured from the scheduled arrival time and not
+ *	the time the dispatcher managed to queue the job so that
+ *	dispatcher stalls are not hidden (coordinated omission)
+ */
+static void *stress_workload_rate_thread(void *ptr)
+{
+	stress_workload_rate_thread_t *thread = (stress_workload_rate_thread_t *)ptr;
+	stress_workload_queue_t *q = thread->queue;
+	uint64_t served = 0;
+
+	for (;;) {
+		stress_workload_job_t job;
+		double t_start, t_end;
+
+		(void)pthread_mutex_lock(&q->lock);
+		/* account the previous job while the lock is held anyway */
+		q->served += served;
+		served = 0;
+		while ((q->head == q->tail) && !q->stop)
+			(void)pthread_cond_wait(&q->cond, &q->lock);
+		if (q->stop) {
+			(void)pthread_mutex_unlock(&q->lock);
+			break;
+		}
+		job = q->jobs[q->tail & (STRESS_WORKLOAD_QUEUE_SIZE - 1)];
+		q->tail++;
+		(void)pthread_mutex_unlock(&q->lock);
+
+		t_start = stress_time_now();
+		stress_workload_waste_time(q->workload_method, job.run_duration_sec, q->buffer, q->buffer_len);
+		t_end = stress_time_now();
+
+		stress_latency_add(&thread->queue_delay, stress_workload_ns(t_start - job.scheduled));
+		stress_latency_add(&thread->service, stress_workload_ns(t_end - t_start));
+		stress_latency_add(&thread->response, stress_workload_ns(t_end - job.scheduled));
+		served = 1;
+	}
+	return NULL;
+}
+
+/*
+ *  stress_workload_rate()
+ *	open-loop mode, dispatch jobs at a fixed arrival rate
+ *	(or poisson arrivals with --workload-dist poisson) to a
+ *	pool of threads regardless of how quickly they are served
+ */
+static int stress_workload_rate(
+	stress_args_t *args,
+	const uint32_t workload_rate,
+	const uint32_t workload_threads,
+	const int workload_method,
+	const uint32_t workload_load,
+	const uint32_t workload_quanta_us,
+	const int workload_dist,
+	uint8_t *buffer,
+	const size_t buffer_len)
+{
+	stress_workload_queue_t *q;
+	stress_workload_rate_thread_t *threads;
+	stress_latency_t *lats;
+	const double interval = 1.0 / (double)workload_rate;
+	const double run_duration_sec = (double)workload_quanta_us *
+		((double)workload_load / 100.0) / STRESS_DBL_MICROSECOND;
+	const double scale32bit = 1.0 / (double)4294967296.0;
+	double t_begin, t_next, t_stop, duration;
+	uint64_t dropped = 0, dispatched, unserved, pos;
+	uint32_t i, threads_started = 0;
+	static const char * const lat_names[] = {
+		"queue delay", "service time", "response time"
+	};
+	size_t j, k;
+	int rc = EXIT_SUCCESS;
+
+	q = (stress_workload_queue_t *)calloc(1, sizeof(*q));
+	if (!q) {
+		pr_inf_skip("%s: cannot allocate job queue, skipping stressor\n", args->name);
+		return EXIT_NO_RESOURCE;
+	}
+	threads = (stress_workload_rate_thread_t *)calloc((size_t)workload_threads, sizeof(*threads));
+	if (!threads) {
+		pr_inf_skip("%s: failed to allocate %" PRIu32 " thread "
+			"descriptors, skipping stressor\n",
+			args->name, workload_threads);
+		free(q);
+		return EXIT_NO_RESOURCE;
+	}
+	lats = (stress_latency_t *)calloc(SIZEOF_ARRAY(lat_names), sizeof(*lats));
+	if (!lats) {
+		pr_inf_skip("%s: cannot allocate latency histograms, skipping stressor\n", args->name);
+		free(threads);
+		free(q);
+		return EXIT_NO_RESOURCE;
+	}
+
+	(void)pthread_mutex_init(&q->lock, NULL);
+	(void)pthread_cond_init(&q->cond, NULL);
+	q->workload_method = workload_method;
+	q->buffer = buffer;
+	q->buffer_len = buffer_len;
+
+	for (j = 0; j < SIZEOF_ARRAY(lat_names); j++)
+		stress_latency_init(&lats[j]);
+	for (i = 0; i < workload_threads; i++) {
+		threads[i].queue = q;
+		stress_latency_init(&threads[i].queue_delay);
+		stress_latency_init(&threads[i].service);
+		stress_latency_init(&threads[i].response);
+		threads[i].ret = pthread_create(&threads[i].pthread, NULL,
+			stress_workload_rate_thread, (void *)&threads[i]);
+		if (threads[i].ret == 0)
+			threads_started++;
+	}
+	if (threads_started == 0) {
+		pr_inf_skip("%s: no threads started, skipping stressor\n",
+			args->name);
+		rc = EXIT_NO_RESOURCE;
+		goto tidy;
+	}
+	if (args->instance == 0)
+		pr_inf("%s: open-loop dispatch of %" PRIu32 " jobs per second to %" PRIu32
+			" threads, %.1f usec service time per job\n",
+			args->name, workload_rate, threads_started,
+			run_duration_sec * STRESS_DBL_MICROSECOND);
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+	t_begin = stress_time_now();
+	t_next = t_begin;
+	do {
+		const double now = stress_time_now();
+
+		if (now < t_next) {
+			shim_nanosleep_uint64((uint64_t)((t_next - now) * STRESS_DBL_NANOSECOND));
+			continue;
+		}
+		/*
+		 *  Jobs that are due are queued immediately with their
+		 *  scheduled time even if the dispatcher is running late,
+		 *  the queue never blocks the dispatcher; jobs that do not
+		 *  fit are dropped and counted. Dropped jobs are never served,
+		 *  so the time they have waited so far is recorded as a lower
+		 *  bound of their queue delay and response time to keep them
+		 *  in the tail.
+		 */
+		(void)pthread_mutex_lock(&q->lock);
+		if ((q->head - q->tail) < STRESS_WORKLOAD_QUEUE_SIZE) {
+			stress_workload_job_t *job = &q->jobs[q->head & (STRESS_WORKLOAD_QUEUE_SIZE - 1)];
+
+			job->scheduled = t_next;
+			job->run_duration_sec = run_duration_sec;
+			q->head++;
+			(void)pthread_cond_signal(&q->cond);
+		} else {
+			const uint64_t waited = stress_workload_ns(now - t_next);
+
+			dropped++;
+			stress_latency_add(&lats[0], waited);
+			stress_latency_add(&lats[2], waited);
+		}
+		/* only served jobs are bogo-ops, not dropped or queued ones */
+		stress_bogo_set(args, q->served);
+		(void)pthread_mutex_unlock(&q->lock);
+
+		if (workload_dist == STRESS_WORKLOAD_DIST_POISSON) {
+			const double rnd = (double)stress_mwc32() * scale32bit;
+
+			t_next += -log(1.0 - rnd) * interval;
+		} else {
+			t_next += interval;
+		}
+	} while (stress_continue(args));
+	duration = stress_time_now() - t_begin;
+
+	(void)pthread_mutex_lock(&q->lock);
+	q->stop = true;
+	(void)pthread_cond_broadcast(&q->cond);
+	dispatched = q->head;
+	unserved = q->head - q->tail;
+	/* jobs still queued at stop waited at least until now */
+	t_stop = stress_time_now();
+	for (pos = q->tail; pos != q->head; pos++) {
+		const stress_workload_job_t *job = &q->jobs[pos & (STRESS_WORKLOAD_QUEUE_SIZE - 1)];
+		const uint64_t waited = stress_workload_ns(t_stop - job->scheduled);
+
+		stress_latency_add(&lats[0], waited);
+		stress_latency_add(&lats[2], waited);
+	}
+	(void)pthread_mutex_unlock(&q->lock);
+
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	for (i = 0; i < workload_threads; i++) {
+		if (threads[i].ret == 0) {
+			VOID_RET(int, pthread_join(threads[i].pthread, NULL));
+			stress_latency_merge(&lats[0], &threads[i].queue_delay);
+			stress_latency_merge(&lats[1], &threads[i].service);
+			stress_latency_merge(&lats[2], &threads[i].response);
+		}
+	}
+	stress_bogo_set(args, q->served);
+
+	if (dropped > 0)
+		pr_dbg("%s: %" PRIu64 " jobs dropped, job queue of %d jobs full\n",
+			args->name, dropped, STRESS_WORKLOAD_QUEUE_SIZE);
+
+	k = 0;
+	stress_metrics_set(args, k++, "jobs served per sec",
+		duration > 0.0 ? (double)lats[1].count / duration : 0.0,
+		STRESS_HARMONIC_MEAN);
+	stress_metrics_set(args, k++, "% jobs dropped",
+		(dispatched + dropped) ? 100.0 * (double)dropped / (double)(dispatched + dropped) : 0.0,
+		STRESS_GEOMETRIC_MEAN);
+	stress_metrics_set(args, k++, "jobs unserved", (double)unserved,
+		STRESS_GEOMETRIC_MEAN);
+	for (j = 0; j < SIZEOF_ARRAY(lat_names); j++)
+		k = stress_latency_metrics_set(args, k, lat_names[j], &lats[j]);
+
+	if (args->instance == 0) {
+		pr_block_begin();
+		pr_inf("%s: %-14s %10s %10s %10s %10s %10s (usec)\n",
+			args->name, "", "p50", "p90", "p99", "p99.9", "max");
+		for (j = 0; j < SIZEOF_ARRAY(lat_names); j++) {
+			pr_inf("%s: %-14s %10.2f %10.2f %10.2f %10.2f %10.2f\n",
+				args->name, lat_names[j],
+				(double)stress_latency_percentile(&lats[j], 50.0) / 1000.0,
+				(double)stress_latency_percentile(&lats[j], 90.0) / 1000.0,
+				(double)stress_latency_percentile(&lats[j], 99.0) / 1000.0,
+				(double)stress_latency_percentile(&lats[j], 99.9) / 1000.0,
+				(double)lats[j].max_ns / 1000.0);
+		}
+		if (dropped + unserved) {
+			pr_inf("%s: queue delay and response time include %" PRIu64
+				" dropped and %" PRIu64 " unserved jobs timed to their drop "
+				"or stop time, percentiles are lower bounds\n",
+				args->name, dropped, unserved);
+		}
+		pr_block_end();
+	}
+
+tidy:
+	(void)pthread_cond_destroy(&q->cond);
+	(void)pthread_mutex_destroy(&q->lock);
+	free(lats);
+	free(threads);
+	free(q);
+
+	return rc;
+}
+#endif
+
 static int stress_workload(stress_args_t *args)
 {
 	uint32_t workload_load = 30;
 	uint32_t workload_slice_us = 100000;	/* 1/10th second */
 	uint32_t workload_quanta_us = 1000;	/* 1/1000th second */
 	uint32_t workload_threads = 0;		/* 0 = disabled */
+	uint32_t workload_rate = 0;		/* 0 = disabled */
 	uint32_t max_quanta;
 	size_t workload_sched = 0;		/* undefined */
 	int workload_dist = STRESS_WORKLOAD_DIST_CLUSTER;
@@ -923,6 +1239,7 @@ static int stress_workload(stress_args_t *args)
 	(void)stress_get_setting("workload-load", &workload_load);
 	(void)stress_get_setting("workload-method", &workload_method);
 	(void)stress_get_setting("workload-quanta-us", &workload_quanta_us);
+	(void)stress_get_setting("workload-rate", &workload_rate);
 	(void)stress_get_setting("workload-sched", &workload_sched);
 	(void)stress_get_setting("workload-slice-us", &workload_slice_us);
 	(void)stress_get_setting("workload-threads", &workload_threads);
@@ -950,6 +1267,21 @@ static int stress_workload(stress_args_t *args)
 		return EXIT_NO_RESOURCE;
 	}
 
+	if (workload_rate > 0) {
+#if defined(WORKLOAD_RATE_THREADED)
+		(void)stress_workload_set_sched(args, workload_sched);
+		rc = stress_workload_rate(args, workload_rate,
+			workload_threads ? workload_threads : STRESS_WORKLOAD_THREADS,
+			workload_method, workload_load, workload_quanta_us,
+			workload_dist, buffer, buffer_len);
+#else
+		pr_inf_skip("%s: --workload-rate requires pthread support, "
+			"skipping stressor\n", args->name);
+		rc = EXIT_NOT_IMPLEMENTED;
+#endif
+		goto exit_free_buffer;
+	}
+
 	if (workload_threads > 0) {
 #if defined(WORKLOAD_THREADED)
 		struct mq_attr attr;
@@ -19,6 +19,7 @@
  */
 #include "stress-ng.h"
 #include "core-killpid.h"
+#include "core-latency.h"
 
 #include <sched.h>
 
@@ -31,14 +32,91 @@ static const stress_help_t help[] = {
 #if defined(_POSIX_PRIORITY_SCHEDULING) &&	\
     !defined(__minix__)
 
+/* per yielder scheduling statistics */
+typedef struct {
+	stress_metrics_t metrics;	/* sched_yield call count and duration */
+	stress_schedstat_t start;	/* schedstat when yielding started */
+	stress_schedstat_t end;		/* schedstat just before reaping */
+	double t_start;			/* time yielding started */
+	double t_end;			/* time of the end schedstat */
+	bool schedstat_ok;		/* start and end schedstat are valid */
+	stress_latency_t latency;	/* sched_yield call latency */
+} stress_yield_stats_t;
+
+/*
+ *  stress_yield_report()
+ *	CPU share fairness between the yielders, their run queue
+ *	wait and the worst case time to get back from a yield
+ */
+static void stress_yield_report(
+	stress_args_t *args,
+	const stress_yield_stats_t *stats,
+	const pid_t *pids,
+	const uint32_t yielders)
+{
+	stress_latency_t latency;
+	double *shares;
+	uint64_t wait_ns = 0, timeslices = 0;
+	double fairness, wait_usec;
+	size_t i, n = 0;
+	int policy;
+	char desc[64];
+	const char *name;
+
+	shares = calloc(yielders, sizeof(*shares));
+	if (!shares)
+		return;
+	stress_latency_init(&latency);
+	for (i = 0; i < yielders; i++) {
+		const stress_yield_stats_t *ys = &stats[i];
+		const double duration = ys->t_end - ys->t_start;
+
+		if ((pids[i] <= 0) || !ys->schedstat_ok || (duration <= 0.0))
+			continue;
+		shares[n++] = ((double)(ys->end.run_ns - ys->start.run_ns) / STRESS_DBL_NANOSECOND) / duration;
+		wait_ns += ys->end.wait_ns - ys->start.wait_ns;
+		timeslices += ys->end.timeslices - ys->start.timeslices;
+		stress_latency_merge(&latency, &ys->latency);
+	}
+	if (n == 0) {
+		free(shares);
+		return;
+	}
+	fairness = stress_sched_fairness(shares, n);
+	wait_usec = timeslices ? ((double)wait_ns / (double)timeslices) / 1000.0 : 0.0;
+	policy = sched_getscheduler(0);
+	name = (policy < 0) ? "unknown" : stress_get_sched_name(policy);
+
+	(void)snprintf(desc, sizeof(desc), "Jain fairness index %s", name);
+	stress_metrics_set(args, 1, desc, fairness, STRESS_GEOMETRIC_MEAN);
+	(void)snprintf(desc, sizeof(desc), "usec rq wait per timeslice %s", name);
+	stress_metrics_set(args, 2, desc, wait_usec, STRESS_GEOMETRIC_MEAN);
+	(void)snprintf(desc, sizeof(desc), "usec max sched_yield latency %s", name);
+	stress_metrics_set(args, 3, desc, (double)latency.max_ns / 1000.0, STRESS_GEOMETRIC_MEAN);
+
+	if (args->instance == 0) {
+		pr_block_begin();
+		pr_inf("%s: %-10s %5s %8s %13s %13s %13s\n", args->name,
+			"policy", "tasks", "Jain", "rq wait/run", "p99 yield", "max yield");
+		pr_inf("%s: %-10s %5s %8s %13s %13s %13s\n", args->name,
+			"", "", "index", "(usec)", "(usec)", "(usec)");
+		pr_inf("%s: %-10s %5zu %8.4f %13.2f %13.2f %13.2f\n", args->name,
+			name, n, fairness, wait_usec,
+			(double)stress_latency_percentile(&latency, 99.0) / 1000.0,
+			(double)latency.max_ns / 1000.0);
+		pr_block_end();
+	}
+	free(shares);
+}
+
 /*
  *  stress on sched_yield()
  *	stress system by sched_yield
  */
 static int stress_yield(stress_args_t *args)
 {
-	stress_metrics_t *metrics;
-	size_t metrics_size;
+	stress_yield_stats_t *stats;
+	size_t stats_size;
 	uint64_t max_ops_per_yielder;
 	int32_t cpus = stress_get_processors_configured();
 	const uint32_t instances = args->num_instances;
@@ -97,20 +175,22 @@ static int stress_yield(stress_args_t *args)
 		return EXIT_NO_RESOURCE;
 	}
 
-	metrics_size = yielders * sizeof(*metrics);
-	metrics = (stress_metrics_t *)
-		stress_mmap_populate(NULL, metrics_size,
+	stats_size = yielders * sizeof(*stats);
+	stats = (stress_yield_stats_t *)
+		stress_mmap_populate(NULL, stats_size,
 			PROT_READ | PROT_WRITE,
 			MAP_SHARED | MAP_ANONYMOUS, -1, 0);
-	if (metrics == MAP_FAILED) {
+	if (stats == MAP_FAILED) {
 		pr_err("%s: mmap failed, count not allocate %zd bytes, errno=%d (%s)\n",
-			args->name, metrics_size, errno, strerror(errno));
+			args->name, stats_size, errno, strerror(errno));
 		free(pids);
 		return EXIT_NO_RESOURCE;
 	}
 	for (i = 0; i < yielders; i++) {
-		metrics[i].count = 0.0;
-		metrics[i].duration = 0.0;
+		stats[i].metrics.count = 0.0;
+		stats[i].metrics.duration = 0.0;
+		stats[i].schedstat_ok = false;
+		stress_latency_init(&stats[i].latency);
 	}
 
 	stress_set_proc_state(args->name, STRESS_STATE_RUN);
@@ -122,22 +202,29 @@ static int stress_yield(stress_args_t *args)
 				", yielder %zd): errno=%d (%s)\n",
 				args->name, args->instance, i, errno, strerror(errno));
 		} else if (pids[i] == 0) {
+			stress_yield_stats_t *ys = &stats[i];
+
 			stress_parent_died_alarm();
 			(void)sched_settings_apply(true);
 
+			ys->schedstat_ok = (stress_get_schedstat(0, &ys->start) == 0);
+			ys->t_start = stress_time_now();
 			do {
 				int ret;
 				double t = stress_time_now();
 
 				ret = shim_sched_yield();
 				if (ret == 0) {
-					metrics[i].count += 1.0;
-					metrics[i].duration += (stress_time_now() - t);
+					const double duration = stress_time_now() - t;
+
+					ys->metrics.count += 1.0;
+					ys->metrics.duration += duration;
+					stress_latency_add(&ys->latency, (uint64_t)(duration * STRESS_DBL_NANOSECOND));
 				} else if ((ret < 0) && (g_opt_flags & OPT_FLAGS_VERIFY)) {
 					pr_fail("%s: sched_yield failed, errno=%d (%s)\n",
 						args->name, errno, strerror(errno));
 				}
-			} while (stress_continue_flag() && (!max_ops_per_yielder || (metrics[i].count < max_ops_per_yielder)));
+			} while (stress_continue_flag() && (!max_ops_per_yielder || (ys->metrics.count < max_ops_per_yielder)));
 			_exit(EXIT_SUCCESS);
 		}
 	}
@@ -156,9 +243,15 @@ static int stress_yield(stress_args_t *args)
 	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
 	for (duration = 0.0, count = 0.0, i = 0; i < yielders; i++) {
 		if (pids[i] > 0) {
+			stress_yield_stats_t *ys = &stats[i];
+
+			/* snapshot the yielder's schedstat before it is reaped */
+			if (ys->schedstat_ok)
+				ys->schedstat_ok = (stress_get_schedstat(pids[i], &ys->end) == 0);
+			ys->t_end = stress_time_now();
 			(void)stress_kill_pid_wait(pids[i], NULL);
-			duration += metrics[i].duration;
-			count += metrics[i].count;
+			duration += stats[i].metrics.duration;
+			count += stats[i].metrics.count;
 		}
 	}
 	stress_bogo_add(args, (uint64_t)count);
@@ -166,8 +259,9 @@ static int stress_yield(stress_args_t *args)
 	ns = count > 0.0 ? (STRESS_DBL_NANOSECOND * duration) / count : 0.0;
 	stress_metrics_set(args, 0, "ns duration per sched_yield call",
 		ns, STRESS_HARMONIC_MEAN);
+	stress_yield_report(args, stats, pids, yielders);
 
-	(void)munmap((void *)metrics, metrics_size);
+	(void)munmap((void *)stats, stats_size);
 	free(pids);
 
 	return EXIT_SUCCESS;